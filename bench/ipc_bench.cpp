@@ -0,0 +1,363 @@
+// Compares the ways the bridge and the engine helper exchange messages:
+// framed pipes, and shared-memory rings with pipe doorbells.
+//
+//   bridge_ipc_bench [round_trips]
+//
+// A forked child stands in for the helper and echoes every command back as
+// an event. "rtt" waits for each echo before sending the next command;
+// "throughput" keeps a window of commands in flight.
+//
+// "cancel" queues a backlog of tts_chunk commands that the child spends
+// kChunkWorkMicros on each, as if synthesizing them, then sends tts_cancel
+// and times how long the child takes to confirm it will produce no more
+// audio for the utterance: in line behind the backlog, and on the control
+// lane (see HelperFrame.h).
+
+#include "HelperFrame.h"
+#include "Json.h"
+#include "SharedMemoryMessageRing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using bridge::HelperIpcMode;
+
+constexpr int kPipelineWindow = 64;
+constexpr int kCancelTrials = 40;
+constexpr int kCancelBacklog = 200;
+constexpr auto kChunkWorkMicros = std::chrono::microseconds(250);
+constexpr uint32_t kRingBytes = 1024 * 1024;
+constexpr std::string_view kCommand =
+    "{\"type\":\"tts_chunk\",\"utterance_id\":\"#3:utt-0042\",\"text\":\"The quick brown fox jumps over the lazy dog.\"}";
+
+// One side of the channel. In shared-memory mode `out_ring` carries what
+// this side sends and `in_ring` what it receives; the pipes carry doorbells.
+class Endpoint {
+ public:
+  Endpoint(HelperIpcMode mode, int read_fd, int write_fd, bridge::SharedMemoryMessageRing* out_ring,
+           bridge::SharedMemoryMessageRing* in_ring)
+      : mode_(mode), read_fd_(read_fd), write_fd_(write_fd), out_ring_(out_ring), in_ring_(in_ring), reader_(mode) {}
+
+  bool Send(std::string_view message) {
+    if (mode_ == HelperIpcMode::kSharedMemory) {
+      while (!out_ring_->Write(message)) {
+        usleep(10);
+      }
+      return !out_ring_->TakeWakeup() || SendFrame(bridge::HelperFrameKind::kDoorbell, {});
+    }
+    return SendFrame(bridge::HelperFrameKind::kJson, message);
+  }
+
+  // Blocks until at least one message has arrived and returns how many did;
+  // 0 once the peer has gone.
+  size_t Receive(const std::function<void(std::string_view)>& on_message) {
+    size_t received = 0;
+    const auto deliver = [&](const bridge::HelperFrameReader::Message& message) {
+      if (message.kind == bridge::HelperFrameKind::kJson) {
+        on_message(message.payload);
+        ++received;
+      }
+    };
+    while (true) {
+      if (mode_ == HelperIpcMode::kSharedMemory) {
+        std::string_view message;
+        while (in_ring_->Peek(&message)) {
+          on_message(message);
+          in_ring_->Consume();
+          ++received;
+        }
+        if (received > 0 || !in_ring_->PrepareToWait()) {
+          if (received > 0) {
+            return received;
+          }
+          continue;
+        }
+      }
+      size_t capacity = 0;
+      char* data = reader_.WritableData(&capacity);
+      const ssize_t rc = read(read_fd_, data, capacity);
+      if (mode_ == HelperIpcMode::kSharedMemory) {
+        in_ring_->FinishWait();
+      }
+      if (rc <= 0 || !reader_.Commit(static_cast<size_t>(rc), deliver, nullptr)) {
+        return 0;
+      }
+      if (received > 0) {
+        return received;
+      }
+    }
+  }
+
+ private:
+  bool SendFrame(bridge::HelperFrameKind kind, std::string_view payload) {
+    uint8_t header[bridge::kHelperFrameHeaderBytes];
+    bridge::EncodeHelperFrameHeader(kind, static_cast<uint32_t>(payload.size()), 0, header);
+    struct iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = const_cast<char*>(payload.data());
+    iov[1].iov_len = payload.size();
+    // Frames here are far below PIPE_BUF, so writev() is all or nothing.
+    return writev(write_fd_, iov, payload.empty() ? 1 : 2) ==
+           static_cast<ssize_t>(sizeof(header) + payload.size());
+  }
+
+  HelperIpcMode mode_;
+  int read_fd_;
+  int write_fd_;
+  bridge::SharedMemoryMessageRing* out_ring_;
+  bridge::SharedMemoryMessageRing* in_ring_;
+  bridge::HelperFrameReader reader_;
+};
+
+double Percentile(std::vector<double>* samples, double p) {
+  std::sort(samples->begin(), samples->end());
+  return (*samples)[std::min(samples->size() - 1, static_cast<size_t>(p * static_cast<double>(samples->size())))];
+}
+
+bool OpenRings(HelperIpcMode mode, const std::string& base, bridge::SharedMemoryMessageRing* commands,
+               bridge::SharedMemoryMessageRing* events) {
+  return mode != HelperIpcMode::kSharedMemory ||
+         (commands->Open(base + "_commands", true, kRingBytes) && events->Open(base + "_events", true, kRingBytes));
+}
+
+bool Measure(HelperIpcMode mode, int round_trips) {
+  const char* name = bridge::HelperIpcModeName(mode);
+  const std::string base = "/bridge_ipc_bench_" + std::to_string(getpid());
+  bridge::SharedMemoryMessageRing commands;
+  bridge::SharedMemoryMessageRing events;
+  if (!OpenRings(mode, base, &commands, &events)) {
+    std::cerr << name << ": failed to create rings\n";
+    return false;
+  }
+
+  int to_child[2];
+  int to_parent[2];
+  if (pipe(to_child) != 0 || pipe(to_parent) != 0) {
+    std::cerr << name << ": failed to create pipes\n";
+    return false;
+  }
+  const pid_t child = fork();
+  if (child < 0) {
+    std::cerr << name << ": failed to fork\n";
+    return false;
+  }
+  if (child == 0) {
+    close(to_child[1]);
+    close(to_parent[0]);
+    Endpoint helper(mode, to_child[0], to_parent[1], &events, &commands);
+    bool ok = true;
+    while (ok && helper.Receive([&](std::string_view command) { ok = ok && helper.Send(command); }) > 0) {
+    }
+    // The parent owns the rings' backing files.
+    _exit(0);
+  }
+  close(to_child[0]);
+  close(to_parent[1]);
+
+  Endpoint bridge_side(mode, to_parent[0], to_child[1], &commands, &events);
+  size_t echoes = 0;
+  const auto count = [&echoes](std::string_view) { ++echoes; };
+  const auto wait_for = [&](size_t target) {
+    while (echoes < target) {
+      if (bridge_side.Receive(count) == 0) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  std::vector<double> samples;
+  samples.reserve(static_cast<size_t>(round_trips));
+  bool ok = true;
+  for (int i = 0; ok && i < round_trips; ++i) {
+    const auto start = Clock::now();
+    ok = bridge_side.Send(kCommand) && wait_for(echoes + 1);
+    samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+  }
+
+  const int batches = std::max(1, round_trips * 4 / kPipelineWindow);
+  const auto start = Clock::now();
+  for (int i = 0; ok && i < batches; ++i) {
+    const size_t target = echoes + kPipelineWindow;
+    for (int n = 0; ok && n < kPipelineWindow; ++n) {
+      ok = bridge_side.Send(kCommand);
+    }
+    ok = ok && wait_for(target);
+  }
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  close(to_child[1]);
+  close(to_parent[0]);
+  int status = 0;
+  waitpid(child, &status, 0);
+  if (!ok) {
+    std::cerr << name << ": helper side went away\n";
+    return false;
+  }
+
+  std::cout << name << ": rtt p50=" << Percentile(&samples, 0.50) << " us p99=" << Percentile(&samples, 0.99)
+            << " us, throughput=" << (static_cast<double>(batches) * kPipelineWindow / seconds) << " msgs/s\n";
+  return true;
+}
+
+uint64_t AfterField(std::string_view command) {
+  const size_t at = command.find("\"after\":");
+  return at == std::string_view::npos ? 0 : std::strtoull(command.data() + at + 8, nullptr, 10);
+}
+
+// The stand-in helper for MeasureCancel(). Commands run one at a time under
+// `mutex`, whichever path they came by, as they do on the helper's command
+// queue.
+void RunCancelHelper(Endpoint* helper, Endpoint* control) {
+  std::mutex mutex;
+  uint64_t seen = 0;
+  uint64_t cancelled_before = 0;
+  const auto handle = [&](std::string_view command, bool data) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const uint64_t index = data ? seen++ : 0;
+    const std::string type = bridge::ExtractJsonStringField(command, "type");
+    if (type == "tts_chunk") {
+      if (index >= cancelled_before) {
+        const auto until = Clock::now() + kChunkWorkMicros;
+        while (Clock::now() < until) {
+        }
+      }
+    } else if (type == "tts_cancel") {
+      cancelled_before = std::max(cancelled_before, AfterField(command));
+      (void)helper->Send("{\"type\":\"tts_status\",\"status\":\"completed\"}");
+    } else if (type == "ping") {
+      (void)helper->Send("{\"type\":\"pong\"}");
+    }
+  };
+
+  std::thread control_thread;
+  if (control != nullptr) {
+    control_thread = std::thread([&]() {
+      while (control->Receive([&](std::string_view command) { handle(command, false); }) > 0) {
+      }
+    });
+  }
+  while (helper->Receive([&](std::string_view command) { handle(command, true); }) > 0) {
+  }
+  if (control_thread.joinable()) {
+    control_thread.join();
+  }
+}
+
+bool MeasureCancel(HelperIpcMode mode, bool control_lane) {
+  const std::string name = std::string(bridge::HelperIpcModeName(mode)) + (control_lane ? " control lane" : " in line");
+  const std::string base = "/bridge_ipc_bench_" + std::to_string(getpid());
+  bridge::SharedMemoryMessageRing commands;
+  bridge::SharedMemoryMessageRing events;
+  if (!OpenRings(mode, base, &commands, &events)) {
+    std::cerr << name << ": failed to create rings\n";
+    return false;
+  }
+
+  int to_child[2];
+  int to_parent[2];
+  int control[2];
+  if (pipe(to_child) != 0 || pipe(to_parent) != 0 || pipe(control) != 0) {
+    std::cerr << name << ": failed to create pipes\n";
+    return false;
+  }
+  const pid_t child = fork();
+  if (child < 0) {
+    std::cerr << name << ": failed to fork\n";
+    return false;
+  }
+  if (child == 0) {
+    close(to_child[1]);
+    close(to_parent[0]);
+    close(control[1]);
+    Endpoint helper(mode, to_child[0], to_parent[1], &events, &commands);
+    Endpoint control_side(HelperIpcMode::kFramed, control[0], -1, nullptr, nullptr);
+    RunCancelHelper(&helper, control_lane ? &control_side : nullptr);
+    _exit(0);
+  }
+  close(to_child[0]);
+  close(to_parent[1]);
+  close(control[0]);
+
+  Endpoint bridge_side(mode, to_parent[0], to_child[1], &commands, &events);
+  Endpoint control_side(HelperIpcMode::kFramed, -1, control[1], nullptr, nullptr);
+  std::string received;
+  const auto wait_for = [&](std::string_view type) {
+    while (received.find(type) == std::string::npos) {
+      if (bridge_side.Receive([&](std::string_view event) { received.append(event); }) == 0) {
+        return false;
+      }
+    }
+    received.erase(0, received.find(type) + type.size());
+    return true;
+  };
+
+  std::vector<double> samples;
+  uint64_t sent = 0;
+  bool ok = true;
+  for (int trial = 0; ok && trial < kCancelTrials; ++trial) {
+    for (int i = 0; ok && i < kCancelBacklog; ++i, ++sent) {
+      ok = bridge_side.Send(kCommand);
+    }
+    const std::string cancel =
+        "{\"type\":\"tts_cancel\",\"utterance_id\":\"#3:utt-0042\",\"after\":" + std::to_string(sent) + "}";
+    const auto start = Clock::now();
+    ok = ok && (control_lane ? control_side.Send(cancel) : bridge_side.Send(cancel));
+    sent += control_lane ? 0 : 1;
+    ok = ok && wait_for("completed");
+    samples.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    // Lets the child reach the end of the backlog before the next trial.
+    ok = ok && bridge_side.Send("{\"type\":\"ping\"}") && wait_for("pong");
+    ++sent;
+  }
+
+  close(to_child[1]);
+  close(to_parent[0]);
+  close(control[1]);
+  int status = 0;
+  waitpid(child, &status, 0);
+  if (!ok) {
+    std::cerr << name << ": helper side went away\n";
+    return false;
+  }
+  std::cout << name << ": cancel-to-silence behind " << kCancelBacklog << " chunks p50=" << Percentile(&samples, 0.50)
+            << " ms p99=" << Percentile(&samples, 0.99) << " ms\n";
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int round_trips = argc > 1 ? std::atoi(argv[1]) : 20000;
+  if (round_trips <= 0) {
+    std::cerr << "Usage: " << argv[0] << " [round_trips]\n";
+    return 1;
+  }
+  for (const HelperIpcMode mode : {HelperIpcMode::kFramed, HelperIpcMode::kSharedMemory}) {
+    if (!Measure(mode, round_trips)) {
+      return 1;
+    }
+  }
+  for (const HelperIpcMode mode : {HelperIpcMode::kFramed, HelperIpcMode::kSharedMemory}) {
+    for (const bool control_lane : {false, true}) {
+      if (!MeasureCancel(mode, control_lane)) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,324 @@
+// Measures the bridge JSON layer against recorded protocol messages.
+//
+//   bridge_bench [corpus.jsonl] [iterations]
+//
+// Each line of the corpus is one client or helper message. The frame cases
+// compare building a response and its WebSocket header per message with
+// rendering it from a pre-framed FrameTemplate. The alignment case
+// transcodes the corpus's tts_alignment events into AlignmentBlocks and
+// compares their size with the JSON. The helper ipc cases split the corpus,
+// as the helper would write it, back into messages: line by line with a copy
+// per message as getline() does, and with HelperFrameReader in both modes.
+// The helper events cases hand the corpus from a producer thread, standing
+// in for a helper reader thread, to the main thread: through a deque of
+// strings under a mutex, and through HelperEventQueue.
+
+#include "AlignmentBlock.h"
+#include "HelperEventQueue.h"
+#include "HelperFrame.h"
+#include "Json.h"
+#include "WebSocketFrame.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#ifndef BRIDGE_BENCH_CORPUS
+#define BRIDGE_BENCH_CORPUS "bench/corpus/protocol_messages.jsonl"
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+bool LoadCorpus(const std::string& path, std::vector<std::string>* out) {
+  std::ifstream in(path);
+  if (!in) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    if (!line.empty()) {
+      out->push_back(line);
+    }
+  }
+  return !out->empty();
+}
+
+void Report(const char* name, Clock::duration elapsed, size_t messages, size_t bytes) {
+  const double seconds = std::chrono::duration<double>(elapsed).count();
+  std::cout << name << ": " << (seconds * 1e9 / static_cast<double>(messages)) << " ns/msg, "
+            << (static_cast<double>(bytes) / seconds / (1024.0 * 1024.0)) << " MiB/s\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const std::string corpus_path = argc > 1 ? argv[1] : BRIDGE_BENCH_CORPUS;
+  const int iterations = argc > 2 ? std::atoi(argv[2]) : 2000;
+
+  std::vector<std::string> corpus;
+  if (!LoadCorpus(corpus_path, &corpus) || iterations <= 0) {
+    std::cerr << "Usage: " << argv[0] << " [corpus.jsonl] [iterations]\n";
+    return 1;
+  }
+  size_t corpus_bytes = 0;
+  for (const std::string& line : corpus) {
+    corpus_bytes += line.size();
+  }
+
+  bridge::JsonReader reader;
+  std::string out;
+  std::string again;
+  std::string error;
+
+  // Every message must parse and survive a write/parse/write round trip.
+  for (const std::string& line : corpus) {
+    const bridge::JsonValue* value = reader.Parse(line, &error);
+    if (value == nullptr || !value->is_object() || !value->StringField("type")) {
+      std::cerr << "Corpus message rejected: " << error << "\n" << line << "\n";
+      return 1;
+    }
+    out.clear();
+    bridge::JsonWriter(&out).Value(*value);
+    value = reader.Parse(out, &error);
+    again.clear();
+    bridge::JsonWriter(&again).Value(*value);
+    if (out != again) {
+      std::cerr << "Round trip mismatch:\n" << out << "\n" << again << "\n";
+      return 1;
+    }
+  }
+
+  const size_t messages = corpus.size() * static_cast<size_t>(iterations);
+  const size_t bytes = corpus_bytes * static_cast<size_t>(iterations);
+  size_t sink = 0;
+
+  auto start = Clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    for (const std::string& line : corpus) {
+      const bridge::JsonValue* value = reader.Parse(line, &error);
+      sink += value->StringField("type")->size();
+    }
+  }
+  Report("parse", Clock::now() - start, messages, bytes);
+
+  start = Clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    for (const std::string& line : corpus) {
+      const bridge::JsonValue* value = reader.Parse(line, &error);
+      out.clear();
+      bridge::JsonWriter(&out).Value(*value);
+      sink += out.size();
+    }
+  }
+  Report("parse+serialize", Clock::now() - start, messages, bytes);
+
+  start = Clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    for (size_t n = 0; n < corpus.size(); ++n) {
+      out.clear();
+      bridge::JsonWriter(&out)
+          .BeginObject()
+          .Field("type", "error")
+          .Field("code", "session_not_configured")
+          .Field("message", "configure_session must be sent before TTS/STT commands")
+          .EndObject();
+      sink += out.size();
+    }
+  }
+  Report("build response", Clock::now() - start, messages, messages * out.size());
+
+  // Both frame paths produce a fresh buffer per message, as the send queue
+  // takes ownership of it.
+  const std::string_view code = "session_not_configured";
+  const std::string_view message = "configure_session must be sent before TTS/STT commands";
+  uint8_t header[bridge::kMaxWsHeaderBytes];
+  start = Clock::now();
+  for (size_t n = 0; n < messages; ++n) {
+    std::string payload;
+    bridge::JsonWriter(&payload).BeginObject().Field("type", "error").Field("code", code).Field("message", message).EndObject();
+    sink += bridge::EncodeWebSocketHeader(header, bridge::WsOpcode::kText, payload.size()) + payload.size();
+  }
+  Report("error: build+frame", Clock::now() - start, messages, messages * out.size());
+
+  bridge::FrameTemplate error_frame;
+  error_frame.Literal("{\"type\":\"error\",\"code\":").Slot().Literal(",\"message\":").Slot().Literal("}");
+  start = Clock::now();
+  for (size_t n = 0; n < messages; ++n) {
+    std::string frame;
+    error_frame.Render({code, message}, &frame);
+    sink += frame.size();
+  }
+  Report("error: template", Clock::now() - start, messages, messages * out.size());
+
+  const std::string_view ping_id = "ping-000042";
+  start = Clock::now();
+  for (size_t n = 0; n < messages; ++n) {
+    std::string payload;
+    bridge::JsonWriter(&payload).BeginObject().Field("type", "pong").Field("id", ping_id).EndObject();
+    sink += bridge::EncodeWebSocketHeader(header, bridge::WsOpcode::kText, payload.size()) + payload.size();
+  }
+  Report("pong: build+frame", Clock::now() - start, messages, messages * 32);
+
+  bridge::FrameTemplate pong_frame;
+  pong_frame.Literal("{\"type\":\"pong\",\"id\":").Slot().Literal("}");
+  start = Clock::now();
+  for (size_t n = 0; n < messages; ++n) {
+    std::string frame;
+    pong_frame.Render({ping_id}, &frame);
+    sink += frame.size();
+  }
+  Report("pong: template", Clock::now() - start, messages, messages * 32);
+
+  std::vector<std::string> alignments;
+  for (const std::string& line : corpus) {
+    if (bridge::ExtractJsonStringField(line, "type") == "tts_alignment") {
+      alignments.push_back(line);
+    }
+  }
+  if (!alignments.empty()) {
+    size_t json_bytes = 0;
+    size_t block_bytes = 0;
+    start = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      for (const std::string& line : alignments) {
+        const bridge::JsonValue* value = reader.Parse(line, &error);
+        std::string block;
+        if (value == nullptr || !bridge::EncodeAlignmentBlock(*value, {}, &block, &error)) {
+          std::cerr << "alignment: " << error << "\n";
+          return 1;
+        }
+        json_bytes += line.size();
+        block_bytes += block.size();
+      }
+    }
+    Report("alignment: parse+encode", Clock::now() - start, alignments.size() * static_cast<size_t>(iterations),
+           json_bytes);
+    std::cout << "alignment: json_bytes=" << json_bytes / static_cast<size_t>(iterations)
+              << " block_bytes=" << block_bytes / static_cast<size_t>(iterations) << "\n";
+    sink += block_bytes;
+  }
+
+  std::string lines_stream;
+  std::string frames_stream;
+  for (const std::string& line : corpus) {
+    lines_stream.append(line).push_back('\n');
+    uint8_t header[bridge::kHelperFrameHeaderBytes];
+    bridge::EncodeHelperFrameHeader(bridge::HelperFrameKind::kJson, static_cast<uint32_t>(line.size()), 0, header);
+    frames_stream.append(reinterpret_cast<const char*>(header), sizeof(header)).append(line);
+  }
+
+  start = Clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    std::istringstream stream(lines_stream);
+    std::string line;
+    while (std::getline(stream, line)) {
+      sink += line.size();
+    }
+  }
+  Report("helper ipc: getline", Clock::now() - start, messages, bytes);
+
+  for (const auto& [name, mode, stream] :
+       {std::make_tuple("helper ipc: lines reader", bridge::HelperIpcMode::kJsonLines, &lines_stream),
+        std::make_tuple("helper ipc: frame reader", bridge::HelperIpcMode::kFramed, &frames_stream)}) {
+    bridge::HelperFrameReader frames(mode);
+    size_t seen = 0;
+    const auto count = [&](const bridge::HelperFrameReader::Message& message) {
+      ++seen;
+      sink += message.payload.size();
+    };
+    start = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      // Feed the stream in pipe-sized reads, as the helper reader thread does.
+      for (size_t offset = 0; offset < stream->size();) {
+        size_t capacity = 0;
+        char* data = frames.WritableData(&capacity);
+        const size_t n = std::min({capacity, stream->size() - offset, size_t{16 * 1024}});
+        std::memcpy(data, stream->data() + offset, n);
+        offset += n;
+        if (!frames.Commit(n, count, &error)) {
+          std::cerr << name << ": " << error << "\n";
+          return 1;
+        }
+      }
+    }
+    Report(name, Clock::now() - start, seen, bytes);
+    if (seen != messages) {
+      std::cerr << name << ": read " << seen << " of " << messages << " messages\n";
+      return 1;
+    }
+  }
+
+  {
+    std::mutex mutex;
+    std::deque<std::string> queue;
+    start = Clock::now();
+    std::thread producer([&]() {
+      for (int i = 0; i < iterations; ++i) {
+        for (const std::string& line : corpus) {
+          std::lock_guard<std::mutex> lock(mutex);
+          queue.push_back(std::string(line));
+        }
+      }
+    });
+    std::deque<std::string> batch;
+    for (size_t seen = 0; seen < messages;) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        batch.swap(queue);
+      }
+      if (batch.empty()) {
+        std::this_thread::yield();
+        continue;
+      }
+      for (const std::string& event : batch) {
+        sink += event.size();
+      }
+      seen += batch.size();
+      batch.clear();
+    }
+    producer.join();
+    Report("helper events: mutex deque", Clock::now() - start, messages, bytes);
+  }
+
+  {
+    bridge::HelperEventQueue queue(1024, 1024);
+    start = Clock::now();
+    std::thread producer([&]() {
+      for (int i = 0; i < iterations; ++i) {
+        for (const std::string& line : corpus) {
+          while (!queue.TryPush(1, Clock::now(), line)) {
+            std::this_thread::yield();
+          }
+        }
+      }
+    });
+    bridge::HelperEventQueue::Event event;
+    for (size_t seen = 0; seen < messages;) {
+      if (!queue.Peek(&event)) {
+        std::this_thread::yield();
+        continue;
+      }
+      sink += event.payload.size();
+      queue.Pop();
+      ++seen;
+    }
+    producer.join();
+    Report("helper events: event queue", Clock::now() - start, messages, bytes);
+  }
+
+  std::cout << "messages=" << corpus.size() << " iterations=" << iterations
+            << " arena_bytes=" << reader.arena().capacity() << " checksum=" << sink << "\n";
+  return 0;
+}
@@ -0,0 +1,197 @@
+// Measures bridge::Resampler against the linear interpolation the engine
+// helper used before it, which started over at every block.
+//
+//   bridge_resample_bench [seconds]
+//
+// For each conversion the helper makes, both are fed 10 ms blocks of input:
+//
+// - "thd+n" is a 1 kHz tone at -1 dBFS: everything in the output but that
+//   tone (and DC), relative to it, once the filter has settled.
+// - "alias" is, when converting down, a tone between the output's Nyquist
+//   frequency and the input's, which should not appear in the output at
+//   all: output power relative to the tone's.
+// - "throughput" is input samples converted per second on one core, over
+//   `seconds` of noise.
+
+#include "Resampler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kToneHz = 1000.0;
+constexpr double kToneAmplitude = 0.891;  // -1 dBFS
+constexpr double kSettleSeconds = 0.1;
+
+struct Conversion {
+  uint32_t input_rate;
+  uint32_t output_rate;
+};
+
+// What downmixAndResampleTo16k and pcm16MonoToStereoFloat did: linear
+// interpolation from position 0 of every block.
+std::vector<float> LinearPerBlock(const std::vector<float>& input, const Conversion& conversion, size_t block) {
+  const double ratio = static_cast<double>(conversion.input_rate) / conversion.output_rate;
+  std::vector<float> output;
+  for (size_t start = 0; start < input.size(); start += block) {
+    const size_t count = std::min(block, input.size() - start);
+    const float* chunk = input.data() + start;
+    for (double position = 0.0; static_cast<size_t>(position) < count; position += ratio) {
+      const size_t i = static_cast<size_t>(position);
+      const size_t j = std::min(i + 1, count - 1);
+      const float frac = static_cast<float>(position - static_cast<double>(i));
+      output.push_back(chunk[i] * (1.0f - frac) + chunk[j] * frac);
+    }
+  }
+  return output;
+}
+
+std::vector<float> Polyphase(const std::vector<float>& input, const Conversion& conversion, size_t block) {
+  bridge::Resampler resampler(conversion.input_rate, conversion.output_rate);
+  std::vector<float> output;
+  std::vector<float> scratch;
+  for (size_t start = 0; start < input.size(); start += block) {
+    const size_t count = std::min(block, input.size() - start);
+    scratch.resize(resampler.OutputCapacity(count));
+    const size_t written = resampler.Process(input.data() + start, count, scratch.data(), scratch.size());
+    output.insert(output.end(), scratch.begin(), scratch.begin() + static_cast<std::ptrdiff_t>(written));
+  }
+  return output;
+}
+
+std::vector<float> Tone(double hz, uint32_t rate, double seconds) {
+  std::vector<float> samples(static_cast<size_t>(seconds * rate));
+  for (size_t i = 0; i < samples.size(); ++i) {
+    samples[i] = static_cast<float>(kToneAmplitude * std::sin(2.0 * kPi * hz * static_cast<double>(i) / rate));
+  }
+  return samples;
+}
+
+double Decibels(double ratio) {
+  return 10.0 * std::log10(std::max(ratio, 1e-30));
+}
+
+// Fits a*sin + b*cos + c at `hz` to the settled output by least squares
+// and returns the power of what is left relative to the fitted tone's.
+double ThdPlusNoise(const std::vector<float>& output, double hz, uint32_t rate) {
+  const size_t skip = static_cast<size_t>(kSettleSeconds * rate);
+  const size_t n = output.size() > 2 * skip ? output.size() - 2 * skip : 0;
+  if (n == 0) {
+    return 0.0;
+  }
+  // Normal equations for the basis (sin, cos, 1).
+  double m[3][4] = {};
+  for (size_t i = 0; i < n; ++i) {
+    const double t = 2.0 * kPi * hz * static_cast<double>(skip + i) / rate;
+    const double basis[3] = {std::sin(t), std::cos(t), 1.0};
+    for (int r = 0; r < 3; ++r) {
+      for (int c = 0; c < 3; ++c) {
+        m[r][c] += basis[r] * basis[c];
+      }
+      m[r][3] += basis[r] * output[skip + i];
+    }
+  }
+  for (int p = 0; p < 3; ++p) {
+    for (int r = p + 1; r < 3; ++r) {
+      const double f = m[r][p] / m[p][p];
+      for (int c = p; c < 4; ++c) {
+        m[r][c] -= f * m[p][c];
+      }
+    }
+  }
+  double x[3];
+  for (int r = 2; r >= 0; --r) {
+    double v = m[r][3];
+    for (int c = r + 1; c < 3; ++c) {
+      v -= m[r][c] * x[c];
+    }
+    x[r] = v / m[r][r];
+  }
+  double residual = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    const double t = 2.0 * kPi * hz * static_cast<double>(skip + i) / rate;
+    const double e = output[skip + i] - (x[0] * std::sin(t) + x[1] * std::cos(t) + x[2]);
+    residual += e * e;
+  }
+  const double tone = 0.5 * (x[0] * x[0] + x[1] * x[1]) * static_cast<double>(n);
+  return Decibels(residual / tone);
+}
+
+double Alias(const std::vector<float>& output, uint32_t rate) {
+  const size_t skip = static_cast<size_t>(kSettleSeconds * rate);
+  if (output.size() <= 2 * skip) {
+    return 0.0;
+  }
+  double power = 0.0;
+  for (size_t i = skip; i < output.size() - skip; ++i) {
+    power += static_cast<double>(output[i]) * output[i];
+  }
+  const double tone = 0.5 * kToneAmplitude * kToneAmplitude * static_cast<double>(output.size() - 2 * skip);
+  return Decibels(power / tone);
+}
+
+double Throughput(const std::vector<float>& input, const Conversion& conversion, size_t block, bool polyphase) {
+  const auto start = Clock::now();
+  const size_t produced =
+      polyphase ? Polyphase(input, conversion, block).size() : LinearPerBlock(input, conversion, block).size();
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  return produced > 0 ? static_cast<double>(input.size()) / seconds : 0.0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const double seconds = argc > 1 ? std::atof(argv[1]) : 20.0;
+  if (seconds <= 0.0) {
+    std::cerr << "Usage: " << argv[0] << " [seconds]\n";
+    return 1;
+  }
+
+  const Conversion conversions[] = {{48000, 16000}, {24000, 48000}, {22050, 48000}, {44100, 48000}, {16000, 48000}};
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+
+  std::cout << std::fixed << std::setprecision(1);
+  for (const Conversion& conversion : conversions) {
+    const size_t block = conversion.input_rate / 100;
+    const bridge::Resampler resampler(conversion.input_rate, conversion.output_rate);
+    std::cout << conversion.input_rate << " -> " << conversion.output_rate << " Hz (L/M " << resampler.interpolation()
+              << "/" << resampler.decimation() << ", " << resampler.taps_per_phase() << " taps per output)\n";
+
+    const std::vector<float> tone = Tone(kToneHz, conversion.input_rate, 2.0);
+    const bool down = conversion.output_rate < conversion.input_rate;
+    // Folds back to 3/8 of the output rate.
+    const double alias_hz = 0.625 * conversion.output_rate;
+    const std::vector<float> alias_tone = Tone(alias_hz, conversion.input_rate, 2.0);
+
+    std::vector<float> input(static_cast<size_t>(seconds * conversion.input_rate));
+    for (float& sample : input) {
+      sample = noise(random);
+    }
+
+    for (const bool polyphase : {false, true}) {
+      const auto convert = polyphase ? Polyphase : LinearPerBlock;
+      std::cout << "  " << std::setw(9) << std::left << (polyphase ? "polyphase" : "linear") << std::right
+                << " thd+n " << std::setw(7) << ThdPlusNoise(convert(tone, conversion, block), kToneHz,
+                                                              conversion.output_rate)
+                << " dB";
+      if (down) {
+        std::cout << "  alias at " << static_cast<int>(alias_hz) << " Hz " << std::setw(7)
+                  << Alias(convert(alias_tone, conversion, block), conversion.output_rate) << " dB";
+      }
+      std::cout << "  throughput " << Throughput(input, conversion, block, polyphase) / 1e6 << " M samples/s\n";
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,118 @@
+// Measures each sample conversion kernel (SampleKernels.h) in every version
+// this CPU runs, against the others.
+//
+//   bridge_sample_kernels_bench [block_samples]
+//
+// Each kernel converts the same block of `block_samples` samples (default
+// 4096, about 40 ms of 48 kHz stereo, which stays in cache) over and over
+// for a fifth of a second. GB/s counts the bytes read plus the bytes
+// written.
+
+#include "SampleKernels.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr auto kRunTime = std::chrono::milliseconds(200);
+
+struct Buffers {
+  std::vector<float> interleaved;
+  std::vector<float> left;
+  std::vector<float> right;
+  std::vector<float> mono;
+  std::vector<float> noise;
+  std::vector<int16_t> s16;
+};
+
+double GigabytesPerSecond(const std::function<void()>& run, size_t bytes_per_run) {
+  run();
+  size_t runs = 0;
+  const auto start = Clock::now();
+  auto now = start;
+  while (now - start < kRunTime) {
+    for (int i = 0; i < 16; ++i) {
+      run();
+    }
+    runs += 16;
+    now = Clock::now();
+  }
+  const double seconds = std::chrono::duration<double>(now - start).count();
+  return static_cast<double>(runs * bytes_per_run) / seconds / 1e9;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const long block = argc > 1 ? std::atol(argv[1]) : 4096;
+  if (block <= 1 || block % 2 != 0) {
+    std::cerr << "Usage: " << argv[0] << " [block_samples (even)]\n";
+    return 1;
+  }
+  const size_t samples = static_cast<size_t>(block);
+  const size_t frames = samples / 2;
+
+  Buffers b;
+  std::mt19937 random(11);
+  std::uniform_real_distribution<float> value(-1.1f, 1.1f);
+  b.interleaved.resize(samples);
+  b.left.resize(frames);
+  b.right.resize(frames);
+  b.mono.resize(samples);
+  b.noise.resize(samples);
+  b.s16.resize(samples);
+  for (float& sample : b.interleaved) {
+    sample = value(random);
+  }
+  for (size_t i = 0; i < samples; ++i) {
+    b.mono[i] = value(random);
+  }
+  bridge::TpdfDither dither;
+  dither.Fill(b.noise.data(), samples);
+
+  std::cout << "active: " << bridge::ActiveSampleKernels().name << "; " << samples << " samples per block\n";
+  std::cout << std::fixed << std::setprecision(2);
+  const bridge::SampleKernelIsa isas[] = {bridge::SampleKernelIsa::kScalar, bridge::SampleKernelIsa::kSse2,
+                                          bridge::SampleKernelIsa::kAvx2, bridge::SampleKernelIsa::kNeon};
+  for (const bridge::SampleKernelIsa isa : isas) {
+    const bridge::SampleKernels* k = bridge::SampleKernelsFor(isa);
+    if (k == nullptr) {
+      continue;
+    }
+    const size_t f32 = samples * sizeof(float);
+    const size_t s16 = samples * sizeof(int16_t);
+    const std::pair<const char*, double> results[] = {
+        {"f32->s16", GigabytesPerSecond([&] { k->float_to_int16(b.interleaved.data(), nullptr, b.s16.data(), samples); },
+                                        f32 + s16)},
+        {"f32->s16 dither",
+         GigabytesPerSecond([&] { k->float_to_int16(b.interleaved.data(), b.noise.data(), b.s16.data(), samples); },
+                            2 * f32 + s16)},
+        {"s16->f32", GigabytesPerSecond([&] { k->int16_to_float(b.s16.data(), b.mono.data(), samples); }, s16 + f32)},
+        {"interleave",
+         GigabytesPerSecond([&] { k->interleave_stereo(b.left.data(), b.right.data(), b.interleaved.data(), frames); },
+                            2 * f32)},
+        {"deinterleave",
+         GigabytesPerSecond([&] { k->deinterleave_stereo(b.interleaved.data(), b.left.data(), b.right.data(), frames); },
+                            2 * f32)},
+        {"stereo->mono",
+         GigabytesPerSecond([&] { k->stereo_to_mono(b.interleaved.data(), b.left.data(), frames); }, f32 + f32 / 2)},
+        {"mono->stereo",
+         GigabytesPerSecond([&] { k->mono_to_stereo(b.left.data(), b.interleaved.data(), frames); }, f32 / 2 + f32)},
+        {"gain", GigabytesPerSecond([&] { k->apply_gain(b.mono.data(), samples, -1.0f); }, 2 * f32)},
+    };
+    std::cout << k->name << ":\n";
+    for (const auto& [name, rate] : results) {
+      std::cout << "  " << std::left << std::setw(16) << name << std::right << std::setw(8) << rate << " GB/s\n";
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,121 @@
+// Compares the ways the bridge can start the engine helper: fork() and
+// execv(), as it used to, and posix_spawn() through bridge::SpawnProcess.
+//
+//   bridge_spawn_bench [launches] [ballast_mib]
+//
+// Each launch starts `/bin/true` with pipes on its stdin, stdout and stderr,
+// as the bridge wires the helper, and times how long the launching call
+// blocks the caller and how long until the child has exited. fork() copies
+// the caller's page tables, so each mode runs with no ballast and again
+// with `ballast_mib` of touched memory standing in for a bridge that has
+// been serving sessions for a while.
+
+#include "ProcessSpawn.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr const char* kProgram = "/bin/true";
+
+double Percentile(std::vector<double>* samples, double p) {
+  std::sort(samples->begin(), samples->end());
+  return (*samples)[std::min(samples->size() - 1, static_cast<size_t>(p * static_cast<double>(samples->size())))];
+}
+
+bool ForkExec(const std::vector<bridge::ChildFd>& fds, pid_t* pid) {
+  *pid = fork();
+  if (*pid < 0) {
+    return false;
+  }
+  if (*pid == 0) {
+    for (const bridge::ChildFd& fd : fds) {
+      dup2(fd.parent_fd, fd.child_fd);
+    }
+    char* argv[] = {const_cast<char*>(kProgram), nullptr};
+    execv(kProgram, argv);
+    _exit(127);
+  }
+  return true;
+}
+
+bool Measure(bool use_spawn, size_t ballast_bytes, int launches) {
+  std::vector<char> ballast(ballast_bytes);
+  // Touches every page so that fork() has to copy a table entry for it.
+  for (size_t i = 0; i < ballast.size(); i += 4096) {
+    ballast[i] = static_cast<char>(i);
+  }
+
+  std::vector<double> launch_samples;
+  std::vector<double> exit_samples;
+  for (int i = 0; i < launches; ++i) {
+    int pipes[3][2];
+    for (auto& fds : pipes) {
+      if (!bridge::MakePipe(fds)) {
+        std::cerr << "pipe: " << std::strerror(errno) << "\n";
+        return false;
+      }
+    }
+    const std::vector<bridge::ChildFd> child_fds = {
+        {pipes[0][0], STDIN_FILENO}, {pipes[1][1], STDOUT_FILENO}, {pipes[2][1], STDERR_FILENO}};
+
+    const auto start = Clock::now();
+    pid_t pid = -1;
+    std::string error;
+    const bool started =
+        use_spawn ? bridge::SpawnProcess(kProgram, {kProgram}, child_fds, &pid, &error) : ForkExec(child_fds, &pid);
+    const auto launched = Clock::now();
+    int status = 0;
+    if (started) {
+      waitpid(pid, &status, 0);
+    }
+    const auto exited = Clock::now();
+    for (auto& fds : pipes) {
+      close(fds[0]);
+      close(fds[1]);
+    }
+    if (!started || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      std::cerr << (error.empty() ? std::string("failed to start ") + kProgram : error) << "\n";
+      return false;
+    }
+    launch_samples.push_back(std::chrono::duration<double, std::micro>(launched - start).count());
+    exit_samples.push_back(std::chrono::duration<double, std::micro>(exited - start).count());
+  }
+
+  const std::string name = std::string(use_spawn ? "posix_spawn" : "fork+execv") + " with " +
+                           std::to_string(ballast_bytes >> 20) + " MiB";
+  std::cout << name << ": launch p50=" << Percentile(&launch_samples, 0.50)
+            << " us p99=" << Percentile(&launch_samples, 0.99) << " us; to exit p50=" << Percentile(&exit_samples, 0.50)
+            << " us p99=" << Percentile(&exit_samples, 0.99) << " us\n";
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int launches = argc > 1 ? std::atoi(argv[1]) : 200;
+  const int ballast_mib = argc > 2 ? std::atoi(argv[2]) : 512;
+  if (launches <= 0 || ballast_mib < 0) {
+    std::cerr << "Usage: " << argv[0] << " [launches] [ballast_mib]\n";
+    return 1;
+  }
+  for (const size_t ballast_bytes : {size_t{0}, static_cast<size_t>(ballast_mib) << 20}) {
+    for (const bool use_spawn : {false, true}) {
+      if (!Measure(use_spawn, ballast_bytes, launches)) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,252 @@
+// Compares the bridge's TCP and Unix domain socket listeners end to end.
+//
+//   bridge_transport_bench [--tcp host:port] [--unix path] [round_trips]
+//
+// Connects to a running bridge, completes the WebSocket handshake, and sends
+// JSON pings. "rtt" waits for each pong before sending the next ping;
+// "throughput" keeps a window of pings in flight. Only one client is served
+// at a time, so the transports are measured one after the other.
+
+#include "WebSocketReader.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kPipelineWindow = 64;
+
+class BenchClient {
+ public:
+  BenchClient()
+      : reader_({nullptr,
+                 [this](const uint8_t* data, size_t size, bool final) {
+                   message_.append(reinterpret_cast<const char*>(data), size);
+                   if (final) {
+                     ++messages_;
+                     if (message_.find("\"pong\"") != std::string::npos) {
+                       ++pongs_;
+                     }
+                     message_.clear();
+                   }
+                 },
+                 nullptr}) {}
+
+  ~BenchClient() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  bool ConnectTcp(const std::string& host_port) {
+    const size_t colon = host_port.rfind(':');
+    if (colon == std::string::npos) {
+      return false;
+    }
+    addrinfo hints {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host_port.substr(0, colon).c_str(), host_port.substr(colon + 1).c_str(), &hints, &result) != 0) {
+      return false;
+    }
+    fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    const bool ok = fd_ >= 0 && connect(fd_, result->ai_addr, result->ai_addrlen) == 0;
+    freeaddrinfo(result);
+    if (ok) {
+      const int one = 1;
+      setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return ok && Handshake();
+  }
+
+  bool ConnectUnix(const std::string& path) {
+    sockaddr_un addr {};
+    if (path.size() >= sizeof(addr.sun_path)) {
+      return false;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    return fd_ >= 0 && connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 && Handshake();
+  }
+
+  // Appends one masked client text frame to *out.
+  static void AppendTextFrame(const std::string& payload, std::string* out) {
+    static const uint8_t kMask[4] = {0x12, 0x34, 0x56, 0x78};
+    out->push_back(static_cast<char>(0x81));
+    out->push_back(static_cast<char>(0x80 | payload.size()));  // pings stay under 126 bytes
+    out->append(reinterpret_cast<const char*>(kMask), sizeof(kMask));
+    for (size_t i = 0; i < payload.size(); ++i) {
+      out->push_back(static_cast<char>(payload[i] ^ kMask[i & 3]));
+    }
+  }
+
+  bool SendAll(const std::string& bytes) {
+    size_t sent = 0;
+    while (sent < bytes.size()) {
+      const ssize_t n = send(fd_, bytes.data() + sent, bytes.size() - sent, 0);
+      if (n <= 0) {
+        return false;
+      }
+      sent += static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+  // Reads until at least `target` pongs have arrived in total.
+  bool WaitForPongs(uint64_t target) {
+    uint8_t buffer[16 * 1024];
+    std::string error;
+    while (pongs_ < target) {
+      const ssize_t n = recv(fd_, buffer, sizeof(buffer), 0);
+      if (n <= 0 || !reader_.Feed(buffer, static_cast<size_t>(n), &error)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  uint64_t pongs() const {
+    return pongs_;
+  }
+
+ private:
+  bool Handshake() {
+    const std::string request =
+        "GET / HTTP/1.1\r\nHost: bench\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+    if (!SendAll(request)) {
+      return false;
+    }
+    std::string response;
+    char c = 0;
+    while (response.size() < 4 || response.compare(response.size() - 4, 4, "\r\n\r\n") != 0) {
+      if (recv(fd_, &c, 1, 0) != 1) {
+        return false;
+      }
+      response.push_back(c);
+    }
+    if (response.compare(0, 12, "HTTP/1.1 101") != 0) {
+      return false;
+    }
+    // The bridge greets every client with a ready message.
+    const uint64_t before = messages_;
+    uint8_t buffer[1024];
+    std::string error;
+    while (messages_ == before) {
+      const ssize_t n = recv(fd_, buffer, sizeof(buffer), 0);
+      if (n <= 0 || !reader_.Feed(buffer, static_cast<size_t>(n), &error)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  int fd_ = -1;
+  bridge::WebSocketReader reader_;
+  std::string message_;
+  uint64_t messages_ = 0;
+  uint64_t pongs_ = 0;
+};
+
+std::string PingFrame(int id) {
+  std::string frame;
+  BenchClient::AppendTextFrame("{\"type\":\"ping\",\"id\":\"" + std::to_string(id) + "\"}", &frame);
+  return frame;
+}
+
+bool Measure(const char* name, BenchClient* client, int round_trips) {
+  std::vector<double> samples;
+  samples.reserve(static_cast<size_t>(round_trips));
+  for (int i = 0; i < round_trips; ++i) {
+    const auto start = Clock::now();
+    if (!client->SendAll(PingFrame(i)) || !client->WaitForPongs(client->pongs() + 1)) {
+      std::cerr << name << ": connection lost during rtt\n";
+      return false;
+    }
+    samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+  }
+  std::sort(samples.begin(), samples.end());
+  const auto percentile = [&samples](double p) {
+    return samples[std::min(samples.size() - 1, static_cast<size_t>(p * static_cast<double>(samples.size())))];
+  };
+
+  std::string window;
+  for (int i = 0; i < kPipelineWindow; ++i) {
+    window += PingFrame(i);
+  }
+  const int batches = std::max(1, round_trips * 4 / kPipelineWindow);
+  const auto start = Clock::now();
+  for (int i = 0; i < batches; ++i) {
+    if (!client->SendAll(window) || !client->WaitForPongs(client->pongs() + kPipelineWindow)) {
+      std::cerr << name << ": connection lost during throughput\n";
+      return false;
+    }
+  }
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::cout << name << ": rtt p50=" << percentile(0.50) << " us p99=" << percentile(0.99)
+            << " us, throughput=" << (static_cast<double>(batches) * kPipelineWindow / seconds) << " msgs/s\n";
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string tcp;
+  std::string unix_path;
+  int round_trips = 5000;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--tcp" && i + 1 < argc) {
+      tcp = argv[++i];
+    } else if (arg == "--unix" && i + 1 < argc) {
+      unix_path = argv[++i];
+    } else {
+      round_trips = std::atoi(argv[i]);
+    }
+  }
+  if ((tcp.empty() && unix_path.empty()) || round_trips <= 0) {
+    std::cerr << "Usage: " << argv[0] << " [--tcp host:port] [--unix path] [round_trips]\n";
+    return 1;
+  }
+
+  if (!tcp.empty()) {
+    BenchClient client;
+    if (!client.ConnectTcp(tcp)) {
+      std::cerr << "Failed to connect to ws://" << tcp << "\n";
+      return 1;
+    }
+    if (!Measure("tcp", &client, round_trips)) {
+      return 1;
+    }
+  }
+  if (!unix_path.empty()) {
+    // The bridge notices the previous client's close on its next poll.
+    usleep(200 * 1000);
+    BenchClient client;
+    if (!client.ConnectUnix(unix_path)) {
+      std::cerr << "Failed to connect to unix:" << unix_path << "\n";
+      return 1;
+    }
+    if (!Measure("unix", &client, round_trips)) {
+      return 1;
+    }
+  }
+  return 0;
+}
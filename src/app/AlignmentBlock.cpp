@@ -0,0 +1,194 @@
+#include "AlignmentBlock.h"
+
+#include <charconv>
+#include <limits>
+
+namespace bridge {
+
+namespace {
+
+void AppendLittleEndian(uint64_t value, size_t bytes, std::string* out) {
+  for (size_t i = 0; i < bytes; ++i) {
+    out->push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+uint64_t ReadLittleEndian(const char* data, size_t bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < bytes; ++i) {
+    value |= static_cast<uint64_t>(static_cast<uint8_t>(data[i])) << (8 * i);
+  }
+  return value;
+}
+
+void AppendVarint(uint64_t value, std::string* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+void AppendZigzag(int64_t value, std::string* out) {
+  AppendVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63), out);
+}
+
+// Differences wrap rather than overflow, so any pair of times survives the
+// round trip.
+int64_t WrappingDifference(int64_t a, int64_t b) {
+  return static_cast<int64_t>(static_cast<uint64_t>(a) - static_cast<uint64_t>(b));
+}
+
+int64_t WrappingSum(int64_t a, int64_t b) {
+  return static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+}
+
+bool ReadVarint(std::string_view* data, uint64_t* value) {
+  *value = 0;
+  for (int shift = 0; shift < 64 && !data->empty(); shift += 7) {
+    const uint8_t byte = static_cast<uint8_t>(data->front());
+    data->remove_prefix(1);
+    *value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ReadZigzag(std::string_view* data, int64_t* value) {
+  uint64_t raw = 0;
+  if (!ReadVarint(data, &raw)) {
+    return false;
+  }
+  *value = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+  return true;
+}
+
+bool ParseInt(const JsonValue& value, int64_t* out) {
+  if (value.type != JsonType::kNumber) {
+    return false;
+  }
+  const char* end = value.text.data() + value.text.size();
+  const auto result = std::from_chars(value.text.data(), end, *out);
+  return result.ec == std::errc() && result.ptr == end;
+}
+
+bool Fail(const char* message, std::string* error) {
+  if (error != nullptr) {
+    *error = message;
+  }
+  return false;
+}
+
+}  // namespace
+
+bool EncodeAlignmentBlock(const JsonValue& event, std::string_view session_id, std::string* out,
+                          std::string* error) {
+  const JsonValue* chars = event.Find("chars");
+  const JsonValue* starts = event.Find("char_start_ms");
+  const JsonValue* ends = event.Find("char_end_ms");
+  if (chars == nullptr || starts == nullptr || ends == nullptr || chars->type != JsonType::kArray ||
+      starts->type != JsonType::kArray || ends->type != JsonType::kArray) {
+    return Fail("tts_alignment is missing its arrays", error);
+  }
+  if (starts->count != chars->count || ends->count != chars->count) {
+    return Fail("tts_alignment arrays differ in length", error);
+  }
+  const std::string_view utterance_id = event.StringField("utterance_id").value_or("");
+  if (utterance_id.size() > 0xFFFF || session_id.size() > 0xFFFF) {
+    return Fail("tts_alignment id is too long", error);
+  }
+
+  size_t text_bytes = 0;
+  for (size_t i = 0; i < chars->count; ++i) {
+    if (chars->items[i].type != JsonType::kString) {
+      return Fail("tts_alignment character is not a string", error);
+    }
+    text_bytes += chars->items[i].text.size();
+  }
+  if (text_bytes > std::numeric_limits<uint32_t>::max()) {
+    return Fail("tts_alignment text is too long", error);
+  }
+
+  const size_t start = out->size();
+  out->reserve(start + kAlignmentBlockHeaderBytes + utterance_id.size() + session_id.size() + text_bytes +
+               chars->count * 4);
+  out->push_back(static_cast<char>(kAlignmentBlockVersion));
+  out->push_back(static_cast<char>(kAlignmentBlockKind));
+  AppendLittleEndian(utterance_id.size(), 2, out);
+  AppendLittleEndian(session_id.size(), 2, out);
+  AppendLittleEndian(0, 2, out);
+  AppendLittleEndian(chars->count, 4, out);
+  AppendLittleEndian(text_bytes, 4, out);
+  out->append(utterance_id);
+  out->append(session_id);
+  for (size_t i = 0; i < chars->count; ++i) {
+    out->append(chars->items[i].text);
+  }
+
+  int64_t previous_start = 0;
+  for (size_t i = 0; i < chars->count; ++i) {
+    int64_t start_ms = 0;
+    int64_t end_ms = 0;
+    if (!ParseInt(starts->items[i], &start_ms) || !ParseInt(ends->items[i], &end_ms)) {
+      out->resize(start);
+      return Fail("tts_alignment time is not an integer", error);
+    }
+    AppendVarint(chars->items[i].text.size(), out);
+    AppendZigzag(WrappingDifference(start_ms, previous_start), out);
+    AppendZigzag(WrappingDifference(end_ms, start_ms), out);
+    previous_start = start_ms;
+  }
+  return true;
+}
+
+bool DecodeAlignmentBlock(std::string_view data, AlignmentBlock* out, std::string* error) {
+  if (data.size() < kAlignmentBlockHeaderBytes) {
+    return Fail("alignment block is shorter than its header", error);
+  }
+  if (static_cast<uint8_t>(data[0]) != kAlignmentBlockVersion ||
+      static_cast<uint8_t>(data[1]) != kAlignmentBlockKind) {
+    return Fail("not an alignment block", error);
+  }
+  const size_t utterance_bytes = ReadLittleEndian(data.data() + 2, 2);
+  const size_t session_bytes = ReadLittleEndian(data.data() + 4, 2);
+  const size_t count = ReadLittleEndian(data.data() + 8, 4);
+  const size_t text_bytes = ReadLittleEndian(data.data() + 12, 4);
+  data.remove_prefix(kAlignmentBlockHeaderBytes);
+  if (data.size() < utterance_bytes + session_bytes + text_bytes) {
+    return Fail("alignment block is truncated", error);
+  }
+  out->utterance_id.assign(data.substr(0, utterance_bytes));
+  out->session_id.assign(data.substr(utterance_bytes, session_bytes));
+  out->text.assign(data.substr(utterance_bytes + session_bytes, text_bytes));
+  data.remove_prefix(utterance_bytes + session_bytes + text_bytes);
+
+  out->char_bytes.clear();
+  out->start_ms.clear();
+  out->end_ms.clear();
+  size_t text_used = 0;
+  int64_t start_ms = 0;
+  for (size_t i = 0; i < count; ++i) {
+    uint64_t char_bytes = 0;
+    int64_t start_delta = 0;
+    int64_t duration = 0;
+    if (!ReadVarint(&data, &char_bytes) || !ReadZigzag(&data, &start_delta) || !ReadZigzag(&data, &duration)) {
+      return Fail("alignment block is truncated", error);
+    }
+    if (char_bytes > text_bytes - text_used) {
+      return Fail("alignment block lengths do not add up", error);
+    }
+    text_used += char_bytes;
+    start_ms = WrappingSum(start_ms, start_delta);
+    out->char_bytes.push_back(static_cast<uint32_t>(char_bytes));
+    out->start_ms.push_back(start_ms);
+    out->end_ms.push_back(WrappingSum(start_ms, duration));
+  }
+  if (text_used != text_bytes || !data.empty()) {
+    return Fail("alignment block lengths do not add up", error);
+  }
+  return true;
+}
+
+}  // namespace bridge
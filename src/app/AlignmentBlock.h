@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Json.h"
+
+namespace bridge {
+
+// tts_alignment as a binary WebSocket message, for sessions that configure
+// "tts_alignment":"binary". The characters are sent once as UTF-8 text and
+// the timings as varints, about a third the size of the helper's three
+// parallel JSON arrays. Integers are little-endian.
+//
+//   offset 0   u8  version (1)
+//   offset 1   u8  kind (3; 1 and 2 are the PCM stream ids of PcmBlock.h)
+//   offset 2   u16 utterance_id bytes
+//   offset 4   u16 session_id bytes (0 for the default session)
+//   offset 6   u16 reserved (0)
+//   offset 8   u32 character count
+//   offset 12  u32 text bytes
+//   offset 16  utterance_id, session_id, text
+//   then, per character: varint UTF-8 byte length of the character in text,
+//   zigzag varint start minus the previous start (ms), zigzag varint end
+//   minus start (ms)
+constexpr uint8_t kAlignmentBlockVersion = 1;
+constexpr uint8_t kAlignmentBlockKind = 3;
+constexpr size_t kAlignmentBlockHeaderBytes = 16;
+
+struct AlignmentBlock {
+  std::string utterance_id;
+  std::string session_id;
+  std::string text;
+  std::vector<uint32_t> char_bytes;
+  std::vector<int64_t> start_ms;
+  std::vector<int64_t> end_ms;
+};
+
+// Transcodes a parsed tts_alignment event and appends the block to *out.
+// Fails if the arrays are missing, of different lengths or hold non-string
+// characters or non-integer times.
+bool EncodeAlignmentBlock(const JsonValue& event, std::string_view session_id, std::string* out,
+                          std::string* error);
+
+bool DecodeAlignmentBlock(std::string_view data, AlignmentBlock* out, std::string* error);
+
+}  // namespace bridge
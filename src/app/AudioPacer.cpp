@@ -0,0 +1,262 @@
+#include "AudioPacer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __APPLE__
+#include <pthread.h>
+#endif
+
+namespace bridge {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+}  // namespace
+
+AudioPacer::AudioPacer(Options options)
+    : options_(std::move(options)),
+      rings_{Ring{kPaceMicFeed, options_.mic_feed_name, {}, false, false, 0, {}},
+             Ring{kPaceSpeakerTap, options_.speaker_tap_name, {}, false, false, 0, {}}} {
+  options_.target_fill_frames = std::min(options_.target_fill_frames, options_.ring_capacity_frames);
+}
+
+AudioPacer::~AudioPacer() {
+  Stop();
+}
+
+void AudioPacer::Start() {
+  Stop();
+  stopping_ = false;
+  thread_ = std::thread([this]() { Run(); });
+}
+
+void AudioPacer::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  for (Ring& ring : rings_) {
+    ring.ring.Close();
+  }
+}
+
+void AudioPacer::Submit(uint64_t source, std::string_view stream, uint8_t targets, const void* frames,
+                        size_t frame_count) {
+  targets &= kPaceMicFeed | kPaceSpeakerTap;
+  if (targets == 0 || frame_count == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (std::find(cancelled_.begin(), cancelled_.end(), stream) != cancelled_.end()) {
+    frames_discarded_.Add(frame_count);
+    return;
+  }
+  if (queued_frames_.load(std::memory_order_relaxed) + frame_count > options_.max_queued_frames) {
+    for (Ring& ring : rings_) {
+      if ((targets & ring.target) != 0) {
+        ring.stats.frames_dropped.Add(frame_count);
+      }
+    }
+    return;
+  }
+
+  std::unique_ptr<Block> block;
+  if (spare_.empty()) {
+    block = std::make_unique<Block>();
+  } else {
+    block = std::move(spare_.back());
+    spare_.pop_back();
+  }
+  block->source = source;
+  block->stream.assign(stream);
+  block->targets = targets;
+  block->samples.resize(frame_count * options_.channels);
+  std::memcpy(block->samples.data(), frames, block->samples.size() * sizeof(float));
+  block->frames = frame_count;
+  block->played = 0;
+  queue_.push_back(std::move(block));
+  queued_frames_.store(queued_frames_.load(std::memory_order_relaxed) + frame_count, std::memory_order_relaxed);
+  wake_.notify_one();
+}
+
+void AudioPacer::Cancel(std::string_view stream) {
+  if (stream.empty()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (std::find(cancelled_.begin(), cancelled_.end(), stream) == cancelled_.end()) {
+    cancelled_.emplace_back(stream);
+    if (cancelled_.size() > kMaxCancelledStreams) {
+      cancelled_.pop_front();
+    }
+  }
+  for (size_t i = 0; i < queue_.size();) {
+    if (queue_[i]->stream == stream) {
+      frames_discarded_.Add(queue_[i]->frames - queue_[i]->played);
+      Retire(i);
+    } else {
+      ++i;
+    }
+  }
+}
+
+void AudioPacer::Release(std::string_view stream) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto it = std::find(cancelled_.begin(), cancelled_.end(), stream);
+  if (it != cancelled_.end()) {
+    cancelled_.erase(it);
+  }
+}
+
+void AudioPacer::DiscardSource(uint64_t source) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < queue_.size();) {
+    if (queue_[i]->source == source) {
+      frames_discarded_.Add(queue_[i]->frames - queue_[i]->played);
+      Retire(i);
+    } else {
+      ++i;
+    }
+  }
+}
+
+void AudioPacer::Run() {
+#ifdef __APPLE__
+  // As the helper's drain timer ran before the bridge took over.
+  (void)pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+#endif
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto next = Clock::now();
+  while (!stopping_) {
+    if (!Tick()) {
+      wake_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+      next = Clock::now();
+      continue;
+    }
+    // Deadlines advance by whole ticks so that late wake-ups do not add up;
+    // after a long stall the schedule restarts instead of catching up.
+    next += options_.tick;
+    lock.unlock();
+    std::this_thread::sleep_until(next);
+    const auto now = Clock::now();
+    wake_lateness_.Observe(std::chrono::duration<double>(now - next).count());
+    if (now - next > options_.tick) {
+      next = now;
+    }
+    lock.lock();
+  }
+}
+
+bool AudioPacer::Tick() {
+  uint8_t wanted = 0;
+  for (const std::unique_ptr<Block>& block : queue_) {
+    wanted |= block->targets;
+  }
+
+  std::array<size_t, 2> room{};
+  for (size_t r = 0; r < rings_.size(); ++r) {
+    Ring& ring = rings_[r];
+    if ((wanted & ring.target) == 0) {
+      ring.feeding = false;
+      ring.dry = false;
+      continue;
+    }
+    if (!OpenRing(&ring)) {
+      // Left queued, the audio would keep the pacer ticking for good.
+      if (++ring.open_failures >= kMaxRingOpenFailures) {
+        ExpireRing(&ring);
+        ring.open_failures = 0;
+      }
+      continue;
+    }
+    ring.open_failures = 0;
+    const uint32_t fill = ring.ring.available_frames();
+    if (fill == 0) {
+      if (ring.feeding && !ring.dry) {
+        ring.stats.underruns.Add();
+      }
+      ring.dry = true;
+    } else {
+      ring.dry = false;
+    }
+    room[r] = fill < options_.target_fill_frames ? options_.target_fill_frames - fill : 0;
+  }
+
+  // A block that cannot finish holds back later blocks for its rings, so
+  // each ring plays its blocks in order.
+  uint8_t held = 0;
+  for (size_t i = 0; i < queue_.size();) {
+    Block& block = *queue_[i];
+    if ((block.targets & held) != 0) {
+      held |= block.targets;
+      ++i;
+      continue;
+    }
+    size_t frames = block.frames - block.played;
+    for (size_t r = 0; r < rings_.size(); ++r) {
+      if ((block.targets & rings_[r].target) != 0) {
+        frames = std::min(frames, room[r]);
+      }
+    }
+    if (frames > 0) {
+      const float* data = block.samples.data() + block.played * options_.channels;
+      for (size_t r = 0; r < rings_.size(); ++r) {
+        Ring& ring = rings_[r];
+        if ((block.targets & ring.target) != 0) {
+          ring.stats.frames_written.Add(ring.ring.Write(data, frames));
+          ring.feeding = true;
+          room[r] -= frames;
+        }
+      }
+      block.played += frames;
+      queued_frames_.store(queued_frames_.load(std::memory_order_relaxed) - frames, std::memory_order_relaxed);
+    }
+    if (block.played == block.frames) {
+      Retire(i);
+      continue;
+    }
+    held |= block.targets;
+    ++i;
+  }
+  return !queue_.empty();
+}
+
+bool AudioPacer::OpenRing(Ring* ring) {
+  return ring->ring.is_open() ||
+         ring->ring.Open(ring->name, false, options_.channels, options_.ring_capacity_frames);
+}
+
+void AudioPacer::ExpireRing(Ring* ring) {
+  for (size_t i = 0; i < queue_.size();) {
+    Block& block = *queue_[i];
+    if ((block.targets & ring->target) == 0) {
+      ++i;
+      continue;
+    }
+    ring->stats.frames_expired.Add(block.frames - block.played);
+    block.targets &= static_cast<uint8_t>(~ring->target);
+    if (block.targets == 0) {
+      Retire(i);
+    } else {
+      ++i;
+    }
+  }
+}
+
+void AudioPacer::Retire(size_t i) {
+  std::unique_ptr<Block> block = std::move(queue_[i]);
+  queue_.erase(queue_.begin() + static_cast<std::ptrdiff_t>(i));
+  queued_frames_.store(queued_frames_.load(std::memory_order_relaxed) - (block->frames - block->played),
+                       std::memory_order_relaxed);
+  if (spare_.size() < kMaxSpareBlocks && block->samples.capacity() <= kMaxSpareSamples) {
+    spare_.push_back(std::move(block));
+  }
+}
+
+}  // namespace bridge
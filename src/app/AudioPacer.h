@@ -0,0 +1,159 @@
+#pragma once
+
+#include "Metrics.h"
+#include "SharedMemoryAudioRing.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace bridge {
+
+// The rings a block of audio is written to; a block may go to both.
+enum AudioPacerTarget : uint8_t {
+  kPaceMicFeed = 1 << 0,
+  kPaceSpeakerTap = 1 << 1,
+};
+
+// Writes audio into the mic_feed and speaker_tap rings at the pace they are
+// played. Producers (the helpers' synthesized speech, a client's PCM) hand
+// over blocks of any size from any thread; a thread of the pacer's own tops
+// each ring up to `target_fill_frames` every tick of a steady clock, so a
+// ring holds a few ticks of audio rather than as much as fits, and a cancel
+// silences it within that. A block for both rings is written to both in the
+// same pass.
+//
+// Blocks for the same ring play in the order they were submitted; blocks
+// for different rings play side by side. Each block belongs to a stream (an
+// utterance id) and to a source (a helper), so that a cancel or a lost
+// helper takes back just its own audio.
+class AudioPacer {
+ public:
+  struct Options {
+    std::string mic_feed_name;
+    std::string speaker_tap_name;
+    uint32_t channels = 2;
+    uint32_t ring_capacity_frames = 48000;
+    // How far ahead of the ring's reader the pacer keeps it.
+    uint32_t target_fill_frames = 1920;
+    // Audio waiting beyond this is dropped as it arrives.
+    size_t max_queued_frames = 48000 * 300;
+    std::chrono::microseconds tick{2000};
+  };
+
+  // Per ring. Only the pacer thread writes them, or Submit() with the
+  // pacer's lock held.
+  struct RingStats {
+    Counter frames_written;
+    // Times the ring ran dry while the pacer still had audio for it.
+    Counter underruns;
+    // Frames turned away because too much audio was queued.
+    Counter frames_dropped;
+    // Queued frames dropped because the ring could not be opened.
+    Counter frames_expired;
+  };
+
+  explicit AudioPacer(Options options);
+  ~AudioPacer();
+
+  AudioPacer(const AudioPacer&) = delete;
+  AudioPacer& operator=(const AudioPacer&) = delete;
+
+  void Start();
+  void Stop();
+
+  // Any thread. Queues `frame_count` interleaved float frames, which need
+  // not be aligned, for the rings in `targets`.
+  void Submit(uint64_t source, std::string_view stream, uint8_t targets, const void* frames, size_t frame_count);
+
+  // Drops the stream's queued audio, and whatever arrives for it until
+  // Release(); audio already in the rings plays out. Only the most recent
+  // kMaxCancelledStreams cancels are remembered. Audio submitted without a
+  // stream cannot be cancelled, so an empty stream is ignored.
+  void Cancel(std::string_view stream);
+  void Release(std::string_view stream);
+  // Drops everything queued from `source`.
+  void DiscardSource(uint64_t source);
+
+  const RingStats& ring_stats(AudioPacerTarget target) const {
+    return rings_[target == kPaceMicFeed ? 0 : 1].stats;
+  }
+  // Frames dropped by Cancel() and DiscardSource().
+  uint64_t frames_discarded() const {
+    return frames_discarded_.value();
+  }
+  size_t queued_frames() const {
+    return queued_frames_.load(std::memory_order_relaxed);
+  }
+  // How late the pacer thread woke for its ticks.
+  const LatencyHistogram& wake_lateness() const {
+    return wake_lateness_;
+  }
+
+ private:
+  static constexpr size_t kMaxCancelledStreams = 64;
+  static constexpr size_t kMaxSpareBlocks = 16;
+  static constexpr size_t kMaxSpareSamples = 64 * 1024;
+  // Ticks in a row a ring may fail to open before the audio queued for it
+  // is dropped.
+  static constexpr uint32_t kMaxRingOpenFailures = 250;
+
+  struct Block {
+    uint64_t source = 0;
+    std::string stream;
+    uint8_t targets = 0;
+    std::vector<float> samples;
+    size_t frames = 0;
+    size_t played = 0;
+  };
+
+  struct Ring {
+    AudioPacerTarget target;
+    std::string name;
+    SharedMemoryAudioRing ring;
+    // The pacer has written to the ring since it last ran out of audio for
+    // it, and whether it has found the ring empty since.
+    bool feeding = false;
+    bool dry = false;
+    uint32_t open_failures = 0;
+    RingStats stats;
+  };
+
+  void Run();
+  // Writes what each ring has room for. Returns false once nothing is
+  // queued. Called with mutex_ held.
+  bool Tick();
+  bool OpenRing(Ring* ring);
+  // Takes `ring` out of every queued block, dropping the blocks left with
+  // no ring. Called with mutex_ held.
+  void ExpireRing(Ring* ring);
+  // Removes queue_[i], keeping its buffer for reuse. Called with mutex_ held.
+  void Retire(size_t i);
+
+  Options options_;
+  std::array<Ring, 2> rings_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::deque<std::unique_ptr<Block>> queue_;
+  std::vector<std::unique_ptr<Block>> spare_;
+  std::deque<std::string> cancelled_;
+  bool stopping_ = false;
+  std::thread thread_;
+
+  std::atomic<size_t> queued_frames_{0};
+  Counter frames_discarded_;
+  LatencyHistogram wake_lateness_{0.0005, 0.001, 0.002, 0.005, 0.01, 0.02, 0.05};
+};
+
+}  // namespace bridge
@@ -0,0 +1,74 @@
+#include "HelperEventQueue.h"
+
+namespace bridge {
+
+HelperEventQueue::HelperEventQueue(size_t slots, size_t slot_bytes) : slot_bytes_(slot_bytes) {
+  size_t count = 1;
+  while (count < slots) {
+    count <<= 1;
+  }
+  mask_ = count - 1;
+  slots_ = std::make_unique<Slot[]>(count);
+  for (size_t i = 0; i < count; ++i) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+    slots_[i].text.reserve(slot_bytes_);
+  }
+}
+
+bool HelperEventQueue::TryPush(uint64_t helper_id, std::chrono::steady_clock::time_point received_at,
+                               std::string_view payload) {
+  uint64_t position = tail_.load(std::memory_order_relaxed);
+  Slot* slot = nullptr;
+  while (true) {
+    slot = &slots_[position & mask_];
+    const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+    const int64_t lag = static_cast<int64_t>(sequence - position);
+    if (lag == 0) {
+      if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (lag < 0) {
+      // The slot still holds the event from one lap ago.
+      return false;
+    } else {
+      position = tail_.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->helper_id = helper_id;
+  slot->received_at = received_at;
+  slot->text.assign(payload);
+  slot->sequence.store(position + 1, std::memory_order_release);
+  return true;
+}
+
+bool HelperEventQueue::Peek(Event* out) {
+  const uint64_t position = head_.load(std::memory_order_relaxed);
+  Slot& slot = slots_[position & mask_];
+  if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+    return false;
+  }
+  out->helper_id = slot.helper_id;
+  out->received_at = slot.received_at;
+  out->payload = slot.text;
+  return true;
+}
+
+void HelperEventQueue::Pop() {
+  const uint64_t position = head_.load(std::memory_order_relaxed);
+  Slot& slot = slots_[position & mask_];
+  if (slot.text.capacity() > kMaxRetainedBytes) {
+    std::string().swap(slot.text);
+    slot.text.reserve(slot_bytes_);
+  }
+  slot.sequence.store(position + mask_ + 1, std::memory_order_release);
+  head_.store(position + 1, std::memory_order_relaxed);
+}
+
+size_t HelperEventQueue::size() const {
+  const uint64_t head = head_.load(std::memory_order_relaxed);
+  const uint64_t tail = tail_.load(std::memory_order_relaxed);
+  return tail > head ? static_cast<size_t>(tail - head) : 0;
+}
+
+}  // namespace bridge
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace bridge {
+
+// Carries events from the helpers' reader threads to the service thread: a
+// bounded multi-producer, single-consumer queue over a fixed array of slots,
+// each with a message buffer reserved up front. Pushing copies the event
+// into its slot's buffer and the consumer reads it there, so once the
+// buffers have grown to fit the events passing through, neither side
+// allocates or takes a lock. A buffer that an outsized event grew past
+// kMaxRetainedBytes is given back when the consumer is done with it.
+//
+// Producers claim slots with a compare-and-swap on the tail and publish them
+// through a sequence number per slot (D. Vyukov's bounded queue). A full
+// queue turns the event away; what to do then is up to the producer.
+class HelperEventQueue {
+ public:
+  struct Event {
+    uint64_t helper_id = 0;
+    std::chrono::steady_clock::time_point received_at;
+    std::string_view payload;
+  };
+
+  // `slots` is rounded up to a power of two.
+  HelperEventQueue(size_t slots, size_t slot_bytes);
+
+  HelperEventQueue(const HelperEventQueue&) = delete;
+  HelperEventQueue& operator=(const HelperEventQueue&) = delete;
+
+  // Any thread. Returns false if the queue is full.
+  bool TryPush(uint64_t helper_id, std::chrono::steady_clock::time_point received_at, std::string_view payload);
+
+  // Consumer. The payload view stays valid until Pop().
+  bool Peek(Event* out);
+  void Pop();
+
+  size_t capacity() const {
+    return mask_ + 1;
+  }
+  // Events waiting; a snapshot, from any thread.
+  size_t size() const;
+
+ private:
+  static constexpr size_t kMaxRetainedBytes = 64 * 1024;
+
+  struct Slot {
+    // Equal to the position of the next push into the slot while it is
+    // free, and one past it once the event is published.
+    std::atomic<uint64_t> sequence{0};
+    uint64_t helper_id = 0;
+    std::chrono::steady_clock::time_point received_at;
+    std::string text;
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;
+  size_t slot_bytes_;
+  // Producers' and consumer's positions on their own cache lines.
+  alignas(64) std::atomic<uint64_t> tail_{0};
+  alignas(64) std::atomic<uint64_t> head_{0};
+};
+
+}  // namespace bridge
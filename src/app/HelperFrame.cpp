@@ -0,0 +1,228 @@
+#include "HelperFrame.h"
+
+#include "Base64.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bridge {
+
+namespace {
+
+uint32_t ReadU32(const char* data) {
+  const auto* bytes = reinterpret_cast<const uint8_t*>(data);
+  return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+         (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+void WriteU32(uint32_t value, uint8_t* out) {
+  for (size_t i = 0; i < 4; ++i) {
+    out[i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+}  // namespace
+
+bool ParseHelperIpcMode(std::string_view name, HelperIpcMode* out) {
+  if (name == "framed") {
+    *out = HelperIpcMode::kFramed;
+    return true;
+  }
+  if (name == "json_lines") {
+    *out = HelperIpcMode::kJsonLines;
+    return true;
+  }
+  if (name == "shared_memory") {
+    *out = HelperIpcMode::kSharedMemory;
+    return true;
+  }
+  return false;
+}
+
+const char* HelperIpcModeName(HelperIpcMode mode) {
+  switch (mode) {
+    case HelperIpcMode::kFramed:
+      return "framed";
+    case HelperIpcMode::kJsonLines:
+      return "json_lines";
+    case HelperIpcMode::kSharedMemory:
+      return "shared_memory";
+  }
+  return "framed";
+}
+
+bool IsHelperControlCommand(std::string_view type) {
+  return type == "tts_cancel" || type == "stop_stt" || type == "disable" || type == "shutdown";
+}
+
+HelperLogLevel ParseHelperLogLine(std::string_view line, std::string_view* message) {
+  for (const HelperLogLevel level :
+       {HelperLogLevel::kDebug, HelperLogLevel::kInfo, HelperLogLevel::kWarn, HelperLogLevel::kError}) {
+    const std::string_view name = HelperLogLevelName(level);
+    if (line.size() > name.size() + 1 && line.substr(0, name.size()) == name && line[name.size()] == ':') {
+      line.remove_prefix(name.size() + 1);
+      *message = line.substr(line.starts_with(' ') ? 1 : 0);
+      return level;
+    }
+  }
+  *message = line;
+  return HelperLogLevel::kInfo;
+}
+
+const char* HelperLogLevelName(HelperLogLevel level) {
+  switch (level) {
+    case HelperLogLevel::kDebug:
+      return "debug";
+    case HelperLogLevel::kInfo:
+      return "info";
+    case HelperLogLevel::kWarn:
+      return "warn";
+    case HelperLogLevel::kError:
+      return "error";
+  }
+  return "info";
+}
+
+void SplitHelperRingMessage(std::string_view message, std::string_view* payload, std::string_view* attachment) {
+  const size_t end = message.find('\0');
+  *payload = message.substr(0, end);
+  *attachment = end == std::string_view::npos ? std::string_view() : message.substr(end + 1);
+}
+
+bool DecodeHelperAttachment(std::string_view base64, std::string* out) {
+  out->resize(Base64DecodedMaxSize(base64.size()));
+  Base64Decoder decoder;
+  size_t size = 0;
+  size_t written = 0;
+  // The pieces between escaped slashes go to the decoder whole.
+  size_t escape = base64.find("\\/");
+  while (escape != std::string_view::npos) {
+    if (!decoder.Update(base64.substr(0, escape), out->data() + size, out->size() - size, &written)) {
+      return false;
+    }
+    size += written;
+    if (!decoder.Update("/", out->data() + size, out->size() - size, &written)) {
+      return false;
+    }
+    size += written;
+    base64.remove_prefix(escape + 2);
+    escape = base64.find("\\/");
+  }
+  if (!decoder.Update(base64, out->data() + size, out->size() - size, &written)) {
+    return false;
+  }
+  size += written;
+  if (!decoder.Finish(out->data() + size, out->size() - size, &written)) {
+    return false;
+  }
+  out->resize(size + written);
+  return true;
+}
+
+void EncodeHelperFrameHeader(HelperFrameKind kind, uint32_t payload_bytes, uint32_t attachment_bytes,
+                             uint8_t* out) {
+  out[0] = static_cast<uint8_t>(kind);
+  out[1] = 0;
+  out[2] = 0;
+  out[3] = 0;
+  WriteU32(payload_bytes, out + 4);
+  WriteU32(attachment_bytes, out + 8);
+}
+
+HelperFrameReader::HelperFrameReader(HelperIpcMode mode) : mode_(mode), buffer_(kMinReadBytes * 4) {}
+
+void HelperFrameReader::Reset() {
+  begin_ = 0;
+  end_ = 0;
+  scan_ = 0;
+}
+
+char* HelperFrameReader::WritableData(size_t* capacity) {
+  size_t needed = kMinReadBytes;
+  if (mode_ != HelperIpcMode::kJsonLines && end_ - begin_ >= kHelperFrameHeaderBytes) {
+    const char* header = buffer_.data() + begin_;
+    const uint64_t body = static_cast<uint64_t>(ReadU32(header + 4)) + ReadU32(header + 8);
+    if (body <= kMaxHelperFrameBytes) {
+      needed = std::max(needed, kHelperFrameHeaderBytes + static_cast<size_t>(body) - (end_ - begin_));
+    }
+  }
+  if (buffer_.size() - end_ < needed) {
+    std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+    end_ -= begin_;
+    begin_ = 0;
+    if (buffer_.size() - end_ < needed) {
+      buffer_.resize(end_ + needed);
+    }
+  }
+  *capacity = buffer_.size() - end_;
+  return buffer_.data() + end_;
+}
+
+bool HelperFrameReader::Commit(size_t size, const MessageCallback& on_message, std::string* error) {
+  end_ += size;
+  Message message;
+  bool too_large = false;
+  while (mode_ != HelperIpcMode::kJsonLines ? NextFrame(&message, &too_large) : NextLine(&message)) {
+    if (on_message) {
+      on_message(message);
+    }
+  }
+  if (too_large) {
+    if (error != nullptr) {
+      *error = "helper frame is too large";
+    }
+    return false;
+  }
+  if (begin_ == end_) {
+    begin_ = 0;
+    end_ = 0;
+  }
+  return true;
+}
+
+bool HelperFrameReader::NextFrame(Message* out, bool* too_large) {
+  if (end_ - begin_ < kHelperFrameHeaderBytes) {
+    return false;
+  }
+  const char* header = buffer_.data() + begin_;
+  const uint32_t payload_bytes = ReadU32(header + 4);
+  const uint32_t attachment_bytes = ReadU32(header + 8);
+  if (static_cast<uint64_t>(payload_bytes) + attachment_bytes > kMaxHelperFrameBytes) {
+    *too_large = true;
+    return false;
+  }
+  const size_t frame = kHelperFrameHeaderBytes + payload_bytes + attachment_bytes;
+  if (end_ - begin_ < frame) {
+    return false;
+  }
+  out->kind = static_cast<HelperFrameKind>(static_cast<uint8_t>(header[0]));
+  out->payload = std::string_view(header + kHelperFrameHeaderBytes, payload_bytes);
+  out->attachment = std::string_view(header + kHelperFrameHeaderBytes + payload_bytes, attachment_bytes);
+  begin_ += frame;
+  return true;
+}
+
+bool HelperFrameReader::NextLine(Message* out) {
+  while (true) {
+    const char* start = buffer_.data() + begin_;
+    const void* newline = std::memchr(start + scan_, '\n', end_ - begin_ - scan_);
+    if (newline == nullptr) {
+      scan_ = end_ - begin_;
+      return false;
+    }
+    size_t length = static_cast<size_t>(static_cast<const char*>(newline) - start);
+    begin_ += length + 1;
+    scan_ = 0;
+    while (length > 0 && start[length - 1] == '\r') {
+      --length;
+    }
+    if (length > 0) {
+      out->kind = HelperFrameKind::kJson;
+      out->payload = std::string_view(start, length);
+      out->attachment = {};
+      return true;
+    }
+  }
+}
+
+}  // namespace bridge
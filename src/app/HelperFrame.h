@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bridge {
+
+// Messages between the bridge and the engine helper cross the helper's stdin
+// and stdout as frames. The header is 12 bytes, little-endian:
+//
+//   offset 0  u8  kind (HelperFrameKind)
+//   offset 1  u8  reserved (0)
+//   offset 2  u16 reserved (0)
+//   offset 4  u32 payload bytes
+//   offset 8  u32 attachment bytes
+//   offset 12 payload, then attachment
+//
+// The payload is one JSON object without a trailing newline. The attachment
+// carries raw bytes, such as PCM, that belong to the message and would
+// otherwise need base64 inside the JSON. Newline-delimited JSON without
+// framing remains available as a debug mode; there the attachment is base64
+// in the message's "attachment" field.
+//
+// In shared-memory mode the messages travel through a pair of
+// SharedMemoryMessageRings, and the pipes carry only empty doorbell frames,
+// sent when the reader of a ring has gone to sleep, plus end-of-file when
+// either side exits. A ring message is the payload, then, if there is an
+// attachment, a NUL byte (which JSON text never contains) and the
+// attachment.
+//
+// The helper hands synthesized speech to the bridge as tts_audio events:
+// "utterance_id", "target" (the session's tts_target) and "frames", with
+// the interleaved float32 samples in the attachment. The bridge's
+// AudioPacer writes them into the rings.
+//
+// Except in json_lines mode, control commands (IsHelperControlCommand) skip
+// the queue: the bridge writes them as frames to a separate pipe, the
+// helper's kHelperControlFd, which the helper reads on a thread of its own.
+// So that a cancel cannot be undone by commands it overtook, each carries
+// "after", the number of commands the bridge had sent on the data path
+// before it; the helper drops the overtaken commands that the control
+// command supersedes.
+enum class HelperFrameKind : uint8_t {
+  kJson = 1,
+  kDoorbell = 2,
+};
+
+enum class HelperIpcMode {
+  kFramed,
+  kJsonLines,
+  kSharedMemory,
+};
+
+constexpr size_t kHelperFrameHeaderBytes = 12;
+constexpr uint32_t kMaxHelperFrameBytes = 64 * 1024 * 1024;
+constexpr int kHelperControlFd = 3;
+
+bool ParseHelperIpcMode(std::string_view name, HelperIpcMode* out);
+const char* HelperIpcModeName(HelperIpcMode mode);
+
+// tts_cancel, stop_stt, disable and shutdown.
+bool IsHelperControlCommand(std::string_view type);
+
+// The helper's stderr is a log, read apart from the messages. Each line may
+// start with its level: "debug: ", "info: ", "warn: " or "error: ".
+enum class HelperLogLevel {
+  kDebug,
+  kInfo,
+  kWarn,
+  kError,
+};
+
+// Lines without a level prefix are kInfo and keep their whole text.
+HelperLogLevel ParseHelperLogLine(std::string_view line, std::string_view* message);
+const char* HelperLogLevelName(HelperLogLevel level);
+
+// Separates a ring message into its payload and attachment.
+void SplitHelperRingMessage(std::string_view message, std::string_view* payload, std::string_view* attachment);
+
+// Decodes a json_lines attachment: base64 as it appears inside a JSON
+// string, where "/" may be escaped. Returns false if it is malformed.
+bool DecodeHelperAttachment(std::string_view base64, std::string* out);
+
+void EncodeHelperFrameHeader(HelperFrameKind kind, uint32_t payload_bytes, uint32_t attachment_bytes,
+                             uint8_t* out);
+
+// Splits the helper's output into messages without copying them: data is
+// read straight into the reader's buffer, and each message is handed out as
+// views into it. Only the unfinished tail of a read is moved, to the front
+// of the buffer, before the next read. Every mode but json_lines reads
+// frames.
+class HelperFrameReader {
+ public:
+  struct Message {
+    HelperFrameKind kind = HelperFrameKind::kJson;
+    std::string_view payload;
+    std::string_view attachment;
+  };
+  // The views are valid only during the call.
+  using MessageCallback = std::function<void(const Message& message)>;
+
+  explicit HelperFrameReader(HelperIpcMode mode);
+
+  void Reset();
+
+  // Room for the next read: at least a few kilobytes, and enough for the
+  // whole of a frame whose header has arrived.
+  char* WritableData(size_t* capacity);
+  // Accepts `size` bytes written at WritableData() and reports every message
+  // they complete. Returns false if the stream is malformed.
+  bool Commit(size_t size, const MessageCallback& on_message, std::string* error);
+
+ private:
+  static constexpr size_t kMinReadBytes = 16 * 1024;
+
+  bool NextFrame(Message* out, bool* too_large);
+  bool NextLine(Message* out);
+
+  HelperIpcMode mode_;
+  std::vector<char> buffer_;
+  size_t begin_ = 0;  // first unconsumed byte
+  size_t end_ = 0;    // one past the last byte read
+  size_t scan_ = 0;   // lines mode: bytes from begin_ known not to hold '\n'
+};
+
+}  // namespace bridge
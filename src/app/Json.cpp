@@ -0,0 +1,729 @@
+#include "Json.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <memory>
+#include <new>
+
+namespace bridge {
+
+namespace {
+
+// A single oversized message may grow the arena; anything above this is
+// released again on the next Reset().
+constexpr size_t kMaxRetainedArenaBytes = 1024 * 1024;
+
+int HexDigitValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// Length of the well-formed UTF-8 sequence starting at `p`, or 0. Rejects
+// overlong forms, surrogates and code points above U+10FFFF.
+size_t Utf8SequenceLength(const char* p, const char* end) {
+  const uint8_t lead = static_cast<uint8_t>(p[0]);
+  size_t length = 0;
+  uint8_t min_second = 0x80;
+  uint8_t max_second = 0xBF;
+  if (lead >= 0xC2 && lead <= 0xDF) {
+    length = 2;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    length = 3;
+    min_second = lead == 0xE0 ? 0xA0 : 0x80;
+    max_second = lead == 0xED ? 0x9F : 0xBF;
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    length = 4;
+    min_second = lead == 0xF0 ? 0x90 : 0x80;
+    max_second = lead == 0xF4 ? 0x8F : 0xBF;
+  } else {
+    return 0;
+  }
+  if (end - p < static_cast<ptrdiff_t>(length)) {
+    return 0;
+  }
+  const uint8_t second = static_cast<uint8_t>(p[1]);
+  if (second < min_second || second > max_second) {
+    return 0;
+  }
+  for (size_t i = 2; i < length; ++i) {
+    if ((static_cast<uint8_t>(p[i]) & 0xC0) != 0x80) {
+      return 0;
+    }
+  }
+  return length;
+}
+
+}  // namespace
+
+JsonArena::JsonArena(size_t block_bytes) : block_bytes_(block_bytes) {}
+
+void JsonArena::AddBlock(size_t min_size) {
+  Block block;
+  block.size = std::max(block_bytes_, min_size);
+  block.data = std::make_unique<uint8_t[]>(block.size);
+  capacity_ += block.size;
+  blocks_.push_back(std::move(block));
+  offset_ = 0;
+}
+
+void* JsonArena::Allocate(size_t size, size_t align) {
+  if (blocks_.empty()) {
+    AddBlock(size + align);
+  }
+  const Block* block = &blocks_.back();
+  uintptr_t base = reinterpret_cast<uintptr_t>(block->data.get());
+  uintptr_t p = (base + offset_ + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+  if (p + size > base + block->size) {
+    AddBlock(size + align);
+    block = &blocks_.back();
+    base = reinterpret_cast<uintptr_t>(block->data.get());
+    p = (base + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+  }
+  offset_ = (p - base) + size;
+  return reinterpret_cast<void*>(p);
+}
+
+void JsonArena::Reset() {
+  offset_ = 0;
+  if (blocks_.size() <= 1 && capacity_ <= kMaxRetainedArenaBytes) {
+    return;
+  }
+  const size_t keep = std::min(capacity_, kMaxRetainedArenaBytes);
+  blocks_.clear();
+  capacity_ = 0;
+  AddBlock(keep);
+}
+
+const JsonValue* JsonValue::Find(std::string_view key) const {
+  if (type != JsonType::kObject) {
+    return nullptr;
+  }
+  // Later duplicates win, matching NSJSONSerialization and Swift's decoder
+  // on the helper side.
+  for (size_t i = count; i > 0; --i) {
+    if (members[i - 1].key == key) {
+      return &members[i - 1].value;
+    }
+  }
+  return nullptr;
+}
+
+std::optional<std::string_view> JsonValue::StringField(std::string_view key) const {
+  const JsonValue* value = Find(key);
+  if (value == nullptr || value->type != JsonType::kString) {
+    return std::nullopt;
+  }
+  return value->text;
+}
+
+std::optional<int64_t> JsonValue::IntField(std::string_view key) const {
+  const JsonValue* value = Find(key);
+  if (value == nullptr || value->type != JsonType::kNumber) {
+    return std::nullopt;
+  }
+  int64_t result = 0;
+  const char* first = value->text.data();
+  const char* last = first + value->text.size();
+  const auto [ptr, ec] = std::from_chars(first, last, result);
+  if (ec != std::errc() || ptr != last) {
+    return std::nullopt;
+  }
+  return result;
+}
+
+const JsonValue* JsonReader::Parse(std::string_view text, std::string* error) {
+  arena_.Reset();
+  value_stack_.clear();
+  member_stack_.clear();
+  begin_ = text.data();
+  pos_ = begin_;
+  end_ = begin_ + text.size();
+  error_ = nullptr;
+
+  JsonValue* root = arena_.AllocateArray<JsonValue>(1);
+  new (root) JsonValue();
+  SkipWhitespace();
+  bool ok = ParseValue(root, 0);
+  if (ok) {
+    SkipWhitespace();
+    ok = pos_ == end_ || Fail("trailing characters");
+  }
+  if (!ok) {
+    if (error != nullptr) {
+      *error = std::string("invalid JSON: ") + error_ + " at offset " + std::to_string(pos_ - begin_);
+    }
+    return nullptr;
+  }
+  return root;
+}
+
+bool JsonReader::Fail(const char* message) {
+  error_ = message;
+  return false;
+}
+
+void JsonReader::SkipWhitespace() {
+  while (pos_ < end_ && (*pos_ == ' ' || *pos_ == '\n' || *pos_ == '\r' || *pos_ == '\t')) {
+    ++pos_;
+  }
+}
+
+bool JsonReader::ParseValue(JsonValue* out, int depth) {
+  if (pos_ >= end_) {
+    return Fail("unexpected end of input");
+  }
+  switch (*pos_) {
+    case '{':
+      return ParseObject(out, depth);
+    case '[':
+      return ParseArray(out, depth);
+    case '"':
+      out->type = JsonType::kString;
+      return ParseString(&out->text);
+    case 't':
+      out->type = JsonType::kBool;
+      out->boolean = true;
+      return ParseLiteral("true");
+    case 'f':
+      out->type = JsonType::kBool;
+      out->boolean = false;
+      return ParseLiteral("false");
+    case 'n':
+      out->type = JsonType::kNull;
+      return ParseLiteral("null");
+    default:
+      if (*pos_ == '-' || (*pos_ >= '0' && *pos_ <= '9')) {
+        return ParseNumber(out);
+      }
+      return Fail("unexpected character");
+  }
+}
+
+bool JsonReader::ParseLiteral(std::string_view literal) {
+  if (static_cast<size_t>(end_ - pos_) < literal.size() ||
+      std::memcmp(pos_, literal.data(), literal.size()) != 0) {
+    return Fail("invalid literal");
+  }
+  pos_ += literal.size();
+  return true;
+}
+
+bool JsonReader::ParseNumber(JsonValue* out) {
+  const char* start = pos_;
+  auto digits = [this]() {
+    const char* first = pos_;
+    while (pos_ < end_ && *pos_ >= '0' && *pos_ <= '9') {
+      ++pos_;
+    }
+    return pos_ > first;
+  };
+
+  if (*pos_ == '-') {
+    ++pos_;
+  }
+  if (pos_ < end_ && *pos_ == '0') {
+    ++pos_;
+  } else if (!digits()) {
+    return Fail("invalid number");
+  }
+  if (pos_ < end_ && *pos_ == '.') {
+    ++pos_;
+    if (!digits()) {
+      return Fail("invalid number");
+    }
+  }
+  if (pos_ < end_ && (*pos_ == 'e' || *pos_ == 'E')) {
+    ++pos_;
+    if (pos_ < end_ && (*pos_ == '+' || *pos_ == '-')) {
+      ++pos_;
+    }
+    if (!digits()) {
+      return Fail("invalid number");
+    }
+  }
+  out->type = JsonType::kNumber;
+  out->text = std::string_view(start, static_cast<size_t>(pos_ - start));
+  return true;
+}
+
+bool JsonReader::ParseString(std::string_view* out) {
+  ++pos_;  // opening quote
+  const char* start = pos_;
+
+  // Fast path: no escapes, so the value can point into the input.
+  while (pos_ < end_) {
+    const uint8_t c = static_cast<uint8_t>(*pos_);
+    if (c == '"') {
+      *out = std::string_view(start, static_cast<size_t>(pos_ - start));
+      ++pos_;
+      return true;
+    }
+    if (c == '\\') {
+      break;
+    }
+    if (c < 0x20) {
+      return Fail("control character in string");
+    }
+    if (c < 0x80) {
+      ++pos_;
+      continue;
+    }
+    const size_t length = Utf8SequenceLength(pos_, end_);
+    if (length == 0) {
+      return Fail("invalid UTF-8 in string");
+    }
+    pos_ += length;
+  }
+  if (pos_ >= end_) {
+    return Fail("unterminated string");
+  }
+
+  unescaped_.assign(start, pos_);
+  while (pos_ < end_ && *pos_ != '"') {
+    const uint8_t c = static_cast<uint8_t>(*pos_);
+    if (c < 0x20) {
+      return Fail("control character in string");
+    }
+    if (c >= 0x80) {
+      const size_t length = Utf8SequenceLength(pos_, end_);
+      if (length == 0) {
+        return Fail("invalid UTF-8 in string");
+      }
+      unescaped_.append(pos_, length);
+      pos_ += length;
+      continue;
+    }
+    if (c != '\\') {
+      unescaped_.push_back(static_cast<char>(c));
+      ++pos_;
+      continue;
+    }
+    if (end_ - pos_ < 2) {
+      return Fail("unterminated string");
+    }
+    const char escape = pos_[1];
+    pos_ += 2;
+    switch (escape) {
+      case '"': unescaped_.push_back('"'); break;
+      case '\\': unescaped_.push_back('\\'); break;
+      case '/': unescaped_.push_back('/'); break;
+      case 'b': unescaped_.push_back('\b'); break;
+      case 'f': unescaped_.push_back('\f'); break;
+      case 'n': unescaped_.push_back('\n'); break;
+      case 'r': unescaped_.push_back('\r'); break;
+      case 't': unescaped_.push_back('\t'); break;
+      case 'u': {
+        auto read_hex4 = [this](uint32_t* value) {
+          if (end_ - pos_ < 4) {
+            return false;
+          }
+          *value = 0;
+          for (int i = 0; i < 4; ++i) {
+            const int digit = HexDigitValue(pos_[i]);
+            if (digit < 0) {
+              return false;
+            }
+            *value = (*value << 4) | static_cast<uint32_t>(digit);
+          }
+          pos_ += 4;
+          return true;
+        };
+        uint32_t code_point = 0;
+        if (!read_hex4(&code_point)) {
+          return Fail("invalid unicode escape");
+        }
+        if (code_point >= 0xDC00 && code_point <= 0xDFFF) {
+          return Fail("unpaired surrogate escape");
+        }
+        if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+          uint32_t low = 0;
+          if (end_ - pos_ < 2 || pos_[0] != '\\' || pos_[1] != 'u') {
+            return Fail("unpaired surrogate escape");
+          }
+          pos_ += 2;
+          if (!read_hex4(&low) || low < 0xDC00 || low > 0xDFFF) {
+            return Fail("unpaired surrogate escape");
+          }
+          code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+        }
+        AppendUtf8(code_point, &unescaped_);
+        break;
+      }
+      default:
+        return Fail("invalid escape");
+    }
+  }
+  if (pos_ >= end_) {
+    return Fail("unterminated string");
+  }
+  ++pos_;  // closing quote
+
+  char* copy = arena_.AllocateArray<char>(unescaped_.size());
+  std::memcpy(copy, unescaped_.data(), unescaped_.size());
+  *out = std::string_view(copy, unescaped_.size());
+  return true;
+}
+
+bool JsonReader::ParseArray(JsonValue* out, int depth) {
+  if (depth >= kMaxDepth) {
+    return Fail("nesting too deep");
+  }
+  ++pos_;  // '['
+  const size_t base = value_stack_.size();
+  SkipWhitespace();
+  if (pos_ < end_ && *pos_ == ']') {
+    ++pos_;
+  } else {
+    while (true) {
+      JsonValue item;
+      if (!ParseValue(&item, depth + 1)) {
+        return false;
+      }
+      value_stack_.push_back(item);
+      SkipWhitespace();
+      if (pos_ < end_ && *pos_ == ',') {
+        ++pos_;
+        SkipWhitespace();
+        continue;
+      }
+      if (pos_ < end_ && *pos_ == ']') {
+        ++pos_;
+        break;
+      }
+      return Fail("expected ',' or ']'");
+    }
+  }
+
+  out->type = JsonType::kArray;
+  out->count = value_stack_.size() - base;
+  JsonValue* items = arena_.AllocateArray<JsonValue>(out->count);
+  std::uninitialized_copy(value_stack_.begin() + static_cast<ptrdiff_t>(base), value_stack_.end(), items);
+  out->items = items;
+  value_stack_.resize(base);
+  return true;
+}
+
+bool JsonReader::ParseObject(JsonValue* out, int depth) {
+  if (depth >= kMaxDepth) {
+    return Fail("nesting too deep");
+  }
+  ++pos_;  // '{'
+  const size_t base = member_stack_.size();
+  SkipWhitespace();
+  if (pos_ < end_ && *pos_ == '}') {
+    ++pos_;
+  } else {
+    while (true) {
+      if (pos_ >= end_ || *pos_ != '"') {
+        return Fail("expected object key");
+      }
+      JsonMember member;
+      if (!ParseString(&member.key)) {
+        return false;
+      }
+      SkipWhitespace();
+      if (pos_ >= end_ || *pos_ != ':') {
+        return Fail("expected ':'");
+      }
+      ++pos_;
+      SkipWhitespace();
+      if (!ParseValue(&member.value, depth + 1)) {
+        return false;
+      }
+      member_stack_.push_back(member);
+      SkipWhitespace();
+      if (pos_ < end_ && *pos_ == ',') {
+        ++pos_;
+        SkipWhitespace();
+        continue;
+      }
+      if (pos_ < end_ && *pos_ == '}') {
+        ++pos_;
+        break;
+      }
+      return Fail("expected ',' or '}'");
+    }
+  }
+
+  out->type = JsonType::kObject;
+  out->count = member_stack_.size() - base;
+  JsonMember* members = arena_.AllocateArray<JsonMember>(out->count);
+  std::uninitialized_copy(member_stack_.begin() + static_cast<ptrdiff_t>(base), member_stack_.end(), members);
+  out->members = members;
+  member_stack_.resize(base);
+  return true;
+}
+
+void JsonWriter::Separator() {
+  if (depth_ == 0 || out_->empty()) {
+    return;
+  }
+  const char last = out_->back();
+  if (last != '{' && last != '[' && last != ':') {
+    out_->push_back(',');
+  }
+}
+
+JsonWriter& JsonWriter::BeginObject() {
+  Separator();
+  out_->push_back('{');
+  ++depth_;
+  return *this;
+}
+
+JsonWriter& JsonWriter::EndObject() {
+  out_->push_back('}');
+  --depth_;
+  return *this;
+}
+
+JsonWriter& JsonWriter::BeginArray() {
+  Separator();
+  out_->push_back('[');
+  ++depth_;
+  return *this;
+}
+
+JsonWriter& JsonWriter::EndArray() {
+  out_->push_back(']');
+  --depth_;
+  return *this;
+}
+
+JsonWriter& JsonWriter::Key(std::string_view key) {
+  Separator();
+  AppendJsonString(key, out_);
+  out_->push_back(':');
+  return *this;
+}
+
+JsonWriter& JsonWriter::String(std::string_view value) {
+  Separator();
+  AppendJsonString(value, out_);
+  return *this;
+}
+
+JsonWriter& JsonWriter::Int(int64_t value) {
+  Separator();
+  char buffer[24];
+  const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  out_->append(buffer, result.ptr);
+  return *this;
+}
+
+JsonWriter& JsonWriter::Bool(bool value) {
+  Separator();
+  out_->append(value ? "true" : "false");
+  return *this;
+}
+
+JsonWriter& JsonWriter::Null() {
+  Separator();
+  out_->append("null");
+  return *this;
+}
+
+JsonWriter& JsonWriter::Value(const JsonValue& value) {
+  switch (value.type) {
+    case JsonType::kNull:
+      return Null();
+    case JsonType::kBool:
+      return Bool(value.boolean);
+    case JsonType::kNumber:
+      Separator();
+      out_->append(value.text);
+      return *this;
+    case JsonType::kString:
+      return String(value.text);
+    case JsonType::kArray:
+      BeginArray();
+      for (size_t i = 0; i < value.count; ++i) {
+        Value(value.items[i]);
+      }
+      return EndArray();
+    case JsonType::kObject:
+      BeginObject();
+      for (size_t i = 0; i < value.count; ++i) {
+        Key(value.members[i].key).Value(value.members[i].value);
+      }
+      return EndObject();
+  }
+  return *this;
+}
+
+void AppendJsonString(std::string_view value, std::string* out) {
+  static constexpr char kHex[] = "0123456789abcdef";
+  out->push_back('"');
+  size_t run = 0;
+  for (size_t i = 0; i < value.size(); ++i) {
+    const uint8_t c = static_cast<uint8_t>(value[i]);
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+    out->append(value.data() + run, i - run);
+    run = i + 1;
+    switch (c) {
+      case '"': out->append("\\\""); break;
+      case '\\': out->append("\\\\"); break;
+      case '\n': out->append("\\n"); break;
+      case '\r': out->append("\\r"); break;
+      case '\t': out->append("\\t"); break;
+      case '\b': out->append("\\b"); break;
+      case '\f': out->append("\\f"); break;
+      default: {
+        const char escaped[] = {'\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0xF]};
+        out->append(escaped, sizeof(escaped));
+        break;
+      }
+    }
+  }
+  out->append(value.data() + run, value.size() - run);
+  out->push_back('"');
+}
+
+bool IsValidUtf8(std::string_view text) {
+  const char* p = text.data();
+  const char* end = p + text.size();
+  while (p < end) {
+    if (static_cast<uint8_t>(*p) < 0x80) {
+      ++p;
+      continue;
+    }
+    const size_t length = Utf8SequenceLength(p, end);
+    if (length == 0) {
+      return false;
+    }
+    p += length;
+  }
+  return true;
+}
+
+void AppendUtf8(uint32_t code_point, std::string* out) {
+  if (code_point < 0x80) {
+    out->push_back(static_cast<char>(code_point));
+  } else if (code_point < 0x800) {
+    out->push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else if (code_point < 0x10000) {
+    out->push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+    out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else {
+    out->push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+    out->push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  }
+}
+
+std::string ExtractJsonStringField(std::string_view json, std::string_view key) {
+  std::string needle;
+  needle.reserve(key.size() + 4);
+  needle.append("\"").append(key).append("\":\"");
+  const size_t pos = json.find(needle);
+  if (pos == std::string_view::npos) {
+    return "";
+  }
+  const size_t begin = pos + needle.size();
+  size_t end = begin;
+  while (end < json.size() && json[end] != '"') {
+    end += (json[end] == '\\') ? 2 : 1;
+  }
+  return end <= json.size() ? std::string(json.substr(begin, end - begin)) : "";
+}
+
+void JsonStringStreamDecoder::Reset() {
+  state_ = State::kNormal;
+  high_surrogate_ = 0;
+  done_ = false;
+}
+
+bool JsonStringStreamDecoder::Decode(const char* data, size_t size, size_t* consumed, std::string* out) {
+  size_t i = 0;
+  for (; i < size && !done_; ++i) {
+    const char c = data[i];
+    switch (state_) {
+      case State::kNormal:
+        // A high surrogate escape must be followed by a low one.
+        if (high_surrogate_ != 0 && c != '\\') {
+          return false;
+        }
+        if (static_cast<uint8_t>(c) < 0x20) {
+          return false;
+        }
+        if (c == '"') {
+          done_ = true;
+        } else if (c == '\\') {
+          state_ = State::kEscape;
+        } else {
+          out->push_back(c);
+        }
+        break;
+      case State::kEscape:
+        state_ = State::kNormal;
+        if (high_surrogate_ != 0 && c != 'u') {
+          return false;
+        }
+        switch (c) {
+          case '"': out->push_back('"'); break;
+          case '\\': out->push_back('\\'); break;
+          case '/': out->push_back('/'); break;
+          case 'b': out->push_back('\b'); break;
+          case 'f': out->push_back('\f'); break;
+          case 'n': out->push_back('\n'); break;
+          case 'r': out->push_back('\r'); break;
+          case 't': out->push_back('\t'); break;
+          case 'u':
+            state_ = State::kUnicode;
+            unicode_value_ = 0;
+            unicode_digits_ = 0;
+            break;
+          default:
+            return false;
+        }
+        break;
+      case State::kUnicode: {
+        const int digit = HexDigitValue(c);
+        if (digit < 0) {
+          return false;
+        }
+        unicode_value_ = (unicode_value_ << 4) | static_cast<uint32_t>(digit);
+        if (++unicode_digits_ < 4) {
+          break;
+        }
+        state_ = State::kNormal;
+        const bool low = unicode_value_ >= 0xDC00 && unicode_value_ <= 0xDFFF;
+        if (high_surrogate_ != 0) {
+          if (!low) {
+            return false;
+          }
+          AppendUtf8(0x10000 + ((high_surrogate_ - 0xD800) << 10) + (unicode_value_ - 0xDC00), out);
+          high_surrogate_ = 0;
+        } else if (unicode_value_ >= 0xD800 && unicode_value_ <= 0xDBFF) {
+          high_surrogate_ = unicode_value_;
+        } else if (low) {
+          return false;
+        } else {
+          AppendUtf8(unicode_value_, out);
+        }
+        break;
+      }
+    }
+  }
+  if (consumed != nullptr) {
+    *consumed = i;
+  }
+  return true;
+}
+
+}  // namespace bridge
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bridge {
+
+// Bump allocator backing one parsed message. Reset() keeps the memory, and
+// folds overflow blocks into one, so steady-state parsing does not allocate.
+class JsonArena {
+ public:
+  explicit JsonArena(size_t block_bytes = 16 * 1024);
+
+  JsonArena(const JsonArena&) = delete;
+  JsonArena& operator=(const JsonArena&) = delete;
+
+  void* Allocate(size_t size, size_t align);
+
+  template <typename T>
+  T* AllocateArray(size_t count) {
+    return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+  }
+
+  void Reset();
+
+  size_t capacity() const {
+    return capacity_;
+  }
+
+ private:
+  struct Block {
+    std::unique_ptr<uint8_t[]> data;
+    size_t size = 0;
+  };
+
+  void AddBlock(size_t min_size);
+
+  size_t block_bytes_;
+  std::vector<Block> blocks_;
+  size_t offset_ = 0;
+  size_t capacity_ = 0;
+};
+
+enum class JsonType : uint8_t { kNull, kBool, kNumber, kString, kArray, kObject };
+
+struct JsonMember;
+
+// A node of a parsed document. Strings without escapes point straight into
+// the parsed text; everything else lives in the reader's arena.
+struct JsonValue {
+  JsonType type = JsonType::kNull;
+  bool boolean = false;
+  std::string_view text;  // string contents, or the literal of a number
+  const JsonValue* items = nullptr;
+  const JsonMember* members = nullptr;
+  size_t count = 0;
+
+  bool is_object() const {
+    return type == JsonType::kObject;
+  }
+
+  // Linear lookup; protocol objects have a handful of members.
+  const JsonValue* Find(std::string_view key) const;
+  std::optional<std::string_view> StringField(std::string_view key) const;
+  std::optional<int64_t> IntField(std::string_view key) const;
+};
+
+struct JsonMember {
+  std::string_view key;
+  JsonValue value;
+};
+
+// Reusable RFC 8259 parser. The returned tree is valid until the next Parse()
+// and only as long as `text` is alive and unchanged: strings in it point into
+// `text`. A caller that parses a member buffer must not let anything it does
+// while walking the tree modify or free that buffer.
+class JsonReader {
+ public:
+  const JsonValue* Parse(std::string_view text, std::string* error);
+
+  const JsonArena& arena() const {
+    return arena_;
+  }
+
+ private:
+  static constexpr int kMaxDepth = 64;
+
+  bool ParseValue(JsonValue* out, int depth);
+  bool ParseString(std::string_view* out);
+  bool ParseNumber(JsonValue* out);
+  bool ParseArray(JsonValue* out, int depth);
+  bool ParseObject(JsonValue* out, int depth);
+  bool ParseLiteral(std::string_view literal);
+  void SkipWhitespace();
+  bool Fail(const char* message);
+
+  JsonArena arena_;
+  std::vector<JsonValue> value_stack_;
+  std::vector<JsonMember> member_stack_;
+  std::string unescaped_;
+  const char* begin_ = nullptr;
+  const char* pos_ = nullptr;
+  const char* end_ = nullptr;
+  const char* error_ = nullptr;
+};
+
+// Appends compact JSON straight into a caller-owned buffer, typically the
+// payload that is about to be queued for a socket or pipe.
+class JsonWriter {
+ public:
+  explicit JsonWriter(std::string* out) : out_(out) {}
+
+  JsonWriter& BeginObject();
+  JsonWriter& EndObject();
+  JsonWriter& BeginArray();
+  JsonWriter& EndArray();
+  JsonWriter& Key(std::string_view key);
+  JsonWriter& String(std::string_view value);
+  JsonWriter& Int(int64_t value);
+  JsonWriter& Bool(bool value);
+  JsonWriter& Null();
+  // Re-emits a parsed value, keeping number literals byte-for-byte.
+  JsonWriter& Value(const JsonValue& value);
+
+  JsonWriter& Field(std::string_view key, std::string_view value) {
+    return Key(key).String(value);
+  }
+
+ private:
+  void Separator();
+
+  std::string* out_;
+  int depth_ = 0;
+};
+
+void AppendUtf8(uint32_t code_point, std::string* out);
+
+// Appends `value` as a quoted, escaped JSON string.
+void AppendJsonString(std::string_view value, std::string* out);
+
+// True if `text` is well-formed UTF-8 without surrogate code points.
+bool IsValidUtf8(std::string_view text);
+
+// Returns the value of a top-level string field from compact JSON such as the
+// helper emits ("key":"value"). Used to classify outbound messages without a
+// full parse; escaped quotes inside the value are honoured.
+std::string ExtractJsonStringField(std::string_view json, std::string_view key);
+
+// Decodes the body of a JSON string literal (everything after the opening
+// quote) into UTF-8 as it arrives. Escapes may be split across pieces.
+class JsonStringStreamDecoder {
+ public:
+  void Reset();
+
+  // Appends decoded text to *out and stops after the closing quote. Returns
+  // false on a malformed escape, an unpaired surrogate escape or a raw
+  // control character, as JsonReader does. *consumed receives the input
+  // bytes used.
+  bool Decode(const char* data, size_t size, size_t* consumed, std::string* out);
+
+  bool done() const {
+    return done_;
+  }
+
+ private:
+  enum class State { kNormal, kEscape, kUnicode };
+
+  State state_ = State::kNormal;
+  uint32_t unicode_value_ = 0;
+  int unicode_digits_ = 0;
+  uint32_t high_surrogate_ = 0;
+  bool done_ = false;
+};
+
+}  // namespace bridge
@@ -0,0 +1,109 @@
+#include "Metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace bridge {
+
+namespace {
+
+std::string FormatDouble(double value) {
+  if (std::isnan(value)) {
+    return "NaN";
+  }
+  char buffer[32];
+  const int n = std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+  return std::string(buffer, static_cast<size_t>(std::max(n, 0)));
+}
+
+}  // namespace
+
+MessageTypeCounter::MessageTypeCounter(std::initializer_list<std::string_view> types)
+    : types_(types), counts_(new Counter[types.size() + 1]) {}
+
+void MessageTypeCounter::Add(std::string_view type) {
+  size_t i = 0;
+  while (i < types_.size() && types_[i] != type) {
+    ++i;
+  }
+  counts_[i].Add();
+}
+
+LatencyHistogram::LatencyHistogram(std::initializer_list<double> bounds)
+    : bounds_(bounds), buckets_(new Counter[bounds.size() + 1]) {}
+
+void LatencyHistogram::Observe(double seconds) {
+  const size_t i = std::lower_bound(bounds_.begin(), bounds_.end(), seconds) - bounds_.begin();
+  buckets_[i].Add();
+  sum_.store(sum_.load(std::memory_order_relaxed) + seconds, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::cumulative_count(size_t i) const {
+  uint64_t total = 0;
+  for (size_t b = 0; b <= i && b <= bounds_.size(); ++b) {
+    total += buckets_[b].value();
+  }
+  return total;
+}
+
+double LatencyHistogram::sum() const {
+  return sum_.load(std::memory_order_relaxed);
+}
+
+PrometheusWriter& PrometheusWriter::Family(std::string_view name, std::string_view type, std::string_view help) {
+  out_->append("# HELP ").append(name).append(" ").append(help).append("\n");
+  out_->append("# TYPE ").append(name).append(" ").append(type).append("\n");
+  return *this;
+}
+
+PrometheusWriter& PrometheusWriter::Sample(std::string_view name, std::string_view labels, uint64_t value) {
+  SampleName(name, labels);
+  out_->append(std::to_string(value)).append("\n");
+  return *this;
+}
+
+PrometheusWriter& PrometheusWriter::Sample(std::string_view name, std::string_view labels, double value) {
+  SampleName(name, labels);
+  out_->append(FormatDouble(value)).append("\n");
+  return *this;
+}
+
+PrometheusWriter& PrometheusWriter::Types(std::string_view name,
+                                          std::string_view help,
+                                          const MessageTypeCounter& counter) {
+  Family(name, "counter", help);
+  std::string label;
+  for (size_t i = 0; i < counter.size(); ++i) {
+    label.assign("type=\"").append(counter.type(i)).append("\"");
+    Sample(name, label, counter.count(i));
+  }
+  return *this;
+}
+
+PrometheusWriter& PrometheusWriter::Histogram(std::string_view name,
+                                              std::string_view help,
+                                              const LatencyHistogram& histogram) {
+  Family(name, "histogram", help);
+  const std::string bucket = std::string(name) + "_bucket";
+  std::string label;
+  for (size_t i = 0; i <= histogram.bounds().size(); ++i) {
+    label.assign("le=\"")
+        .append(i < histogram.bounds().size() ? FormatDouble(histogram.bounds()[i]) : "+Inf")
+        .append("\"");
+    Sample(bucket, label, histogram.cumulative_count(i));
+  }
+  Sample(std::string(name) + "_sum", {}, histogram.sum());
+  Sample(std::string(name) + "_count", {}, histogram.cumulative_count(histogram.bounds().size()));
+  return *this;
+}
+
+void PrometheusWriter::SampleName(std::string_view name, std::string_view labels) {
+  out_->append(name);
+  if (!labels.empty()) {
+    out_->append("{").append(labels).append("}");
+  }
+  out_->append(" ");
+}
+
+}  // namespace bridge
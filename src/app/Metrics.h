@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace bridge {
+
+// Counters for the /metrics endpoint. Each one has a single writing thread,
+// which updates it with relaxed loads and stores; no locks or read-modify-
+// write instructions are involved, so counting costs the same as a plain
+// increment. Any thread may read a consistent (if slightly stale) value when
+// the endpoint is scraped.
+class Counter {
+ public:
+  void Add(uint64_t n = 1) {
+    value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+  uint64_t value() const {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<uint64_t> value_{0};
+};
+
+// One counter per message type. Types outside the fixed list are counted as
+// "other", so a misbehaving peer cannot grow the label set.
+class MessageTypeCounter {
+ public:
+  explicit MessageTypeCounter(std::initializer_list<std::string_view> types);
+
+  void Add(std::string_view type);
+
+  size_t size() const {
+    return types_.size() + 1;
+  }
+  std::string_view type(size_t i) const {
+    return i < types_.size() ? types_[i] : std::string_view("other");
+  }
+  uint64_t count(size_t i) const {
+    return counts_[i].value();
+  }
+
+ private:
+  std::vector<std::string_view> types_;
+  std::unique_ptr<Counter[]> counts_;
+};
+
+// Cumulative latency histogram with fixed bucket bounds in seconds. Like
+// Counter, it has a single writing thread.
+class LatencyHistogram {
+ public:
+  explicit LatencyHistogram(std::initializer_list<double> bounds);
+
+  void Observe(double seconds);
+
+  const std::vector<double>& bounds() const {
+    return bounds_;
+  }
+  // Observations at or below bounds()[i]; i == bounds().size() is +Inf.
+  uint64_t cumulative_count(size_t i) const;
+  double sum() const;
+
+ private:
+  std::vector<double> bounds_;
+  std::unique_ptr<Counter[]> buckets_;  // per bucket, not cumulative
+  std::atomic<double> sum_{0.0};
+};
+
+// Appends metrics in the Prometheus text exposition format (0.0.4). Label
+// strings are preformatted, e.g. `ring="mic_feed"`, and are not escaped.
+class PrometheusWriter {
+ public:
+  explicit PrometheusWriter(std::string* out) : out_(out) {}
+
+  // Starts a metric family; `type` is "counter", "gauge" or "histogram".
+  PrometheusWriter& Family(std::string_view name, std::string_view type, std::string_view help);
+  PrometheusWriter& Sample(std::string_view name, std::string_view labels, uint64_t value);
+  PrometheusWriter& Sample(std::string_view name, std::string_view labels, double value);
+  template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+  PrometheusWriter& Sample(std::string_view name, std::string_view labels, T value) {
+    return Sample(name, labels, static_cast<uint64_t>(value));
+  }
+  // Writes a counter family with one sample per message type.
+  PrometheusWriter& Types(std::string_view name, std::string_view help, const MessageTypeCounter& counter);
+  // Writes a whole histogram family.
+  PrometheusWriter& Histogram(std::string_view name, std::string_view help, const LatencyHistogram& histogram);
+
+ private:
+  void SampleName(std::string_view name, std::string_view labels);
+
+  std::string* out_;
+};
+
+}  // namespace bridge
@@ -0,0 +1,197 @@
+#include "PcmBlock.h"
+
+#include "SampleKernels.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <utility>
+
+namespace bridge {
+
+// Samples are copied as host values; every supported Mac is little-endian.
+static_assert(std::endian::native == std::endian::little, "PCM blocks assume a little-endian host");
+
+size_t PcmBytesPerSample(PcmSampleFormat format) {
+  return format == PcmSampleFormat::kInt16 ? sizeof(int16_t) : sizeof(float);
+}
+
+bool ParsePcmSampleFormat(std::string_view name, PcmSampleFormat* out) {
+  if (name == "f32") {
+    *out = PcmSampleFormat::kFloat32;
+    return true;
+  }
+  if (name == "s16") {
+    *out = PcmSampleFormat::kInt16;
+    return true;
+  }
+  return false;
+}
+
+const char* PcmSampleFormatName(PcmSampleFormat format) {
+  return format == PcmSampleFormat::kInt16 ? "s16" : "f32";
+}
+
+void EncodePcmBlockHeader(const PcmBlockHeader& header, uint8_t* out) {
+  out[0] = header.version;
+  out[1] = static_cast<uint8_t>(header.stream);
+  out[2] = static_cast<uint8_t>(header.format);
+  out[3] = header.channels;
+  for (size_t i = 0; i < 4; ++i) {
+    out[4 + i] = static_cast<uint8_t>(header.frame_count >> (8 * i));
+  }
+  for (size_t i = 0; i < 8; ++i) {
+    out[8 + i] = static_cast<uint8_t>(header.timestamp_us >> (8 * i));
+  }
+}
+
+bool DecodePcmBlockHeader(const uint8_t* data, PcmBlockHeader* out, std::string* error) {
+  PcmBlockHeader header;
+  header.version = data[0];
+  header.stream = static_cast<PcmStreamId>(data[1]);
+  header.format = static_cast<PcmSampleFormat>(data[2]);
+  header.channels = data[3];
+  for (size_t i = 0; i < 4; ++i) {
+    header.frame_count |= static_cast<uint32_t>(data[4 + i]) << (8 * i);
+  }
+  for (size_t i = 0; i < 8; ++i) {
+    header.timestamp_us |= static_cast<uint64_t>(data[8 + i]) << (8 * i);
+  }
+
+  const char* problem = nullptr;
+  if (header.version != kPcmBlockVersion) {
+    problem = "unsupported PCM block version";
+  } else if (header.stream != PcmStreamId::kMicFeed && header.stream != PcmStreamId::kSpeakerTap) {
+    problem = "unknown PCM stream id";
+  } else if (header.format != PcmSampleFormat::kFloat32 && header.format != PcmSampleFormat::kInt16) {
+    problem = "unknown PCM sample format";
+  } else if (header.channels == 0 || header.channels > kPcmMaxChannels) {
+    problem = "invalid PCM channel count";
+  }
+  if (problem != nullptr) {
+    if (error != nullptr) {
+      *error = problem;
+    }
+    return false;
+  }
+  *out = header;
+  return true;
+}
+
+void AppendPcmSamples(const float* frames, size_t sample_count, PcmSampleFormat format, std::string* out) {
+  if (format == PcmSampleFormat::kFloat32) {
+    out->append(reinterpret_cast<const char*>(frames), sample_count * sizeof(float));
+    return;
+  }
+  const size_t offset = out->size();
+  out->resize(offset + sample_count * sizeof(int16_t));
+  FloatToInt16(frames, out->data() + offset, sample_count);
+}
+
+PcmBlockReader::PcmBlockReader(uint32_t output_channels, Callbacks callbacks)
+    : output_channels_(output_channels), callbacks_(std::move(callbacks)) {}
+
+void PcmBlockReader::Reset() {
+  header_size_ = 0;
+  frame_bytes_ = 0;
+  frames_remaining_ = 0;
+  partial_size_ = 0;
+}
+
+void PcmBlockReader::EmitFrames(const uint8_t* data, size_t frame_count) {
+  if (header_.format == PcmSampleFormat::kFloat32 && header_.channels == output_channels_ &&
+      reinterpret_cast<uintptr_t>(data) % alignof(float) == 0) {
+    callbacks_.on_frames(reinterpret_cast<const float*>(data), frame_count);
+    return;
+  }
+
+  const bool upmix = header_.channels != output_channels_;
+  if (scratch_.empty()) {
+    scratch_.resize(kScratchFrames * (output_channels_ + 1));
+  }
+  // Mono input is converted into the tail of scratch_, then spread over
+  // the channels at its head.
+  float* converted = upmix ? scratch_.data() + kScratchFrames * output_channels_ : scratch_.data();
+  while (frame_count > 0) {
+    const size_t n = std::min(frame_count, kScratchFrames);
+    const size_t samples = n * header_.channels;
+    if (header_.format == PcmSampleFormat::kInt16) {
+      Int16ToFloat(data, converted, samples);
+    } else {
+      std::memcpy(converted, data, samples * sizeof(float));
+    }
+    if (upmix) {
+      UpmixFromMono(converted, output_channels_, n, scratch_.data());
+    }
+    callbacks_.on_frames(scratch_.data(), n);
+    data += n * frame_bytes_;
+    frame_count -= n;
+  }
+}
+
+bool PcmBlockReader::Feed(const uint8_t* data, size_t size, bool final, std::string* error) {
+  auto fail = [error](const char* message) {
+    if (error != nullptr) {
+      *error = message;
+    }
+    return false;
+  };
+
+  if (header_size_ < kPcmBlockHeaderBytes) {
+    const size_t take = std::min(kPcmBlockHeaderBytes - header_size_, size);
+    if (take > 0) {
+      std::memcpy(header_bytes_ + header_size_, data, take);
+    }
+    header_size_ += take;
+    data += take;
+    size -= take;
+    if (header_size_ < kPcmBlockHeaderBytes) {
+      return !final || fail("PCM block is shorter than its header");
+    }
+    if (!DecodePcmBlockHeader(header_bytes_, &header_, error)) {
+      return false;
+    }
+    if (header_.channels != 1 && header_.channels != output_channels_) {
+      return fail("PCM channel count does not match the device");
+    }
+    if (callbacks_.on_header != nullptr && !callbacks_.on_header(header_, error)) {
+      return false;
+    }
+    frame_bytes_ = PcmBytesPerSample(header_.format) * header_.channels;
+    frames_remaining_ = header_.frame_count;
+  }
+
+  if (partial_size_ > 0 && size > 0) {
+    const size_t take = std::min(frame_bytes_ - partial_size_, size);
+    std::memcpy(partial_frame_ + partial_size_, data, take);
+    partial_size_ += take;
+    data += take;
+    size -= take;
+    if (partial_size_ == frame_bytes_) {
+      EmitFrames(partial_frame_, 1);
+      --frames_remaining_;
+      partial_size_ = 0;
+    }
+  }
+
+  const size_t whole_frames = size / frame_bytes_;
+  const size_t leftover = size % frame_bytes_;
+  if (whole_frames > frames_remaining_ || (whole_frames == frames_remaining_ && leftover > 0)) {
+    return fail("PCM block is longer than its frame count");
+  }
+  if (whole_frames > 0) {
+    EmitFrames(data, whole_frames);
+    frames_remaining_ -= whole_frames;
+  }
+  if (leftover > 0) {
+    std::memcpy(partial_frame_, data + whole_frames * frame_bytes_, leftover);
+    partial_size_ = leftover;
+  }
+
+  if (final && (frames_remaining_ > 0 || partial_size_ > 0)) {
+    return fail("PCM block is shorter than its frame count");
+  }
+  return true;
+}
+
+}  // namespace bridge
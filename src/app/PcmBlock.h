@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bridge {
+
+// Binary WebSocket messages carry one block of PCM: a fixed 16-byte
+// little-endian header followed by interleaved samples.
+//
+//   offset 0  u8  version (1)
+//   offset 1  u8  stream id (PcmStreamId)
+//   offset 2  u8  sample format (PcmSampleFormat)
+//   offset 3  u8  channels
+//   offset 4  u32 frame count
+//   offset 8  u64 timestamp, microseconds on the sender's monotonic clock
+enum class PcmStreamId : uint8_t {
+  kMicFeed = 1,     // client -> bridge, written into the mic_feed ring
+  kSpeakerTap = 2,  // bridge -> client, read from the speaker_tap ring
+};
+
+enum class PcmSampleFormat : uint8_t {
+  kFloat32 = 1,
+  kInt16 = 2,
+};
+
+struct PcmBlockHeader {
+  uint8_t version = 1;
+  PcmStreamId stream = PcmStreamId::kMicFeed;
+  PcmSampleFormat format = PcmSampleFormat::kFloat32;
+  uint8_t channels = 0;
+  uint32_t frame_count = 0;
+  uint64_t timestamp_us = 0;
+};
+
+constexpr uint8_t kPcmBlockVersion = 1;
+constexpr size_t kPcmBlockHeaderBytes = 16;
+constexpr uint8_t kPcmMaxChannels = 8;
+
+size_t PcmBytesPerSample(PcmSampleFormat format);
+bool ParsePcmSampleFormat(std::string_view name, PcmSampleFormat* out);
+const char* PcmSampleFormatName(PcmSampleFormat format);
+
+void EncodePcmBlockHeader(const PcmBlockHeader& header, uint8_t* out);
+bool DecodePcmBlockHeader(const uint8_t* data, PcmBlockHeader* out, std::string* error);
+
+// Converts interleaved float frames to `format`, appending to *out.
+void AppendPcmSamples(const float* frames, size_t sample_count, PcmSampleFormat format, std::string* out);
+
+// Turns the pieces of one binary message into interleaved float frames with
+// `output_channels` channels. Mono input is duplicated across channels.
+// Aligned float32 input with matching channels is passed through without a
+// copy; everything else is converted through a small fixed buffer, so memory
+// use does not depend on block size.
+class PcmBlockReader {
+ public:
+  struct Callbacks {
+    // Called once the header is complete; returning false rejects the block.
+    std::function<bool(const PcmBlockHeader& header, std::string* error)> on_header;
+    std::function<void(const float* frames, size_t frame_count)> on_frames;
+  };
+
+  PcmBlockReader(uint32_t output_channels, Callbacks callbacks);
+
+  void Reset();
+
+  // Returns false if the block is malformed or rejected; the rest of the
+  // message must then be discarded.
+  bool Feed(const uint8_t* data, size_t size, bool final, std::string* error);
+
+ private:
+  static constexpr size_t kScratchFrames = 512;
+
+  void EmitFrames(const uint8_t* data, size_t frame_count);
+
+  uint32_t output_channels_;
+  Callbacks callbacks_;
+
+  uint8_t header_bytes_[kPcmBlockHeaderBytes] = {};
+  size_t header_size_ = 0;
+  PcmBlockHeader header_;
+  size_t frame_bytes_ = 0;
+  uint64_t frames_remaining_ = 0;
+
+  // One frame split across two pieces.
+  alignas(float) uint8_t partial_frame_[kPcmMaxChannels * sizeof(float)] = {};
+  size_t partial_size_ = 0;
+
+  std::vector<float> scratch_;
+};
+
+}  // namespace bridge
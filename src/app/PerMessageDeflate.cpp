@@ -0,0 +1,252 @@
+#include "PerMessageDeflate.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+
+namespace bridge {
+
+namespace {
+
+// Trailer removed from every compressed message and restored before inflate.
+constexpr uint8_t kDeflateTail[4] = {0x00, 0x00, 0xFF, 0xFF};
+
+std::string TrimCopy(const std::string& s) {
+  size_t begin = 0;
+  size_t end = s.size();
+  while (begin < end && std::isspace(static_cast<unsigned char>(s[begin]))) {
+    ++begin;
+  }
+  while (end > begin && std::isspace(static_cast<unsigned char>(s[end - 1]))) {
+    --end;
+  }
+  return s.substr(begin, end - begin);
+}
+
+std::vector<std::string> Split(const std::string& s, char separator) {
+  std::vector<std::string> parts;
+  std::string part;
+  std::istringstream stream(s);
+  while (std::getline(stream, part, separator)) {
+    parts.push_back(TrimCopy(part));
+  }
+  return parts;
+}
+
+// Parses a window-bits value; an empty value (bare parameter) is allowed
+// only where the RFC allows it and then means "no preference".
+bool ParseWindowBits(const std::string& value, int* out) {
+  std::string digits = value;
+  if (digits.size() >= 2 && digits.front() == '"' && digits.back() == '"') {
+    digits = digits.substr(1, digits.size() - 2);
+  }
+  if (digits.empty() || digits.size() > 2 ||
+      !std::all_of(digits.begin(), digits.end(), [](unsigned char c) { return std::isdigit(c); })) {
+    return false;
+  }
+  const int bits = std::atoi(digits.c_str());
+  if (bits < 8 || bits > 15) {
+    return false;
+  }
+  *out = bits;
+  return true;
+}
+
+}  // namespace
+
+bool NegotiatePerMessageDeflate(const std::string& extensions_header,
+                                const DeflateOptions& options,
+                                DeflateParams* params,
+                                std::string* response_value) {
+  if (!options.enabled || extensions_header.empty()) {
+    return false;
+  }
+
+  for (const std::string& offer : Split(extensions_header, ',')) {
+    const std::vector<std::string> tokens = Split(offer, ';');
+    if (tokens.empty() || tokens[0] != "permessage-deflate") {
+      continue;
+    }
+
+    // zlib cannot produce a raw deflate stream with an 8-bit window, so the
+    // server side never goes below 9.
+    int server_bits = std::clamp(options.server_max_window_bits, 9, 15);
+    bool client_bits_offered = false;
+    int client_bits = 15;
+    bool server_no_takeover = !options.context_takeover;
+    bool client_no_takeover = false;
+    bool acceptable = true;
+
+    for (size_t i = 1; i < tokens.size() && acceptable; ++i) {
+      const size_t eq = tokens[i].find('=');
+      const std::string name = TrimCopy(tokens[i].substr(0, eq));
+      const std::string value = eq == std::string::npos ? "" : TrimCopy(tokens[i].substr(eq + 1));
+
+      if (name == "server_no_context_takeover") {
+        server_no_takeover = true;
+      } else if (name == "client_no_context_takeover") {
+        client_no_takeover = true;
+      } else if (name == "server_max_window_bits") {
+        int requested = 0;
+        acceptable = ParseWindowBits(value, &requested) && requested >= 9;
+        server_bits = std::min(server_bits, requested);
+      } else if (name == "client_max_window_bits") {
+        client_bits_offered = true;
+        int requested = 15;
+        if (!value.empty()) {
+          acceptable = ParseWindowBits(value, &requested);
+        }
+        client_bits = std::min(requested, std::clamp(options.client_max_window_bits, 8, 15));
+      } else {
+        acceptable = false;
+      }
+    }
+    if (!acceptable) {
+      continue;
+    }
+
+    std::ostringstream response;
+    response << "permessage-deflate";
+    if (server_no_takeover) {
+      response << "; server_no_context_takeover";
+    }
+    if (client_no_takeover) {
+      response << "; client_no_context_takeover";
+    }
+    if (server_bits < 15) {
+      response << "; server_max_window_bits=" << server_bits;
+    }
+    if (client_bits_offered && client_bits < 15) {
+      response << "; client_max_window_bits=" << client_bits;
+    }
+
+    params->enabled = true;
+    params->server_max_window_bits = server_bits;
+    params->server_no_context_takeover = server_no_takeover;
+    params->client_no_context_takeover = client_no_takeover;
+    *response_value = response.str();
+    return true;
+  }
+
+  return false;
+}
+
+PerMessageDeflate::~PerMessageDeflate() {
+  Close();
+}
+
+bool PerMessageDeflate::Init(const DeflateParams& params) {
+  Close();
+  params_ = params;
+
+  deflate_ = z_stream{};
+  if (deflateInit2(&deflate_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -params.server_max_window_bits, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+  // The client window never exceeds 15 bits, so inflating with 15 accepts
+  // whatever client_max_window_bits it settled on.
+  inflate_ = z_stream{};
+  if (inflateInit2(&inflate_, -15) != Z_OK) {
+    deflateEnd(&deflate_);
+    return false;
+  }
+  inflate_out_.resize(kInflateChunkBytes);
+  open_ = true;
+  return true;
+}
+
+void PerMessageDeflate::Close() {
+  if (!open_) {
+    return;
+  }
+  deflateEnd(&deflate_);
+  inflateEnd(&inflate_);
+  open_ = false;
+}
+
+bool PerMessageDeflate::Compress(const uint8_t* data, size_t size, std::string* out) {
+  if (!open_) {
+    return false;
+  }
+
+  // deflateBound() ignores the sync flush marker, hence the extra slack.
+  out->resize(deflateBound(&deflate_, static_cast<uLong>(size)) + 16);
+  deflate_.next_in = const_cast<Bytef*>(data);
+  deflate_.avail_in = static_cast<uInt>(size);
+  deflate_.next_out = reinterpret_cast<Bytef*>(out->data());
+  deflate_.avail_out = static_cast<uInt>(out->size());
+
+  int rc = deflate(&deflate_, Z_SYNC_FLUSH);
+  while (rc == Z_OK && deflate_.avail_out == 0) {
+    const size_t used = out->size();
+    out->resize(used * 2);
+    deflate_.next_out = reinterpret_cast<Bytef*>(out->data() + used);
+    deflate_.avail_out = static_cast<uInt>(out->size() - used);
+    rc = deflate(&deflate_, Z_SYNC_FLUSH);
+  }
+  if (rc != Z_OK && rc != Z_BUF_ERROR) {
+    return false;
+  }
+
+  size_t produced = out->size() - deflate_.avail_out;
+  if (produced >= sizeof(kDeflateTail) &&
+      std::equal(kDeflateTail, kDeflateTail + sizeof(kDeflateTail),
+                 reinterpret_cast<const uint8_t*>(out->data()) + produced - sizeof(kDeflateTail))) {
+    produced -= sizeof(kDeflateTail);
+  }
+  out->resize(produced);
+  // With nothing to flush (an empty message) zlib writes no block at all,
+  // but the receiver still appends the tail; a lone empty stored-block
+  // header keeps its stream in step (RFC 7692 section 7.2.3.6).
+  if (produced == 0) {
+    out->push_back('\0');
+  }
+
+  if (params_.server_no_context_takeover) {
+    deflateReset(&deflate_);
+  }
+  return true;
+}
+
+bool PerMessageDeflate::InflateInput(const uint8_t* data, size_t size, const Sink& sink) {
+  inflate_.next_in = const_cast<Bytef*>(data);
+  inflate_.avail_in = static_cast<uInt>(size);
+  do {
+    inflate_.next_out = inflate_out_.data();
+    inflate_.avail_out = static_cast<uInt>(inflate_out_.size());
+    const int rc = inflate(&inflate_, Z_SYNC_FLUSH);
+    if (rc != Z_OK && rc != Z_BUF_ERROR && rc != Z_STREAM_END) {
+      return false;
+    }
+    const size_t produced = inflate_out_.size() - inflate_.avail_out;
+    if (produced > 0) {
+      sink(inflate_out_.data(), produced);
+    }
+    if (rc == Z_BUF_ERROR && produced == 0) {
+      break;
+    }
+  } while (inflate_.avail_in > 0 || inflate_.avail_out == 0);
+  return true;
+}
+
+bool PerMessageDeflate::Decompress(const uint8_t* data, size_t size, bool final, const Sink& sink) {
+  if (!open_) {
+    return false;
+  }
+  if (size > 0 && !InflateInput(data, size, sink)) {
+    return false;
+  }
+  if (final) {
+    if (!InflateInput(kDeflateTail, sizeof(kDeflateTail), sink)) {
+      return false;
+    }
+    if (params_.client_no_context_takeover) {
+      inflateReset(&inflate_);
+    }
+  }
+  return true;
+}
+
+}  // namespace bridge
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <zlib.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace bridge {
+
+// Server-side permessage-deflate settings from the config file.
+struct DeflateOptions {
+  bool enabled = true;
+  int server_max_window_bits = 15;
+  int client_max_window_bits = 15;
+  bool context_takeover = true;
+  size_t min_compress_bytes = 512;
+};
+
+// Parameters agreed with one client during the opening handshake.
+struct DeflateParams {
+  bool enabled = false;
+  int server_max_window_bits = 15;
+  bool server_no_context_takeover = false;
+  bool client_no_context_takeover = false;
+};
+
+// Picks the first acceptable permessage-deflate offer from a
+// Sec-WebSocket-Extensions request header (RFC 7692). On success fills
+// *params and *response_value with the extension to echo back.
+bool NegotiatePerMessageDeflate(const std::string& extensions_header,
+                                const DeflateOptions& options,
+                                DeflateParams* params,
+                                std::string* response_value);
+
+// Per-connection compressor and decompressor. Both zlib streams live as long
+// as the connection and are only reset when context takeover is disabled, so
+// steady-state messages cause no allocation.
+class PerMessageDeflate {
+ public:
+  using Sink = std::function<void(const uint8_t* data, size_t size)>;
+
+  PerMessageDeflate() = default;
+  ~PerMessageDeflate();
+
+  PerMessageDeflate(const PerMessageDeflate&) = delete;
+  PerMessageDeflate& operator=(const PerMessageDeflate&) = delete;
+
+  bool Init(const DeflateParams& params);
+  void Close();
+
+  // Compresses one whole message into *out, replacing its contents. The
+  // buffer's capacity is reused across calls.
+  bool Compress(const uint8_t* data, size_t size, std::string* out);
+
+  // Inflates the next piece of a compressed message, passing output to
+  // `sink` in bounded chunks. `final` marks the last piece of the message.
+  bool Decompress(const uint8_t* data, size_t size, bool final, const Sink& sink);
+
+  bool is_open() const {
+    return open_;
+  }
+
+ private:
+  bool InflateInput(const uint8_t* data, size_t size, const Sink& sink);
+
+  static constexpr size_t kInflateChunkBytes = 16 * 1024;
+
+  DeflateParams params_;
+  z_stream deflate_ {};
+  z_stream inflate_ {};
+  std::vector<uint8_t> inflate_out_;
+  bool open_ = false;
+};
+
+}  // namespace bridge
@@ -0,0 +1,97 @@
+#include "ProcessSpawn.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace bridge {
+
+namespace {
+
+bool SetCloseOnExec(int fd) {
+  const int flags = fcntl(fd, F_GETFD, 0);
+  return flags >= 0 && fcntl(fd, F_SETFD, flags | FD_CLOEXEC) == 0;
+}
+
+}  // namespace
+
+bool MakePipe(int fds[2]) {
+  if (pipe(fds) != 0) {
+    return false;
+  }
+  if (!SetCloseOnExec(fds[0]) || !SetCloseOnExec(fds[1])) {
+    close(fds[0]);
+    close(fds[1]);
+    fds[0] = fds[1] = -1;
+    return false;
+  }
+  return true;
+}
+
+bool SpawnProcess(const std::string& path, const std::vector<std::string>& args, const std::vector<ChildFd>& fds,
+                  pid_t* pid, std::string* error) {
+  // A source descriptor numbered like one of the targets could be replaced
+  // by an earlier dup2 before its own; such sources are copied above them.
+  int highest_target = -1;
+  for (const ChildFd& fd : fds) {
+    highest_target = std::max(highest_target, fd.child_fd);
+  }
+  std::vector<int> sources;
+  std::vector<int> copies;
+  for (const ChildFd& fd : fds) {
+    int source = fd.parent_fd;
+    if (source <= highest_target) {
+      source = fcntl(source, F_DUPFD_CLOEXEC, highest_target + 1);
+      if (source < 0) {
+        for (int copy : copies) {
+          close(copy);
+        }
+        if (error != nullptr) {
+          *error = std::string("failed to set up child descriptors: ") + std::strerror(errno);
+        }
+        return false;
+      }
+      copies.push_back(source);
+    }
+    sources.push_back(source);
+  }
+
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attributes;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawnattr_init(&attributes);
+  for (size_t i = 0; i < fds.size(); ++i) {
+    posix_spawn_file_actions_adddup2(&actions, sources[i], fds[i].child_fd);
+  }
+#ifdef POSIX_SPAWN_CLOEXEC_DEFAULT
+  posix_spawnattr_setflags(&attributes, POSIX_SPAWN_CLOEXEC_DEFAULT);
+#endif
+
+  std::vector<char*> argv;
+  argv.reserve(args.size() + 1);
+  for (const std::string& arg : args) {
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+
+  const int rc = posix_spawn(pid, path.c_str(), &actions, &attributes, argv.data(), environ);
+  posix_spawnattr_destroy(&attributes);
+  posix_spawn_file_actions_destroy(&actions);
+  for (int copy : copies) {
+    close(copy);
+  }
+  if (rc != 0) {
+    if (error != nullptr) {
+      *error = "failed to start " + path + ": " + std::strerror(rc);
+    }
+    return false;
+  }
+  return true;
+}
+
+}  // namespace bridge
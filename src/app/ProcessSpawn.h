@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace bridge {
+
+// A descriptor the child gets: `parent_fd` appears there as `child_fd`.
+struct ChildFd {
+  int parent_fd = -1;
+  int child_fd = -1;
+};
+
+// Creates a pipe whose ends are close-on-exec, so that they reach a child
+// only through SpawnProcess's `fds`.
+bool MakePipe(int fds[2]);
+
+// Starts `path` with `args` (args[0] included) and the bridge's environment
+// through posix_spawn(), which neither copies the bridge's address space
+// nor runs code between fork and exec. The child gets the descriptors in
+// `fds` and, on macOS, no others; elsewhere descriptors lacking FD_CLOEXEC
+// leak into it as well. A failure to start the program, including exec
+// errors, is returned rather than surfacing as an exit status.
+bool SpawnProcess(const std::string& path, const std::vector<std::string>& args, const std::vector<ChildFd>& fds,
+                  pid_t* pid, std::string* error);
+
+}  // namespace bridge
@@ -0,0 +1,229 @@
+#include "SharedMemoryMessageRing.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bridge {
+
+namespace {
+
+// The engine helper maps the same layout from Swift.
+constexpr size_t kHeaderBytes = 192;
+constexpr size_t kWriteIndexOffset = 64;
+constexpr size_t kReadIndexOffset = 128;
+constexpr size_t kConsumerWaitingOffset = 132;
+
+uint32_t Padded(uint32_t bytes) {
+  return (bytes + 3) & ~uint32_t{3};
+}
+
+}  // namespace
+
+SharedMemoryMessageRing::SharedMemoryMessageRing()
+    : shm_fd_(-1),
+      mapping_(nullptr),
+      mapping_size_(0),
+      header_(nullptr),
+      capacity_(0),
+      peeked_bytes_(0),
+      owner_(false) {
+  static_assert(sizeof(Header) == kHeaderBytes);
+  static_assert(offsetof(Header, write_index) == kWriteIndexOffset);
+  static_assert(offsetof(Header, read_index) == kReadIndexOffset);
+  static_assert(offsetof(Header, consumer_waiting) == kConsumerWaitingOffset);
+}
+
+SharedMemoryMessageRing::~SharedMemoryMessageRing() {
+  Close();
+}
+
+uint8_t* SharedMemoryMessageRing::DataStart() const {
+  return reinterpret_cast<uint8_t*>(mapping_) + kHeaderBytes;
+}
+
+bool SharedMemoryMessageRing::Open(const std::string& name, bool create, uint32_t capacity_bytes) {
+  Close();
+
+  if (name.empty() || capacity_bytes < 4096 || (capacity_bytes & (capacity_bytes - 1)) != 0) {
+    return false;
+  }
+
+  std::string path_name = name;
+  if (!path_name.empty() && path_name[0] == '/') {
+    path_name.erase(0, 1);
+  }
+  std::replace(path_name.begin(), path_name.end(), '/', '_');
+  backing_file_ = "/tmp/" + path_name + ".ring";
+
+  const int flags = create ? (O_CREAT | O_RDWR) : O_RDWR;
+  shm_fd_ = open(backing_file_.c_str(), flags, 0600);
+  if (shm_fd_ < 0) {
+    return false;
+  }
+  owner_ = create;
+
+  mapping_size_ = kHeaderBytes + capacity_bytes;
+  if (ftruncate(shm_fd_, static_cast<off_t>(mapping_size_)) != 0) {
+    Close();
+    return false;
+  }
+
+  mapping_ = mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd_, 0);
+  if (mapping_ == MAP_FAILED) {
+    mapping_ = nullptr;
+    Close();
+    return false;
+  }
+
+  header_ = reinterpret_cast<Header*>(mapping_);
+  if (create) {
+    std::memset(mapping_, 0, kHeaderBytes);
+    header_->magic = kMagic;
+    header_->version = kVersion;
+    header_->capacity_bytes = capacity_bytes;
+  } else if (header_->magic != kMagic || header_->version != kVersion ||
+             header_->capacity_bytes != capacity_bytes) {
+    Close();
+    return false;
+  }
+
+  capacity_ = capacity_bytes;
+  peeked_bytes_ = 0;
+  return true;
+}
+
+void SharedMemoryMessageRing::Close() {
+  if (mapping_ != nullptr) {
+    munmap(mapping_, mapping_size_);
+    mapping_ = nullptr;
+  }
+  if (shm_fd_ >= 0) {
+    close(shm_fd_);
+    shm_fd_ = -1;
+  }
+  if (owner_ && !backing_file_.empty()) {
+    unlink(backing_file_.c_str());
+  }
+  owner_ = false;
+  backing_file_.clear();
+  mapping_size_ = 0;
+  header_ = nullptr;
+  capacity_ = 0;
+  peeked_bytes_ = 0;
+}
+
+bool SharedMemoryMessageRing::Write(std::string_view message) {
+  if (header_ == nullptr || message.size() > max_message_bytes()) {
+    return false;
+  }
+
+  const uint32_t length = static_cast<uint32_t>(message.size());
+  const uint32_t record = 4 + Padded(length);
+  uint32_t write = header_->write_index.load(std::memory_order_relaxed);
+  const uint32_t read = header_->read_index.load(std::memory_order_acquire);
+  uint32_t offset = write & (capacity_ - 1);
+  // A record that would run past the end starts over at the front, and the
+  // rest of the tail is skipped.
+  const uint32_t skip = capacity_ - offset < record ? capacity_ - offset : 0;
+  if (capacity_ - (write - read) < skip + record) {
+    return false;
+  }
+
+  uint8_t* data = DataStart();
+  if (skip > 0) {
+    std::memcpy(data + offset, &kWrapMarker, 4);
+    write += skip;
+    offset = 0;
+  }
+  std::memcpy(data + offset, &length, 4);
+  std::memcpy(data + offset + 4, message.data(), message.size());
+  header_->write_index.store(write + record, std::memory_order_release);
+  return true;
+}
+
+bool SharedMemoryMessageRing::TakeWakeup() {
+  if (header_ == nullptr) {
+    return false;
+  }
+  // Pairs with PrepareToWait(): either the consumer sees the new write index
+  // or this sees its flag.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  return header_->consumer_waiting.load(std::memory_order_relaxed) != 0 &&
+         header_->consumer_waiting.exchange(0, std::memory_order_relaxed) != 0;
+}
+
+bool SharedMemoryMessageRing::Peek(std::string_view* message) {
+  if (header_ == nullptr) {
+    return false;
+  }
+
+  const uint32_t write = header_->write_index.load(std::memory_order_acquire);
+  uint32_t read = header_->read_index.load(std::memory_order_relaxed);
+  if (read == write) {
+    return false;
+  }
+
+  const uint8_t* data = DataStart();
+  uint32_t offset = read & (capacity_ - 1);
+  uint32_t length = 0;
+  std::memcpy(&length, data + offset, 4);
+  if (length == kWrapMarker) {
+    read += capacity_ - offset;
+    header_->read_index.store(read, std::memory_order_release);
+    if (read == write) {
+      return false;
+    }
+    offset = 0;
+    std::memcpy(&length, data, 4);
+  }
+  if (length > max_message_bytes() || 4 + Padded(length) > write - read) {
+    return false;
+  }
+
+  *message = std::string_view(reinterpret_cast<const char*>(data + offset + 4), length);
+  peeked_bytes_ = 4 + Padded(length);
+  return true;
+}
+
+void SharedMemoryMessageRing::Consume() {
+  if (header_ == nullptr || peeked_bytes_ == 0) {
+    return;
+  }
+  const uint32_t read = header_->read_index.load(std::memory_order_relaxed);
+  header_->read_index.store(read + peeked_bytes_, std::memory_order_release);
+  peeked_bytes_ = 0;
+}
+
+bool SharedMemoryMessageRing::PrepareToWait() {
+  if (header_ == nullptr) {
+    return true;
+  }
+  header_->consumer_waiting.store(1, std::memory_order_seq_cst);
+  if (header_->write_index.load(std::memory_order_seq_cst) !=
+      header_->read_index.load(std::memory_order_relaxed)) {
+    header_->consumer_waiting.store(0, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void SharedMemoryMessageRing::FinishWait() {
+  if (header_ != nullptr) {
+    header_->consumer_waiting.store(0, std::memory_order_relaxed);
+  }
+}
+
+size_t SharedMemoryMessageRing::max_message_bytes() const {
+  return capacity_ == 0 ? 0 : capacity_ / 2 - 4;
+}
+
+bool SharedMemoryMessageRing::is_open() const {
+  return header_ != nullptr;
+}
+
+}  // namespace bridge
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace bridge {
+
+// Single-producer, single-consumer ring of variable-length messages in a
+// shared mapping, for commands and events between the bridge and the engine
+// helper. Like SharedMemoryAudioRing it is backed by a file under /tmp named
+// after the ring. Each message is a u32 length and its bytes, padded to four
+// bytes; a message never wraps, so the consumer reads it in place.
+//
+// Neither side blocks on the ring. A consumer that runs out of messages
+// calls PrepareToWait() and then sleeps on some other channel (the helper's
+// pipes); a producer that sees TakeWakeup() return true after a Write() must
+// signal that channel. While the consumer keeps up, nothing is signalled.
+class SharedMemoryMessageRing {
+ public:
+  SharedMemoryMessageRing();
+  ~SharedMemoryMessageRing();
+
+  SharedMemoryMessageRing(const SharedMemoryMessageRing&) = delete;
+  SharedMemoryMessageRing& operator=(const SharedMemoryMessageRing&) = delete;
+
+  // `capacity_bytes` must be a power of two of at least 4 KiB. The side
+  // that creates the ring removes its backing file on Close().
+  bool Open(const std::string& name, bool create, uint32_t capacity_bytes);
+  void Close();
+
+  // Producer. Returns false if the message does not fit right now; one
+  // longer than max_message_bytes() never does.
+  bool Write(std::string_view message);
+  // True, once, if the consumer announced it was going to sleep.
+  bool TakeWakeup();
+
+  // Consumer. The view stays valid until Consume().
+  bool Peek(std::string_view* message);
+  void Consume();
+  // Announces that the consumer is about to sleep. Returns false, and the
+  // consumer should not sleep, if messages arrived in the meantime.
+  bool PrepareToWait();
+  void FinishWait();
+
+  size_t max_message_bytes() const;
+  bool is_open() const;
+
+ private:
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity_bytes;
+    uint32_t reserved;
+    // Each side's index on its own cache line.
+    alignas(64) std::atomic<uint32_t> write_index;
+    alignas(64) std::atomic<uint32_t> read_index;
+    std::atomic<uint32_t> consumer_waiting;
+  };
+
+  static constexpr uint32_t kMagic = 0x424D5253;  // "SRMB"
+  static constexpr uint32_t kVersion = 1;
+  static constexpr uint32_t kWrapMarker = 0xFFFFFFFF;
+
+  uint8_t* DataStart() const;
+
+  int shm_fd_;
+  void* mapping_;
+  size_t mapping_size_;
+  Header* header_;
+  uint32_t capacity_;
+  uint32_t peeked_bytes_;
+  bool owner_;
+  std::string backing_file_;
+};
+
+}  // namespace bridge
@@ -0,0 +1,75 @@
+#include "WebSocketFrame.h"
+
+#include "Json.h"
+
+#include <cstring>
+
+namespace bridge {
+
+size_t EncodeWebSocketHeader(uint8_t* out, WsOpcode opcode, size_t payload_size, bool compressed) {
+  out[0] = 0x80 | (compressed ? 0x40 : 0x00) | static_cast<uint8_t>(opcode);
+  if (payload_size < 126) {
+    out[1] = static_cast<uint8_t>(payload_size);
+    return 2;
+  }
+  size_t ext_bytes = 8;
+  out[1] = 127;
+  if (payload_size <= 0xFFFF) {
+    ext_bytes = 2;
+    out[1] = 126;
+  }
+  for (size_t i = 0; i < ext_bytes; ++i) {
+    out[2 + i] = static_cast<uint8_t>(static_cast<uint64_t>(payload_size) >> (8 * (ext_bytes - 1 - i)));
+  }
+  return 2 + ext_bytes;
+}
+
+std::string_view WebSocketFramePayload(std::string_view frame) {
+  if (frame.size() < 2) {
+    return {};
+  }
+  const uint8_t length = static_cast<uint8_t>(frame[1]) & 0x7F;
+  const size_t header_len = length == 127 ? 10 : (length == 126 ? 4 : 2);
+  return header_len <= frame.size() ? frame.substr(header_len) : std::string_view();
+}
+
+FrameTemplate::FrameTemplate() : literals_(1) {}
+
+FrameTemplate& FrameTemplate::Literal(std::string_view json) {
+  literals_.back().append(json);
+  literal_bytes_ += json.size();
+  return *this;
+}
+
+FrameTemplate& FrameTemplate::Slot() {
+  literals_.emplace_back();
+  return *this;
+}
+
+void FrameTemplate::Render(std::initializer_list<std::string_view> values, std::string* out) const {
+  // The payload is written after room for the largest header; once its size
+  // is known the header goes right in front of it and the gap is closed.
+  const size_t start = out->size();
+  size_t expected = kMaxWsHeaderBytes + literal_bytes_;
+  for (const std::string_view value : values) {
+    expected += value.size() + 2;  // exact unless the value needs escapes
+  }
+  out->reserve(start + expected);
+  out->resize(start + kMaxWsHeaderBytes);
+  const size_t payload_start = out->size();
+
+  auto value = values.begin();
+  for (size_t i = 0; i < literals_.size(); ++i) {
+    if (i > 0) {
+      AppendJsonString(value != values.end() ? *value++ : std::string_view(), out);
+    }
+    out->append(literals_[i]);
+  }
+
+  uint8_t header[kMaxWsHeaderBytes];
+  const size_t header_len = EncodeWebSocketHeader(header, WsOpcode::kText, out->size() - payload_start);
+  std::memcpy(out->data() + payload_start - header_len, header, header_len);
+  out->erase(start, kMaxWsHeaderBytes - header_len);
+}
+
+}  // namespace bridge
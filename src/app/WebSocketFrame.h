@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "WebSocketReader.h"
+
+namespace bridge {
+
+// Server frames are never masked, so the header is at most 2 + 8 bytes.
+constexpr size_t kMaxWsHeaderBytes = 10;
+
+// Writes a single-frame (FIN) server header and returns its length.
+size_t EncodeWebSocketHeader(uint8_t* out, WsOpcode opcode, size_t payload_size, bool compressed = false);
+
+// The payload of a complete unmasked server frame.
+std::string_view WebSocketFramePayload(std::string_view frame);
+
+// A text message serialized and framed once, at startup. Only its string
+// slots are filled in per message, so sending it costs a few appends and no
+// JSON building. Frames are never compressed, which RFC 7692 allows per
+// message even when permessage-deflate is in use.
+//
+//   FrameTemplate pong;
+//   pong.Literal("{\"type\":\"pong\",\"id\":").Slot().Literal("}");
+//   pong.Render({id}, &frame);
+class FrameTemplate {
+ public:
+  FrameTemplate();
+
+  // Raw JSON text, copied verbatim.
+  FrameTemplate& Literal(std::string_view json);
+  // A JSON string value supplied to Render(), quoted and escaped there.
+  FrameTemplate& Slot();
+
+  // Appends the complete frame, header included, to *out. `values` fill the
+  // slots in order.
+  void Render(std::initializer_list<std::string_view> values, std::string* out) const;
+
+  size_t slot_count() const {
+    return literals_.size() - 1;
+  }
+
+ private:
+  // One more literal than slots: literal, slot, literal, ..., literal.
+  std::vector<std::string> literals_;
+  size_t literal_bytes_ = 0;
+};
+
+}  // namespace bridge
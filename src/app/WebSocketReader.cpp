@@ -0,0 +1,200 @@
+#include "WebSocketReader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace bridge {
+
+namespace {
+
+bool IsControlOpcode(WsOpcode opcode) {
+  return (static_cast<uint8_t>(opcode) & 0x08) != 0;
+}
+
+bool IsKnownOpcode(WsOpcode opcode) {
+  switch (opcode) {
+    case WsOpcode::kContinuation:
+    case WsOpcode::kText:
+    case WsOpcode::kBinary:
+    case WsOpcode::kClose:
+    case WsOpcode::kPing:
+    case WsOpcode::kPong:
+      return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+WebSocketReader::WebSocketReader(Callbacks callbacks) : callbacks_(std::move(callbacks)) {}
+
+void WebSocketReader::Reset() {
+  state_ = State::kHeader;
+  header_size_ = 0;
+  frame_remaining_ = 0;
+  frame_offset_ = 0;
+  message_in_progress_ = false;
+  control_size_ = 0;
+}
+
+size_t WebSocketReader::CompleteHeaderLength() const {
+  if (header_size_ < 2) {
+    return 0;
+  }
+  size_t length = 2;
+  const uint8_t len7 = header_[1] & 0x7F;
+  if (len7 == 126) {
+    length += 2;
+  } else if (len7 == 127) {
+    length += 8;
+  }
+  if ((header_[1] & 0x80) != 0) {
+    length += 4;
+  }
+  return length;
+}
+
+bool WebSocketReader::BeginFrame(std::string* error) {
+  const uint8_t h1 = header_[0];
+  const uint8_t h2 = header_[1];
+
+  frame_fin_ = (h1 & 0x80) != 0;
+  frame_opcode_ = static_cast<WsOpcode>(h1 & 0x0F);
+  frame_masked_ = (h2 & 0x80) != 0;
+
+  size_t offset = 2;
+  uint64_t payload_len = h2 & 0x7F;
+  if (payload_len == 126) {
+    payload_len = (static_cast<uint64_t>(header_[2]) << 8) | header_[3];
+    offset += 2;
+  } else if (payload_len == 127) {
+    payload_len = 0;
+    for (size_t i = 0; i < 8; ++i) {
+      payload_len = (payload_len << 8) | header_[2 + i];
+    }
+    offset += 8;
+  }
+  if (frame_masked_) {
+    std::memcpy(mask_, header_ + offset, sizeof(mask_));
+  }
+
+  const bool rsv1 = (h1 & 0x40) != 0;
+  const bool rsv1_allowed = allow_compressed_ && (frame_opcode_ == WsOpcode::kText ||
+                                                  frame_opcode_ == WsOpcode::kBinary);
+  if ((h1 & 0x30) != 0 || (rsv1 && !rsv1_allowed)) {
+    if (error != nullptr) {
+      *error = "websocket frame uses reserved bits";
+    }
+    return false;
+  }
+  if (!IsKnownOpcode(frame_opcode_)) {
+    if (error != nullptr) {
+      *error = "unknown websocket opcode";
+    }
+    return false;
+  }
+  if ((payload_len >> 63) != 0) {
+    if (error != nullptr) {
+      *error = "invalid websocket payload length";
+    }
+    return false;
+  }
+
+  if (IsControlOpcode(frame_opcode_)) {
+    if (!frame_fin_ || payload_len > kMaxControlPayload) {
+      if (error != nullptr) {
+        *error = "fragmented or oversized websocket control frame";
+      }
+      return false;
+    }
+    control_size_ = 0;
+  } else if (frame_opcode_ == WsOpcode::kContinuation) {
+    if (!message_in_progress_) {
+      if (error != nullptr) {
+        *error = "websocket continuation frame without a message";
+      }
+      return false;
+    }
+  } else {
+    if (message_in_progress_) {
+      if (error != nullptr) {
+        *error = "websocket data frame interrupts a fragmented message";
+      }
+      return false;
+    }
+    message_in_progress_ = true;
+    if (callbacks_.on_message_begin != nullptr) {
+      callbacks_.on_message_begin(frame_opcode_, rsv1);
+    }
+  }
+
+  state_ = State::kPayload;
+  frame_remaining_ = payload_len;
+  frame_offset_ = 0;
+  if (payload_len == 0) {
+    ConsumePayload(nullptr, 0);
+  }
+  return true;
+}
+
+void WebSocketReader::ConsumePayload(uint8_t* data, size_t size) {
+  if (frame_masked_) {
+    for (size_t i = 0; i < size; ++i) {
+      data[i] ^= mask_[(frame_offset_ + i) & 3];
+    }
+  }
+  frame_offset_ += size;
+  frame_remaining_ -= size;
+  const bool frame_done = frame_remaining_ == 0;
+
+  if (IsControlOpcode(frame_opcode_)) {
+    if (size > 0) {
+      std::memcpy(control_payload_ + control_size_, data, size);
+      control_size_ += size;
+    }
+    if (frame_done && callbacks_.on_control != nullptr) {
+      callbacks_.on_control(frame_opcode_, control_payload_, control_size_);
+    }
+  } else {
+    const bool message_done = frame_done && frame_fin_;
+    if ((size > 0 || message_done) && callbacks_.on_message_data != nullptr) {
+      callbacks_.on_message_data(data, size, message_done);
+    }
+    if (message_done) {
+      message_in_progress_ = false;
+    }
+  }
+
+  if (frame_done) {
+    state_ = State::kHeader;
+    header_size_ = 0;
+  }
+}
+
+bool WebSocketReader::Feed(uint8_t* data, size_t size, std::string* error) {
+  while (size > 0) {
+    if (state_ == State::kHeader) {
+      const size_t complete = CompleteHeaderLength();
+      const size_t target = complete == 0 ? 2 : complete;
+      const size_t take = std::min(target - header_size_, size);
+      std::memcpy(header_ + header_size_, data, take);
+      header_size_ += take;
+      data += take;
+      size -= take;
+
+      if (header_size_ == CompleteHeaderLength() && !BeginFrame(error)) {
+        return false;
+      }
+      continue;
+    }
+
+    const size_t take = static_cast<size_t>(std::min<uint64_t>(frame_remaining_, size));
+    ConsumePayload(data, take);
+    data += take;
+    size -= take;
+  }
+  return true;
+}
+
+}  // namespace bridge
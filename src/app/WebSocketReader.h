@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace bridge {
+
+enum class WsOpcode : uint8_t {
+  kContinuation = 0x0,
+  kText = 0x1,
+  kBinary = 0x2,
+  kClose = 0x8,
+  kPing = 0x9,
+  kPong = 0xA,
+};
+
+// Incremental RFC 6455 frame parser for client-to-server traffic. Bytes are
+// fed as they arrive from the socket, payloads are unmasked in place and
+// handed out piecewise, and fragmented messages are reassembled as a stream
+// of pieces. Memory use therefore does not depend on message size.
+class WebSocketReader {
+ public:
+  struct Callbacks {
+    // A text or binary message starts; `compressed` is its RSV1 bit.
+    std::function<void(WsOpcode opcode, bool compressed)> on_message_begin;
+    // The next piece of the current message; `final` is set on the last one.
+    std::function<void(const uint8_t* data, size_t size, bool final)> on_message_data;
+    // A complete ping, pong or close frame (payload is at most 125 bytes).
+    std::function<void(WsOpcode opcode, const uint8_t* data, size_t size)> on_control;
+  };
+
+  explicit WebSocketReader(Callbacks callbacks);
+
+  // Consumes `size` bytes, unmasking them in place. Returns false on a
+  // protocol violation; the connection must then be closed.
+  bool Feed(uint8_t* data, size_t size, std::string* error);
+
+  void Reset();
+
+  // Accepts RSV1 on the first frame of a message once permessage-deflate
+  // has been negotiated.
+  void set_allow_compressed(bool allow) {
+    allow_compressed_ = allow;
+  }
+
+ private:
+  enum class State { kHeader, kPayload };
+
+  static constexpr size_t kMaxHeaderBytes = 14;
+  static constexpr size_t kMaxControlPayload = 125;
+
+  // Returns the header length once enough bytes are buffered, or 0.
+  size_t CompleteHeaderLength() const;
+  bool BeginFrame(std::string* error);
+  void ConsumePayload(uint8_t* data, size_t size);
+
+  Callbacks callbacks_;
+  State state_ = State::kHeader;
+
+  uint8_t header_[kMaxHeaderBytes] = {};
+  size_t header_size_ = 0;
+
+  WsOpcode frame_opcode_ = WsOpcode::kText;
+  bool frame_fin_ = true;
+  bool frame_masked_ = false;
+  uint8_t mask_[4] = {};
+  uint64_t frame_remaining_ = 0;
+  uint64_t frame_offset_ = 0;
+
+  bool message_in_progress_ = false;
+  bool allow_compressed_ = false;
+
+  uint8_t control_payload_[kMaxControlPayload] = {};
+  size_t control_size_ = 0;
+};
+
+}  // namespace bridge
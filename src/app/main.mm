@@ -1,26 +1,42 @@
+#include "AlignmentBlock.h"
+#include "AudioPacer.h"
+#include "HelperEventQueue.h"
+#include "HelperFrame.h"
+#include "Json.h"
+#include "Metrics.h"
+#include "PcmBlock.h"
+#include "PerMessageDeflate.h"
+#include "ProcessSpawn.h"
+#include "SharedMemoryMessageRing.h"
 #include "SharedMemoryAudioRing.h"
+#include "WebSocketFrame.h"
+#include "WebSocketReader.h"
 
 #import <CommonCrypto/CommonDigest.h>
 #import <Foundation/Foundation.h>
 
 #include <arpa/inet.h>
 #include <fcntl.h>
-#include <libkern/OSByteOrder.h>
 #include <limits.h>
 #include <mach-o/dyld.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <poll.h>
 #include <signal.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 #include <algorithm>
 #include <atomic>
+#include <charconv>
 #include <chrono>
 #include <cmath>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
@@ -28,10 +44,13 @@
 #include <deque>
 #include <functional>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
 #include <utility>
@@ -46,6 +65,22 @@ constexpr uint32_t kRingCapacityFrames = 48000;
 constexpr const char* kMicFeedName = "/virtual_audio_bridge_mic_feed";
 constexpr const char* kSpeakerTapName = "/virtual_audio_bridge_speaker_tap";
 constexpr const char* kProtocolVersion = "1";
+constexpr size_t kClientRecvBufferBytes = 64 * 1024;
+constexpr size_t kTtsStreamPieceBytes = 8 * 1024;
+constexpr size_t kPcmTapMaxBlockFrames = 2400;
+constexpr int kPcmTapPollIntervalMs = 10;
+constexpr size_t kMaxSessions = 16;
+constexpr int kMaxHelperShards = 8;
+constexpr size_t kMaxPendingHttpConnections = 4;
+constexpr size_t kHelperEventQueueSlots = 1024;
+constexpr size_t kHelperEventSlotBytes = 1024;
+// AudioPacer source and stream of client PCM; helper ids start at 1.
+// HelperScopedId() never returns the stream: its ids that start with '#'
+// go on with a tag and a colon.
+constexpr uint64_t kClientAudioSource = 0;
+constexpr std::string_view kClientAudioStream = "#pcm";
+constexpr auto kAudioPacerTick = std::chrono::milliseconds(2);
+constexpr int kAudioPacerQueueSeconds = 300;
 
 std::atomic<bool> g_should_exit{false};
 bool g_verbose = false;
@@ -106,33 +141,6 @@ bool FileIsExecutable(const std::string& path) {
   return access(path.c_str(), X_OK) == 0;
 }
 
-NSDictionary* ParseJsonObject(const std::string& text, std::string* error) {
-  NSData* data = [NSData dataWithBytes:text.data() length:text.size()];
-  NSError* ns_error = nil;
-  id obj = [NSJSONSerialization JSONObjectWithData:data options:0 error:&ns_error];
-  if (ns_error != nil || ![obj isKindOfClass:[NSDictionary class]]) {
-    if (error != nullptr) {
-      *error = ns_error == nil ? "JSON payload is not an object" : NSStringToStdString(ns_error.localizedDescription);
-    }
-    return nil;
-  }
-  return (NSDictionary*)obj;
-}
-
-std::string SerializeJsonObject(NSDictionary* obj, std::string* error) {
-  @autoreleasepool {
-    NSError* ns_error = nil;
-    NSData* data = [NSJSONSerialization dataWithJSONObject:obj options:0 error:&ns_error];
-    if (ns_error != nil || data == nil) {
-      if (error != nullptr) {
-        *error = ns_error == nil ? "failed to serialize JSON" : NSStringToStdString(ns_error.localizedDescription);
-      }
-      return "";
-    }
-    return std::string(reinterpret_cast<const char*>(data.bytes), data.length);
-  }
-}
-
 std::string BuildWebSocketAccept(const std::string& sec_websocket_key) {
   const std::string magic = sec_websocket_key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
   unsigned char hash[CC_SHA1_DIGEST_LENGTH];
@@ -144,51 +152,6 @@ std::string BuildWebSocketAccept(const std::string& sec_websocket_key) {
   }
 }
 
-bool ReadExactBuffered(int fd,
-                      std::string* pending_bytes,
-                      void* buffer,
-                      size_t bytes,
-                      int timeout_ms) {
-  uint8_t* out = reinterpret_cast<uint8_t*>(buffer);
-  size_t offset = 0;
-
-  if (pending_bytes != nullptr && !pending_bytes->empty()) {
-    const size_t take = std::min(bytes, pending_bytes->size());
-    std::memcpy(out, pending_bytes->data(), take);
-    pending_bytes->erase(0, take);
-    offset += take;
-  }
-
-  while (offset < bytes) {
-    struct pollfd pfd {};
-    pfd.fd = fd;
-    pfd.events = POLLIN;
-    const int poll_result = poll(&pfd, 1, timeout_ms);
-    if (poll_result <= 0) {
-      return false;
-    }
-    if ((pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0) {
-      return false;
-    }
-
-    uint8_t chunk[4096];
-    const ssize_t rc = recv(fd, chunk, sizeof(chunk), 0);
-    if (rc <= 0) {
-      return false;
-    }
-    const size_t got = static_cast<size_t>(rc);
-    const size_t needed = bytes - offset;
-    const size_t take = std::min(got, needed);
-    std::memcpy(out + offset, chunk, take);
-    offset += take;
-
-    if (got > take && pending_bytes != nullptr) {
-      pending_bytes->append(reinterpret_cast<const char*>(chunk + take), got - take);
-    }
-  }
-  return true;
-}
-
 bool SendAll(int fd, const void* data, size_t size) {
   const uint8_t* ptr = reinterpret_cast<const uint8_t*>(data);
   size_t sent = 0;
@@ -205,6 +168,32 @@ bool SendAll(int fd, const void* data, size_t size) {
   return true;
 }
 
+// Writes every iovec completely, advancing through partial writes. The
+// iovec array is modified in place.
+bool WritevAll(int fd, struct iovec* iov, int iov_count) {
+  while (iov_count > 0) {
+    const ssize_t rc = writev(fd, iov, iov_count);
+    if (rc <= 0) {
+      if (rc < 0 && errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+
+    size_t written = static_cast<size_t>(rc);
+    while (iov_count > 0 && written >= iov->iov_len) {
+      written -= iov->iov_len;
+      ++iov;
+      --iov_count;
+    }
+    if (iov_count > 0) {
+      iov->iov_base = static_cast<uint8_t*>(iov->iov_base) + written;
+      iov->iov_len -= written;
+    }
+  }
+  return true;
+}
+
 void CloseFd(int* fd) {
   if (*fd >= 0) {
     close(*fd);
@@ -222,6 +211,8 @@ struct AudioConfig {
   int sample_rate_hz = 48000;
   int channels = 2;
   int ring_capacity_frames = 48000;
+  // How much audio the bridge keeps queued in a ring ahead of its reader.
+  int tts_target_fill_ms = 40;
 };
 
 struct ElevenLabsTtsConfig {
@@ -250,11 +241,21 @@ struct AppleConfig {
 struct BridgeConfig {
   std::string host = "127.0.0.1";
   int port = 0;
+  std::string unix_path;
+  int send_queue_max_bytes = 4 * 1024 * 1024;
+  int send_stall_timeout_ms = 10000;
+  int resume_grace_ms = 15000;
+  int tts_chunk_batch_ms = 0;
+  int max_message_bytes = 1024 * 1024;
+  bridge::DeflateOptions permessage_deflate;
   SessionDefaults session_defaults;
   AudioConfig audio;
   ElevenLabsConfig elevenlabs;
   AppleConfig apple;
   std::string helper_path;
+  bridge::HelperIpcMode helper_ipc = bridge::HelperIpcMode::kSharedMemory;
+  int helper_standby = 1;
+  int helper_shards = 1;
 };
 
 std::optional<NSDictionary*> DictForKey(NSDictionary* dict, NSString* key) {
@@ -327,6 +328,42 @@ bool LoadConfig(const std::string& path, BridgeConfig* out_config, std::string*
       if (auto port = IntForKey(websocket_dict, @"port")) {
         cfg.port = *port;
       }
+      if (auto value = StringForKey(websocket_dict, @"unix_path")) {
+        cfg.unix_path = *value;
+      }
+      if (auto value = IntForKey(websocket_dict, @"send_queue_max_bytes")) {
+        cfg.send_queue_max_bytes = *value;
+      }
+      if (auto value = IntForKey(websocket_dict, @"send_stall_timeout_ms")) {
+        cfg.send_stall_timeout_ms = *value;
+      }
+      if (auto value = IntForKey(websocket_dict, @"resume_grace_ms")) {
+        cfg.resume_grace_ms = *value;
+      }
+      if (auto value = IntForKey(websocket_dict, @"tts_chunk_batch_ms")) {
+        cfg.tts_chunk_batch_ms = *value;
+      }
+      if (auto value = IntForKey(websocket_dict, @"max_message_bytes")) {
+        cfg.max_message_bytes = *value;
+      }
+      if (auto deflate_opt = DictForKey(websocket_dict, @"permessage_deflate")) {
+        NSDictionary* deflate = *deflate_opt;
+        if (auto v = BoolForKey(deflate, @"enabled")) {
+          cfg.permessage_deflate.enabled = *v;
+        }
+        if (auto v = IntForKey(deflate, @"server_max_window_bits")) {
+          cfg.permessage_deflate.server_max_window_bits = *v;
+        }
+        if (auto v = IntForKey(deflate, @"client_max_window_bits")) {
+          cfg.permessage_deflate.client_max_window_bits = *v;
+        }
+        if (auto v = BoolForKey(deflate, @"context_takeover")) {
+          cfg.permessage_deflate.context_takeover = *v;
+        }
+        if (auto v = IntForKey(deflate, @"min_compress_bytes")) {
+          cfg.permessage_deflate.min_compress_bytes = static_cast<size_t>(std::max(0, *v));
+        }
+      }
     }
 
     if (cfg.port <= 0 || cfg.port > 65535) {
@@ -336,6 +373,58 @@ bool LoadConfig(const std::string& path, BridgeConfig* out_config, std::string*
       return false;
     }
 
+    if (cfg.unix_path.size() >= sizeof(sockaddr_un::sun_path)) {
+      if (error != nullptr) {
+        *error = "websocket.unix_path is too long for a unix socket address";
+      }
+      return false;
+    }
+
+    if (cfg.send_queue_max_bytes < 64 * 1024) {
+      if (error != nullptr) {
+        *error = "websocket.send_queue_max_bytes must be at least 65536";
+      }
+      return false;
+    }
+
+    if (cfg.max_message_bytes < 4096) {
+      if (error != nullptr) {
+        *error = "websocket.max_message_bytes must be at least 4096";
+      }
+      return false;
+    }
+
+    if (cfg.permessage_deflate.server_max_window_bits < 9 ||
+        cfg.permessage_deflate.server_max_window_bits > 15 ||
+        cfg.permessage_deflate.client_max_window_bits < 8 ||
+        cfg.permessage_deflate.client_max_window_bits > 15) {
+      if (error != nullptr) {
+        *error = "websocket.permessage_deflate window bits must be 9-15 (server) and 8-15 (client)";
+      }
+      return false;
+    }
+
+    if (cfg.send_stall_timeout_ms <= 0) {
+      if (error != nullptr) {
+        *error = "websocket.send_stall_timeout_ms must be positive";
+      }
+      return false;
+    }
+
+    if (cfg.resume_grace_ms < 0) {
+      if (error != nullptr) {
+        *error = "websocket.resume_grace_ms must not be negative";
+      }
+      return false;
+    }
+
+    if (cfg.tts_chunk_batch_ms < 0) {
+      if (error != nullptr) {
+        *error = "websocket.tts_chunk_batch_ms must not be negative";
+      }
+      return false;
+    }
+
     if (auto defaults_dict_opt = DictForKey(root, @"session_defaults")) {
       NSDictionary* defaults_dict = *defaults_dict_opt;
       if (auto value = StringForKey(defaults_dict, @"mode")) {
@@ -360,6 +449,16 @@ bool LoadConfig(const std::string& path, BridgeConfig* out_config, std::string*
       if (auto value = IntForKey(audio_dict, @"ring_capacity_frames")) {
         cfg.audio.ring_capacity_frames = *value;
       }
+      if (auto value = IntForKey(audio_dict, @"tts_target_fill_ms")) {
+        cfg.audio.tts_target_fill_ms = *value;
+      }
+    }
+
+    if (cfg.audio.tts_target_fill_ms <= 0 || cfg.audio.tts_target_fill_ms > 1000) {
+      if (error != nullptr) {
+        *error = "audio.tts_target_fill_ms must be between 1 and 1000";
+      }
+      return false;
     }
 
     if (auto eleven_dict_opt = DictForKey(root, @"elevenlabs")) {
@@ -406,6 +505,35 @@ bool LoadConfig(const std::string& path, BridgeConfig* out_config, std::string*
       cfg.helper_path = *helper_path;
     }
 
+    if (auto helper_ipc = StringForKey(root, @"helper_ipc")) {
+      if (!bridge::ParseHelperIpcMode(*helper_ipc, &cfg.helper_ipc)) {
+        if (error != nullptr) {
+          *error = "helper_ipc must be shared_memory, framed or json_lines";
+        }
+        return false;
+      }
+    }
+
+    if (auto value = IntForKey(root, @"helper_standby")) {
+      cfg.helper_standby = *value;
+    }
+    if (cfg.helper_standby < 0 || cfg.helper_standby > 4) {
+      if (error != nullptr) {
+        *error = "helper_standby must be between 0 and 4";
+      }
+      return false;
+    }
+
+    if (auto value = IntForKey(root, @"helper_shards")) {
+      cfg.helper_shards = *value;
+    }
+    if (cfg.helper_shards < 1 || cfg.helper_shards > kMaxHelperShards) {
+      if (error != nullptr) {
+        *error = "helper_shards must be between 1 and " + std::to_string(kMaxHelperShards);
+      }
+      return false;
+    }
+
     if (cfg.helper_path.empty()) {
       cfg.helper_path = ExecutableDir() + "/engine_helper";
     }
@@ -455,69 +583,107 @@ bool LoadConfig(const std::string& path, BridgeConfig* out_config, std::string*
   }
 }
 
+// Runs the engine helper with its stdin and stdout as the message channel
+// and its stderr as a log, which a thread of its own passes on to the
+// bridge's stderr. In framed mode each message is a HelperFrame; in
+// json_lines mode (for debugging by hand) it is one JSON object per line. In
+// shared_memory mode messages go through a command ring and an event ring,
+// and the pipes carry only doorbells; there is no reader thread, and the
+// owner polls event_fd() and calls DrainEvents() instead. Outside json_lines
+// mode a third pipe, the helper's kHelperControlFd, carries control commands
+// past the queue.
 class HelperProcess {
  public:
-  using LineCallback = std::function<void(const std::string&)>;
+  // The views are valid only during the call.
+  using MessageCallback = std::function<void(std::string_view payload, std::string_view attachment)>;
 
-  HelperProcess() = default;
+  // `id` tells helpers started by the same bridge apart.
+  explicit HelperProcess(uint64_t id) : id_(id) {}
   ~HelperProcess() {
     Stop();
   }
 
-  bool Start(const std::string& path, LineCallback callback, std::string* error) {
-    VLOG("HelperProcess::Start path=" << path);
+  // `callback` runs on the reader thread in the pipe modes.
+  bool Start(const std::string& path, bridge::HelperIpcMode mode, MessageCallback callback, std::string* error) {
+    VLOG("HelperProcess::Start path=" << path << " ipc=" << bridge::HelperIpcModeName(mode));
     Stop();
 
+    std::vector<std::string> args = {path, std::string("--ipc=") + bridge::HelperIpcModeName(mode)};
+    if (mode == bridge::HelperIpcMode::kSharedMemory) {
+      const std::string base =
+          "/virtual_audio_bridge_helper_" + std::to_string(getpid()) + "_" + std::to_string(id_);
+      if (!command_ring_.Open(base + "_commands", true, kHelperRingBytes) ||
+          !event_ring_.Open(base + "_events", true, kHelperRingBytes)) {
+        if (error != nullptr) {
+          *error = "failed to create helper message rings";
+        }
+        command_ring_.Close();
+        event_ring_.Close();
+        return false;
+      }
+      args.push_back("--command-ring=" + base + "_commands");
+      args.push_back("--event-ring=" + base + "_events");
+    }
+    const bool control_lane = mode != bridge::HelperIpcMode::kJsonLines;
+    if (control_lane) {
+      args.push_back("--control-fd=" + std::to_string(bridge::kHelperControlFd));
+    }
     int stdin_pipe[2] = {-1, -1};
     int stdout_pipe[2] = {-1, -1};
-    if (pipe(stdin_pipe) != 0 || pipe(stdout_pipe) != 0) {
+    int log_pipe[2] = {-1, -1};
+    int control_pipe[2] = {-1, -1};
+    const auto close_pipes = [&]() {
+      for (int* fd : {&stdin_pipe[0], &stdin_pipe[1], &stdout_pipe[0], &stdout_pipe[1], &log_pipe[0], &log_pipe[1],
+                      &control_pipe[0], &control_pipe[1]}) {
+        CloseFd(fd);
+      }
+      command_ring_.Close();
+      event_ring_.Close();
+    };
+    if (!bridge::MakePipe(stdin_pipe) || !bridge::MakePipe(stdout_pipe) || !bridge::MakePipe(log_pipe) ||
+        (control_lane && !bridge::MakePipe(control_pipe))) {
       if (error != nullptr) {
         *error = "failed to create helper pipes";
       }
-      CloseFd(&stdin_pipe[0]);
-      CloseFd(&stdin_pipe[1]);
-      CloseFd(&stdout_pipe[0]);
-      CloseFd(&stdout_pipe[1]);
+      close_pipes();
       return false;
     }
 
-    pid_t child = fork();
-    if (child < 0) {
-      if (error != nullptr) {
-        *error = "failed to fork helper process";
-      }
-      CloseFd(&stdin_pipe[0]);
-      CloseFd(&stdin_pipe[1]);
-      CloseFd(&stdout_pipe[0]);
-      CloseFd(&stdout_pipe[1]);
-      return false;
+    std::vector<bridge::ChildFd> child_fds = {
+        {stdin_pipe[0], STDIN_FILENO}, {stdout_pipe[1], STDOUT_FILENO}, {log_pipe[1], STDERR_FILENO}};
+    if (control_lane) {
+      child_fds.push_back({control_pipe[0], bridge::kHelperControlFd});
     }
-
-    if (child == 0) {
-      dup2(stdin_pipe[0], STDIN_FILENO);
-      dup2(stdout_pipe[1], STDOUT_FILENO);
-      dup2(stdout_pipe[1], STDERR_FILENO);
-
-      CloseFd(&stdin_pipe[0]);
-      CloseFd(&stdin_pipe[1]);
-      CloseFd(&stdout_pipe[0]);
-      CloseFd(&stdout_pipe[1]);
-
-      execl(path.c_str(), path.c_str(), nullptr);
-      _exit(127);
+    pid_t child = -1;
+    if (!bridge::SpawnProcess(path, args, child_fds, &child, error)) {
+      close_pipes();
+      return false;
     }
 
     CloseFd(&stdin_pipe[0]);
     CloseFd(&stdout_pipe[1]);
+    CloseFd(&log_pipe[1]);
+    CloseFd(&control_pipe[0]);
 
     path_ = path;
+    mode_ = mode;
     callback_ = std::move(callback);
     child_pid_ = child;
     stdin_fd_ = stdin_pipe[1];
     stdout_fd_ = stdout_pipe[0];
+    log_fd_ = log_pipe[0];
+    control_fd_ = control_pipe[1];
+    data_messages_sent_ = 0;
     running_.store(true, std::memory_order_relaxed);
 
-    reader_thread_ = std::thread([this]() { ReaderLoop(); });
+    if (mode == bridge::HelperIpcMode::kSharedMemory) {
+      const int flags = fcntl(stdout_fd_, F_GETFL, 0);
+      (void)fcntl(stdout_fd_, F_SETFL, flags | O_NONBLOCK);
+      doorbell_reader_.Reset();
+    } else {
+      reader_thread_ = std::thread([this]() { ReaderLoop(); });
+    }
+    log_thread_ = std::thread([this]() { LogLoop(); });
     waiter_thread_ = std::thread([this]() { WaiterLoop(); });
 
     VLOG("Helper process started, pid=" << child_pid_);
@@ -529,11 +695,12 @@ class HelperProcess {
 
     if (was_running && stdin_fd_ >= 0) {
       std::string ignored;
-      (void)SendLine("{\"type\":\"shutdown\"}", &ignored);
+      (void)SendControl("{\"type\":\"shutdown\"}", &ignored);
     }
 
     CloseFd(&stdin_fd_);
     CloseFd(&stdout_fd_);
+    CloseFd(&control_fd_);
 
     if (child_pid_ > 0 && was_running) {
       kill(child_pid_, SIGTERM);
@@ -547,13 +714,25 @@ class HelperProcess {
     if (waiter_thread_.joinable()) {
       waiter_thread_.join();
     }
+    // The log pipe ends with the helper.
+    if (log_thread_.joinable()) {
+      log_thread_.join();
+    }
+    CloseFd(&log_fd_);
 
     child_pid_ = -1;
     callback_ = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(write_mutex_);
+      queued_commands_.clear();
+      queued_command_bytes_ = 0;
+    }
+    command_ring_.Close();
+    event_ring_.Close();
   }
 
-  bool SendLine(const std::string& line, std::string* error) {
-    VLOG("Helper << " << line);
+  bool SendMessage(std::string_view message, std::string* error) {
+    VLOG("Helper << " << message);
     std::lock_guard<std::mutex> lock(write_mutex_);
     if (!running_.load(std::memory_order_relaxed) || stdin_fd_ < 0) {
       if (error != nullptr) {
@@ -561,9 +740,30 @@ class HelperProcess {
       }
       return false;
     }
+    if (mode_ == bridge::HelperIpcMode::kSharedMemory) {
+      if (!SendToRing(message, error)) {
+        return false;
+      }
+      data_messages_sent_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
 
-    const std::string payload = line + "\n";
-    if (!SendAll(stdin_fd_, payload.data(), payload.size())) {
+    uint8_t header[bridge::kHelperFrameHeaderBytes];
+    char newline = '\n';
+    struct iovec iov[2];
+    iov[1].iov_base = const_cast<char*>(message.data());
+    iov[1].iov_len = message.size();
+    if (mode_ == bridge::HelperIpcMode::kFramed) {
+      bridge::EncodeHelperFrameHeader(bridge::HelperFrameKind::kJson, static_cast<uint32_t>(message.size()), 0,
+                                      header);
+      iov[0].iov_base = header;
+      iov[0].iov_len = sizeof(header);
+    } else {
+      std::swap(iov[0], iov[1]);
+      iov[1].iov_base = &newline;
+      iov[1].iov_len = 1;
+    }
+    if (!WritevAll(stdin_fd_, iov, 2)) {
       if (error != nullptr) {
         *error = "failed to write to helper stdin";
       }
@@ -571,9 +771,48 @@ class HelperProcess {
       return false;
     }
 
+    data_messages_sent_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Sends a control command straight to the helper's control thread, ahead
+  // of whatever SendMessage() has queued. In json_lines mode it goes in line.
+  bool SendControl(std::string_view message, std::string* error) {
+    if (mode_ == bridge::HelperIpcMode::kJsonLines) {
+      return SendMessage(message, error);
+    }
+    VLOG("Helper <<! " << message);
+    std::lock_guard<std::mutex> lock(control_mutex_);
+    if (control_fd_ < 0) {
+      if (error != nullptr) {
+        *error = "helper is not running";
+      }
+      return false;
+    }
+    uint8_t header[bridge::kHelperFrameHeaderBytes];
+    bridge::EncodeHelperFrameHeader(bridge::HelperFrameKind::kJson, static_cast<uint32_t>(message.size()), 0,
+                                    header);
+    struct iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = const_cast<char*>(message.data());
+    iov[1].iov_len = message.size();
+    if (!WritevAll(control_fd_, iov, 2)) {
+      if (error != nullptr) {
+        *error = "failed to write to helper control pipe";
+      }
+      running_.store(false, std::memory_order_relaxed);
+      return false;
+    }
     return true;
   }
 
+  // How many commands SendMessage() has handed over since Start(); control
+  // commands carry it as "after".
+  uint64_t data_messages_sent() const {
+    return data_messages_sent_.load(std::memory_order_relaxed);
+  }
+
   bool IsRunning() const {
     return running_.load(std::memory_order_relaxed);
   }
@@ -582,36 +821,207 @@ class HelperProcess {
     return exit_code_.load(std::memory_order_relaxed);
   }
 
+  uint64_t id() const {
+    return id_;
+  }
+
+  // Shared-memory mode: the descriptor that becomes readable when the helper
+  // rings the doorbell or exits; -1 in the pipe modes.
+  int event_fd() const {
+    return mode_ == bridge::HelperIpcMode::kSharedMemory ? stdout_fd_ : -1;
+  }
+
+  // Shared-memory mode: call before sleeping on event_fd(). Returns false if
+  // events are already waiting, in which case the caller should not sleep.
+  bool PrepareToWait() {
+    return event_ring_.PrepareToWait();
+  }
+
+  // Shared-memory mode: hands the helper whatever SendMessage() queued while
+  // the command ring was full. Returns true if some of it still does not fit.
+  bool RetryQueuedCommands() {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    if (queued_commands_.empty() || !running_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    std::string error;
+    if (!WriteQueuedCommands(&error)) {
+      std::cerr << "Helper command queue: " << error << "\n";
+    }
+    return !queued_commands_.empty();
+  }
+
+  // Shared-memory mode: consumes doorbells and delivers every waiting event
+  // on the calling thread.
+  void DrainEvents(const MessageCallback& callback) {
+    if (mode_ != bridge::HelperIpcMode::kSharedMemory || stdout_fd_ < 0) {
+      return;
+    }
+    event_ring_.FinishWait();
+
+    const auto deliver = [&](const bridge::HelperFrameReader::Message& message) {
+      if (message.kind == bridge::HelperFrameKind::kJson) {
+        VLOG("Helper >> " << message.payload);
+        callback(message.payload, message.attachment);
+      }
+    };
+    while (true) {
+      size_t capacity = 0;
+      char* data = doorbell_reader_.WritableData(&capacity);
+      const ssize_t rc = read(stdout_fd_, data, capacity);
+      if (rc > 0) {
+        std::string error;
+        if (!doorbell_reader_.Commit(static_cast<size_t>(rc), deliver, &error)) {
+          std::cerr << "Helper output is malformed: " << error << "\n";
+          running_.store(false, std::memory_order_relaxed);
+          break;
+        }
+        continue;
+      }
+      if (rc == 0) {
+        running_.store(false, std::memory_order_relaxed);
+      } else if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+
+    std::string_view message;
+    while (event_ring_.Peek(&message)) {
+      std::string_view payload;
+      std::string_view attachment;
+      bridge::SplitHelperRingMessage(message, &payload, &attachment);
+      VLOG("Helper >> " << payload);
+      callback(payload, attachment);
+      event_ring_.Consume();
+    }
+  }
+
  private:
-  void ReaderLoop() {
-    FILE* stream = fdopen(stdout_fd_, "r");
-    if (stream == nullptr) {
+  // Each ring holds at least two of the largest messages either side sends.
+  static constexpr uint32_t kHelperRingBytes = 1024 * 1024;
+  static constexpr size_t kMaxHelperLogLineBytes = 16 * 1024;
+  // How much SendMessage() holds back while the command ring is full before
+  // it refuses commands; the main loop retries the queue on every pass.
+  static constexpr size_t kMaxQueuedCommandBytes = kHelperRingBytes;
+
+  // Commands queue behind earlier ones that did not fit, so the helper sees
+  // them in the order they were sent.
+  bool SendToRing(std::string_view message, std::string* error) {
+    if (message.size() > command_ring_.max_message_bytes()) {
+      if (error != nullptr) {
+        *error = "helper command is too large";
+      }
+      return false;
+    }
+    if (queued_commands_.empty() && command_ring_.Write(message)) {
+      return RingDoorbell(error);
+    }
+    if (queued_command_bytes_ + message.size() > kMaxQueuedCommandBytes) {
+      if (error != nullptr) {
+        *error = "helper command ring is full";
+      }
+      return false;
+    }
+    queued_commands_.emplace_back(message);
+    queued_command_bytes_ += message.size();
+    return true;
+  }
+
+  // Moves queued commands into the ring while they fit. Expects write_mutex_.
+  bool WriteQueuedCommands(std::string* error) {
+    bool wrote = false;
+    while (!queued_commands_.empty() && command_ring_.Write(queued_commands_.front())) {
+      queued_command_bytes_ -= queued_commands_.front().size();
+      queued_commands_.pop_front();
+      wrote = true;
+    }
+    return !wrote || RingDoorbell(error);
+  }
+
+  bool RingDoorbell(std::string* error) {
+    if (!command_ring_.TakeWakeup()) {
+      return true;
+    }
+
+    uint8_t doorbell[bridge::kHelperFrameHeaderBytes];
+    bridge::EncodeHelperFrameHeader(bridge::HelperFrameKind::kDoorbell, 0, 0, doorbell);
+    if (!SendAll(stdin_fd_, doorbell, sizeof(doorbell))) {
+      if (error != nullptr) {
+        *error = "failed to write to helper stdin";
+      }
       running_.store(false, std::memory_order_relaxed);
-      return;
+      return false;
     }
+    return true;
+  }
+
+  void ReaderLoop() {
+    bridge::HelperFrameReader reader(mode_);
+    const auto deliver = [this](const bridge::HelperFrameReader::Message& message) {
+      VLOG("Helper >> " << message.payload);
+      if (callback_ != nullptr) {
+        callback_(message.payload, message.attachment);
+      }
+    };
 
-    char* line = nullptr;
-    size_t capacity = 0;
     while (running_.load(std::memory_order_relaxed)) {
-      const ssize_t read = getline(&line, &capacity, stream);
-      if (read <= 0) {
+      size_t capacity = 0;
+      char* data = reader.WritableData(&capacity);
+      const ssize_t rc = read(stdout_fd_, data, capacity);
+      if (rc < 0 && errno == EINTR) {
+        continue;
+      }
+      if (rc <= 0) {
+        break;
+      }
+      std::string error;
+      if (!reader.Commit(static_cast<size_t>(rc), deliver, &error)) {
+        std::cerr << "Helper output is malformed: " << error << "\n";
+        break;
+      }
+    }
+
+    running_.store(false, std::memory_order_relaxed);
+  }
+
+  // Passes the helper's stderr on a line at a time, tagged with its id and
+  // level; debug lines appear only with --verbose.
+  void LogLoop() {
+    std::string pending;
+    char buffer[4096];
+    while (true) {
+      const ssize_t rc = read(log_fd_, buffer, sizeof(buffer));
+      if (rc < 0 && errno == EINTR) {
+        continue;
+      }
+      if (rc <= 0) {
         break;
       }
-      std::string payload(line, static_cast<size_t>(read));
-      while (!payload.empty() && (payload.back() == '\n' || payload.back() == '\r')) {
-        payload.pop_back();
+      pending.append(buffer, static_cast<size_t>(rc));
+      size_t begin = 0;
+      for (size_t end = pending.find('\n'); end != std::string::npos; end = pending.find('\n', begin)) {
+        LogHelperLine(std::string_view(pending).substr(begin, end - begin));
+        begin = end + 1;
       }
-      if (!payload.empty() && callback_ != nullptr) {
-        VLOG("Helper >> " << payload);
-        callback_(payload);
+      pending.erase(0, begin);
+      if (pending.size() > kMaxHelperLogLineBytes) {
+        LogHelperLine(pending);
+        pending.clear();
       }
     }
+    if (!pending.empty()) {
+      LogHelperLine(pending);
+    }
+  }
 
-    if (line != nullptr) {
-      free(line);
+  void LogHelperLine(std::string_view line) {
+    std::string_view message;
+    const bridge::HelperLogLevel level = bridge::ParseHelperLogLine(line, &message);
+    if (level == bridge::HelperLogLevel::kDebug && !g_verbose) {
+      return;
     }
-    fclose(stream);
-    running_.store(false, std::memory_order_relaxed);
+    std::cerr << "engine_helper[" << id_ << "] " << bridge::HelperLogLevelName(level) << ": " << message << "\n";
   }
 
   void WaiterLoop() {
@@ -631,39 +1041,176 @@ class HelperProcess {
     }
   }
 
+  const uint64_t id_;
   std::string path_;
-  LineCallback callback_;
+  bridge::HelperIpcMode mode_ = bridge::HelperIpcMode::kFramed;
+  MessageCallback callback_;
+  bridge::SharedMemoryMessageRing command_ring_;
+  bridge::SharedMemoryMessageRing event_ring_;
+  bridge::HelperFrameReader doorbell_reader_{bridge::HelperIpcMode::kSharedMemory};
   pid_t child_pid_ = -1;
   int stdin_fd_ = -1;
   int stdout_fd_ = -1;
+  int log_fd_ = -1;
+  int control_fd_ = -1;
   std::atomic<bool> running_{false};
   std::atomic<int> exit_code_{0};
+  std::atomic<uint64_t> data_messages_sent_{0};
   std::mutex write_mutex_;
+  std::deque<std::string> queued_commands_;
+  size_t queued_command_bytes_ = 0;
+  std::mutex control_mutex_;
   std::thread reader_thread_;
+  std::thread log_thread_;
   std::thread waiter_thread_;
 };
 
-enum class WsOpcode : uint8_t {
-  kContinuation = 0x0,
-  kText = 0x1,
-  kBinary = 0x2,
-  kClose = 0x8,
-  kPing = 0x9,
-  kPong = 0xA,
+// Stops helpers the service thread has finished with on a thread of its own,
+// so that a helper slow to exit (SIGTERM, waitpid and the thread joins in
+// HelperProcess::Stop) never holds up the loop. `on_stopped` runs there with
+// each helper's id once it is gone.
+class HelperReaper {
+ public:
+  explicit HelperReaper(std::function<void(uint64_t id)> on_stopped) : on_stopped_(std::move(on_stopped)) {}
+  ~HelperReaper() {
+    Stop();
+  }
+
+  void Retire(std::unique_ptr<HelperProcess> helper) {
+    if (helper == nullptr) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!thread_.joinable()) {
+      stopping_ = false;
+      thread_ = std::thread([this]() { Run(); });
+    }
+    retired_.push_back(std::move(helper));
+    wake_.notify_one();
+  }
+
+  // Waits for every retired helper to stop.
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+      wake_.notify_one();
+    }
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+ private:
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      wake_.wait(lock, [this]() { return stopping_ || !retired_.empty(); });
+      if (retired_.empty()) {
+        return;
+      }
+      std::unique_ptr<HelperProcess> helper = std::move(retired_.front());
+      retired_.pop_front();
+      lock.unlock();
+      const uint64_t id = helper->id();
+      helper.reset();
+      on_stopped_(id);
+      lock.lock();
+    }
+  }
+
+  const std::function<void(uint64_t id)> on_stopped_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::deque<std::unique_ptr<HelperProcess>> retired_;
+  bool stopping_ = false;
+  std::thread thread_;
 };
 
-struct WsFrame {
-  WsOpcode opcode = WsOpcode::kText;
-  bool fin = true;
-  std::string payload;
+using bridge::DeflateOptions;
+using bridge::DeflateParams;
+using bridge::EncodeAlignmentBlock;
+using bridge::EncodeWebSocketHeader;
+using bridge::ExtractJsonStringField;
+using bridge::FrameTemplate;
+using bridge::JsonReader;
+using bridge::JsonStringStreamDecoder;
+using bridge::JsonValue;
+using bridge::JsonWriter;
+using bridge::PcmBlockHeader;
+using bridge::PcmBlockReader;
+using bridge::PcmSampleFormat;
+using bridge::PcmStreamId;
+using bridge::PerMessageDeflate;
+using bridge::WebSocketReader;
+using bridge::WsOpcode;
+using bridge::kMaxWsHeaderBytes;
+
+// An HTTP request on one of the listeners: a WebSocket upgrade, or a plain
+// GET of /metrics or /healthz.
+struct HttpRequest {
+  std::string method;
+  std::string target;
+  std::unordered_map<std::string, std::string> headers;  // keys in lower case
+  std::string extra_bytes;  // anything the client sent after the headers
 };
 
-bool PerformWebSocketHandshake(int fd, std::string* out_extra_bytes, std::string* error) {
-  std::string request;
-  request.reserve(2048);
+constexpr size_t kMaxHttpRequestBytes = 16384;
 
-  auto start = std::chrono::steady_clock::now();
-  constexpr size_t kMaxRequestSize = 16384;
+// Parses `raw`, which must hold at least the complete request headers.
+bool ParseHttpRequest(const std::string& raw, HttpRequest* out, std::string* error) {
+  const size_t header_end = raw.find("\r\n\r\n");
+  std::istringstream lines(raw.substr(0, header_end));
+  std::string line;
+  if (header_end == std::string::npos || !std::getline(lines, line)) {
+    if (error != nullptr) {
+      *error = "malformed http request";
+    }
+    return false;
+  }
+  if (!line.empty() && line.back() == '\r') {
+    line.pop_back();
+  }
+  const size_t target_begin = line.find(' ');
+  const size_t target_end = target_begin == std::string::npos ? std::string::npos : line.find(' ', target_begin + 1);
+  out->method = line.substr(0, target_begin);
+  out->target = target_begin == std::string::npos
+                    ? std::string()
+                    : line.substr(target_begin + 1, target_end == std::string::npos
+                                                        ? std::string::npos
+                                                        : target_end - target_begin - 1);
+
+  out->headers.clear();
+  while (std::getline(lines, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (line.empty()) {
+      break;
+    }
+    const size_t colon = line.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+    std::string key = ToLower(Trim(line.substr(0, colon)));
+    std::string value = Trim(line.substr(colon + 1));
+    if (key == "sec-websocket-extensions" && !out->headers[key].empty()) {
+      out->headers[key] += ", " + value;
+    } else {
+      out->headers[key] = value;
+    }
+  }
+  out->extra_bytes = raw.substr(header_end + 4);
+  return true;
+}
+
+// Reads and parses one request from a blocking socket, giving up after five
+// seconds.
+bool ReadHttpRequest(int fd, HttpRequest* out, std::string* error) {
+  std::string request;
+  request.reserve(2048);
+
+  auto start = std::chrono::steady_clock::now();
 
   while (request.find("\r\n\r\n") == std::string::npos) {
     const auto now = std::chrono::steady_clock::now();
@@ -697,7 +1244,7 @@ bool PerformWebSocketHandshake(int fd, std::string* out_extra_bytes, std::string
       return false;
     }
     request.append(buf, static_cast<size_t>(rc));
-    if (request.size() > kMaxRequestSize) {
+    if (request.size() > kMaxHttpRequestBytes) {
       if (error != nullptr) {
         *error = "websocket handshake request too large";
       }
@@ -705,41 +1252,23 @@ bool PerformWebSocketHandshake(int fd, std::string* out_extra_bytes, std::string
     }
   }
 
-  std::istringstream lines(request);
-  std::string line;
-  if (!std::getline(lines, line)) {
-    if (error != nullptr) {
-      *error = "malformed websocket handshake request";
-    }
-    return false;
-  }
+  return ParseHttpRequest(request, out, error);
+}
 
-  if (line.find("GET") != 0) {
+bool PerformWebSocketHandshake(int fd,
+                               const HttpRequest& request,
+                               const DeflateOptions& deflate_options,
+                               DeflateParams* out_deflate,
+                               std::string* error) {
+  if (request.method != "GET") {
     if (error != nullptr) {
       *error = "websocket handshake must be GET";
     }
     return false;
   }
 
-  std::unordered_map<std::string, std::string> headers;
-  while (std::getline(lines, line)) {
-    if (!line.empty() && line.back() == '\r') {
-      line.pop_back();
-    }
-    if (line.empty()) {
-      break;
-    }
-    const size_t colon = line.find(':');
-    if (colon == std::string::npos) {
-      continue;
-    }
-    std::string key = ToLower(Trim(line.substr(0, colon)));
-    std::string value = Trim(line.substr(colon + 1));
-    headers[key] = value;
-  }
-
-  auto key_it = headers.find("sec-websocket-key");
-  if (key_it == headers.end()) {
+  auto key_it = request.headers.find("sec-websocket-key");
+  if (key_it == request.headers.end()) {
     if (error != nullptr) {
       *error = "missing Sec-WebSocket-Key";
     }
@@ -751,29 +1280,67 @@ bool PerformWebSocketHandshake(int fd, std::string* out_extra_bytes, std::string
   response << "HTTP/1.1 101 Switching Protocols\r\n"
            << "Upgrade: websocket\r\n"
            << "Connection: Upgrade\r\n"
-           << "Sec-WebSocket-Accept: " << accept_value << "\r\n\r\n";
+           << "Sec-WebSocket-Accept: " << accept_value << "\r\n";
+
+  std::string extension_response;
+  const auto extensions_it = request.headers.find("sec-websocket-extensions");
+  if (out_deflate != nullptr && extensions_it != request.headers.end() &&
+      bridge::NegotiatePerMessageDeflate(extensions_it->second, deflate_options, out_deflate,
+                                         &extension_response)) {
+    VLOG("WebSocket handshake: negotiated " << extension_response);
+    response << "Sec-WebSocket-Extensions: " << extension_response << "\r\n";
+  }
+  response << "\r\n";
 
   const std::string response_data = response.str();
   VLOG("WebSocket handshake: sending 101 Switching Protocols");
-  if (!SendAll(fd, response_data.data(), response_data.size())) {
-    return false;
-  }
+  return SendAll(fd, response_data.data(), response_data.size());
+}
 
-  if (out_extra_bytes != nullptr) {
-    const size_t header_end = request.find("\r\n\r\n");
-    if (header_end != std::string::npos) {
-      const size_t extra_offset = header_end + 4;
-      if (extra_offset < request.size()) {
-        *out_extra_bytes = request.substr(extra_offset);
-      } else {
-        out_extra_bytes->clear();
-      }
-    } else {
-      out_extra_bytes->clear();
+// Returns the value of `name` in the query of a request target such as
+// "/?resume_token=ab12", or an empty view. Values are not percent-decoded.
+std::string_view QueryParameter(std::string_view target, std::string_view name) {
+  const size_t query = target.find('?');
+  if (query == std::string_view::npos) {
+    return {};
+  }
+  std::string_view rest = target.substr(query + 1);
+  while (!rest.empty()) {
+    const size_t amp = rest.find('&');
+    const std::string_view pair = rest.substr(0, amp);
+    const size_t eq = pair.find('=');
+    if (pair.substr(0, eq) == name) {
+      return eq == std::string_view::npos ? std::string_view() : pair.substr(eq + 1);
     }
+    rest = amp == std::string_view::npos ? std::string_view() : rest.substr(amp + 1);
   }
+  return {};
+}
 
-  return true;
+// 128 random bits as hex; identifies a client's sessions across reconnects.
+std::string NewResumeToken() {
+  uint8_t bytes[16];
+  arc4random_buf(bytes, sizeof(bytes));
+  static const char kHex[] = "0123456789abcdef";
+  std::string token;
+  token.reserve(sizeof(bytes) * 2);
+  for (const uint8_t byte : bytes) {
+    token.push_back(kHex[byte >> 4]);
+    token.push_back(kHex[byte & 0x0f]);
+  }
+  return token;
+}
+
+// Answers a plain HTTP request and closes the connection.
+void SendHttpResponse(int fd, std::string_view status, std::string_view content_type, std::string_view body) {
+  std::string response;
+  response.reserve(body.size() + 128);
+  response.append("HTTP/1.1 ").append(status).append("\r\n");
+  response.append("Content-Type: ").append(content_type).append("\r\n");
+  response.append("Content-Length: ").append(std::to_string(body.size())).append("\r\n");
+  response.append("Connection: close\r\n\r\n").append(body);
+  (void)SendAll(fd, response.data(), response.size());
+  close(fd);
 }
 
 void RejectHttpConnection(int fd, int status_code, const std::string& message) {
@@ -787,125 +1354,680 @@ void RejectHttpConnection(int fd, int status_code, const std::string& message) {
   close(fd);
 }
 
-bool ReadWebSocketFrame(int fd,
-                        std::string* pending_bytes,
-                        WsFrame* out_frame,
-                        int timeout_ms,
-                        std::string* error) {
-  uint8_t h1 = 0;
-  uint8_t h2 = 0;
-  if (!ReadExactBuffered(fd, pending_bytes, &h1, 1, timeout_ms) ||
-      !ReadExactBuffered(fd, pending_bytes, &h2, 1, timeout_ms)) {
+// Frames per writev() call when relaying batches; each frame needs two iovecs.
+constexpr size_t kMaxFramesPerWritev = 64;
+
+bool SendWebSocketFrame(int fd, WsOpcode opcode, const std::string& payload, std::string* error) {
+  uint8_t header[kMaxWsHeaderBytes];
+  struct iovec iov[2];
+  iov[0].iov_base = header;
+  iov[0].iov_len = EncodeWebSocketHeader(header, opcode, payload.size());
+  iov[1].iov_base = const_cast<char*>(payload.data());
+  iov[1].iov_len = payload.size();
+
+  if (!WritevAll(fd, iov, payload.empty() ? 1 : 2)) {
     if (error != nullptr) {
-      *error = "failed to read websocket frame header";
+      *error = "failed to send websocket frame";
     }
     return false;
   }
 
-  const bool fin = (h1 & 0x80) != 0;
-  const WsOpcode opcode = static_cast<WsOpcode>(h1 & 0x0F);
-  const bool masked = (h2 & 0x80) != 0;
-  uint64_t payload_len = h2 & 0x7F;
+  return true;
+}
 
-  if (payload_len == 126) {
-    uint16_t ext = 0;
-    if (!ReadExactBuffered(fd, pending_bytes, &ext, sizeof(ext), timeout_ms)) {
-      if (error != nullptr) {
-        *error = "failed to read extended websocket payload length (16-bit)";
+// Length of the longest prefix of `text` that does not end inside a UTF-8
+// sequence, so the prefix can be handed on as a complete string.
+size_t Utf8SafePrefixLength(const std::string& text, size_t max_length) {
+  size_t cut = std::min(max_length, text.size());
+  if (cut == text.size()) {
+    return cut;
+  }
+  while (cut > 0 && (static_cast<uint8_t>(text[cut]) & 0xC0) == 0x80) {
+    --cut;
+  }
+  return cut;
+}
+
+// How an outbound message may be treated when its client falls behind.
+enum class OutboundClass : uint8_t {
+  kCritical,   // never dropped; overflowing the queue disconnects the client
+  kCoalesce,   // an unsent older message with the same key is replaced
+  kDroppable,  // dropped first when the queue is over budget
+};
+
+// An stt_partial that may go out as a delta: `prefix` is the event's JSON
+// without its text and closing brace.
+struct PartialText {
+  std::string prefix;
+  std::string text;
+};
+
+struct OutboundMessage {
+  WsOpcode opcode = WsOpcode::kText;
+  OutboundClass klass = OutboundClass::kCritical;
+  std::string coalesce_key;
+  std::string payload;
+  PartialText partial;  // empty unless the session asked for delta partials
+  uint8_t header[kMaxWsHeaderBytes] = {};
+  size_t header_len = 0;
+  size_t sent = 0;  // bytes of header + payload already written
+  // Set once the payload has been through the deflate context. From then on
+  // the message must be delivered as-is: dropping it would desynchronise
+  // the client's decompressor.
+  bool committed = false;
+
+  size_t size() const {
+    return header_len + payload.size();
+  }
+};
+
+struct ClientSendStats {
+  uint64_t frames_sent = 0;
+  uint64_t bytes_sent = 0;
+  uint64_t coalesced = 0;
+  uint64_t dropped = 0;
+  uint64_t compressed = 0;
+  size_t peak_queued_bytes = 0;
+};
+
+// Bounded outbound queue for one WebSocket connection. Messages are framed on
+// enqueue and written with writev() whenever the non-blocking socket is
+// writable, so a slow reader never blocks the service thread.
+class ClientSendQueue {
+ public:
+  enum class EnqueueResult { kQueued, kCoalesced, kDropped, kOverflow };
+
+  explicit ClientSendQueue(size_t max_bytes) : max_bytes_(max_bytes) {}
+
+  // Compresses text and binary messages of at least `min_bytes` right
+  // before they are first written. Pass nullptr to disable.
+  void SetCompressor(PerMessageDeflate* deflate, size_t min_bytes) {
+    deflate_ = deflate;
+    min_compress_bytes_ = min_bytes;
+  }
+
+  EnqueueResult Enqueue(WsOpcode opcode,
+                        std::string payload,
+                        OutboundClass klass,
+                        std::string coalesce_key,
+                        PartialText partial = {}) {
+    if (klass == OutboundClass::kCoalesce) {
+      // Walk back to the newest message for this key; only an unsent
+      // coalescible message may be replaced, anything else keeps ordering.
+      for (auto it = queue_.rbegin(); it != queue_.rend(); ++it) {
+        if (it->coalesce_key != coalesce_key) {
+          continue;
+        }
+        if (it->klass == OutboundClass::kCoalesce && !it->committed) {
+          queued_bytes_ -= it->size();
+          it->payload = std::move(payload);
+          it->partial = std::move(partial);
+          it->header_len = EncodeWebSocketHeader(it->header, opcode, it->payload.size());
+          queued_bytes_ += it->size();
+          ++stats_.coalesced;
+          return EnqueueResult::kCoalesced;
+        }
+        break;
       }
-      return false;
     }
-    payload_len = ntohs(ext);
-  } else if (payload_len == 127) {
-    uint64_t ext = 0;
-    if (!ReadExactBuffered(fd, pending_bytes, &ext, sizeof(ext), timeout_ms)) {
-      if (error != nullptr) {
-        *error = "failed to read extended websocket payload length (64-bit)";
+
+    const size_t incoming = kMaxWsHeaderBytes + payload.size();
+    if (queued_bytes_ + incoming > max_bytes_) {
+      EvictDroppable(queued_bytes_ + incoming - max_bytes_);
+    }
+    if (queued_bytes_ + incoming > max_bytes_) {
+      if (klass != OutboundClass::kCritical) {
+        ++stats_.dropped;
+        return EnqueueResult::kDropped;
       }
-      return false;
+      return EnqueueResult::kOverflow;
+    }
+
+    if (queue_.empty()) {
+      last_progress_ = std::chrono::steady_clock::now();
     }
-    payload_len = OSSwapBigToHostInt64(ext);
+    OutboundMessage& msg = queue_.emplace_back();
+    msg.opcode = opcode;
+    msg.klass = klass;
+    msg.coalesce_key = std::move(coalesce_key);
+    msg.payload = std::move(payload);
+    msg.partial = std::move(partial);
+    msg.header_len = EncodeWebSocketHeader(msg.header, opcode, msg.payload.size());
+    queued_bytes_ += msg.size();
+    stats_.peak_queued_bytes = std::max(stats_.peak_queued_bytes, queued_bytes_);
+    return EnqueueResult::kQueued;
   }
 
-  uint8_t masking_key[4] = {0, 0, 0, 0};
-  if (masked) {
-    if (!ReadExactBuffered(fd, pending_bytes, masking_key, sizeof(masking_key), timeout_ms)) {
-      if (error != nullptr) {
-        *error = "failed to read websocket masking key";
+  // Queues a complete, pre-framed text message (see FrameTemplate). It is
+  // critical and goes out exactly as given, uncompressed.
+  EnqueueResult EnqueueFrame(std::string frame) {
+    if (queued_bytes_ + frame.size() > max_bytes_) {
+      EvictDroppable(queued_bytes_ + frame.size() - max_bytes_);
+    }
+    if (queued_bytes_ + frame.size() > max_bytes_) {
+      return EnqueueResult::kOverflow;
+    }
+    if (queue_.empty()) {
+      last_progress_ = std::chrono::steady_clock::now();
+    }
+    OutboundMessage& msg = queue_.emplace_back();
+    msg.payload = std::move(frame);
+    msg.committed = true;
+    queued_bytes_ += msg.size();
+    stats_.peak_queued_bytes = std::max(stats_.peak_queued_bytes, queued_bytes_);
+    return EnqueueResult::kQueued;
+  }
+
+  // Writes as much as the socket accepts, batching up to kMaxFramesPerWritev
+  // frames per syscall. Returns false on a hard socket error.
+  bool Flush(int fd) {
+    struct iovec iov[kMaxFramesPerWritev * 2];
+    while (!queue_.empty()) {
+      int iov_count = 0;
+      size_t frames = 0;
+      for (auto it = queue_.begin(); it != queue_.end() && frames < kMaxFramesPerWritev; ++it, ++frames) {
+        if (!it->committed && !Commit(&*it)) {
+          errno = EPROTO;
+          return false;
+        }
+        size_t skip = it->sent;
+        if (skip < it->header_len) {
+          iov[iov_count].iov_base = it->header + skip;
+          iov[iov_count].iov_len = it->header_len - skip;
+          ++iov_count;
+          skip = 0;
+        } else {
+          skip -= it->header_len;
+        }
+        if (skip < it->payload.size()) {
+          iov[iov_count].iov_base = it->payload.data() + skip;
+          iov[iov_count].iov_len = it->payload.size() - skip;
+          ++iov_count;
+        }
+      }
+
+      const ssize_t rc = writev(fd, iov, iov_count);
+      if (rc < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+      }
+      if (rc == 0) {
+        return true;
+      }
+
+      last_progress_ = std::chrono::steady_clock::now();
+      size_t written = static_cast<size_t>(rc);
+      stats_.bytes_sent += written;
+      while (written > 0) {
+        OutboundMessage& front = queue_.front();
+        const size_t remaining = front.size() - front.sent;
+        if (written < remaining) {
+          front.sent += written;
+          queued_bytes_ -= written;
+          break;
+        }
+        written -= remaining;
+        queued_bytes_ -= remaining;
+        queue_.pop_front();
+        ++stats_.frames_sent;
+      }
+    }
+    return true;
+  }
+
+  // Time the queue has been non-empty without the socket accepting a byte.
+  std::chrono::milliseconds StalledFor(std::chrono::steady_clock::time_point now) const {
+    if (queue_.empty()) {
+      return std::chrono::milliseconds(0);
+    }
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now - last_progress_);
+  }
+
+  // Moves out text messages that have not started going out on the wire;
+  // they can be replayed on another connection. Call before Reset().
+  void TakeUnsent(std::deque<OutboundMessage>* out) {
+    for (OutboundMessage& msg : queue_) {
+      if (!msg.committed && msg.opcode == WsOpcode::kText) {
+        out->push_back(std::move(msg));
+      }
+    }
+  }
+
+  void Reset() {
+    queue_.clear();
+    queued_bytes_ = 0;
+    partial_bases_.clear();
+    deflate_ = nullptr;
+    stats_ = ClientSendStats{};
+    last_progress_ = std::chrono::steady_clock::now();
+  }
+
+  bool empty() const {
+    return queue_.empty();
+  }
+
+  size_t queued_bytes() const {
+    return queued_bytes_;
+  }
+
+  const ClientSendStats& stats() const {
+    return stats_;
+  }
+
+ private:
+  void EvictDroppable(size_t needed) {
+    size_t freed = 0;
+    for (auto it = queue_.begin(); it != queue_.end() && freed < needed;) {
+      if (it->klass == OutboundClass::kDroppable && !it->committed) {
+        freed += it->size();
+        queued_bytes_ -= it->size();
+        ++stats_.dropped;
+        it = queue_.erase(it);
+      } else {
+        ++it;
       }
+    }
+  }
+
+  // Runs the message through the deflate context when it qualifies. The
+  // compressed bytes are swapped into the payload so both buffers keep
+  // their capacity for the next message.
+  bool Commit(OutboundMessage* msg) {
+    msg->committed = true;
+    if (!msg->coalesce_key.empty()) {
+      EncodePartialDelta(msg);
+    }
+    // Binary frames carry PCM, which deflate barely shrinks.
+    if (deflate_ == nullptr || msg->opcode != WsOpcode::kText || msg->payload.size() < min_compress_bytes_) {
+      return true;
+    }
+    if (!deflate_->Compress(reinterpret_cast<const uint8_t*>(msg->payload.data()), msg->payload.size(),
+                            &compress_scratch_)) {
       return false;
     }
+    queued_bytes_ -= msg->size();
+    msg->payload.swap(compress_scratch_);
+    msg->header_len = EncodeWebSocketHeader(msg->header, msg->opcode, msg->payload.size(), true);
+    queued_bytes_ += msg->size();
+    ++stats_.compressed;
+    return true;
   }
 
-  if (payload_len > (4 * 1024 * 1024)) {
-    if (error != nullptr) {
-      *error = "websocket payload too large";
+  // Delta partials are computed here, when a message is first written,
+  // rather than on enqueue: coalescing can then replace an unsent partial
+  // freely, and the base is always text the client has actually been sent.
+  // The first partial of a stream, and the first after a final, go out in
+  // full.
+  void EncodePartialDelta(OutboundMessage* msg) {
+    if (msg->partial.prefix.empty()) {
+      if (msg->klass == OutboundClass::kCritical) {
+        partial_bases_.erase(msg->coalesce_key);
+      }
+      return;
     }
-    return false;
+    auto [base, first] = partial_bases_.try_emplace(msg->coalesce_key);
+    const std::string& text = msg->partial.text;
+    if (!first) {
+      const std::string& previous = base->second;
+      size_t keep = std::mismatch(previous.begin(), previous.begin() + std::min(previous.size(), text.size()),
+                                  text.begin())
+                        .first -
+                    previous.begin();
+      // Never split a UTF-8 sequence.
+      while (keep > 0 && keep < text.size() && (static_cast<uint8_t>(text[keep]) & 0xC0) == 0x80) {
+        --keep;
+      }
+      const size_t keep_code_points = static_cast<size_t>(std::count_if(
+          text.begin(), text.begin() + keep, [](char c) { return (static_cast<uint8_t>(c) & 0xC0) != 0x80; }));
+
+      queued_bytes_ -= msg->size();
+      std::string& payload = msg->payload;
+      payload.assign(msg->partial.prefix);
+      payload.append(",\"keep\":").append(std::to_string(keep_code_points)).append(",\"append\":");
+      bridge::AppendJsonString(std::string_view(text).substr(keep), &payload);
+      payload.push_back('}');
+      msg->header_len = EncodeWebSocketHeader(msg->header, msg->opcode, payload.size());
+      queued_bytes_ += msg->size();
+    }
+    base->second = std::move(msg->partial.text);
+    msg->partial = PartialText{};
   }
 
-  std::string payload(payload_len, '\0');
-  if (payload_len > 0 &&
-      !ReadExactBuffered(fd, pending_bytes, payload.data(), payload_len, timeout_ms)) {
-    if (error != nullptr) {
-      *error = "failed to read websocket payload";
+  size_t max_bytes_;
+  size_t queued_bytes_ = 0;
+  std::deque<OutboundMessage> queue_;
+  // Last partial text written per coalesce key (one per STT stream).
+  std::unordered_map<std::string, std::string> partial_bases_;
+  PerMessageDeflate* deflate_ = nullptr;
+  size_t min_compress_bytes_ = 0;
+  std::string compress_scratch_;
+  ClientSendStats stats_;
+  std::chrono::steady_clock::time_point last_progress_ = std::chrono::steady_clock::now();
+};
+
+// How a session's audio is synthesized and routed; the helper holds one of
+// these at a time.
+struct SessionRouting {
+  std::string mode;
+  std::string stt_source;
+  std::string tts_target;
+
+  bool operator==(const SessionRouting&) const = default;
+};
+
+// One logical session multiplexed over the client connection. Messages
+// without a session_id belong to the default session (tag 0), which always
+// exists, so single-session clients see the protocol unchanged.
+struct SessionState {
+  std::string id;
+  uint32_t tag = 0;  // namespaces this session's utterance and stream ids at the helper
+  bool configured = false;
+  SessionRouting routing;
+  bool delta_partials = false;     // stt_partials: "delta"
+  bool binary_alignment = false;   // tts_alignment: "binary"
+  std::vector<std::string> utterances;   // started and not yet completed
+  std::vector<std::string> stt_streams;  // started and not yet stopped
+  size_t shard = 0;                      // helper shard serving it, chosen when first configured
+};
+
+// Live sessions of the active client. Lookups are linear: a client holds a
+// handful at most.
+class SessionTable {
+ public:
+  void Reset(const SessionDefaults& defaults) {
+    defaults_ = {defaults.mode, defaults.stt_source, defaults.tts_target};
+    sessions_.clear();
+    sessions_.push_back(SessionState{});
+    sessions_.front().routing = defaults_;
+  }
+
+  SessionState* FindById(std::string_view id) {
+    for (SessionState& session : sessions_) {
+      if (session.id == id) {
+        return &session;
+      }
     }
-    return false;
+    return nullptr;
+  }
+
+  SessionState* FindByTag(uint32_t tag) {
+    for (SessionState& session : sessions_) {
+      if (session.tag == tag) {
+        return &session;
+      }
+    }
+    return nullptr;
+  }
+
+  // Returns nullptr once kMaxSessions are open.
+  SessionState* Create(std::string_view id) {
+    if (sessions_.size() >= kMaxSessions) {
+      return nullptr;
+    }
+    SessionState& session = sessions_.emplace_back();
+    session.id = id;
+    session.tag = next_tag_++;
+    session.routing = defaults_;
+    return &session;
   }
 
-  if (masked) {
-    for (uint64_t i = 0; i < payload_len; ++i) {
-      payload[static_cast<size_t>(i)] ^= masking_key[i % 4];
+  // The default session is never removed, only returned to its initial state.
+  void Remove(uint32_t tag) {
+    if (tag == 0) {
+      sessions_.front() = SessionState{};
+      sessions_.front().routing = defaults_;
+      return;
     }
+    sessions_.erase(std::remove_if(sessions_.begin(), sessions_.end(),
+                                   [tag](const SessionState& session) { return session.tag == tag; }),
+                    sessions_.end());
   }
 
-  if (out_frame != nullptr) {
-    out_frame->fin = fin;
-    out_frame->opcode = opcode;
-    out_frame->payload = std::move(payload);
+  template <typename Fn>
+  void ForEach(Fn fn) {
+    std::for_each(sessions_.begin(), sessions_.end(), fn);
   }
-  return true;
+
+  template <typename Predicate>
+  bool Any(Predicate predicate) const {
+    return std::any_of(sessions_.begin(), sessions_.end(), predicate);
+  }
+
+  const SessionRouting& defaults() const {
+    return defaults_;
+  }
+
+ private:
+  std::vector<SessionState> sessions_;
+  SessionRouting defaults_;
+  // Tags are never reused, so a late helper event cannot reach a newer
+  // session that happens to occupy the same slot.
+  uint32_t next_tag_ = 1;
+};
+
+// Utterance and stream ids are namespaced per session at the helper, so two
+// sessions may use the same ids. The default session's ids pass through
+// unchanged unless they could be mistaken for a namespaced one.
+std::string HelperScopedId(uint32_t tag, std::string_view id) {
+  if (tag == 0 && (id.empty() || id.front() != '#')) {
+    return std::string(id);
+  }
+  return "#" + std::to_string(tag) + ":" + std::string(id);
 }
 
-bool SendWebSocketFrame(int fd, WsOpcode opcode, const std::string& payload, std::string* error) {
-  std::vector<uint8_t> frame;
-  frame.reserve(payload.size() + 16);
-
-  const uint8_t first = 0x80 | static_cast<uint8_t>(opcode);
-  frame.push_back(first);
-
-  if (payload.size() < 126) {
-    frame.push_back(static_cast<uint8_t>(payload.size()));
-  } else if (payload.size() <= 0xFFFF) {
-    frame.push_back(126);
-    const uint16_t ext = htons(static_cast<uint16_t>(payload.size()));
-    const uint8_t* ext_ptr = reinterpret_cast<const uint8_t*>(&ext);
-    frame.insert(frame.end(), ext_ptr, ext_ptr + sizeof(ext));
-  } else {
-    frame.push_back(127);
-    const uint64_t ext = OSSwapHostToBigInt64(static_cast<uint64_t>(payload.size()));
-    const uint8_t* ext_ptr = reinterpret_cast<const uint8_t*>(&ext);
-    frame.insert(frame.end(), ext_ptr, ext_ptr + sizeof(ext));
+// Inverse of HelperScopedId(): returns the session tag and points *id at
+// the client's id within `scoped`.
+uint32_t SplitHelperScopedId(std::string_view scoped, std::string_view* id) {
+  *id = scoped;
+  const size_t colon = scoped.find(':');
+  uint32_t tag = 0;
+  if (scoped.empty() || scoped.front() != '#' || colon == std::string_view::npos ||
+      std::from_chars(scoped.data() + 1, scoped.data() + colon, tag).ec != std::errc()) {
+    return 0;
   }
+  *id = scoped.substr(colon + 1);
+  return tag;
+}
 
-  frame.insert(frame.end(), payload.begin(), payload.end());
+// The sides of the audio rings that a session's work drives. Each ring has
+// a single writer and a single reader, so helpers in different shards must
+// not drive the same side at once.
+enum AudioRingUse : uint8_t {
+  kWritesMicFeed = 1 << 0,
+  kWritesSpeakerTap = 1 << 1,
+  kReadsMicFeed = 1 << 2,
+  kReadsSpeakerTap = 1 << 3,
+};
 
-  if (!SendAll(fd, frame.data(), frame.size())) {
-    if (error != nullptr) {
-      *error = "failed to send websocket frame";
-    }
-    return false;
+uint8_t TtsRingUse(const SessionRouting& routing) {
+  if (routing.tts_target == "both") {
+    return kWritesMicFeed | kWritesSpeakerTap;
   }
+  return routing.tts_target == "virtual_speaker" ? kWritesSpeakerTap : kWritesMicFeed;
+}
 
-  return true;
+uint8_t SttRingUse(const SessionRouting& routing) {
+  return routing.stt_source == "virtual_mic" ? kReadsMicFeed : kReadsSpeakerTap;
+}
+
+uint8_t ActiveRingUse(const SessionState& session) {
+  return (session.utterances.empty() ? 0 : TtsRingUse(session.routing)) |
+         (session.stt_streams.empty() ? 0 : SttRingUse(session.routing));
+}
+
+// Rendezvous score of `shard` for `session_id`; the highest wins.
+uint64_t HelperShardScore(std::string_view session_id, size_t shard) {
+  uint64_t hash = 14695981039346656037ull;
+  for (const char c : session_id) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+  }
+  hash ^= (shard + 1) * 0x9E3779B97F4A7C15ull;
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDull;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+// Frequent bridge -> client messages, framed once at startup.
+struct ProtocolFrames {
+  FrameTemplate ready;          // resume_token
+  FrameTemplate ready_resumed;  // resume_token
+  FrameTemplate pong;           // id
+  FrameTemplate error;          // code, message
+  FrameTemplate session_error;  // code, message, session_id
+
+  ProtocolFrames() {
+    const std::string ready_prefix =
+        std::string("{\"type\":\"ready\",\"version\":\"") + kProtocolVersion + "\",\"resume_token\":";
+    ready.Literal(ready_prefix).Slot().Literal(",\"resumed\":false}");
+    ready_resumed.Literal(ready_prefix).Slot().Literal(",\"resumed\":true}");
+    pong.Literal("{\"type\":\"pong\",\"id\":").Slot().Literal("}");
+    error.Literal("{\"type\":\"error\",\"code\":").Slot().Literal(",\"message\":").Slot().Literal("}");
+    session_error.Literal("{\"type\":\"error\",\"code\":")
+        .Slot()
+        .Literal(",\"message\":")
+        .Slot()
+        .Literal(",\"session_id\":")
+        .Slot()
+        .Literal("}");
+  }
+};
+
+// How long to wait before starting a helper after `failures` failures in a
+// row: nothing after the first, then 250 ms doubling up to 30 s.
+std::chrono::milliseconds HelperRestartBackoff(int failures) {
+  if (failures <= 1) {
+    return std::chrono::milliseconds(0);
+  }
+  const int doublings = std::min(failures - 2, 7);
+  return std::min(std::chrono::milliseconds(250 << doublings), std::chrono::milliseconds(30000));
+}
+
+bool SetNonBlocking(int fd) {
+  const int flags = fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// Counters behind GET /metrics that the service thread updates. Scrapes are
+// answered on the same thread, so they only cost anything while a scrape is
+// being served.
+struct ServiceMetrics {
+  bridge::Counter tcp_connections;
+  bridge::Counter unix_connections;
+  bridge::Counter rejected_connections;
+  bridge::Counter resumed_connections;
+  bridge::Counter helper_restarts;
+  bridge::Counter helper_failovers;
+  bridge::Counter speaker_tap_frames_skipped;
+  bridge::MessageTypeCounter client_messages{
+      "ping", "configure_session", "end_session", "enable", "disable", "tts_start", "tts_chunk",
+      "tts_chunks", "tts_flush", "tts_cancel", "start_stt", "stop_stt", "pcm_subscribe",
+      "pcm_unsubscribe", "pcm_block"};
+  // Time from the helper reader thread receiving an event to the service
+  // thread queueing it for the client.
+  bridge::LatencyHistogram helper_event_relay{0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 1.0};
+  // Time from losing the helper to its replacement reporting engine_ready.
+  bridge::LatencyHistogram helper_recovery{0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 1.0, 2.5, 5.0};
+  ClientSendStats finished_clients;  // summed when each client goes away
+};
+
+// Counters for messages from the active helpers, updated on the service
+// thread as it takes them.
+struct HelperReaderMetrics {
+  bridge::Counter messages;
+  bridge::Counter bytes;
+  bridge::MessageTypeCounter events{
+      "engine_ready", "session_config_applied", "tts_status", "tts_alignment", "stt_partial",
+      "stt_final", "enabled", "disabled", "engine_error"};
+};
+
+// Events that found the helper event queue full. When it is, events that
+// later ones supersede are dropped at once; the rest wait for room, holding
+// up the helper's output, and are lost only if none comes within
+// kHelperEventQueueFullTimeout. Every helper's reader thread writes these,
+// so unlike bridge::Counter they use fetch_add; they move only on overflow.
+struct HelperEventOverflow {
+  static constexpr std::string_view kDroppableTypes[] = {"tts_alignment", "stt_partial"};
+  static constexpr size_t kLostIndex = std::size(kDroppableTypes);
+
+  std::atomic<uint64_t> dropped[kLostIndex + 1] = {};  // by droppable type, then lost after waiting
+  std::atomic<uint64_t> waits{0};
+};
+
+// One helper of the pool and the engine state the bridge has given it.
+// Each configured session is served by one shard.
+struct HelperShard {
+  struct ConfigAck {
+    uint32_t tag;
+    bool announce;
+  };
+
+  size_t index = 0;
+  std::unique_ptr<HelperProcess> helper;
+  // Session of the last command forwarded; events without an utterance or
+  // stream id are attributed to it.
+  uint32_t last_tag = 0;
+  // The routing the helper currently holds, and whose it is.
+  SessionRouting routing;
+  uint32_t routing_tag = 0;
+  bool routing_valid = false;
+  std::deque<ConfigAck> pending_config_acks;
+  // The last event, or when the helper took over.
+  std::chrono::steady_clock::time_point last_activity;
+  // The outage in progress, if any.
+  std::optional<std::chrono::steady_clock::time_point> lost_at;
+  std::optional<std::chrono::steady_clock::time_point> recovering_since;
+  bool outage_reported = false;
+  // Shared-memory mode: when the service thread first saw events waiting in
+  // the ring, by a doorbell or PrepareToWait(); they are stamped with it.
+  std::optional<std::chrono::steady_clock::time_point> events_seen_at;
+};
+
+bridge::AudioPacer::Options AudioPacerOptions(const BridgeConfig& config) {
+  bridge::AudioPacer::Options options;
+  options.mic_feed_name = kMicFeedName;
+  options.speaker_tap_name = kSpeakerTapName;
+  options.channels = static_cast<uint32_t>(config.audio.channels);
+  options.ring_capacity_frames = static_cast<uint32_t>(config.audio.ring_capacity_frames);
+  options.target_fill_frames =
+      static_cast<uint32_t>(static_cast<int64_t>(config.audio.sample_rate_hz) * config.audio.tts_target_fill_ms / 1000);
+  options.max_queued_frames = static_cast<size_t>(config.audio.sample_rate_hz) * kAudioPacerQueueSeconds;
+  options.tick = kAudioPacerTick;
+  return options;
 }
 
 class BridgeService {
  public:
-  explicit BridgeService(BridgeConfig config) : config_(std::move(config)) {}
+  explicit BridgeService(BridgeConfig config)
+      : config_(std::move(config)),
+        client_queue_(static_cast<size_t>(config_.send_queue_max_bytes)),
+        client_reader_(WebSocketReader::Callbacks{
+            [this](WsOpcode opcode, bool compressed) { OnClientMessageBegin(opcode, compressed); },
+            [this](const uint8_t* data, size_t size, bool final) {
+              OnClientMessageData(data, size, final);
+            },
+            [this](WsOpcode opcode, const uint8_t* data, size_t size) {
+              OnClientControlFrame(opcode, data, size);
+            },
+        }),
+        client_recv_buffer_(kClientRecvBufferBytes),
+        pcm_reader_(static_cast<uint32_t>(config_.audio.channels),
+                    PcmBlockReader::Callbacks{
+                        [this](const PcmBlockHeader& header, std::string* error) {
+                          return OnPcmBlockHeader(header, error);
+                        },
+                        [this](const float* frames, size_t frame_count) {
+                          OnPcmFrames(frames, frame_count);
+                        },
+                    }) {
+    sessions_.Reset(config_.session_defaults);
+  }
 
   int Run() {
-    if (!StartHelper()) {
+    audio_pacer_.Start();
+    if (!StartHelpers()) {
       return 1;
     }
 
@@ -926,449 +2048,2177 @@ class BridgeService {
       return 1;
     }
 
-    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
-      std::cerr << "Failed to bind websocket server on " << config_.host << ":" << config_.port
-                << " (" << std::strerror(errno) << ")\n";
-      return 1;
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+      std::cerr << "Failed to bind websocket server on " << config_.host << ":" << config_.port
+                << " (" << std::strerror(errno) << ")\n";
+      return 1;
+    }
+
+    if (listen(listen_fd_, 8) != 0) {
+      std::cerr << "Failed to listen on websocket socket\n";
+      return 1;
+    }
+
+    std::cout << "Bridge service listening on ws://" << config_.host << ":" << config_.port << "\n";
+
+    if (!config_.unix_path.empty() && !OpenUnixListener()) {
+      return 1;
+    }
+    VLOG("Entering main event loop");
+
+    auto last_heartbeat_sent = std::chrono::steady_clock::now();
+
+    while (!g_should_exit.load(std::memory_order_relaxed)) {
+      for (HelperShard& shard : shards_) {
+        if (!shard.helper->IsRunning()) {
+          ReplaceHelper(shard);
+        }
+      }
+
+      FlushHelperEvents();
+      MaintainStandbyHelpers();
+
+      const auto now = std::chrono::steady_clock::now();
+      if (std::chrono::duration_cast<std::chrono::seconds>(now - last_heartbeat_sent).count() >= 5) {
+        SendHeartbeats();
+        last_heartbeat_sent = now;
+      }
+
+      if (parked_ && now >= parked_deadline_) {
+        DiscardParkedSessions("resume grace period elapsed");
+      }
+
+      bool timed_out = false;
+      for (HelperShard& shard : shards_) {
+        if (std::chrono::duration_cast<std::chrono::seconds>(now - shard.last_activity).count() > 30 &&
+            shard.helper->IsRunning()) {
+          std::cerr << "Helper shard " << shard.index << " heartbeat timeout; replacing it\n";
+          ReplaceHelper(shard);
+          timed_out = true;
+        }
+      }
+      if (timed_out) {
+        continue;
+      }
+
+      PumpPendingHttp();
+      if (active_client_fd_ < 0) {
+        AcceptPrimaryClient();
+      } else {
+        PollActiveClient();
+        FlushDueTtsBatch();
+        PumpSpeakerTap();
+      }
+    }
+
+    CloseActiveClient();
+    for (PendingHttpConnection& pending : http_pending_) {
+      CloseFd(&pending.fd);
+    }
+    CloseFd(&listen_fd_);
+    if (unix_listen_fd_ >= 0) {
+      CloseFd(&unix_listen_fd_);
+      unlink(config_.unix_path.c_str());
+    }
+    for (std::unique_ptr<HelperProcess>& standby : standby_helpers_) {
+      standby->Stop();
+    }
+    for (HelperShard& shard : shards_) {
+      shard.helper->Stop();
+    }
+    helper_reaper_.Stop();
+    audio_pacer_.Stop();
+    return 0;
+  }
+
+ private:
+  // Same-host clients can skip the TCP stack. A socket file left behind by
+  // an earlier run is replaced; any other file at the path is an error.
+  bool OpenUnixListener() {
+    const std::string& path = config_.unix_path;
+    struct stat st {};
+    if (lstat(path.c_str(), &st) == 0) {
+      if (!S_ISSOCK(st.st_mode)) {
+        std::cerr << "websocket.unix_path exists and is not a socket: " << path << "\n";
+        return false;
+      }
+      unlink(path.c_str());
+    }
+
+    unix_listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (unix_listen_fd_ < 0) {
+      std::cerr << "Failed to create unix listening socket\n";
+      return false;
+    }
+
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    if (bind(unix_listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+      std::cerr << "Failed to bind websocket server on " << path << " (" << std::strerror(errno) << ")\n";
+      CloseFd(&unix_listen_fd_);
+      return false;
+    }
+    if (listen(unix_listen_fd_, 8) != 0) {
+      std::cerr << "Failed to listen on unix socket\n";
+      CloseFd(&unix_listen_fd_);
+      unlink(path.c_str());
+      return false;
+    }
+
+    std::cout << "Bridge service listening on unix:" << path << "\n";
+    return true;
+  }
+
+  // Fills `pfds` with the open listening sockets and returns their count.
+  nfds_t ListenerPollFds(struct pollfd* pfds) const {
+    nfds_t count = 0;
+    for (const int fd : {listen_fd_, unix_listen_fd_}) {
+      if (fd >= 0) {
+        pfds[count].fd = fd;
+        pfds[count].events = POLLIN;
+        ++count;
+      }
+    }
+    return count;
+  }
+
+  bool StartHelpers() {
+    shards_.resize(static_cast<size_t>(config_.helper_shards));
+    const auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < shards_.size(); ++i) {
+      shards_[i].index = i;
+      shards_[i].last_activity = now;
+      if ((shards_[i].helper = SpawnHelper(false)) == nullptr) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Starts a helper and sends it the engine config. A standby warms up but
+  // leaves the audio rings alone until PromoteStandbyHelper() activates it.
+  // Only the first helper resets the rings; later ones join them as they
+  // are, as other shards may be using them.
+  std::unique_ptr<HelperProcess> SpawnHelper(bool standby) {
+    if (!FileIsExecutable(config_.helper_path)) {
+      std::cerr << "Helper executable not found or not executable: " << config_.helper_path << "\n";
+      std::cerr << "Build helper with: swift build --package-path swift --product engine_helper -c release\n";
+      return nullptr;
+    }
+
+    const uint64_t id = next_helper_id_++;
+    auto helper = std::make_unique<HelperProcess>(id);
+    std::string error;
+    const bool started = helper->Start(
+        config_.helper_path, config_.helper_ipc,
+        [this, id](std::string_view payload, std::string_view attachment) {
+          if (!SubmitHelperAudio(id, payload, attachment)) {
+            QueueHelperEvent(id, payload);
+          }
+        },
+        &error);
+
+    if (!started) {
+      std::cerr << "Failed to start helper process: " << error << "\n";
+      return nullptr;
+    }
+
+    std::string payload;
+    JsonWriter json(&payload);
+    json.BeginObject()
+        .Field("type", "engine_config")
+        .Key("standby").Bool(standby)
+        .Key("audio").BeginObject()
+        .Key("sample_rate_hz").Int(config_.audio.sample_rate_hz)
+        .Key("channels").Int(config_.audio.channels)
+        .Key("ring_capacity_frames").Int(config_.audio.ring_capacity_frames)
+        .EndObject()
+        .Key("elevenlabs").BeginObject()
+        .Field("api_key", config_.elevenlabs.api_key)
+        .Key("tts").BeginObject()
+        .Field("voice_id", config_.elevenlabs.tts.voice_id)
+        .Field("model_id", config_.elevenlabs.tts.model_id)
+        .Field("output_format", config_.elevenlabs.tts.output_format)
+        .EndObject()
+        .Key("stt").BeginObject()
+        .Field("model_id", config_.elevenlabs.stt.model_id)
+        .Field("language_code", config_.elevenlabs.stt.language_code)
+        .EndObject()
+        .EndObject()
+        .Key("apple").BeginObject()
+        .Field("locale", config_.apple.locale)
+        .Key("on_device_only").Bool(config_.apple.on_device_only)
+        .EndObject()
+        .Key("rings").BeginObject()
+        .Field("mic_feed", kMicFeedName)
+        .Field("speaker_tap", kSpeakerTapName)
+        .Key("reset").Bool(!standby && std::exchange(reset_audio_rings_, false))
+        .EndObject()
+        .EndObject();
+
+    std::string json_error;
+    if (!helper->SendMessage(payload, &json_error)) {
+      std::cerr << "Failed to send engine config to helper: " << json_error << "\n";
+      helper_reaper_.Retire(std::move(helper));
+      return nullptr;
+    }
+
+    return helper;
+  }
+
+  // Puts a new helper in place of one that exited or stopped answering:
+  // a warm standby at once if there is one, otherwise a cold start once the
+  // restart backoff allows. Other shards carry on meanwhile. Returns false
+  // while the shard still has no helper; until then it holds one that was
+  // never started. The old helper is stopped on helper_reaper_'s thread.
+  bool ReplaceHelper(HelperShard& shard) {
+    const auto now = std::chrono::steady_clock::now();
+    if (!shard.lost_at) {
+      audio_pacer_.DiscardSource(shard.helper->id());
+      std::cerr << "Helper shard " << shard.index << " stopped (exit code " << shard.helper->ExitCode()
+                << "); replacing it\n";
+      helper_reaper_.Retire(std::exchange(shard.helper, std::make_unique<HelperProcess>(next_helper_id_++)));
+      shard.lost_at = now;
+      NoteHelperFailure(now);
+      // Work in flight died with the helper and will never complete.
+      sessions_.ForEach([&shard](SessionState& session) {
+        if (session.shard == shard.index) {
+          session.utterances.clear();
+          session.stt_streams.clear();
+        }
+      });
+    }
+
+    if (PromoteStandbyHelper(shard)) {
+      metrics_.helper_failovers.Add();
+    } else if (now < next_helper_spawn_) {
+      return false;
+    } else if (std::unique_ptr<HelperProcess> fresh = SpawnHelper(false)) {
+      shard.helper = std::move(fresh);
+    } else {
+      std::cerr << "Helper restart failed; retrying in "
+                << HelperRestartBackoff(helper_failures_ + 1).count() << " ms\n";
+      NoteHelperFailure(now);
+      if (!shard.outage_reported) {
+        SendErrorToClient("helper_exited", "Engine helper process stopped");
+        shard.outage_reported = true;
+      }
+      return false;
+    }
+    metrics_.helper_restarts.Add();
+    shard.recovering_since = shard.lost_at;
+    shard.lost_at.reset();
+    shard.outage_reported = false;
+    shard.last_activity = now;
+
+    // The new helper starts unconfigured; give it the routing the old one
+    // held.
+    shard.pending_config_acks.clear();
+    shard.routing_valid = false;
+    if (SessionState* session = sessions_.FindByTag(shard.routing_tag);
+        session != nullptr && session->configured && session->shard == shard.index) {
+      SendSessionConfigToHelper(*session, true);
+    }
+    return true;
+  }
+
+  bool PromoteStandbyHelper(HelperShard& shard) {
+    while (!standby_helpers_.empty()) {
+      std::unique_ptr<HelperProcess> standby = std::move(standby_helpers_.front());
+      standby_helpers_.erase(standby_helpers_.begin());
+      std::string error;
+      if (standby->IsRunning() && standby->SendMessage("{\"type\":\"activate\"}", &error)) {
+        VLOG("Promoted standby helper " << standby->id() << " to shard " << shard.index);
+        shard.helper = std::move(standby);
+        return true;
+      }
+      helper_reaper_.Retire(std::move(standby));
+    }
+    return false;
+  }
+
+  // Failures close together back off further; a quiet minute starts over.
+  void NoteHelperFailure(std::chrono::steady_clock::time_point now) {
+    if (now - last_helper_failure_ >= kHelperFailureMemory) {
+      helper_failures_ = 0;
+    }
+    ++helper_failures_;
+    last_helper_failure_ = now;
+    next_helper_spawn_ = now + HelperRestartBackoff(helper_failures_);
+  }
+
+  // Drops standbys that exited, discards what the live ones report, and
+  // starts one more when the pool is short and the backoff allows.
+  void MaintainStandbyHelpers() {
+    const auto now = std::chrono::steady_clock::now();
+    for (auto it = standby_helpers_.begin(); it != standby_helpers_.end();) {
+      HelperProcess& standby = **it;
+      standby.DrainEvents([](std::string_view, std::string_view) {});
+      if (standby.IsRunning()) {
+        ++it;
+        continue;
+      }
+      std::cerr << "Standby helper exited\n";
+      helper_reaper_.Retire(std::move(*it));
+      it = standby_helpers_.erase(it);
+      NoteHelperFailure(now);
+    }
+
+    const bool shard_lost =
+        std::any_of(shards_.begin(), shards_.end(), [](const HelperShard& shard) { return shard.lost_at.has_value(); });
+    if (shard_lost || standby_helpers_.size() >= static_cast<size_t>(config_.helper_standby) ||
+        now < next_helper_spawn_) {
+      return;
+    }
+    if (std::unique_ptr<HelperProcess> standby = SpawnHelper(true)) {
+      standby_helpers_.push_back(std::move(standby));
+    } else {
+      NoteHelperFailure(now);
+    }
+  }
+
+  // Passes a tts_audio event's samples straight to the pacer, on whichever
+  // thread read the event, so that audio never waits behind other events.
+  // Returns false for every other event.
+  bool SubmitHelperAudio(uint64_t helper_id, std::string_view payload, std::string_view attachment) {
+    if (ExtractJsonStringField(payload, "type") != "tts_audio") {
+      return false;
+    }
+    std::string decoded;
+    if (config_.helper_ipc == bridge::HelperIpcMode::kJsonLines &&
+        bridge::DecodeHelperAttachment(ExtractJsonStringField(payload, "attachment"), &decoded)) {
+      attachment = decoded;
+    }
+    const size_t frame_bytes = sizeof(float) * static_cast<size_t>(config_.audio.channels);
+    if (attachment.size() % frame_bytes != 0) {
+      std::cerr << "Dropping tts_audio of " << attachment.size() << " bytes, not a whole number of frames\n";
+      return true;
+    }
+    const std::string target = ExtractJsonStringField(payload, "target");
+    const uint8_t targets = target == "both"              ? bridge::kPaceMicFeed | bridge::kPaceSpeakerTap
+                            : target == "virtual_speaker" ? bridge::kPaceSpeakerTap
+                                                          : bridge::kPaceMicFeed;
+    audio_pacer_.Submit(helper_id, ExtractJsonStringField(payload, "utterance_id"), targets, attachment.data(),
+                        attachment.size() / frame_bytes);
+    return true;
+  }
+
+  // Runs on a helper's reader thread in the pipe modes.
+  void QueueHelperEvent(uint64_t helper_id, std::string_view payload) {
+    const auto received_at = std::chrono::steady_clock::now();
+    if (helper_events_.TryPush(helper_id, received_at, payload)) {
+      return;
+    }
+    const std::string type = ExtractJsonStringField(payload, "type");
+    const auto& droppable = HelperEventOverflow::kDroppableTypes;
+    const size_t index = std::find(std::begin(droppable), std::end(droppable), type) - std::begin(droppable);
+    if (index < HelperEventOverflow::kLostIndex) {
+      helper_event_overflow_.dropped[index].fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    helper_event_overflow_.waits.fetch_add(1, std::memory_order_relaxed);
+    const auto deadline = received_at + kHelperEventQueueFullTimeout;
+    while (!helper_events_.TryPush(helper_id, received_at, payload)) {
+      if (std::chrono::steady_clock::now() >= deadline) {
+        helper_event_overflow_.dropped[HelperEventOverflow::kLostIndex].fetch_add(1, std::memory_order_relaxed);
+        std::cerr << "Helper event queue is full; lost a " << type << " event\n";
+        return;
+      }
+      usleep(1000);
+    }
+  }
+
+  // Runs on the service thread for each message from an active helper.
+  void CountHelperMessage(std::string_view payload) {
+    helper_metrics_.messages.Add();
+    helper_metrics_.bytes.Add(payload.size());
+    helper_metrics_.events.Add(ExtractJsonStringField(payload, "type"));
+  }
+
+  // In shared_memory mode the helpers' doorbell descriptors join every poll,
+  // so an event wakes the loop at once; the timeout drops to zero if events
+  // are already waiting. Commands still queued for a full command ring are
+  // retried here, and the loop wakes again within a millisecond while any
+  // remain. `pfds` has room for kMaxHelperShards entries.
+  nfds_t HelperPollFds(struct pollfd* pfds, int* timeout_ms) {
+    nfds_t count = 0;
+    for (HelperShard& shard : shards_) {
+      const int fd = shard.helper->event_fd();
+      if (fd < 0) {
+        continue;
+      }
+      if (shard.helper->RetryQueuedCommands()) {
+        *timeout_ms = std::min(*timeout_ms, 1);
+      }
+      if (!shard.helper->PrepareToWait()) {
+        *timeout_ms = 0;
+        if (!shard.events_seen_at) {
+          shard.events_seen_at = std::chrono::steady_clock::now();
+        }
+      }
+      pfds[count].fd = fd;
+      pfds[count].events = POLLIN;
+      ++count;
+    }
+    return count;
+  }
+
+  // Stamps the shards whose doorbell rang in a poll over HelperPollFds().
+  void NoteHelperDoorbells(const struct pollfd* pfds, nfds_t count) {
+    const auto now = std::chrono::steady_clock::now();
+    nfds_t i = 0;
+    for (HelperShard& shard : shards_) {
+      if (i < count && shard.helper->event_fd() >= 0 && pfds[i].fd == shard.helper->event_fd()) {
+        if ((pfds[i].revents & POLLIN) != 0 && !shard.events_seen_at) {
+          shard.events_seen_at = now;
+        }
+        ++i;
+      }
+    }
+  }
+
+  // Rendezvous hashing keeps a session id on the same shard for as long as
+  // the shard count stays the same. A shard already carrying more than its
+  // share of sessions and active streams, or without a running helper,
+  // passes the session on to the next choice.
+  size_t PickHelperShard(std::string_view session_id) {
+    std::vector<size_t> load(shards_.size(), 0);
+    size_t total = 1;
+    sessions_.ForEach([&](const SessionState& session) {
+      if (session.configured) {
+        const size_t weight = 1 + session.utterances.size() + session.stt_streams.size();
+        load[session.shard] += weight;
+        total += weight;
+      }
+    });
+    const size_t bound = (total + shards_.size() - 1) / shards_.size();
+
+    std::vector<size_t> order(shards_.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [session_id](size_t a, size_t b) {
+      return HelperShardScore(session_id, a) > HelperShardScore(session_id, b);
+    });
+    for (const size_t index : order) {
+      if (load[index] < bound && shards_[index].helper->IsRunning()) {
+        return index;
+      }
+    }
+    for (const size_t index : order) {
+      if (shards_[index].helper->IsRunning()) {
+        return index;
+      }
+    }
+    return order.front();
+  }
+
+  // Names the audio ring side that `uses` needs and a session on another
+  // shard is driving, or returns nullptr if there is none.
+  const char* AudioRingBusyElsewhere(const SessionState& session, uint8_t uses) {
+    uint8_t busy = 0;
+    sessions_.ForEach([&](const SessionState& other) {
+      if (other.configured && other.shard != session.shard) {
+        busy |= ActiveRingUse(other);
+      }
+    });
+    busy &= uses;
+    if ((busy & (kWritesMicFeed | kReadsMicFeed)) != 0) {
+      return "mic_feed";
+    }
+    return busy != 0 ? "speaker_tap" : nullptr;
+  }
+
+  HelperShard& ShardOf(const SessionState& session) {
+    return shards_[session.shard];
+  }
+
+  bool SendJsonToClient(std::string payload) {
+    if (active_client_fd_ < 0) {
+      return false;
+    }
+    VLOG("Client << " << payload);
+    if (!EnqueueToClient(WsOpcode::kText, std::move(payload), OutboundClass::kCritical, "")) {
+      return false;
+    }
+    return FlushClient();
+  }
+
+  bool SendFrameToClient(const FrameTemplate& frame, std::initializer_list<std::string_view> values) {
+    if (active_client_fd_ < 0 || client_close_pending_) {
+      return false;
+    }
+    std::string bytes;
+    frame.Render(values, &bytes);
+    VLOG("Client << " << bridge::WebSocketFramePayload(bytes));
+    if (client_queue_.EnqueueFrame(std::move(bytes)) == ClientSendQueue::EnqueueResult::kOverflow) {
+      DisconnectSlowClient("send queue overflow");
+      return false;
+    }
+    return FlushClient();
+  }
+
+  // Queues a frame for the active client. Returns false if the client was
+  // disconnected because a critical message no longer fits its queue.
+  bool EnqueueToClient(WsOpcode opcode,
+                       std::string payload,
+                       OutboundClass klass,
+                       std::string coalesce_key,
+                       PartialText partial = {}) {
+    if (active_client_fd_ < 0 || client_close_pending_) {
+      return false;
+    }
+    const auto result =
+        client_queue_.Enqueue(opcode, std::move(payload), klass, std::move(coalesce_key), std::move(partial));
+    if (result == ClientSendQueue::EnqueueResult::kOverflow) {
+      DisconnectSlowClient("send queue overflow");
+      return false;
+    }
+    return true;
+  }
+
+  bool FlushClient() {
+    if (active_client_fd_ < 0 || client_close_pending_) {
+      return false;
+    }
+    if (!client_queue_.Flush(active_client_fd_)) {
+      std::cerr << "Failed to send websocket data: " << std::strerror(errno) << "\n";
+      CloseActiveClient();
+      return false;
+    }
+    return true;
+  }
+
+  void DisconnectSlowClient(const char* reason) {
+    ++slow_client_disconnects_;
+    const ClientSendStats& stats = client_queue_.stats();
+    std::cerr << "Disconnecting slow websocket client (" << reason << "):"
+              << " queued_bytes=" << client_queue_.queued_bytes()
+              << " peak_queued_bytes=" << stats.peak_queued_bytes
+              << " frames_sent=" << stats.frames_sent
+              << " dropped=" << stats.dropped
+              << " coalesced=" << stats.coalesced
+              << " slow_disconnects_total=" << slow_client_disconnects_ << "\n";
+    CloseActiveClient();
+  }
+
+  // Partials for a stream supersede each other, so only the newest unsent one
+  // is kept; finals share the key so a partial never overtakes its final.
+  static OutboundClass ClassifyHelperEvent(std::string_view line, std::string* coalesce_key) {
+    const std::string type = ExtractJsonStringField(line, "type");
+    if (type == "stt_partial" || type == "stt_final") {
+      *coalesce_key = "stt:" + ExtractJsonStringField(line, "stream_id");
+      return type == "stt_partial" ? OutboundClass::kCoalesce : OutboundClass::kCritical;
+    }
+    // Heartbeat replies only say the helper is alive; any other engine_ready
+    // announces a mode switch or a standby taking over, which the client
+    // needs to see.
+    if (type == "tts_alignment" ||
+        (type == "engine_ready" && line.find("\"heartbeat\":true") != std::string_view::npos)) {
+      return OutboundClass::kDroppable;
+    }
+    return OutboundClass::kCritical;
+  }
+
+  void SendErrorToClient(std::string_view code, std::string_view message, std::string_view session_id = {}) {
+    if (session_id.empty()) {
+      (void)SendFrameToClient(frames_.error, {code, message});
+    } else {
+      (void)SendFrameToClient(frames_.session_error, {code, message, session_id});
+    }
+  }
+
+  void SendHeartbeats() {
+    static const std::string kHeartbeatLine = "{\"type\":\"heartbeat\"}";
+    std::string error;
+    for (HelperShard& shard : shards_) {
+      (void)shard.helper->SendMessage(kHeartbeatLine, &error);
+    }
+  }
+
+  // Applies `session`'s routing in the helper. The helper acknowledges every
+  // session_config; only acknowledgements the client asked for reach it.
+  void SendSessionConfigToHelper(const SessionState& session, bool announce) {
+    std::string line;
+    JsonWriter(&line)
+        .BeginObject()
+        .Field("type", "session_config")
+        .Field("mode", session.routing.mode)
+        .Field("stt_source", session.routing.stt_source)
+        .Field("tts_target", session.routing.tts_target)
+        .EndObject();
+
+    HelperShard& shard = ShardOf(session);
+    std::string error;
+    if (!shard.helper->SendMessage(line, &error)) {
+      std::cerr << "Failed to send session config to helper: " << error << "\n";
+      return;
+    }
+    shard.pending_config_acks.push_back({session.tag, announce});
+    shard.routing = session.routing;
+    shard.routing_tag = session.tag;
+    shard.routing_valid = true;
+  }
+
+  // Sessions with different routing on the same shard take turns on its
+  // helper engine: switching is deferred until a session actually sends it
+  // a command.
+  void EnsureHelperRouting(const SessionState& session) {
+    const HelperShard& shard = ShardOf(session);
+    if (!shard.routing_valid || shard.routing != session.routing) {
+      VLOG("Switching helper shard " << shard.index << " routing to session tag " << session.tag);
+      SendSessionConfigToHelper(session, false);
+    }
+  }
+
+  void AcceptPrimaryClient() {
+    struct pollfd pfds[2 + kMaxHelperShards] {};
+    const nfds_t listeners = ListenerPollFds(pfds);
+    int timeout_ms = 200;
+    const nfds_t count = listeners + HelperPollFds(&pfds[listeners], &timeout_ms);
+    if (poll(pfds, count, timeout_ms) <= 0) {
+      return;
+    }
+    NoteHelperDoorbells(&pfds[listeners], count - listeners);
+    int listener = -1;
+    for (nfds_t i = 0; i < listeners && listener < 0; ++i) {
+      if ((pfds[i].revents & POLLIN) != 0) {
+        listener = pfds[i].fd;
+      }
+    }
+    if (listener < 0) {
+      return;
+    }
+
+    int fd = accept(listener, nullptr, nullptr);
+    if (fd < 0) {
+      return;
+    }
+
+    std::string handshake_error;
+    HttpRequest request;
+    DeflateParams deflate_params;
+    if (!ReadHttpRequest(fd, &request, &handshake_error)) {
+      RejectHttpConnection(fd, 400, "invalid websocket handshake");
+      return;
+    }
+    if (ServeObservabilityRequest(fd, request)) {
+      return;
+    }
+    if (!PerformWebSocketHandshake(fd, request, config_.permessage_deflate, &deflate_params, &handshake_error)) {
+      RejectHttpConnection(fd, 400, "invalid websocket handshake");
+      return;
+    }
+
+    if (!SetNonBlocking(fd)) {
+      std::cerr << "Failed to make websocket client non-blocking\n";
+      close(fd);
+      return;
+    }
+    if (listener == listen_fd_) {
+      // Protocol messages are small and latency-bound; never let Nagle hold
+      // them back waiting for an ACK.
+      const int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    VLOG("Client connected, fd=" << fd << (listener == listen_fd_ ? " (tcp)" : " (unix)"));
+    (listener == listen_fd_ ? metrics_.tcp_connections : metrics_.unix_connections).Add();
+    active_client_fd_ = fd;
+    client_queue_.Reset();
+    client_reader_.Reset();
+    if (deflate_params.enabled && client_deflate_.Init(deflate_params)) {
+      client_reader_.set_allow_compressed(true);
+      client_queue_.SetCompressor(&client_deflate_, config_.permessage_deflate.min_compress_bytes);
+    }
+    inbound_mode_ = InboundMode::kIdle;
+    client_close_requested_ = false;
+
+    const std::string_view token = QueryParameter(request.target, "resume_token");
+    const bool resumed = parked_ && !token.empty() && token == resume_token_;
+    if (resumed) {
+      VLOG("Client resumed parked sessions; replaying " << parked_messages_.size() << " messages");
+      metrics_.resumed_connections.Add();
+      parked_ = false;
+    } else if (parked_) {
+      DiscardParkedSessions("a client connected without the resume token");
+    }
+    resume_token_ = NewResumeToken();
+
+    (void)SendFrameToClient(resumed ? frames_.ready_resumed : frames_.ready, {resume_token_});
+
+    std::deque<OutboundMessage> replay;
+    replay.swap(parked_messages_);
+    parked_bytes_ = 0;
+    for (OutboundMessage& msg : replay) {
+      if (!EnqueueToClient(msg.opcode, std::move(msg.payload), msg.klass, std::move(msg.coalesce_key))) {
+        return;
+      }
+    }
+
+    if (!request.extra_bytes.empty()) {
+      FeedClientBytes(reinterpret_cast<uint8_t*>(request.extra_bytes.data()), request.extra_bytes.size());
+    }
+  }
+
+  // Another connection while a client is active: only a metrics or health
+  // request can be served, and it is read without holding up the client.
+  void AcceptSecondaryConnection(int listener) {
+    int fd = accept(listener, nullptr, nullptr);
+    if (fd < 0) {
+      return;
+    }
+    if (http_pending_.size() >= kMaxPendingHttpConnections) {
+      metrics_.rejected_connections.Add();
+      RejectHttpConnection(fd, 409, "single active websocket client supported");
+      return;
+    }
+    http_pending_.push_back({fd, {}, std::chrono::steady_clock::now() + std::chrono::seconds(5)});
+  }
+
+  void PumpPendingHttp() {
+    if (http_pending_.empty()) {
+      return;
+    }
+    struct pollfd pfds[kMaxPendingHttpConnections] {};
+    for (size_t i = 0; i < http_pending_.size(); ++i) {
+      pfds[i].fd = http_pending_[i].fd;
+      pfds[i].events = POLLIN;
+    }
+    (void)poll(pfds, static_cast<nfds_t>(http_pending_.size()), 0);
+
+    const auto now = std::chrono::steady_clock::now();
+    size_t kept = 0;
+    for (size_t i = 0; i < http_pending_.size(); ++i) {
+      PendingHttpConnection& pending = http_pending_[i];
+      bool done = now >= pending.deadline;
+      if (!done && (pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0) {
+        char buf[1024];
+        const ssize_t rc = recv(pending.fd, buf, sizeof(buf), 0);
+        if (rc > 0) {
+          pending.request.append(buf, static_cast<size_t>(rc));
+        }
+        done = rc <= 0 || pending.request.size() > kMaxHttpRequestBytes;
+        HttpRequest request;
+        if (!done && pending.request.find("\r\n\r\n") != std::string::npos) {
+          if (!ParseHttpRequest(pending.request, &request, nullptr) ||
+              !ServeObservabilityRequest(pending.fd, request)) {
+            metrics_.rejected_connections.Add();
+            RejectHttpConnection(pending.fd, 409, "single active websocket client supported");
+          }
+          pending.fd = -1;
+          done = true;
+        }
+      }
+      if (done) {
+        CloseFd(&pending.fd);
+      } else {
+        http_pending_[kept++] = std::move(pending);
+      }
+    }
+    http_pending_.resize(kept);
+  }
+
+  // Answers GET /metrics and GET /healthz and closes `fd`. Returns false,
+  // leaving `fd` alone, for any other request.
+  bool ServeObservabilityRequest(int fd, const HttpRequest& request) {
+    const std::string_view target = request.target;
+    const std::string_view path = target.substr(0, target.find('?'));
+    if (request.method != "GET" || (path != "/metrics" && path != "/healthz")) {
+      return false;
+    }
+    // A scraper that stops reading must not stall the service thread.
+    struct timeval timeout {};
+    timeout.tv_sec = 1;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    if (path == "/metrics") {
+      std::string body;
+      AppendMetrics(&body);
+      SendHttpResponse(fd, "200 OK", "text/plain; version=0.0.4", body);
+      return true;
+    }
+
+    const bool helpers_running = std::all_of(shards_.begin(), shards_.end(), [](const HelperShard& shard) {
+      return shard.helper->IsRunning();
+    });
+    double heartbeat_age = 0.0;
+    for (const HelperShard& shard : shards_) {
+      heartbeat_age = std::max(heartbeat_age, HelperHeartbeatAgeSeconds(shard));
+    }
+    if (!helpers_running) {
+      SendHttpResponse(fd, "503 Service Unavailable", "text/plain", "helper not running\n");
+    } else if (heartbeat_age > 30.0) {
+      SendHttpResponse(fd, "503 Service Unavailable", "text/plain", "helper heartbeat overdue\n");
+    } else {
+      SendHttpResponse(fd, "200 OK", "text/plain", "ok\n");
+    }
+    return true;
+  }
+
+  // Seconds since the helper last wrote a line, or since it was started if
+  // it has not written one yet.
+  double HelperHeartbeatAgeSeconds(const HelperShard& shard) const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - shard.last_activity).count();
+  }
+
+  void AppendMetrics(std::string* out) {
+    bridge::PrometheusWriter metrics(out);
+    metrics.Family("bridge_client_connections_total", "counter", "WebSocket clients accepted")
+        .Sample("bridge_client_connections_total", "transport=\"tcp\"", metrics_.tcp_connections.value())
+        .Sample("bridge_client_connections_total", "transport=\"unix\"", metrics_.unix_connections.value());
+    metrics.Family("bridge_client_resumes_total", "counter", "Clients that resumed parked sessions")
+        .Sample("bridge_client_resumes_total", {}, metrics_.resumed_connections.value());
+    metrics.Family("bridge_client_rejected_total", "counter", "Connections turned away while a client was active")
+        .Sample("bridge_client_rejected_total", {}, metrics_.rejected_connections.value());
+    metrics.Family("bridge_client_slow_disconnects_total", "counter", "Clients disconnected for not reading")
+        .Sample("bridge_client_slow_disconnects_total", {}, slow_client_disconnects_);
+    metrics.Family("bridge_client_connected", "gauge", "Whether a WebSocket client is connected")
+        .Sample("bridge_client_connected", {}, active_client_fd_ >= 0 ? 1 : 0);
+    uint64_t sessions = 0;
+    sessions_.ForEach([&sessions](const SessionState& session) { sessions += session.configured ? 1 : 0; });
+    metrics.Family("bridge_sessions", "gauge", "Configured sessions, including parked ones")
+        .Sample("bridge_sessions", {}, sessions);
+    metrics.Family("bridge_sessions_parked", "gauge", "Whether a dropped client's sessions await resumption")
+        .Sample("bridge_sessions_parked", {}, parked_ ? 1 : 0);
+
+    metrics.Types("bridge_client_messages_total", "Messages received from clients by type",
+                  metrics_.client_messages);
+    metrics.Types("bridge_helper_events_total", "Events received from the engine helper by type",
+                  helper_metrics_.events);
+
+    const ClientSendStats& current = client_queue_.stats();
+    const ClientSendStats& finished = metrics_.finished_clients;
+    metrics.Family("bridge_client_frames_sent_total", "counter", "Frames written to clients")
+        .Sample("bridge_client_frames_sent_total", {}, finished.frames_sent + current.frames_sent);
+    metrics.Family("bridge_client_bytes_sent_total", "counter", "Bytes written to clients")
+        .Sample("bridge_client_bytes_sent_total", {}, finished.bytes_sent + current.bytes_sent);
+    metrics.Family("bridge_client_messages_coalesced_total", "counter", "Queued stt_partial events replaced")
+        .Sample("bridge_client_messages_coalesced_total", {}, finished.coalesced + current.coalesced);
+    metrics.Family("bridge_client_messages_dropped_total", "counter", "Outbound messages dropped for a full queue")
+        .Sample("bridge_client_messages_dropped_total", {}, finished.dropped + current.dropped);
+    metrics.Family("bridge_client_send_queue_bytes", "gauge", "Bytes queued for the client")
+        .Sample("bridge_client_send_queue_bytes", {}, client_queue_.queued_bytes());
+    metrics.Histogram("bridge_helper_event_relay_seconds",
+                      "Time from receiving a helper event to queueing it for the client",
+                      metrics_.helper_event_relay);
+    metrics.Family("bridge_helper_event_queue_depth", "gauge", "Helper events waiting for the service thread")
+        .Sample("bridge_helper_event_queue_depth", {}, helper_events_.size());
+    metrics.Family("bridge_helper_event_queue_waits_total", "counter",
+                   "Helper events that waited for room in a full event queue")
+        .Sample("bridge_helper_event_queue_waits_total", {},
+                helper_event_overflow_.waits.load(std::memory_order_relaxed));
+    metrics.Family("bridge_helper_events_dropped_total", "counter", "Helper events a full event queue turned away");
+    for (size_t i = 0; i <= HelperEventOverflow::kLostIndex; ++i) {
+      const std::string_view type =
+          i < HelperEventOverflow::kLostIndex ? HelperEventOverflow::kDroppableTypes[i] : "other";
+      metrics.Sample("bridge_helper_events_dropped_total", "type=\"" + std::string(type) + "\"",
+                     helper_event_overflow_.dropped[i].load(std::memory_order_relaxed));
+    }
+
+    std::vector<std::string> shard_labels;
+    std::vector<uint64_t> shard_sessions(shards_.size(), 0);
+    for (const HelperShard& shard : shards_) {
+      shard_labels.push_back("shard=\"" + std::to_string(shard.index) + "\"");
+    }
+    sessions_.ForEach([&shard_sessions](const SessionState& session) {
+      shard_sessions[session.shard] += session.configured ? 1 : 0;
+    });
+    metrics.Family("bridge_helper_up", "gauge", "Whether the shard's engine helper process is running");
+    for (const HelperShard& shard : shards_) {
+      metrics.Sample("bridge_helper_up", shard_labels[shard.index], shard.helper->IsRunning() ? 1 : 0);
+    }
+    metrics.Family("bridge_helper_sessions", "gauge", "Configured sessions served by the shard");
+    for (const HelperShard& shard : shards_) {
+      metrics.Sample("bridge_helper_sessions", shard_labels[shard.index], shard_sessions[shard.index]);
+    }
+    metrics.Family("bridge_helper_restarts_total", "counter", "Engine helper replacements")
+        .Sample("bridge_helper_restarts_total", {}, metrics_.helper_restarts.value());
+    metrics.Family("bridge_helper_failovers_total", "counter", "Engine helpers replaced by a warm standby")
+        .Sample("bridge_helper_failovers_total", {}, metrics_.helper_failovers.value());
+    uint64_t standbys = 0;
+    for (const std::unique_ptr<HelperProcess>& standby : standby_helpers_) {
+      standbys += standby->IsRunning() ? 1 : 0;
+    }
+    metrics.Family("bridge_helper_standby", "gauge", "Warm standby helpers ready to take over")
+        .Sample("bridge_helper_standby", {}, standbys);
+    metrics.Histogram("bridge_helper_recovery_seconds",
+                      "Time from losing the helper to its replacement reporting engine_ready",
+                      metrics_.helper_recovery);
+    metrics.Family("bridge_helper_messages_total", "counter", "Messages read from the engine helper")
+        .Sample("bridge_helper_messages_total", {}, helper_metrics_.messages.value());
+    metrics.Family("bridge_helper_bytes_total", "counter", "Bytes read from the engine helper")
+        .Sample("bridge_helper_bytes_total", {}, helper_metrics_.bytes.value());
+    metrics.Family("bridge_helper_heartbeat_age_seconds", "gauge",
+                   "Seconds since the shard's helper last wrote a line");
+    for (const HelperShard& shard : shards_) {
+      metrics.Sample("bridge_helper_heartbeat_age_seconds", shard_labels[shard.index],
+                     HelperHeartbeatAgeSeconds(shard));
+    }
+
+    // The rings are opened for the scrape only, as the service keeps them
+    // open just while a client uses PCM.
+    struct RingLevel {
+      const char* label;
+      uint32_t fill;
+      uint32_t capacity;
+    };
+    std::vector<RingLevel> rings;
+    for (const char* name : {kMicFeedName, kSpeakerTapName}) {
+      bridge::SharedMemoryAudioRing ring;
+      if (OpenPcmRing(&ring, name)) {
+        rings.push_back({name == kMicFeedName ? "ring=\"mic_feed\"" : "ring=\"speaker_tap\"",
+                         ring.available_frames(), ring.capacity_frames()});
+      }
+    }
+    metrics.Family("bridge_ring_fill_frames", "gauge", "Frames written to a ring and not yet consumed");
+    for (const RingLevel& ring : rings) {
+      metrics.Sample("bridge_ring_fill_frames", ring.label, ring.fill);
+    }
+    metrics.Family("bridge_ring_capacity_frames", "gauge", "Ring size in frames");
+    for (const RingLevel& ring : rings) {
+      metrics.Sample("bridge_ring_capacity_frames", ring.label, ring.capacity);
+    }
+    metrics.Family("bridge_ring_overrun_frames_total", "counter", "Frames the bridge lost to a full or overtaken ring")
+        .Sample("bridge_ring_overrun_frames_total", "ring=\"mic_feed\"",
+                audio_pacer_.ring_stats(bridge::kPaceMicFeed).frames_dropped.value())
+        .Sample("bridge_ring_overrun_frames_total", "ring=\"speaker_tap\"",
+                metrics_.speaker_tap_frames_skipped.value() +
+                    audio_pacer_.ring_stats(bridge::kPaceSpeakerTap).frames_dropped.value());
+
+    constexpr std::pair<bridge::AudioPacerTarget, const char*> kPacedRings[] = {
+        {bridge::kPaceMicFeed, "ring=\"mic_feed\""}, {bridge::kPaceSpeakerTap, "ring=\"speaker_tap\""}};
+    metrics.Family("bridge_pacer_frames_written_total", "counter", "Frames the audio pacer wrote into a ring");
+    for (const auto& [target, label] : kPacedRings) {
+      metrics.Sample("bridge_pacer_frames_written_total", label,
+                     audio_pacer_.ring_stats(target).frames_written.value());
+    }
+    metrics.Family("bridge_pacer_underruns_total", "counter",
+                   "Times a ring ran dry while the audio pacer still had audio for it");
+    for (const auto& [target, label] : kPacedRings) {
+      metrics.Sample("bridge_pacer_underruns_total", label, audio_pacer_.ring_stats(target).underruns.value());
+    }
+    metrics.Family("bridge_pacer_frames_expired_total", "counter",
+                   "Queued frames the audio pacer dropped because their ring would not open");
+    for (const auto& [target, label] : kPacedRings) {
+      metrics.Sample("bridge_pacer_frames_expired_total", label,
+                     audio_pacer_.ring_stats(target).frames_expired.value());
+    }
+    metrics.Family("bridge_pacer_queued_frames", "gauge", "Frames waiting in the audio pacer")
+        .Sample("bridge_pacer_queued_frames", {}, audio_pacer_.queued_frames());
+    metrics.Family("bridge_pacer_frames_discarded_total", "counter", "Queued frames dropped by cancels")
+        .Sample("bridge_pacer_frames_discarded_total", {}, audio_pacer_.frames_discarded());
+    metrics.Histogram("bridge_pacer_wake_late_seconds", "How late the audio pacer woke for its ticks",
+                      audio_pacer_.wake_lateness());
+  }
+
+  // A client that goes away without a close frame while it has configured
+  // sessions is parked: its sessions and helper work stay as they are for
+  // websocket.resume_grace_ms, and reconnecting with its resume token picks
+  // them up without another configure_session or engine warm-up.
+  void CloseActiveClient() {
+    if (dispatching_client_) {
+      client_close_pending_ = true;
+      return;
+    }
+    client_close_pending_ = false;
+    FlushTtsBatch();
+    const bool park = active_client_fd_ >= 0 && !client_close_requested_ && config_.resume_grace_ms > 0 &&
+                      sessions_.Any([](const SessionState& session) { return session.configured; });
+    if (active_client_fd_ >= 0) {
+      const ClientSendStats& stats = client_queue_.stats();
+      metrics_.finished_clients.frames_sent += stats.frames_sent;
+      metrics_.finished_clients.bytes_sent += stats.bytes_sent;
+      metrics_.finished_clients.coalesced += stats.coalesced;
+      metrics_.finished_clients.dropped += stats.dropped;
+      VLOG("Closing client fd=" << active_client_fd_
+           << " frames_sent=" << client_queue_.stats().frames_sent
+           << " dropped=" << client_queue_.stats().dropped
+           << " coalesced=" << client_queue_.stats().coalesced);
+      // Best effort: deliver what the socket accepts without blocking, and
+      // only append a close frame if no message is left half-written.
+      (void)client_queue_.Flush(active_client_fd_);
+      if (client_queue_.empty()) {
+        std::string ignored;
+        (void)SendWebSocketFrame(active_client_fd_, WsOpcode::kClose, "", &ignored);
+      }
+      close(active_client_fd_);
+      active_client_fd_ = -1;
+    }
+    if (park) {
+      client_queue_.TakeUnsent(&parked_messages_);
+      parked_bytes_ = 0;
+      for (const OutboundMessage& msg : parked_messages_) {
+        parked_bytes_ += msg.payload.size();
+      }
+    }
+    client_queue_.Reset();
+    client_reader_.Reset();
+    client_reader_.set_allow_compressed(false);
+    client_deflate_.Close();
+    inbound_mode_ = InboundMode::kIdle;
+    inbound_message_.clear();
+    inbound_message_.shrink_to_fit();
+    tts_stream_text_.clear();
+    pcm_reader_.Reset();
+    pcm_tap_subscribed_ = false;
+    pcm_mic_feed_.Close();
+    pcm_speaker_tap_.Close();
+    if (park) {
+      parked_ = true;
+      parked_deadline_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(config_.resume_grace_ms);
+      VLOG("Parked client sessions for " << config_.resume_grace_ms << " ms");
+    } else {
+      sessions_.Reset(config_.session_defaults);
+      ResetHelperLastTags();
+      resume_token_.clear();
+    }
+  }
+
+  // Gives up on a parked client: its helper work is cancelled and the
+  // sessions are forgotten.
+  void DiscardParkedSessions(const char* reason) {
+    VLOG("Discarding parked sessions: " << reason);
+    sessions_.ForEach([this](SessionState& session) { CancelSessionWork(session); });
+    sessions_.Reset(config_.session_defaults);
+    ResetHelperLastTags();
+    resume_token_.clear();
+    parked_ = false;
+    parked_messages_.clear();
+    parked_bytes_ = 0;
+  }
+
+  void ResetHelperLastTags() {
+    for (HelperShard& shard : shards_) {
+      shard.last_tag = 0;
+    }
+  }
+
+  // Holds events for a parked client, newest partial per stream only.
+  // Returns false once they no longer fit the send queue budget.
+  bool ParkHelperEvent(std::string line, OutboundClass klass, std::string coalesce_key) {
+    if (klass == OutboundClass::kDroppable) {
+      return true;
+    }
+    if (klass == OutboundClass::kCoalesce) {
+      for (auto it = parked_messages_.rbegin(); it != parked_messages_.rend(); ++it) {
+        if (it->coalesce_key != coalesce_key) {
+          continue;
+        }
+        if (it->klass == OutboundClass::kCoalesce) {
+          parked_bytes_ = parked_bytes_ - it->payload.size() + line.size();
+          it->payload = std::move(line);
+          return true;
+        }
+        break;
+      }
+    }
+    parked_bytes_ += line.size();
+    if (parked_bytes_ > static_cast<size_t>(config_.send_queue_max_bytes)) {
+      return false;
+    }
+    OutboundMessage& msg = parked_messages_.emplace_back();
+    msg.klass = klass;
+    msg.coalesce_key = std::move(coalesce_key);
+    msg.payload = std::move(line);
+    return true;
+  }
+
+  HelperShard* ShardOfHelper(uint64_t helper_id) {
+    for (HelperShard& shard : shards_) {
+      if (shard.helper->id() == helper_id) {
+        return &shard;
+      }
+    }
+    return nullptr;
+  }
+
+  void FlushHelperEvents() {
+    bool relayed = false;
+    if (config_.helper_ipc == bridge::HelperIpcMode::kSharedMemory) {
+      // Events that came in without a doorbell or a wait, while this thread
+      // was busy elsewhere, count from now.
+      const auto now = std::chrono::steady_clock::now();
+      for (HelperShard& shard : shards_) {
+        const uint64_t id = shard.helper->id();
+        const auto seen_at = std::exchange(shard.events_seen_at, std::nullopt).value_or(now);
+        shard.helper->DrainEvents([&](std::string_view payload, std::string_view attachment) {
+          if (!SubmitHelperAudio(id, payload, attachment)) {
+            relayed = RelayHelperEvent(id, seen_at, payload) || relayed;
+          }
+        });
+      }
+    } else {
+      // Events pushed meanwhile wait for the next pass.
+      bridge::HelperEventQueue::Event event;
+      for (size_t n = helper_events_.capacity(); n > 0 && helper_events_.Peek(&event); --n) {
+        relayed = RelayHelperEvent(event.helper_id, event.received_at, event.payload) || relayed;
+        helper_events_.Pop();
+      }
+    }
+    if (relayed) {
+      (void)FlushClient();
+    }
+  }
+
+  // Hands one event to the client, or parks it. Only the line queued for
+  // the client is allocated. Returns true if something was queued.
+  bool RelayHelperEvent(uint64_t helper_id, std::chrono::steady_clock::time_point received_at,
+                        std::string_view payload) {
+    // Standbys, and helpers already replaced, never speak to sessions.
+    HelperShard* shard = ShardOfHelper(helper_id);
+    if (shard == nullptr) {
+      return false;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    CountHelperMessage(payload);
+    shard->last_activity = now;
+    if (shard->recovering_since && ExtractJsonStringField(payload, "type") == "engine_ready") {
+      metrics_.helper_recovery.Observe(std::chrono::duration<double>(received_at - *shard->recovering_since).count());
+      shard->recovering_since.reset();
+    }
+    metrics_.helper_event_relay.Observe(std::chrono::duration<double>(now - received_at).count());
+
+    std::string line;
+    std::string coalesce_key;
+    const OutboundClass klass = ClassifyHelperEvent(payload, &coalesce_key);
+    const SessionState* session = nullptr;
+    if (!RouteHelperEvent(*shard, payload, &line, &session)) {
+      return false;
+    }
+    if (active_client_fd_ < 0) {
+      // Routing still ran so session_config acknowledgements stay matched
+      // with their requests.
+      if (parked_ && !ParkHelperEvent(std::move(line), klass, std::move(coalesce_key))) {
+        DiscardParkedSessions("too many events while disconnected");
+      }
+      return false;
+    }
+    if (klass == OutboundClass::kDroppable && session != nullptr && session->binary_alignment &&
+        EncodeAlignmentForClient(&line, *session)) {
+      return EnqueueToClient(WsOpcode::kBinary, std::move(line), klass, std::move(coalesce_key));
+    }
+    PartialText partial;
+    if (klass == OutboundClass::kCoalesce && session != nullptr && session->delta_partials) {
+      SplitPartialText(line, &partial);
+    }
+    return EnqueueToClient(WsOpcode::kText, std::move(line), klass, std::move(coalesce_key), std::move(partial));
+  }
+
+  // Maps a helper event back to its session: by utterance or stream id where
+  // the event has one, otherwise to the session of the command that caused
+  // it on `shard`. Events for the default session are forwarded untouched;
+  // the others get their client ids restored and a session_id. Returns false
+  // if the event must not reach the client; otherwise `line` receives it.
+  bool RouteHelperEvent(HelperShard& shard, std::string_view event_line, std::string* line,
+                        const SessionState** routed_to = nullptr) {
+    const std::string type = ExtractJsonStringField(event_line, "type");
+    if (type == "engine_ready") {
+      line->assign(event_line);
+      return true;
+    }
+
+    uint32_t tag = shard.last_tag;
+    std::string_view id_key;
+    if (type == "session_config_applied") {
+      if (shard.pending_config_acks.empty()) {
+        line->assign(event_line);
+        return true;
+      }
+      const HelperShard::ConfigAck ack = shard.pending_config_acks.front();
+      shard.pending_config_acks.pop_front();
+      if (!ack.announce) {
+        return false;
+      }
+      tag = ack.tag;
+    } else if (type == "tts_status" || type == "tts_alignment") {
+      id_key = "utterance_id";
+    } else if (type == "stt_partial" || type == "stt_final") {
+      id_key = "stream_id";
+    }
+
+    std::string scoped_id;
+    std::string_view client_id;
+    if (!id_key.empty()) {
+      scoped_id = ExtractJsonStringField(event_line, id_key);
+      tag = SplitHelperScopedId(scoped_id, &client_id);
+    }
+    bool utterance_done = false;
+    if (type == "tts_status") {
+      const std::string status = ExtractJsonStringField(event_line, "status");
+      utterance_done = status == "completed" || status == "error";
+    }
+    if (utterance_done) {
+      // The helper sends no audio for the utterance after this, so a cancel
+      // has caught all of it.
+      audio_pacer_.Release(scoped_id);
+    }
+    SessionState* session = sessions_.FindByTag(tag);
+    if (session == nullptr) {
+      VLOG("Dropping helper event for ended session: type=" << type);
+      return false;
+    }
+    if (routed_to != nullptr) {
+      *routed_to = session;
+    }
+    if (utterance_done) {
+      std::erase(session->utterances, client_id);
+    }
+    if (tag == 0 && client_id.size() == scoped_id.size()) {
+      line->assign(event_line);
+      return true;
+    }
+
+    std::string json_error;
+    const JsonValue* event = helper_event_reader_.Parse(event_line, &json_error);
+    if (event == nullptr || !event->is_object()) {
+      line->assign(event_line);
+      return true;
+    }
+    line->clear();
+    line->reserve(event_line.size() + session->id.size() + 16);
+    JsonWriter json(line);
+    json.BeginObject();
+    for (size_t i = 0; i < event->count; ++i) {
+      const bridge::JsonMember& member = event->members[i];
+      if (!id_key.empty() && member.key == id_key && member.value.type == bridge::JsonType::kString) {
+        json.Field(member.key, client_id);
+      } else {
+        json.Key(member.key).Value(member.value);
+      }
+    }
+    if (!session->id.empty()) {
+      json.Field("session_id", session->id);
+    }
+    json.EndObject();
+    return true;
+  }
+
+  // Separates a routed stt_partial into its text and the rest of the event,
+  // ready for ClientSendQueue to send as a delta.
+  void SplitPartialText(const std::string& line, PartialText* out) {
+    std::string json_error;
+    const JsonValue* event = helper_event_reader_.Parse(line, &json_error);
+    const JsonValue* text = event != nullptr ? event->Find("text") : nullptr;
+    if (text == nullptr || text->type != bridge::JsonType::kString) {
+      return;
+    }
+    JsonWriter json(&out->prefix);
+    json.BeginObject();
+    for (size_t i = 0; i < event->count; ++i) {
+      if (event->members[i].key != "text") {
+        json.Key(event->members[i].key).Value(event->members[i].value);
+      }
+    }
+    out->text = text->text;
+  }
+
+  // Replaces a routed tts_alignment event with its AlignmentBlock. Returns
+  // false, leaving the line alone, for other events or if it does not parse.
+  bool EncodeAlignmentForClient(std::string* line, const SessionState& session) {
+    std::string json_error;
+    const JsonValue* event = helper_event_reader_.Parse(*line, &json_error);
+    if (event == nullptr || event->StringField("type") != "tts_alignment") {
+      return false;
+    }
+    std::string block;
+    if (!EncodeAlignmentBlock(*event, session.id, &block, &json_error)) {
+      VLOG("Sending tts_alignment as JSON: " << json_error);
+      return false;
+    }
+    // The tree points into *line, so it is replaced only once it is done with.
+    *line = std::move(block);
+    return true;
+  }
+
+  // Takes the text of a tts_chunk or tts_chunks message into the batch.
+  // Returns false for a tts_chunk without utterance_id or text, which is
+  // forwarded as it is so the helper reports it.
+  bool BatchTtsText(const JsonValue& obj, std::string_view type, const SessionState& session) {
+    const std::string_view utterance_id = obj.StringField("utterance_id").value_or("");
+    if (type == "tts_chunk") {
+      const auto text = obj.StringField("text");
+      if (utterance_id.empty() || !text) {
+        return false;
+      }
+      AppendTtsBatch(session, utterance_id, *text);
+      return true;
+    }
+
+    const JsonValue* texts = obj.Find("texts");
+    bool valid = !utterance_id.empty() && texts != nullptr && texts->type == bridge::JsonType::kArray;
+    for (size_t i = 0; valid && i < texts->count; ++i) {
+      valid = texts->items[i].type == bridge::JsonType::kString;
+    }
+    if (!valid) {
+      SendErrorToClient("invalid_tts_chunks", "tts_chunks requires utterance_id and a texts array of strings",
+                        session.id);
+      return true;
+    }
+    for (size_t i = 0; i < texts->count; ++i) {
+      AppendTtsBatch(session, utterance_id, texts->items[i].text);
+    }
+    return true;
+  }
+
+  // Consecutive chunks for one utterance are joined and forwarded as a
+  // single tts_chunk once websocket.tts_chunk_batch_ms has passed (with 0,
+  // after the client read they arrived in), when the batch grows large, or
+  // when any other command arrives.
+  void AppendTtsBatch(const SessionState& session, std::string_view utterance_id, std::string_view text) {
+    std::string helper_id = HelperScopedId(session.tag, utterance_id);
+    if (tts_batch_.pieces > 0 &&
+        (tts_batch_.session_tag != session.tag || tts_batch_.utterance_id != helper_id)) {
+      FlushTtsBatch();
+    }
+    if (tts_batch_.pieces == 0) {
+      tts_batch_.session_tag = session.tag;
+      tts_batch_.utterance_id = std::move(helper_id);
+      tts_batch_.deadline =
+          std::chrono::steady_clock::now() + std::chrono::milliseconds(config_.tts_chunk_batch_ms);
+    }
+    tts_batch_.text.append(text);
+    ++tts_batch_.pieces;
+    if (tts_batch_.text.size() >= kTtsStreamPieceBytes) {
+      FlushTtsBatch();
+    }
+  }
+
+  void FlushTtsBatch() {
+    if (tts_batch_.pieces == 0) {
+      return;
+    }
+    if (const SessionState* session = sessions_.FindByTag(tts_batch_.session_tag)) {
+      VLOG("Forwarding tts_chunk batch: pieces=" << tts_batch_.pieces << " bytes=" << tts_batch_.text.size());
+      ForwardTtsChunk(*session, tts_batch_.utterance_id, tts_batch_.text);
+    }
+    tts_batch_.text.clear();
+    tts_batch_.pieces = 0;
+  }
+
+  void FlushDueTtsBatch() {
+    if (tts_batch_.pieces > 0 &&
+        (config_.tts_chunk_batch_ms == 0 || std::chrono::steady_clock::now() >= tts_batch_.deadline)) {
+      FlushTtsBatch();
+    }
+  }
+
+  void ForwardTtsChunk(const SessionState& session, std::string_view helper_utterance_id, std::string_view text) {
+    EnsureHelperRouting(session);
+    ShardOf(session).last_tag = session.tag;
+    std::string chunk;
+    chunk.reserve(text.size() + helper_utterance_id.size() + 64);
+    JsonWriter(&chunk)
+        .BeginObject()
+        .Field("type", "tts_chunk")
+        .Field("utterance_id", helper_utterance_id)
+        .Field("text", text)
+        .EndObject();
+    (void)ForwardJsonToHelper(session, chunk);
+  }
+
+  // Control commands must carry "after" (see HelperFrame.h).
+  bool ForwardJsonToHelper(const SessionState& session, const std::string& line, bool control = false) {
+    HelperProcess& helper = *ShardOf(session).helper;
+    std::string error;
+    if (!(control ? helper.SendControl(line, &error) : helper.SendMessage(line, &error))) {
+      if (helper.IsRunning()) {
+        SendErrorToClient("helper_busy", error);
+      } else {
+        SendErrorToClient("helper_unavailable", "engine helper is unavailable");
+      }
+      return false;
+    }
+    return true;
+  }
+
+  // `text_payload` is inbound_message_, which the parsed tree points into.
+  // It stays intact until this returns because client closes wait for the
+  // reader (see dispatching_client_), and nothing here appends to it.
+  void HandleClientMessage(const std::string& text_payload) {
+    VLOG("Client >> " << text_payload);
+    std::string json_error;
+    const JsonValue* obj = json_reader_.Parse(text_payload, &json_error);
+    if (obj == nullptr || !obj->is_object()) {
+      VLOG("Rejected client message: " << (obj == nullptr ? json_error : "not an object"));
+      SendErrorToClient("invalid_json", "message is not valid JSON object");
+      return;
+    }
+
+    auto type_opt = obj->StringField("type");
+    if (!type_opt) {
+      SendErrorToClient("invalid_message", "message missing type field");
+      return;
+    }
+
+    const std::string_view type = *type_opt;
+    const std::string_view session_id = obj->StringField("session_id").value_or("");
+    metrics_.client_messages.Add(type);
+
+    if (type == "ping") {
+      (void)SendFrameToClient(frames_.pong, {obj->StringField("id").value_or("")});
+      return;
+    }
+
+    if (type == "pcm_subscribe" || type == "pcm_unsubscribe") {
+      HandlePcmSubscription(*obj, type == "pcm_subscribe");
+      return;
+    }
+
+    // Batched chunk text must reach the helper before any later command,
+    // unless the command cancels its utterance.
+    if (type != "tts_chunk" && type != "tts_chunks" && type != "tts_cancel") {
+      FlushTtsBatch();
+      if (client_close_pending_) {
+        return;
+      }
+    }
+
+    if (type == "configure_session") {
+      ConfigureSession(*obj, session_id);
+      return;
+    }
+
+    if (type == "end_session") {
+      EndSession(session_id);
+      return;
+    }
+
+    SessionState* session = sessions_.FindById(session_id);
+    if (session == nullptr) {
+      SendErrorToClient("unknown_session", "configure_session must be sent for this session_id first", session_id);
+      return;
+    }
+    if (!session->configured) {
+      SendErrorToClient("session_not_configured", "configure_session must be sent before TTS/STT commands",
+                        session_id);
+      return;
     }
 
-    if (listen(listen_fd_, 8) != 0) {
-      std::cerr << "Failed to listen on websocket socket\n";
-      return 1;
+    static const std::vector<std::string_view> allowed_forward_types = {
+        "enable", "disable",
+        "tts_start", "tts_chunk", "tts_chunks", "tts_flush", "tts_cancel", "start_stt", "stop_stt"};
+
+    if (std::find(allowed_forward_types.begin(), allowed_forward_types.end(), type) ==
+        allowed_forward_types.end()) {
+      SendErrorToClient("unknown_message_type", "unsupported message type", session_id);
+      return;
     }
 
-    std::cout << "Bridge service listening on ws://" << config_.host << ":" << config_.port << "\n";
-    VLOG("Entering main event loop");
+    if (type == "tts_cancel" && obj->StringField("utterance_id").value_or("").empty()) {
+      SendErrorToClient("invalid_tts_cancel", "tts_cancel requires utterance_id", session_id);
+      return;
+    }
 
-    auto last_heartbeat_sent = std::chrono::steady_clock::now();
-    auto last_helper_activity = std::chrono::steady_clock::now();
+    if ((type == "tts_chunk" || type == "tts_chunks") && BatchTtsText(*obj, type, *session)) {
+      return;
+    }
 
-    while (!g_should_exit.load(std::memory_order_relaxed)) {
-      if (!helper_.IsRunning()) {
-        if (helper_restart_budget_ > 0) {
-          std::cerr << "Helper process exited; restarting...\n";
-          --helper_restart_budget_;
-          if (!StartHelper()) {
-            std::cerr << "Helper restart failed\n";
-            break;
-          }
-          if (session_configured_) {
-            SendSessionConfigToHelper();
-          }
-          last_helper_activity = std::chrono::steady_clock::now();
-        } else {
-          std::cerr << "Helper process exited permanently\n";
-          SendErrorToClient("helper_exited", "Engine helper process stopped");
-          break;
-        }
+    if (type == "tts_start" || type == "start_stt") {
+      const uint8_t uses = type == "tts_start" ? TtsRingUse(session->routing) : SttRingUse(session->routing);
+      if (const char* ring = AudioRingBusyElsewhere(*session, uses)) {
+        SendErrorToClient("audio_busy", std::string("the ") + ring + " ring is in use by another session",
+                          session_id);
+        return;
       }
+    }
 
-      FlushHelperEvents(&last_helper_activity);
-
-      const auto now = std::chrono::steady_clock::now();
-      if (std::chrono::duration_cast<std::chrono::seconds>(now - last_heartbeat_sent).count() >= 5) {
-        SendHeartbeat();
-        last_heartbeat_sent = now;
+    // Commands name their stream explicitly so it can be namespaced; a
+    // missing stream_id means the helper's default, or for stop_stt the
+    // session's newest stream.
+    const bool stt_command = type == "start_stt" || type == "stop_stt";
+    std::string stream_id(obj->StringField("stream_id").value_or(""));
+    if (stt_command && stream_id.empty()) {
+      stream_id = type == "stop_stt" && !session->stt_streams.empty() ? session->stt_streams.back()
+                                                                      : "stt-default";
+    }
+    if (type == "start_stt" && std::find(session->stt_streams.begin(), session->stt_streams.end(), stream_id) ==
+                                   session->stt_streams.end()) {
+      session->stt_streams.push_back(stream_id);
+    } else if (type == "stop_stt") {
+      std::erase(session->stt_streams, stream_id);
+    } else if (type == "tts_start") {
+      const std::string_view utterance_id = obj->StringField("utterance_id").value_or("");
+      if (!utterance_id.empty() &&
+          std::find(session->utterances.begin(), session->utterances.end(), utterance_id) ==
+              session->utterances.end()) {
+        session->utterances.emplace_back(utterance_id);
+      }
+    } else if (type == "tts_cancel") {
+      const std::string scoped_id = HelperScopedId(session->tag, obj->StringField("utterance_id").value_or(""));
+      audio_pacer_.Cancel(scoped_id);
+      if (tts_batch_.pieces > 0 && tts_batch_.session_tag == session->tag && tts_batch_.utterance_id == scoped_id) {
+        VLOG("Dropping tts_chunk batch of cancelled utterance: pieces=" << tts_batch_.pieces);
+        tts_batch_.text.clear();
+        tts_batch_.pieces = 0;
+      } else {
+        FlushTtsBatch();
+      }
+      if (client_close_pending_) {
+        return;
       }
+    }
+
+    EnsureHelperRouting(*session);
+    HelperShard& shard = ShardOf(*session);
+    shard.last_tag = session->tag;
+    const bool control = bridge::IsHelperControlCommand(type);
+    if (type == "disable") {
+      // The helper drops all of its TTS work, and so does the pacer.
+      audio_pacer_.DiscardSource(shard.helper->id());
+    }
 
-      if (std::chrono::duration_cast<std::chrono::seconds>(now - last_helper_activity).count() > 30 &&
-          helper_.IsRunning()) {
-        std::cerr << "Helper heartbeat timeout; forcing restart\n";
-        helper_.Stop();
+    // Re-serializing keeps the helper line compact and newline-free whatever
+    // whitespace the client used.
+    std::string forward;
+    forward.reserve(text_payload.size() + 32);
+    JsonWriter json(&forward);
+    json.BeginObject();
+    for (size_t i = 0; i < obj->count; ++i) {
+      const bridge::JsonMember& member = obj->members[i];
+      if (member.key == "session_id" || (stt_command && member.key == "stream_id") ||
+          (control && member.key == "after")) {
         continue;
       }
-
-      if (active_client_fd_ < 0) {
-        AcceptPrimaryClient();
+      if (member.key == "utterance_id" && member.value.type == bridge::JsonType::kString) {
+        json.Field(member.key, HelperScopedId(session->tag, member.value.text));
       } else {
-        PollActiveClient();
+        json.Key(member.key).Value(member.value);
       }
     }
+    if (stt_command) {
+      json.Field("stream_id", HelperScopedId(session->tag, stream_id));
+    }
+    if (type == "start_stt" && !obj->StringField("language")) {
+      json.Field("language", config_.apple.locale);
+    }
+    if (control) {
+      json.Key("after").Int(static_cast<int64_t>(shard.helper->data_messages_sent()));
+    }
+    json.EndObject();
 
-    CloseActiveClient();
-    CloseFd(&listen_fd_);
-    helper_.Stop();
-    return 0;
+    VLOG("Forwarding to helper: type=" << type << " session_tag=" << session->tag);
+    (void)ForwardJsonToHelper(*session, forward, control);
   }
 
- private:
-  bool StartHelper() {
-    if (!FileIsExecutable(config_.helper_path)) {
-      std::cerr << "Helper executable not found or not executable: " << config_.helper_path << "\n";
-      std::cerr << "Build helper with: swift build --package-path swift --product engine_helper -c release\n";
-      return false;
-    }
-
-    std::string error;
-    const bool started = helper_.Start(
-        config_.helper_path,
-        [this](const std::string& line) {
-          std::lock_guard<std::mutex> lock(helper_queue_mutex_);
-          helper_events_.push_back(line);
-        },
-        &error);
+  // Creates the session on first use. Settings that are omitted keep their
+  // previous value, or the config defaults for a new session.
+  void ConfigureSession(const JsonValue& obj, std::string_view session_id) {
+    SessionState* session = sessions_.FindById(session_id);
+    SessionRouting routing = session != nullptr ? session->routing : sessions_.defaults();
+    bool delta_partials = session != nullptr && session->delta_partials;
+    bool binary_alignment = session != nullptr && session->binary_alignment;
 
-    if (!started) {
-      std::cerr << "Failed to start helper process: " << error << "\n";
-      return false;
+    if (auto mode_opt = obj.StringField("mode")) {
+      routing.mode = ToLower(std::string(*mode_opt));
+    }
+    if (auto stt_opt = obj.StringField("stt_source")) {
+      routing.stt_source = *stt_opt;
+    }
+    if (auto tts_opt = obj.StringField("tts_target")) {
+      routing.tts_target = *tts_opt;
+    }
+    if (auto partials_opt = obj.StringField("stt_partials")) {
+      if (*partials_opt != "full" && *partials_opt != "delta") {
+        SendErrorToClient("invalid_stt_partials", "stt_partials must be full or delta", session_id);
+        return;
+      }
+      delta_partials = *partials_opt == "delta";
+    }
+    if (auto alignment_opt = obj.StringField("tts_alignment")) {
+      if (*alignment_opt != "json" && *alignment_opt != "binary") {
+        SendErrorToClient("invalid_tts_alignment", "tts_alignment must be json or binary", session_id);
+        return;
+      }
+      binary_alignment = *alignment_opt == "binary";
     }
 
-    NSDictionary* engine_config = @{
-      @"type" : @"engine_config",
-      @"audio" : @{
-        @"sample_rate_hz" : @(config_.audio.sample_rate_hz),
-        @"channels" : @(config_.audio.channels),
-        @"ring_capacity_frames" : @(config_.audio.ring_capacity_frames),
-      },
-      @"elevenlabs" : @{
-        @"api_key" : StdStringToNSString(config_.elevenlabs.api_key),
-        @"tts" : @{
-          @"voice_id" : StdStringToNSString(config_.elevenlabs.tts.voice_id),
-          @"model_id" : StdStringToNSString(config_.elevenlabs.tts.model_id),
-          @"output_format" : StdStringToNSString(config_.elevenlabs.tts.output_format),
-        },
-        @"stt" : @{
-          @"model_id" : StdStringToNSString(config_.elevenlabs.stt.model_id),
-          @"language_code" : StdStringToNSString(config_.elevenlabs.stt.language_code),
-        },
-      },
-      @"apple" : @{
-        @"locale" : StdStringToNSString(config_.apple.locale),
-        @"on_device_only" : @(config_.apple.on_device_only),
-      },
-      @"rings" : @{
-        @"mic_feed" : @"/virtual_audio_bridge_mic_feed",
-        @"speaker_tap" : @"/virtual_audio_bridge_speaker_tap",
-      },
-    };
-
-    std::string json_error;
-    const std::string payload = SerializeJsonObject(engine_config, &json_error);
-    if (payload.empty()) {
-      std::cerr << "Failed to serialize engine config: " << json_error << "\n";
-      return false;
+    if (routing.mode != "apple" && routing.mode != "elevenlabs") {
+      SendErrorToClient("invalid_mode", "mode must be apple or elevenlabs", session_id);
+      return;
     }
 
-    if (!helper_.SendLine(payload, &json_error)) {
-      std::cerr << "Failed to send engine config to helper: " << json_error << "\n";
-      return false;
+    if (routing.stt_source != "virtual_speaker" && routing.stt_source != "virtual_mic") {
+      SendErrorToClient("invalid_stt_source", "stt_source must be virtual_speaker or virtual_mic", session_id);
+      return;
     }
 
-    return true;
-  }
+    if (routing.tts_target != "virtual_mic" && routing.tts_target != "virtual_speaker" &&
+        routing.tts_target != "both") {
+      SendErrorToClient("invalid_tts_target", "tts_target must be virtual_mic, virtual_speaker, or both",
+                        session_id);
+      return;
+    }
 
-  bool SendJsonToClient(NSDictionary* obj) {
-    if (active_client_fd_ < 0) {
-      return false;
+    if (routing.mode == "elevenlabs" && config_.elevenlabs.api_key.empty()) {
+      SendErrorToClient("missing_api_key", "ELEVENLABS_API_KEY is not set (or configured env var missing)",
+                        session_id);
+      return;
     }
-    std::string error;
-    const std::string payload = SerializeJsonObject(obj, &error);
-    if (payload.empty()) {
-      std::cerr << "Failed to serialize websocket response: " << error << "\n";
-      return false;
+
+    if (session == nullptr && (session = sessions_.Create(session_id)) == nullptr) {
+      SendErrorToClient("too_many_sessions", "too many open sessions on this connection", session_id);
+      return;
     }
-    VLOG("Client << " << payload);
-    if (!SendWebSocketFrame(active_client_fd_, WsOpcode::kText, payload, &error)) {
-      std::cerr << "Failed to send websocket response: " << error << "\n";
-      CloseActiveClient();
-      return false;
+    if (!session->configured) {
+      session->shard = PickHelperShard(session_id);
     }
-    return true;
+    session->routing = routing;
+    session->delta_partials = delta_partials;
+    session->binary_alignment = binary_alignment;
+    session->configured = true;
+
+    VLOG("Session configured: id=" << session_id << " shard=" << session->shard << " mode=" << routing.mode
+         << " stt_source=" << routing.stt_source << " tts_target=" << routing.tts_target);
+    SendSessionConfigToHelper(*session, true);
+    // The helper emits session_config_applied after warm-up; it flows
+    // through FlushHelperEvents() automatically.
   }
 
-  void SendErrorToClient(const std::string& code, const std::string& message) {
-    NSDictionary* payload = @{
-      @"type" : @"error",
-      @"code" : StdStringToNSString(code),
-      @"message" : StdStringToNSString(message),
-    };
-    (void)SendJsonToClient(payload);
-  }
+  // Cancels the session's utterances and stops its STT streams. Ending the
+  // default session only returns it to the unconfigured state.
+  void EndSession(std::string_view session_id) {
+    SessionState* session = sessions_.FindById(session_id);
+    if (session == nullptr) {
+      SendErrorToClient("unknown_session", "configure_session must be sent for this session_id first", session_id);
+      return;
+    }
 
-  void SendHeartbeat() {
-    NSDictionary* payload = @{@"type" : @"heartbeat"};
-    std::string error;
-    const std::string line = SerializeJsonObject(payload, &error);
-    if (!line.empty()) {
-      (void)helper_.SendLine(line, &error);
+    CancelSessionWork(*session);
+
+    std::string reply;
+    JsonWriter json(&reply);
+    json.BeginObject().Field("type", "session_ended");
+    if (!session_id.empty()) {
+      json.Field("session_id", session_id);
     }
+    json.EndObject();
+    VLOG("Session ended: id=" << session_id);
+    sessions_.Remove(session->tag);
+    (void)SendJsonToClient(std::move(reply));
   }
 
-  void SendSessionConfigToHelper() {
-    NSDictionary* session = @{
-      @"type" : @"session_config",
-      @"mode" : StdStringToNSString(session_mode_),
-      @"stt_source" : StdStringToNSString(session_stt_source_),
-      @"tts_target" : StdStringToNSString(session_tts_target_),
-    };
-
+  // Cancels the session's utterances and stops its STT streams.
+  void CancelSessionWork(SessionState& session) {
+    if (!session.configured || (session.utterances.empty() && session.stt_streams.empty())) {
+      return;
+    }
+    EnsureHelperRouting(session);
+    HelperProcess& helper = *ShardOf(session).helper;
+    std::string line;
     std::string error;
-    const std::string line = SerializeJsonObject(session, &error);
-    if (line.empty() || !helper_.SendLine(line, &error)) {
-      std::cerr << "Failed to send session config to helper: " << error << "\n";
+    for (const std::string& utterance_id : session.utterances) {
+      const std::string scoped_id = HelperScopedId(session.tag, utterance_id);
+      audio_pacer_.Cancel(scoped_id);
+      line.clear();
+      JsonWriter(&line)
+          .BeginObject()
+          .Field("type", "tts_cancel")
+          .Field("utterance_id", scoped_id)
+          .Key("after")
+          .Int(static_cast<int64_t>(helper.data_messages_sent()))
+          .EndObject();
+      (void)helper.SendControl(line, &error);
+    }
+    for (const std::string& stream_id : session.stt_streams) {
+      line.clear();
+      JsonWriter(&line)
+          .BeginObject()
+          .Field("type", "stop_stt")
+          .Field("stream_id", HelperScopedId(session.tag, stream_id))
+          .Key("after")
+          .Int(static_cast<int64_t>(helper.data_messages_sent()))
+          .EndObject();
+      (void)helper.SendControl(line, &error);
     }
+    session.utterances.clear();
+    session.stt_streams.clear();
   }
 
-  void AcceptPrimaryClient() {
-    struct pollfd pfd {};
-    pfd.fd = listen_fd_;
-    pfd.events = POLLIN;
-    if (poll(&pfd, 1, 200) <= 0) {
+  bool OpenPcmRing(bridge::SharedMemoryAudioRing* ring, const char* name) {
+    return ring->is_open() || ring->Open(name, false, static_cast<uint32_t>(config_.audio.channels),
+                                         static_cast<uint32_t>(config_.audio.ring_capacity_frames));
+  }
+
+  void HandlePcmSubscription(const JsonValue& obj, bool subscribe) {
+    if (obj.StringField("stream").value_or("speaker_tap") != "speaker_tap") {
+      SendErrorToClient("invalid_pcm_stream", "only speaker_tap can be subscribed");
       return;
     }
 
-    sockaddr_in addr {};
-    socklen_t addr_len = sizeof(addr);
-    int fd = accept(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &addr_len);
-    if (fd < 0) {
+    std::string reply;
+    JsonWriter json(&reply);
+    if (!subscribe) {
+      pcm_tap_subscribed_ = false;
+      json.BeginObject().Field("type", "pcm_unsubscribed").Field("stream", "speaker_tap").EndObject();
+      (void)SendJsonToClient(std::move(reply));
       return;
     }
 
-    std::string handshake_error;
-    std::string handshake_extra;
-    if (!PerformWebSocketHandshake(fd, &handshake_extra, &handshake_error)) {
-      RejectHttpConnection(fd, 400, "invalid websocket handshake");
+    PcmSampleFormat format = PcmSampleFormat::kFloat32;
+    if (auto name = obj.StringField("format"); name && !bridge::ParsePcmSampleFormat(*name, &format)) {
+      SendErrorToClient("invalid_pcm_format", "format must be f32 or s16");
       return;
     }
-
-    VLOG("Client connected, fd=" << fd);
-    active_client_fd_ = fd;
-    client_pending_bytes_ = std::move(handshake_extra);
-    session_configured_ = false;
-    session_mode_ = config_.session_defaults.mode;
-    session_stt_source_ = config_.session_defaults.stt_source;
-    session_tts_target_ = config_.session_defaults.tts_target;
-
-    NSDictionary* ready = @{
-      @"type" : @"ready",
-      @"version" : StdStringToNSString(kProtocolVersion),
-    };
-    (void)SendJsonToClient(ready);
-  }
-
-  void RejectSecondaryClient() {
-    sockaddr_in addr {};
-    socklen_t addr_len = sizeof(addr);
-    int fd = accept(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &addr_len);
-    if (fd < 0) {
+    if (!OpenPcmRing(&pcm_speaker_tap_, kSpeakerTapName)) {
+      SendErrorToClient("pcm_unavailable", "speaker_tap ring is unavailable");
       return;
     }
-    RejectHttpConnection(fd, 409, "single active websocket client supported");
+    pcm_tap_subscribed_ = true;
+    pcm_tap_format_ = format;
+    pcm_tap_consuming_ = false;
+    pcm_tap_cursor_ = pcm_speaker_tap_.write_index();
+
+    json.BeginObject()
+        .Field("type", "pcm_subscribed")
+        .Field("stream", "speaker_tap")
+        .Key("sample_rate_hz").Int(config_.audio.sample_rate_hz)
+        .Key("channels").Int(pcm_speaker_tap_.channels())
+        .Field("format", bridge::PcmSampleFormatName(format))
+        .EndObject();
+    (void)SendJsonToClient(std::move(reply));
   }
 
-  void CloseActiveClient() {
-    if (active_client_fd_ >= 0) {
-      VLOG("Closing client fd=" << active_client_fd_);
-      std::string ignored;
-      (void)SendWebSocketFrame(active_client_fd_, WsOpcode::kClose, "", &ignored);
-      close(active_client_fd_);
-      active_client_fd_ = -1;
+  // The rings have one producer and one consumer each, so client PCM may
+  // only enter mic_feed while no session routes TTS into it.
+  bool OnPcmBlockHeader(const PcmBlockHeader& header, std::string* error) {
+    if (header.stream != PcmStreamId::kMicFeed) {
+      *error = "only mic_feed blocks can be sent to the bridge";
+      return false;
+    }
+    if (sessions_.Any([](const SessionState& session) {
+          return session.configured && session.routing.tts_target != "virtual_speaker";
+        })) {
+      *error = "mic_feed is fed by TTS; configure tts_target virtual_speaker first";
+      return false;
     }
-    client_pending_bytes_.clear();
-    session_configured_ = false;
+    if (!OpenPcmRing(&pcm_mic_feed_, kMicFeedName)) {
+      *error = "mic_feed ring is unavailable";
+      return false;
+    }
+    VLOG("PCM block: frames=" << header.frame_count << " format="
+         << bridge::PcmSampleFormatName(header.format) << " ts_us=" << header.timestamp_us);
+    return true;
   }
 
-  void FlushHelperEvents(std::chrono::steady_clock::time_point* last_helper_activity) {
-    std::deque<std::string> events;
-    {
-      std::lock_guard<std::mutex> lock(helper_queue_mutex_);
-      events.swap(helper_events_);
+  // Client PCM is paced like synthesized speech; the rings have one writer,
+  // the pacer.
+  void OnPcmFrames(const float* frames, size_t frame_count) {
+    audio_pacer_.Submit(kClientAudioSource, kClientAudioStream, bridge::kPaceMicFeed, frames, frame_count);
+  }
+
+  // Sends new speaker_tap audio to a subscribed client. While no session's STT
+  // reads virtual_speaker the bridge drains the ring itself; otherwise it
+  // follows the helper's reads with a cursor of its own.
+  void PumpSpeakerTap() {
+    if (!pcm_tap_subscribed_ || active_client_fd_ < 0) {
+      return;
+    }
+    const bool consume = !sessions_.Any([](const SessionState& session) {
+      return session.configured && session.routing.stt_source == "virtual_speaker";
+    });
+    if (consume != pcm_tap_consuming_) {
+      pcm_tap_consuming_ = consume;
+      pcm_tap_cursor_ = pcm_speaker_tap_.write_index();
     }
 
-    for (const std::string& line : events) {
-      if (last_helper_activity != nullptr) {
-        *last_helper_activity = std::chrono::steady_clock::now();
+    const uint32_t channels = pcm_speaker_tap_.channels();
+    bool queued = false;
+    while (true) {
+      std::string block;
+      size_t frames = 0;
+      if (pcm_tap_format_ == PcmSampleFormat::kFloat32) {
+        // Read straight into the frame payload.
+        block.resize(bridge::kPcmBlockHeaderBytes + kPcmTapMaxBlockFrames * channels * sizeof(float));
+        frames = ReadSpeakerTap(reinterpret_cast<float*>(block.data() + bridge::kPcmBlockHeaderBytes));
+        block.resize(bridge::kPcmBlockHeaderBytes + frames * channels * sizeof(float));
+      } else {
+        pcm_tap_frames_.resize(kPcmTapMaxBlockFrames * channels);
+        frames = ReadSpeakerTap(pcm_tap_frames_.data());
+        block.resize(bridge::kPcmBlockHeaderBytes);
+        bridge::AppendPcmSamples(pcm_tap_frames_.data(), frames * channels, pcm_tap_format_, &block);
       }
-
-      if (active_client_fd_ < 0) {
-        continue;
+      if (frames == 0) {
+        break;
       }
 
-      std::string error;
-      if (!SendWebSocketFrame(active_client_fd_, WsOpcode::kText, line, &error)) {
-        std::cerr << "Failed to relay helper event to websocket client: " << error << "\n";
-        CloseActiveClient();
+      // Stamp the block with the approximate capture time of its first frame.
+      const auto now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::steady_clock::now().time_since_epoch())
+                              .count();
+      PcmBlockHeader header;
+      header.stream = PcmStreamId::kSpeakerTap;
+      header.format = pcm_tap_format_;
+      header.channels = static_cast<uint8_t>(channels);
+      header.frame_count = static_cast<uint32_t>(frames);
+      header.timestamp_us = static_cast<uint64_t>(now_us) -
+                            frames * 1000000 / static_cast<uint64_t>(config_.audio.sample_rate_hz);
+      bridge::EncodePcmBlockHeader(header, reinterpret_cast<uint8_t*>(block.data()));
+
+      // Late audio is worthless, so a backed-up client loses blocks first.
+      if (!EnqueueToClient(WsOpcode::kBinary, std::move(block), OutboundClass::kDroppable, "")) {
+        return;
+      }
+      queued = true;
+      if (frames < kPcmTapMaxBlockFrames) {
         break;
       }
     }
+    if (queued) {
+      (void)FlushClient();
+    }
   }
 
-  bool ForwardJsonToHelper(NSDictionary* payload) {
-    std::string error;
-    const std::string line = SerializeJsonObject(payload, &error);
-    if (line.empty()) {
-      SendErrorToClient("internal_error", "failed to serialize helper command");
-      return false;
-    }
-    if (!helper_.SendLine(line, &error)) {
-      SendErrorToClient("helper_unavailable", "engine helper is unavailable");
-      return false;
+  size_t ReadSpeakerTap(float* out) {
+    if (pcm_tap_consuming_) {
+      return pcm_speaker_tap_.Read(out, kPcmTapMaxBlockFrames);
     }
-    return true;
+    // Peek() moves the cursor past frames that were overwritten before they
+    // could be copied.
+    const uint32_t cursor = pcm_tap_cursor_;
+    const size_t frames = pcm_speaker_tap_.Peek(&pcm_tap_cursor_, out, kPcmTapMaxBlockFrames);
+    metrics_.speaker_tap_frames_skipped.Add(pcm_tap_cursor_ - cursor - frames);
+    return frames;
   }
 
-  void HandleClientMessage(const std::string& text_payload) {
-    VLOG("Client >> " << text_payload);
-    std::string json_error;
-    NSDictionary* obj = ParseJsonObject(text_payload, &json_error);
-    if (obj == nil) {
-      SendErrorToClient("invalid_json", "message is not valid JSON object");
+  void PollActiveClient() {
+    struct pollfd pfds[3 + kMaxHelperShards] {};
+    const nfds_t listeners = ListenerPollFds(pfds);
+    struct pollfd& client = pfds[listeners];
+    client.fd = active_client_fd_;
+    client.events = POLLIN | (client_queue_.empty() ? 0 : POLLOUT);
+
+    const auto stalled = client_queue_.StalledFor(std::chrono::steady_clock::now());
+    if (stalled.count() > config_.send_stall_timeout_ms) {
+      DisconnectSlowClient("send stalled");
       return;
     }
 
-    auto type_opt = StringForKey(obj, @"type");
-    if (!type_opt) {
-      SendErrorToClient("invalid_message", "message missing type field");
+    int timeout_ms = pcm_tap_subscribed_ ? kPcmTapPollIntervalMs : 100;
+    if (tts_batch_.pieces > 0) {
+      const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(tts_batch_.deadline -
+                                                                           std::chrono::steady_clock::now());
+      timeout_ms = std::clamp(static_cast<int>(remaining.count()), 0, timeout_ms);
+    }
+    const nfds_t count = listeners + 1 + HelperPollFds(&pfds[listeners + 1], &timeout_ms);
+    const int rc = poll(pfds, count, timeout_ms);
+    if (rc <= 0) {
       return;
     }
+    NoteHelperDoorbells(&pfds[listeners + 1], count - listeners - 1);
 
-    const std::string type = *type_opt;
+    for (nfds_t i = 0; i < listeners; ++i) {
+      if ((pfds[i].revents & POLLIN) != 0) {
+        AcceptSecondaryConnection(pfds[i].fd);
+      }
+    }
 
-    if (type == "ping") {
-      std::string id;
-      if (auto id_opt = StringForKey(obj, @"id")) {
-        id = *id_opt;
-      }
-      NSDictionary* pong = @{
-        @"type" : @"pong",
-        @"id" : StdStringToNSString(id),
-      };
-      (void)SendJsonToClient(pong);
+    if ((client.revents & (POLLHUP | POLLERR | POLLNVAL)) != 0) {
+      CloseActiveClient();
       return;
     }
 
-    if (type == "configure_session") {
-      std::string mode = session_mode_;
-      std::string stt_source = session_stt_source_;
-      std::string tts_target = session_tts_target_;
-
-      if (auto mode_opt = StringForKey(obj, @"mode")) {
-        mode = ToLower(*mode_opt);
-      }
-      if (auto stt_opt = StringForKey(obj, @"stt_source")) {
-        stt_source = *stt_opt;
-      }
-      if (auto tts_opt = StringForKey(obj, @"tts_target")) {
-        tts_target = *tts_opt;
-      }
+    if ((client.revents & POLLOUT) != 0 && !FlushClient()) {
+      return;
+    }
 
-      if (mode != "apple" && mode != "elevenlabs") {
-        SendErrorToClient("invalid_mode", "mode must be apple or elevenlabs");
+    if ((client.revents & POLLIN) != 0) {
+      const ssize_t got = recv(active_client_fd_, client_recv_buffer_.data(), client_recv_buffer_.size(), 0);
+      if (got == 0) {
+        CloseActiveClient();
         return;
       }
-
-      if (stt_source != "virtual_speaker" && stt_source != "virtual_mic") {
-        SendErrorToClient("invalid_stt_source", "stt_source must be virtual_speaker or virtual_mic");
+      if (got < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+          CloseActiveClient();
+        }
         return;
       }
+      FeedClientBytes(client_recv_buffer_.data(), static_cast<size_t>(got));
+    }
+  }
 
-      if (tts_target != "virtual_mic" && tts_target != "virtual_speaker" && tts_target != "both") {
-        SendErrorToClient("invalid_tts_target", "tts_target must be virtual_mic, virtual_speaker, or both");
-        return;
-      }
+  void FeedClientBytes(uint8_t* data, size_t size) {
+    std::string error;
+    dispatching_client_ = true;
+    const bool ok = client_reader_.Feed(data, size, &error);
+    dispatching_client_ = false;
+    if (!ok) {
+      std::cerr << "Closing websocket client after protocol error: " << error << "\n";
+      CloseActiveClient();
+      return;
+    }
+    if (client_close_requested_ || client_close_pending_) {
+      CloseActiveClient();
+    }
+  }
 
-      if (mode == "elevenlabs" && config_.elevenlabs.api_key.empty()) {
-        SendErrorToClient("missing_api_key",
-                          "ELEVENLABS_API_KEY is not set (or configured env var missing)");
-        return;
+  void OnClientControlFrame(WsOpcode opcode, const uint8_t* data, size_t size) {
+    if (active_client_fd_ < 0 || client_close_pending_) {
+      return;
+    }
+    if (opcode == WsOpcode::kPing) {
+      std::string payload(reinterpret_cast<const char*>(data), size);
+      if (EnqueueToClient(WsOpcode::kPong, std::move(payload), OutboundClass::kCritical, "")) {
+        (void)FlushClient();
       }
+    } else if (opcode == WsOpcode::kClose) {
+      client_close_requested_ = true;
+    }
+  }
 
-      session_mode_ = mode;
-      session_stt_source_ = stt_source;
-      session_tts_target_ = tts_target;
-      session_configured_ = true;
+  void OnClientMessageBegin(WsOpcode opcode, bool compressed) {
+    inbound_compressed_ = compressed;
+    inbound_message_.clear();
+    if (opcode == WsOpcode::kBinary) {
+      metrics_.client_messages.Add("pcm_block");
+      pcm_reader_.Reset();
+      inbound_mode_ = InboundMode::kPcm;
+    } else {
+      inbound_mode_ = InboundMode::kBuffering;
+    }
+  }
 
-      VLOG("Session configured: mode=" << mode << " stt_source=" << stt_source << " tts_target=" << tts_target);
-      SendSessionConfigToHelper();
-      // The helper emits session_config_applied after warm-up; it flows
-      // through FlushHelperEvents() automatically.
+  void OnClientMessageData(const uint8_t* data, size_t size, bool final) {
+    if (active_client_fd_ < 0 || client_close_requested_ || client_close_pending_) {
+      return;
+    }
+    if (!inbound_compressed_) {
+      ProcessInboundData(data, size, final);
+      return;
+    }
+    // Inflated output arrives in bounded chunks, so the size limits below
+    // apply to the decompressed message as well.
+    const bool ok = client_deflate_.Decompress(data, size, final, [this](const uint8_t* out, size_t out_size) {
+      ProcessInboundData(out, out_size, false);
+    });
+    if (!ok) {
+      std::cerr << "Closing websocket client after invalid compressed message\n";
+      client_close_requested_ = true;
       return;
     }
+    if (final) {
+      ProcessInboundData(nullptr, 0, true);
+    }
+  }
 
-    if (!session_configured_) {
-      SendErrorToClient("session_not_configured", "configure_session must be sent before TTS/STT commands");
+  // Text messages are buffered up to max_message_bytes and then handled as a
+  // whole. A larger message is only accepted if it is a tts_chunk, whose text
+  // is then decoded and forwarded to the helper piecewise as it arrives.
+  void ProcessInboundData(const uint8_t* data, size_t size, bool final) {
+    if (active_client_fd_ < 0) {
       return;
     }
+    const char* text = reinterpret_cast<const char*>(data);
 
-    static const std::vector<std::string> allowed_forward_types = {
-        "enable", "disable",
-        "tts_start", "tts_chunk", "tts_flush", "tts_cancel", "start_stt", "stop_stt"};
+    switch (inbound_mode_) {
+      case InboundMode::kBuffering:
+        inbound_message_.append(text, size);
+        if (inbound_message_.size() > static_cast<size_t>(config_.max_message_bytes)) {
+          BeginTtsTextStream();
+        }
+        break;
+      case InboundMode::kStreamingTts:
+        ContinueTtsTextStream(text, size);
+        break;
+      case InboundMode::kPcm: {
+        std::string error;
+        if (!pcm_reader_.Feed(data, size, final, &error)) {
+          SendErrorToClient("invalid_pcm_block", error);
+          inbound_mode_ = InboundMode::kDiscarding;
+        }
+        break;
+      }
+      case InboundMode::kIdle:
+      case InboundMode::kDiscarding:
+        break;
+    }
 
-    if (std::find(allowed_forward_types.begin(), allowed_forward_types.end(), type) ==
-        allowed_forward_types.end()) {
-      SendErrorToClient("unknown_message_type", "unsupported message type");
+    if (!final) {
       return;
     }
+    if (inbound_mode_ == InboundMode::kBuffering) {
+      HandleClientMessage(inbound_message_);
+    } else if (inbound_mode_ == InboundMode::kStreamingTts) {
+      FinishTtsTextStream();
+    }
+    inbound_mode_ = InboundMode::kIdle;
+    inbound_message_.clear();
+    if (inbound_message_.capacity() > static_cast<size_t>(config_.max_message_bytes)) {
+      inbound_message_.shrink_to_fit();
+    }
+  }
 
-    NSMutableDictionary* forward = [obj mutableCopy];
-    if (type == "start_stt" && StringForKey(obj, @"language") == std::nullopt) {
-      forward[@"language"] = StdStringToNSString(config_.apple.locale);
+  void BeginTtsTextStream() {
+    // "type" and "utterance_id" must precede "text" for a message to stream.
+    const size_t text_key = inbound_message_.find("\"text\"");
+    const std::string type = ExtractJsonStringField(inbound_message_.substr(0, text_key), "type");
+    const std::string utterance_id =
+        ExtractJsonStringField(inbound_message_.substr(0, text_key), "utterance_id");
+    const std::string session_id = ExtractJsonStringField(inbound_message_.substr(0, text_key), "session_id");
+
+    size_t body = text_key == std::string::npos ? std::string::npos : text_key + 6;
+    while (body != std::string::npos && body < inbound_message_.size() &&
+           (std::isspace(static_cast<unsigned char>(inbound_message_[body])) || inbound_message_[body] == ':')) {
+      ++body;
+    }
+    if (type != "tts_chunk" || utterance_id.empty() || body == std::string::npos ||
+        body >= inbound_message_.size() || inbound_message_[body] != '"') {
+      SendErrorToClient("message_too_large", "message exceeds websocket.max_message_bytes");
+      inbound_mode_ = InboundMode::kDiscarding;
+      inbound_message_.clear();
+      return;
+    }
+    const SessionState* session = sessions_.FindById(session_id);
+    if (session == nullptr || !session->configured) {
+      SendErrorToClient("session_not_configured", "configure_session must be sent before TTS/STT commands",
+                        session_id);
+      inbound_mode_ = InboundMode::kDiscarding;
+      inbound_message_.clear();
+      return;
     }
 
-    VLOG("Forwarding to helper: type=" << type);
-    (void)ForwardJsonToHelper(forward);
+    VLOG("Streaming oversized tts_chunk for utterance " << utterance_id);
+    FlushTtsBatch();
+    inbound_mode_ = InboundMode::kStreamingTts;
+    tts_stream_utterance_id_ = HelperScopedId(session->tag, utterance_id);
+    tts_stream_session_tag_ = session->tag;
+    tts_stream_text_.clear();
+    tts_stream_decoder_.Reset();
+    const std::string rest = inbound_message_.substr(body + 1);
+    inbound_message_.clear();
+    ContinueTtsTextStream(rest.data(), rest.size());
   }
 
-  void PollActiveClient() {
-    struct pollfd pfds[2] {};
-    pfds[0].fd = listen_fd_;
-    pfds[0].events = POLLIN;
-    pfds[1].fd = active_client_fd_;
-    pfds[1].events = POLLIN;
-
-    const int rc = poll(pfds, 2, 100);
-    if (rc <= 0) {
+  void ContinueTtsTextStream(const char* data, size_t size) {
+    if (tts_stream_decoder_.done()) {
+      return;
+    }
+    size_t consumed = 0;
+    if (!tts_stream_decoder_.Decode(data, size, &consumed, &tts_stream_text_)) {
+      SendErrorToClient("invalid_json", "message is not valid JSON object");
+      inbound_mode_ = InboundMode::kDiscarding;
+      tts_stream_text_.clear();
       return;
     }
+    while (tts_stream_text_.size() >= kTtsStreamPieceBytes) {
+      const size_t piece = Utf8SafePrefixLength(tts_stream_text_, kTtsStreamPieceBytes);
+      ForwardTtsTextPiece(tts_stream_text_.substr(0, piece));
+      tts_stream_text_.erase(0, piece);
+    }
+  }
 
-    if ((pfds[0].revents & POLLIN) != 0) {
-      RejectSecondaryClient();
+  void FinishTtsTextStream() {
+    if (!tts_stream_decoder_.done()) {
+      SendErrorToClient("invalid_json", "message is not valid JSON object");
+    } else if (!tts_stream_text_.empty()) {
+      ForwardTtsTextPiece(tts_stream_text_);
     }
+    tts_stream_text_.clear();
+  }
 
-    if ((pfds[1].revents & (POLLHUP | POLLERR | POLLNVAL)) != 0) {
-      CloseActiveClient();
+  void ForwardTtsTextPiece(const std::string& text) {
+    const SessionState* session = sessions_.FindByTag(tts_stream_session_tag_);
+    if (session == nullptr) {
       return;
     }
-
-    if ((pfds[1].revents & POLLIN) != 0) {
-      WsFrame frame;
-      std::string error;
-      if (!ReadWebSocketFrame(active_client_fd_, &client_pending_bytes_, &frame, 1000, &error)) {
-        CloseActiveClient();
-        return;
-      }
-
-      switch (frame.opcode) {
-        case WsOpcode::kText:
-          HandleClientMessage(frame.payload);
-          break;
-        case WsOpcode::kPing:
-          (void)SendWebSocketFrame(active_client_fd_, WsOpcode::kPong, frame.payload, &error);
-          break;
-        case WsOpcode::kClose:
-          CloseActiveClient();
-          break;
-        default:
-          break;
-      }
+    if (!bridge::IsValidUtf8(text)) {
+      SendErrorToClient("invalid_text", "tts_chunk text is not valid UTF-8", session->id);
+      return;
     }
+    ForwardTtsChunk(*session, tts_stream_utterance_id_, text);
   }
 
   BridgeConfig config_;
-  HelperProcess helper_;
+  const ProtocolFrames frames_;
+  std::vector<HelperShard> shards_;
+  std::vector<std::unique_ptr<HelperProcess>> standby_helpers_;
+  uint64_t next_helper_id_ = 1;
+  bool reset_audio_rings_ = true;
   int listen_fd_ = -1;
+  int unix_listen_fd_ = -1;
   int active_client_fd_ = -1;
-  std::string client_pending_bytes_;
-
-  bool session_configured_ = false;
-  std::string session_mode_;
-  std::string session_stt_source_;
-  std::string session_tts_target_;
-
-  int helper_restart_budget_ = 1;
-
-  std::mutex helper_queue_mutex_;
-  std::deque<std::string> helper_events_;
+  ClientSendQueue client_queue_;
+  WebSocketReader client_reader_;
+  PerMessageDeflate client_deflate_;
+  std::vector<uint8_t> client_recv_buffer_;
+  bool client_close_requested_ = false;
+  // Set while the reader is dispatching client frames. A close asked for
+  // meanwhile (a failed send, a slow client) only sets client_close_pending_
+  // and happens once the reader returns, so the message being handled and
+  // the sessions it names stay put.
+  bool dispatching_client_ = false;
+  bool client_close_pending_ = false;
+
+  // What happens to the data of the client message currently arriving.
+  enum class InboundMode { kIdle, kBuffering, kStreamingTts, kPcm, kDiscarding };
+  InboundMode inbound_mode_ = InboundMode::kIdle;
+  bool inbound_compressed_ = false;
+  std::string inbound_message_;
+  JsonStringStreamDecoder tts_stream_decoder_;
+  JsonReader json_reader_;
+  std::string tts_stream_utterance_id_;  // already namespaced for the helper
+  uint32_t tts_stream_session_tag_ = 0;
+  std::string tts_stream_text_;
+  struct TtsBatch {
+    uint32_t session_tag = 0;
+    std::string utterance_id;  // already namespaced for the helper
+    std::string text;
+    size_t pieces = 0;
+    std::chrono::steady_clock::time_point deadline;
+  };
+  TtsBatch tts_batch_;
+  uint64_t slow_client_disconnects_ = 0;
+
+  // Raw PCM over binary frames. The rings are opened on first use and closed
+  // with the client.
+  bridge::SharedMemoryAudioRing pcm_mic_feed_;
+  bridge::SharedMemoryAudioRing pcm_speaker_tap_;
+  PcmBlockReader pcm_reader_;
+  bool pcm_tap_subscribed_ = false;
+  bool pcm_tap_consuming_ = false;
+  PcmSampleFormat pcm_tap_format_ = PcmSampleFormat::kFloat32;
+  uint32_t pcm_tap_cursor_ = 0;
+  std::vector<float> pcm_tap_frames_;
+
+  SessionTable sessions_;
+  std::string resume_token_;
+  bool parked_ = false;
+  std::chrono::steady_clock::time_point parked_deadline_;
+  std::deque<OutboundMessage> parked_messages_;
+  size_t parked_bytes_ = 0;
+  JsonReader helper_event_reader_;
+
+  // Restart backoff, shared by all shards and the standby pool.
+  static constexpr auto kHelperFailureMemory = std::chrono::seconds(60);
+  int helper_failures_ = 0;
+  std::chrono::steady_clock::time_point last_helper_failure_;
+  std::chrono::steady_clock::time_point next_helper_spawn_;
+
+  // Pipe modes only: events from the helpers' reader threads.
+  static constexpr auto kHelperEventQueueFullTimeout = std::chrono::seconds(1);
+  bridge::HelperEventQueue helper_events_{kHelperEventQueueSlots, kHelperEventSlotBytes};
+  HelperEventOverflow helper_event_overflow_;
+
+  // The only writer of the audio rings in the bridge.
+  bridge::AudioPacer audio_pacer_{AudioPacerOptions(config_)};
+  // Audio a retired helper's reader thread queued before it stopped is
+  // dropped once it is gone.
+  HelperReaper helper_reaper_{[this](uint64_t id) { audio_pacer_.DiscardSource(id); }};
+
+  // Connections accepted while a client is active. They are read without
+  // blocking until the request is complete; /metrics and /healthz are
+  // answered and anything else is turned away.
+  struct PendingHttpConnection {
+    int fd = -1;
+    std::string request;
+    std::chrono::steady_clock::time_point deadline;
+  };
+  std::vector<PendingHttpConnection> http_pending_;
+
+  ServiceMetrics metrics_;
+  HelperReaderMetrics helper_metrics_;
 };
 
 void PrintUsage(const char* program_name) {
@@ -1484,8 +4334,14 @@ int RunDoctor(const std::string& config_path) {
 
   std::cout << "Config OK\n";
   std::cout << "  websocket: " << config.host << ":" << config.port << "\n";
+  if (!config.unix_path.empty()) {
+    std::cout << "  websocket unix socket: " << config.unix_path << "\n";
+  }
   std::cout << "  default mode: " << config.session_defaults.mode << "\n";
   std::cout << "  helper path: " << config.helper_path << "\n";
+  std::cout << "  helper ipc: " << bridge::HelperIpcModeName(config.helper_ipc) << "\n";
+  std::cout << "  helper shards: " << config.helper_shards << "\n";
+  std::cout << "  helper standby: " << config.helper_standby << "\n";
 
   if (!FileIsExecutable(config.helper_path)) {
     std::cerr << "FAIL: helper executable missing or not executable: " << config.helper_path << "\n";
@@ -0,0 +1,459 @@
+#include "Base64.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__SSE2__)
+#define BRIDGE_BASE64_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define BRIDGE_BASE64_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace bridge {
+
+namespace {
+
+constexpr char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Each character's value, or 0xFF outside the alphabet.
+constexpr std::array<uint8_t, 256> kDecodeTable = [] {
+  std::array<uint8_t, 256> table{};
+  table.fill(0xFF);
+  for (uint8_t i = 0; i < 64; ++i) {
+    table[static_cast<uint8_t>(kAlphabet[i])] = i;
+  }
+  return table;
+}();
+
+// The scalar versions are also the tails of the SIMD ones.
+
+size_t EncodeGroupsScalar(const uint8_t* in, size_t size, char* out) {
+  const size_t groups = size / 3;
+  for (size_t g = 0; g < groups; ++g) {
+    const uint32_t bits = (static_cast<uint32_t>(in[0]) << 16) | (static_cast<uint32_t>(in[1]) << 8) | in[2];
+    out[0] = kAlphabet[bits >> 18];
+    out[1] = kAlphabet[(bits >> 12) & 0x3F];
+    out[2] = kAlphabet[(bits >> 6) & 0x3F];
+    out[3] = kAlphabet[bits & 0x3F];
+    in += 3;
+    out += 4;
+  }
+  return groups * 4;
+}
+
+size_t DecodeGroupsScalar(const char* in, size_t size, uint8_t* out, size_t capacity) {
+  size_t i = 0;
+  for (; i + 4 <= size && i / 4 * 3 + 3 <= capacity; i += 4) {
+    const uint32_t a = kDecodeTable[static_cast<uint8_t>(in[i])];
+    const uint32_t b = kDecodeTable[static_cast<uint8_t>(in[i + 1])];
+    const uint32_t c = kDecodeTable[static_cast<uint8_t>(in[i + 2])];
+    const uint32_t d = kDecodeTable[static_cast<uint8_t>(in[i + 3])];
+    if ((a | b | c | d) > 0x3F) {
+      break;
+    }
+    const uint32_t bits = (a << 18) | (b << 12) | (c << 6) | d;
+    uint8_t* group = out + i / 4 * 3;
+    group[0] = static_cast<uint8_t>(bits >> 16);
+    group[1] = static_cast<uint8_t>(bits >> 8);
+    group[2] = static_cast<uint8_t>(bits);
+  }
+  return i;
+}
+
+constexpr Base64Codec kScalarCodec = {
+    .isa = Base64Isa::kScalar,
+    .name = "scalar",
+    .encode_groups = EncodeGroupsScalar,
+    .decode_groups = DecodeGroupsScalar,
+};
+
+#if BRIDGE_BASE64_X86
+
+// Built for SSSE3 and AVX2 whatever the compiler's target; used only once
+// the CPU has been found to support them. The SIMD versions follow Muła and
+// Lemire: pshufb both spreads the bytes of each group over four lanes and
+// maps six-bit values to and from characters, and multiplies move the bits.
+#define BRIDGE_SSSE3 __attribute__((target("ssse3")))
+#define BRIDGE_AVX2 __attribute__((target("avx2")))
+
+// Three bytes per 32-bit lane, in the order 1, 0, 2, 1 that the multiplies
+// below want.
+#define BRIDGE_BASE64_SPREAD 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10
+// Added to each six-bit value by range: 'A', 'a' - 26, '0' - 52, '+' - 62
+// and '/' - 63, indexed as EncodeCharacters() works out.
+#define BRIDGE_BASE64_OFFSETS                                                                                         \
+  'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,     \
+      '+' - 62, '/' - 63, 'A', 0, 0
+// Decoding: flags by low and high nibble that only meet for characters
+// outside the alphabet, and what to add by high nibble ('/' has its own).
+#define BRIDGE_BASE64_LOW_FLAGS                                                                                       \
+  0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A
+#define BRIDGE_BASE64_HIGH_FLAGS                                                                                      \
+  0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+#define BRIDGE_BASE64_ROLL 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0
+// The three bytes of each 32-bit lane, most significant first.
+#define BRIDGE_BASE64_PACK 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+
+BRIDGE_SSSE3 __m128i EncodeCharacters(__m128i bytes) {
+  const __m128i spread = _mm_shuffle_epi8(bytes, _mm_setr_epi8(BRIDGE_BASE64_SPREAD));
+  const __m128i ac = _mm_mulhi_epu16(_mm_and_si128(spread, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+  const __m128i bd = _mm_mullo_epi16(_mm_and_si128(spread, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+  const __m128i values = _mm_or_si128(ac, bd);
+  // 0 for 0-25, 13 for 26-51, then 1-12 for 52-63.
+  __m128i index = _mm_subs_epu8(values, _mm_set1_epi8(51));
+  index = _mm_or_si128(index, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), values), _mm_set1_epi8(13)));
+  return _mm_add_epi8(values, _mm_shuffle_epi8(_mm_setr_epi8(BRIDGE_BASE64_OFFSETS), index));
+}
+
+BRIDGE_SSSE3 size_t EncodeGroupsSsse3(const uint8_t* in, size_t size, char* out) {
+  size_t i = 0;
+  // Each load reads 16 bytes and encodes the first 12.
+  for (; i + 16 <= size; i += 12) {
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i / 3 * 4), EncodeCharacters(bytes));
+  }
+  return i / 3 * 4 + EncodeGroupsScalar(in + i, size - i, out + i / 3 * 4);
+}
+
+// Returns false if any of the 16 characters is outside the alphabet.
+BRIDGE_SSSE3 bool DecodeCharacters(__m128i chars, __m128i* bytes) {
+  const __m128i nibble = _mm_set1_epi8(0x2F);
+  const __m128i high_nibbles = _mm_and_si128(_mm_srli_epi32(chars, 4), nibble);
+  const __m128i low = _mm_shuffle_epi8(_mm_setr_epi8(BRIDGE_BASE64_LOW_FLAGS), _mm_and_si128(chars, nibble));
+  const __m128i high = _mm_shuffle_epi8(_mm_setr_epi8(BRIDGE_BASE64_HIGH_FLAGS), high_nibbles);
+  if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(low, high), _mm_setzero_si128())) != 0xFFFF) {
+    return false;
+  }
+  const __m128i slash = _mm_cmpeq_epi8(chars, nibble);
+  const __m128i roll = _mm_shuffle_epi8(_mm_setr_epi8(BRIDGE_BASE64_ROLL), _mm_add_epi8(slash, high_nibbles));
+  const __m128i values = _mm_add_epi8(chars, roll);
+  const __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+  const __m128i groups = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+  *bytes = _mm_shuffle_epi8(groups, _mm_setr_epi8(BRIDGE_BASE64_PACK));
+  return true;
+}
+
+BRIDGE_SSSE3 size_t DecodeGroupsSsse3(const char* in, size_t size, uint8_t* out, size_t capacity) {
+  size_t i = 0;
+  // Each store writes 16 bytes, the first 12 of them decoded.
+  for (; i + 16 <= size && i / 4 * 3 + 16 <= capacity; i += 16) {
+    __m128i bytes;
+    if (!DecodeCharacters(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)), &bytes)) {
+      break;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i / 4 * 3), bytes);
+  }
+  return i + DecodeGroupsScalar(in + i, size - i, out + i / 4 * 3, capacity - i / 4 * 3);
+}
+
+constexpr Base64Codec kSsse3Codec = {
+    .isa = Base64Isa::kSsse3,
+    .name = "ssse3",
+    .encode_groups = EncodeGroupsSsse3,
+    .decode_groups = DecodeGroupsSsse3,
+};
+
+BRIDGE_AVX2 size_t EncodeGroupsAvx2(const uint8_t* in, size_t size, char* out) {
+  const __m256i spread_mask = _mm256_setr_epi8(BRIDGE_BASE64_SPREAD, BRIDGE_BASE64_SPREAD);
+  const __m256i offsets = _mm256_setr_epi8(BRIDGE_BASE64_OFFSETS, BRIDGE_BASE64_OFFSETS);
+  size_t i = 0;
+  // 24 bytes a time, 12 in each lane, from two loads of 16.
+  for (; i + 28 <= size; i += 24) {
+    const __m256i bytes =
+        _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i))),
+                                _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 12)), 1);
+    const __m256i spread = _mm256_shuffle_epi8(bytes, spread_mask);
+    const __m256i ac =
+        _mm256_mulhi_epu16(_mm256_and_si256(spread, _mm256_set1_epi32(0x0FC0FC00)), _mm256_set1_epi32(0x04000040));
+    const __m256i bd =
+        _mm256_mullo_epi16(_mm256_and_si256(spread, _mm256_set1_epi32(0x003F03F0)), _mm256_set1_epi32(0x01000010));
+    const __m256i values = _mm256_or_si256(ac, bd);
+    __m256i index = _mm256_subs_epu8(values, _mm256_set1_epi8(51));
+    index = _mm256_or_si256(
+        index, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), values), _mm256_set1_epi8(13)));
+    const __m256i chars = _mm256_add_epi8(values, _mm256_shuffle_epi8(offsets, index));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i / 3 * 4), chars);
+  }
+  return i / 3 * 4 + EncodeGroupsScalar(in + i, size - i, out + i / 3 * 4);
+}
+
+BRIDGE_AVX2 size_t DecodeGroupsAvx2(const char* in, size_t size, uint8_t* out, size_t capacity) {
+  const __m256i nibble = _mm256_set1_epi8(0x2F);
+  const __m256i low_flags = _mm256_setr_epi8(BRIDGE_BASE64_LOW_FLAGS, BRIDGE_BASE64_LOW_FLAGS);
+  const __m256i high_flags = _mm256_setr_epi8(BRIDGE_BASE64_HIGH_FLAGS, BRIDGE_BASE64_HIGH_FLAGS);
+  const __m256i roll_table = _mm256_setr_epi8(BRIDGE_BASE64_ROLL, BRIDGE_BASE64_ROLL);
+  const __m256i pack = _mm256_setr_epi8(BRIDGE_BASE64_PACK, BRIDGE_BASE64_PACK);
+  size_t i = 0;
+  // Each store writes 32 bytes, the first 24 of them decoded.
+  for (; i + 32 <= size && i / 4 * 3 + 32 <= capacity; i += 32) {
+    const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+    const __m256i high_nibbles = _mm256_and_si256(_mm256_srli_epi32(chars, 4), nibble);
+    const __m256i low = _mm256_shuffle_epi8(low_flags, _mm256_and_si256(chars, nibble));
+    const __m256i high = _mm256_shuffle_epi8(high_flags, high_nibbles);
+    if (!_mm256_testz_si256(low, high)) {
+      break;
+    }
+    const __m256i slash = _mm256_cmpeq_epi8(chars, nibble);
+    const __m256i roll = _mm256_shuffle_epi8(roll_table, _mm256_add_epi8(slash, high_nibbles));
+    const __m256i values = _mm256_add_epi8(chars, roll);
+    const __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+    const __m256i groups = _mm256_shuffle_epi8(_mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000)), pack);
+    const __m256i bytes = _mm256_permutevar8x32_epi32(groups, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i / 4 * 3), bytes);
+  }
+  return i + DecodeGroupsScalar(in + i, size - i, out + i / 4 * 3, capacity - i / 4 * 3);
+}
+
+constexpr Base64Codec kAvx2Codec = {
+    .isa = Base64Isa::kAvx2,
+    .name = "avx2",
+    .encode_groups = EncodeGroupsAvx2,
+    .decode_groups = DecodeGroupsAvx2,
+};
+
+bool CpuSupports(Base64Isa isa) {
+  __builtin_cpu_init();
+  return isa == Base64Isa::kAvx2 ? __builtin_cpu_supports("avx2") : __builtin_cpu_supports("ssse3");
+}
+
+#elif BRIDGE_BASE64_NEON
+
+uint8x16x4_t LoadTable(const uint8_t* table) {
+  return uint8x16x4_t{{vld1q_u8(table), vld1q_u8(table + 16), vld1q_u8(table + 32), vld1q_u8(table + 48)}};
+}
+
+size_t EncodeGroupsNeon(const uint8_t* in, size_t size, char* out) {
+  const uint8x16x4_t alphabet = LoadTable(reinterpret_cast<const uint8_t*>(kAlphabet));
+  const uint8x16_t six_bits = vdupq_n_u8(0x3F);
+  size_t i = 0;
+  // 48 bytes a time, split three ways by position in the group.
+  for (; i + 48 <= size; i += 48) {
+    const uint8x16x3_t bytes = vld3q_u8(in + i);
+    uint8x16x4_t chars;
+    chars.val[0] = vshrq_n_u8(bytes.val[0], 2);
+    chars.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(bytes.val[0], 4), vshrq_n_u8(bytes.val[1], 4)), six_bits);
+    chars.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(bytes.val[1], 2), vshrq_n_u8(bytes.val[2], 6)), six_bits);
+    chars.val[3] = vandq_u8(bytes.val[2], six_bits);
+    for (uint8x16_t& c : chars.val) {
+      c = vqtbl4q_u8(alphabet, c);
+    }
+    vst4q_u8(reinterpret_cast<uint8_t*>(out + i / 3 * 4), chars);
+  }
+  return i / 3 * 4 + EncodeGroupsScalar(in + i, size - i, out + i / 3 * 4);
+}
+
+size_t DecodeGroupsNeon(const char* in, size_t size, uint8_t* out, size_t capacity) {
+  // The table's first 128 entries; bytes above that are caught apart.
+  const uint8x16x4_t low_table = LoadTable(kDecodeTable.data());
+  const uint8x16x4_t high_table = LoadTable(kDecodeTable.data() + 64);
+  size_t i = 0;
+  for (; i + 64 <= size && i / 4 * 3 + 48 <= capacity; i += 64) {
+    const uint8x16x4_t chars = vld4q_u8(reinterpret_cast<const uint8_t*>(in + i));
+    uint8x16x4_t values;
+    uint8x16_t bad = vdupq_n_u8(0);
+    for (size_t k = 0; k < 4; ++k) {
+      // Indices past 63 leave the lane as it was: the first lookup covers
+      // characters below 64, the second those from 64 to 127.
+      const uint8x16_t c = chars.val[k];
+      values.val[k] = vqtbx4q_u8(vqtbl4q_u8(low_table, c), high_table, vsubq_u8(c, vdupq_n_u8(64)));
+      bad = vorrq_u8(bad, vorrq_u8(values.val[k], vandq_u8(c, vdupq_n_u8(0x80))));
+    }
+    if (vmaxvq_u8(bad) > 0x3F) {
+      break;
+    }
+    uint8x16x3_t bytes;
+    bytes.val[0] = vorrq_u8(vshlq_n_u8(values.val[0], 2), vshrq_n_u8(values.val[1], 4));
+    bytes.val[1] = vorrq_u8(vshlq_n_u8(values.val[1], 4), vshrq_n_u8(values.val[2], 2));
+    bytes.val[2] = vorrq_u8(vshlq_n_u8(values.val[2], 6), values.val[3]);
+    vst3q_u8(out + i / 4 * 3, bytes);
+  }
+  return i + DecodeGroupsScalar(in + i, size - i, out + i / 4 * 3, capacity - i / 4 * 3);
+}
+
+constexpr Base64Codec kNeonCodec = {
+    .isa = Base64Isa::kNeon,
+    .name = "neon",
+    .encode_groups = EncodeGroupsNeon,
+    .decode_groups = DecodeGroupsNeon,
+};
+
+#endif
+
+const Base64Codec& PickBase64Codec() {
+  for (const Base64Isa isa : {Base64Isa::kAvx2, Base64Isa::kNeon, Base64Isa::kSsse3}) {
+    if (const Base64Codec* codec = Base64CodecFor(isa)) {
+      return *codec;
+    }
+  }
+  return kScalarCodec;
+}
+
+}  // namespace
+
+const Base64Codec& ActiveBase64Codec() {
+  static const Base64Codec& codec = PickBase64Codec();
+  return codec;
+}
+
+const Base64Codec* Base64CodecFor(Base64Isa isa) {
+  switch (isa) {
+    case Base64Isa::kScalar:
+      return &kScalarCodec;
+#if BRIDGE_BASE64_X86
+    case Base64Isa::kSsse3: {
+      static const bool supported = CpuSupports(Base64Isa::kSsse3);
+      return supported ? &kSsse3Codec : nullptr;
+    }
+    case Base64Isa::kAvx2: {
+      static const bool supported = CpuSupports(Base64Isa::kAvx2);
+      return supported ? &kAvx2Codec : nullptr;
+    }
+#elif BRIDGE_BASE64_NEON
+    case Base64Isa::kNeon:
+      return &kNeonCodec;
+#endif
+    default:
+      return nullptr;
+  }
+}
+
+size_t Base64Encoder::Update(const void* data, size_t size, char* out) {
+  const auto* in = static_cast<const uint8_t*>(data);
+  size_t written = 0;
+  if (pending_size_ > 0 && pending_size_ + size >= 3) {
+    uint8_t group[3];
+    std::memcpy(group, pending_, pending_size_);
+    const size_t taken = 3 - pending_size_;
+    std::memcpy(group + pending_size_, in, taken);
+    written = EncodeGroupsScalar(group, 3, out);
+    in += taken;
+    size -= taken;
+    pending_size_ = 0;
+  }
+  if (pending_size_ > 0) {
+    std::memcpy(pending_ + pending_size_, in, size);
+    pending_size_ += size;
+    return written;
+  }
+  written += ActiveBase64Codec().encode_groups(in, size, out + written);
+  pending_size_ = size % 3;
+  if (pending_size_ > 0) {
+    std::memcpy(pending_, in + size - pending_size_, pending_size_);
+  }
+  return written;
+}
+
+size_t Base64Encoder::Finish(char* out) {
+  if (pending_size_ == 0) {
+    return 0;
+  }
+  const uint32_t bits = (static_cast<uint32_t>(pending_[0]) << 16) |
+                        (pending_size_ > 1 ? static_cast<uint32_t>(pending_[1]) << 8 : 0);
+  out[0] = kAlphabet[bits >> 18];
+  out[1] = kAlphabet[(bits >> 12) & 0x3F];
+  out[2] = pending_size_ > 1 ? kAlphabet[(bits >> 6) & 0x3F] : '=';
+  out[3] = '=';
+  pending_size_ = 0;
+  return 4;
+}
+
+bool Base64Decoder::Update(std::string_view text, void* out, size_t capacity, size_t* written) {
+  auto* dst = static_cast<uint8_t*>(out);
+  *written = 0;
+  if (!failed_ && pending_size_ > 0) {
+    const size_t taken = std::min(4 - pending_size_, text.size());
+    std::memcpy(pending_ + pending_size_, text.data(), taken);
+    pending_size_ += taken;
+    text.remove_prefix(taken);
+    if (pending_size_ == 4) {
+      failed_ = !DecodeGroup(pending_, dst, capacity, written);
+      pending_size_ = 0;
+    }
+  }
+  while (!failed_ && !text.empty()) {
+    if (padded_) {
+      failed_ = true;
+      break;
+    }
+    const size_t used =
+        ActiveBase64Codec().decode_groups(text.data(), text.size(), dst + *written, capacity - *written);
+    *written += used / 4 * 3;
+    text.remove_prefix(used);
+    if (text.size() < 4) {
+      std::memcpy(pending_, text.data(), text.size());
+      pending_size_ = text.size();
+      break;
+    }
+    // The kernels stop at padding, at a bad character and when out of room.
+    failed_ = !DecodeGroup(text.data(), dst, capacity, written);
+    text.remove_prefix(4);
+  }
+  return !failed_;
+}
+
+bool Base64Decoder::Finish(void* out, size_t capacity, size_t* written) {
+  *written = 0;
+  bool ok = !failed_ && pending_size_ != 1;
+  if (ok && pending_size_ > 1) {
+    std::fill(pending_ + pending_size_, pending_ + 4, '=');
+    ok = DecodeGroup(pending_, static_cast<uint8_t*>(out), capacity, written);
+  }
+  Reset();
+  return ok;
+}
+
+void Base64Decoder::Reset() {
+  pending_size_ = 0;
+  padded_ = false;
+  failed_ = false;
+}
+
+bool Base64Decoder::DecodeGroup(const char* group, uint8_t* out, size_t capacity, size_t* written) {
+  const uint32_t a = kDecodeTable[static_cast<uint8_t>(group[0])];
+  const uint32_t b = kDecodeTable[static_cast<uint8_t>(group[1])];
+  const uint32_t c = kDecodeTable[static_cast<uint8_t>(group[2])];
+  const uint32_t d = kDecodeTable[static_cast<uint8_t>(group[3])];
+  if ((a | b) > 0x3F) {
+    return false;
+  }
+  size_t bytes = 3;
+  if (group[3] == '=') {
+    bytes = group[2] == '=' ? 1 : 2;
+    if (bytes == 2 && c > 0x3F) {
+      return false;
+    }
+    padded_ = true;
+  } else if ((c | d) > 0x3F) {
+    return false;
+  }
+  if (*written + bytes > capacity) {
+    return false;
+  }
+  const uint32_t bits = (a << 18) | (b << 12) | (bytes > 1 ? c << 6 : 0) | (bytes > 2 ? d : 0);
+  for (size_t i = 0; i < bytes; ++i) {
+    out[(*written)++] = static_cast<uint8_t>(bits >> (16 - 8 * i));
+  }
+  return true;
+}
+
+size_t Base64Encode(const void* data, size_t size, char* out) {
+  Base64Encoder encoder;
+  const size_t written = encoder.Update(data, size, out);
+  return written + encoder.Finish(out + written);
+}
+
+bool Base64Decode(std::string_view text, void* out, size_t capacity, size_t* written) {
+  Base64Decoder decoder;
+  size_t tail = 0;
+  if (!decoder.Update(text, out, capacity, written) ||
+      !decoder.Finish(static_cast<uint8_t*>(out) + *written, capacity - *written, &tail)) {
+    return false;
+  }
+  *written += tail;
+  return true;
+}
+
+}  // namespace bridge
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace bridge {
+
+// RFC 4648 base64 (the standard alphabet, "=" padding) for audio that has to
+// travel inside JSON. Each direction has a scalar version and SSSE3 and AVX2
+// (x86-64) or NEON (arm64) versions; the first call picks the best set the
+// CPU supports. Output goes to buffers the caller sizes with
+// Base64EncodedSize() and Base64DecodedMaxSize().
+//
+// Decoding accepts a padded or unpadded last group and rejects anything else
+// outside the alphabet, including whitespace. The unused low bits of a last
+// group are not checked.
+enum class Base64Isa : uint8_t {
+  kScalar,
+  kSsse3,
+  kAvx2,
+  kNeon,
+};
+
+struct Base64Codec {
+  Base64Isa isa;
+  const char* name;
+  // Encodes size / 3 whole groups, without padding; returns the characters
+  // written.
+  size_t (*encode_groups)(const uint8_t* in, size_t size, char* out);
+  // Decodes whole groups of four alphabet characters, stopping at the first
+  // group holding anything else or once `capacity` bytes would not hold the
+  // next one; returns the characters consumed.
+  size_t (*decode_groups)(const char* in, size_t size, uint8_t* out, size_t capacity);
+};
+
+// The set in use.
+const Base64Codec& ActiveBase64Codec();
+// A particular set, or null if it was not built or the CPU lacks it.
+const Base64Codec* Base64CodecFor(Base64Isa isa);
+
+constexpr size_t Base64EncodedSize(size_t bytes) {
+  return (bytes + 2) / 3 * 4;
+}
+
+// The most bytes `chars` characters decode to.
+constexpr size_t Base64DecodedMaxSize(size_t chars) {
+  return chars / 4 * 3 + chars % 4 * 3 / 4;
+}
+
+// Encodes in pieces, carrying up to two bytes from one call to the next.
+// `out` must hold Base64EncodedSize(size + 2) characters for Update() and
+// four for Finish().
+class Base64Encoder {
+ public:
+  size_t Update(const void* data, size_t size, char* out);
+  // Writes the last group, padded, and starts over.
+  size_t Finish(char* out);
+
+ private:
+  uint8_t pending_[2] = {};
+  size_t pending_size_ = 0;
+};
+
+// Decodes in pieces, carrying up to three characters from one call to the
+// next. Each call writes at most `capacity` bytes to `out` and sets
+// `written`; it returns false once the text is malformed or a call's output
+// does not fit, and keeps doing so until Reset().
+class Base64Decoder {
+ public:
+  bool Update(std::string_view text, void* out, size_t capacity, size_t* written);
+  // The end of the text: decodes an unpadded last group.
+  bool Finish(void* out, size_t capacity, size_t* written);
+  void Reset();
+
+ private:
+  // Decodes one group of four, which may be padded.
+  bool DecodeGroup(const char* group, uint8_t* out, size_t capacity, size_t* written);
+
+  char pending_[4] = {};
+  size_t pending_size_ = 0;
+  bool padded_ = false;
+  bool failed_ = false;
+};
+
+// Entry points for a whole buffer. Base64Encode() returns
+// Base64EncodedSize(size).
+size_t Base64Encode(const void* data, size_t size, char* out);
+bool Base64Decode(std::string_view text, void* out, size_t capacity, size_t* written);
+
+}  // namespace bridge
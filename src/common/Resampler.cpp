@@ -0,0 +1,151 @@
+#include "Resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+namespace bridge {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Zeroth-order modified Bessel function of the first kind, for the Kaiser
+// window.
+double BesselI0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; term > 1e-12 * sum; ++k) {
+    const double half = x / (2.0 * k);
+    term *= half * half;
+    sum += term;
+  }
+  return sum;
+}
+
+double KaiserBeta(double stopband_db) {
+  if (stopband_db > 50.0) {
+    return 0.1102 * (stopband_db - 8.7);
+  }
+  if (stopband_db >= 21.0) {
+    return 0.5842 * std::pow(stopband_db - 21.0, 0.4) + 0.07886 * (stopband_db - 21.0);
+  }
+  return 0.0;
+}
+
+float Dot(const float* a, const float* b, size_t n) {
+  size_t i = 0;
+  float sum = 0.0f;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+  float32x4_t acc0 = vdupq_n_f32(0.0f);
+  float32x4_t acc1 = vdupq_n_f32(0.0f);
+  for (; i + 8 <= n; i += 8) {
+    acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+    acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+  }
+  sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+#elif defined(__SSE__)
+  __m128 acc0 = _mm_setzero_ps();
+  __m128 acc1 = _mm_setzero_ps();
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+  sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+  for (; i < n; ++i) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+}  // namespace
+
+Resampler::Resampler(uint32_t input_rate, uint32_t output_rate) : Resampler(input_rate, output_rate, Options{}) {}
+
+Resampler::Resampler(uint32_t input_rate, uint32_t output_rate, Options options) {
+  input_rate = std::max<uint32_t>(input_rate, 1);
+  output_rate = std::max<uint32_t>(output_rate, 1);
+  const uint32_t divisor = std::gcd(input_rate, output_rate);
+  interpolation_ = output_rate / divisor;
+  decimation_ = input_rate / divisor;
+
+  if (interpolation_ == 1 && decimation_ == 1) {
+    taps_ = 1;
+    coefficients_ = {1.0f};
+    Reset();
+    return;
+  }
+
+  // The prototype low-pass runs at input_rate * interpolation_, where the
+  // input has interpolation_ - 1 zeros stuffed between its samples.
+  const double prototype_rate = static_cast<double>(input_rate) * interpolation_;
+  const double nyquist = 0.5 * std::min(input_rate, output_rate);
+  const double transition = (1.0 - options.passband) * nyquist;
+  const double cutoff = nyquist - 0.5 * transition;
+  const double length = (options.stopband_db - 7.95) / (14.36 * transition / prototype_rate) + 1.0;
+  taps_ = static_cast<size_t>(std::ceil(length / interpolation_));
+  taps_ = (taps_ + 3) & ~size_t{3};
+
+  const size_t total = taps_ * interpolation_;
+  const double center = 0.5 * static_cast<double>(total - 1);
+  const double beta = KaiserBeta(options.stopband_db);
+  const double window_scale = BesselI0(beta);
+  const double normalized_cutoff = 2.0 * cutoff / prototype_rate;
+  std::vector<double> prototype(total);
+  double sum = 0.0;
+  for (size_t i = 0; i < total; ++i) {
+    const double x = static_cast<double>(i) - center;
+    const double sinc = x == 0.0 ? 1.0 : std::sin(kPi * normalized_cutoff * x) / (kPi * normalized_cutoff * x);
+    const double r = x / center;
+    const double window = BesselI0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / window_scale;
+    prototype[i] = sinc * window;
+    sum += prototype[i];
+  }
+  // Unity gain at DC for every phase, making up for the stuffed zeros.
+  const double gain = static_cast<double>(interpolation_) / sum;
+
+  coefficients_.resize(total);
+  for (uint32_t phase = 0; phase < interpolation_; ++phase) {
+    for (size_t j = 0; j < taps_; ++j) {
+      coefficients_[phase * taps_ + j] =
+          static_cast<float>(gain * prototype[phase + (taps_ - 1 - j) * interpolation_]);
+    }
+  }
+  Reset();
+}
+
+void Resampler::Reset() {
+  history_.assign(taps_ - 1, 0.0f);
+  next_ = 0;
+  phase_ = 0;
+}
+
+size_t Resampler::Process(const float* input, size_t count, float* output, size_t capacity) {
+  history_.insert(history_.end(), input, input + count);
+  size_t written = 0;
+  while (written < capacity && next_ + taps_ <= history_.size()) {
+    output[written++] = Dot(coefficients_.data() + phase_ * taps_, history_.data() + next_, taps_);
+    phase_ += decimation_;
+    next_ += phase_ / interpolation_;
+    phase_ %= interpolation_;
+  }
+  const size_t consumed = std::min(next_, history_.size());
+  history_.erase(history_.begin(), history_.begin() + static_cast<std::ptrdiff_t>(consumed));
+  next_ -= consumed;
+  return written;
+}
+
+size_t Resampler::OutputCapacity(size_t count) const {
+  return (history_.size() + count) * interpolation_ / decimation_ + 1;
+}
+
+}  // namespace bridge
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bridge {
+
+// Converts one channel of float audio between two sample rates whose ratio
+// reduces to L/M, as a polyphase windowed-sinc (Kaiser) filter. State
+// carries over from one Process() call to the next, so a stream cut into
+// blocks of any size comes out as if it had been converted in one piece;
+// callers downmix or duplicate channels themselves.
+//
+// The filter passes everything below `passband` of the lower rate's Nyquist
+// frequency and attenuates by `stopband_db` from that Nyquist frequency up,
+// so nothing above it aliases into the output. Output lags input by the
+// filter's group delay, taps_per_phase() / 2 samples at the input rate:
+// with the defaults, 2.25 ms from 48 kHz to 16 kHz (216 taps) and from
+// 16 kHz to 48 kHz (72 taps), 1.5 ms from 24 kHz and 0.8 ms from 44.1 kHz.
+class Resampler {
+ public:
+  struct Options {
+    double passband = 0.84;
+    double stopband_db = 90.0;
+  };
+
+  Resampler(uint32_t input_rate, uint32_t output_rate);
+  Resampler(uint32_t input_rate, uint32_t output_rate, Options options);
+
+  // Forgets the stream so far, as at construction.
+  void Reset();
+
+  // Converts `count` samples and writes up to `capacity` results to
+  // `output`, returning how many it wrote. Input whose output did not fit
+  // is kept for the next call. OutputCapacity(count) is always enough.
+  size_t Process(const float* input, size_t count, float* output, size_t capacity);
+  size_t OutputCapacity(size_t count) const;
+
+  uint32_t interpolation() const {
+    return interpolation_;
+  }
+  uint32_t decimation() const {
+    return decimation_;
+  }
+  // Multiply-adds per output sample.
+  size_t taps_per_phase() const {
+    return taps_;
+  }
+
+ private:
+  uint32_t interpolation_ = 1;
+  uint32_t decimation_ = 1;
+  size_t taps_ = 0;
+  // interpolation_ rows of taps_ coefficients, each row reversed so that an
+  // output is the dot product of a row with taps_ consecutive inputs.
+  std::vector<float> coefficients_;
+  // The last taps_ - 1 inputs consumed, then inputs not yet consumed.
+  std::vector<float> history_;
+  size_t next_ = 0;
+  uint32_t phase_ = 0;
+};
+
+}  // namespace bridge
@@ -0,0 +1,553 @@
+#include "SampleKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__SSE2__)
+#define BRIDGE_SAMPLE_KERNELS_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define BRIDGE_SAMPLE_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace bridge {
+
+namespace {
+
+constexpr float kInt16Scale = 32767.0f;
+constexpr float kInt16Inverse = 1.0f / 32768.0f;
+// TpdfDither::Fill() works in chunks of this many samples.
+constexpr size_t kDitherChunk = 256;
+
+// The scalar versions are also the tails of the SIMD ones. The clamps are
+// written the way SSE's max and min treat NaN, and scaling and noise are
+// separate statements so that no compiler fuses them into one rounding.
+
+int16_t ToInt16(float x, float noise) {
+  x = x > -1.0f ? x : -1.0f;
+  x = x < 1.0f ? x : 1.0f;
+  float scaled = x * kInt16Scale;
+  scaled += noise;
+  return static_cast<int16_t>(std::clamp(std::lrintf(scaled), -32768L, 32767L));
+}
+
+void FloatToInt16Scalar(const float* in, const float* noise, void* out, size_t count) {
+  auto* dst = static_cast<uint8_t*>(out);
+  for (size_t i = 0; i < count; ++i) {
+    const int16_t sample = ToInt16(in[i], noise != nullptr ? noise[i] : 0.0f);
+    std::memcpy(dst + i * sizeof(int16_t), &sample, sizeof(sample));
+  }
+}
+
+void Int16ToFloatScalar(const void* in, float* out, size_t count) {
+  const auto* src = static_cast<const uint8_t*>(in);
+  for (size_t i = 0; i < count; ++i) {
+    int16_t sample = 0;
+    std::memcpy(&sample, src + i * sizeof(int16_t), sizeof(sample));
+    out[i] = static_cast<float>(sample) * kInt16Inverse;
+  }
+}
+
+void InterleaveStereoScalar(const float* left, const float* right, float* out, size_t frames) {
+  for (size_t i = 0; i < frames; ++i) {
+    out[2 * i] = left[i];
+    out[2 * i + 1] = right[i];
+  }
+}
+
+void DeinterleaveStereoScalar(const float* in, float* left, float* right, size_t frames) {
+  for (size_t i = 0; i < frames; ++i) {
+    left[i] = in[2 * i];
+    right[i] = in[2 * i + 1];
+  }
+}
+
+void StereoToMonoScalar(const float* in, float* out, size_t frames) {
+  for (size_t i = 0; i < frames; ++i) {
+    out[i] = (in[2 * i] + in[2 * i + 1]) * 0.5f;
+  }
+}
+
+void MonoToStereoScalar(const float* in, float* out, size_t frames) {
+  for (size_t i = 0; i < frames; ++i) {
+    out[2 * i] = in[i];
+    out[2 * i + 1] = in[i];
+  }
+}
+
+void ApplyGainScalar(float* samples, size_t count, float gain) {
+  for (size_t i = 0; i < count; ++i) {
+    samples[i] *= gain;
+  }
+}
+
+constexpr SampleKernels kScalarKernels = {
+    .isa = SampleKernelIsa::kScalar,
+    .name = "scalar",
+    .float_to_int16 = FloatToInt16Scalar,
+    .int16_to_float = Int16ToFloatScalar,
+    .interleave_stereo = InterleaveStereoScalar,
+    .deinterleave_stereo = DeinterleaveStereoScalar,
+    .stereo_to_mono = StereoToMonoScalar,
+    .mono_to_stereo = MonoToStereoScalar,
+    .apply_gain = ApplyGainScalar,
+};
+
+#if BRIDGE_SAMPLE_KERNELS_X86
+
+void FloatToInt16Sse2(const float* in, const float* noise, void* out, size_t count) {
+  const __m128 low = _mm_set1_ps(-1.0f);
+  const __m128 high = _mm_set1_ps(1.0f);
+  const __m128 scale = _mm_set1_ps(kInt16Scale);
+  auto* dst = static_cast<uint8_t*>(out);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128 a = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i), low), high), scale);
+    __m128 b = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i + 4), low), high), scale);
+    if (noise != nullptr) {
+      a = _mm_add_ps(a, _mm_loadu_ps(noise + i));
+      b = _mm_add_ps(b, _mm_loadu_ps(noise + i + 4));
+    }
+    const __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * sizeof(int16_t)), packed);
+  }
+  FloatToInt16Scalar(in + i, noise != nullptr ? noise + i : nullptr, dst + i * sizeof(int16_t), count - i);
+}
+
+void Int16ToFloatSse2(const void* in, float* out, size_t count) {
+  const __m128 scale = _mm_set1_ps(kInt16Inverse);
+  const auto* src = static_cast<const uint8_t*>(in);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * sizeof(int16_t)));
+    // Sign-extends by placing each sample in the top half of a 32-bit lane.
+    const __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+    const __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+    _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+  }
+  Int16ToFloatScalar(src + i * sizeof(int16_t), out + i, count - i);
+}
+
+void InterleaveStereoSse2(const float* left, const float* right, float* out, size_t frames) {
+  size_t i = 0;
+  for (; i + 4 <= frames; i += 4) {
+    const __m128 l = _mm_loadu_ps(left + i);
+    const __m128 r = _mm_loadu_ps(right + i);
+    _mm_storeu_ps(out + 2 * i, _mm_unpacklo_ps(l, r));
+    _mm_storeu_ps(out + 2 * i + 4, _mm_unpackhi_ps(l, r));
+  }
+  InterleaveStereoScalar(left + i, right + i, out + 2 * i, frames - i);
+}
+
+void DeinterleaveStereoSse2(const float* in, float* left, float* right, size_t frames) {
+  size_t i = 0;
+  for (; i + 4 <= frames; i += 4) {
+    const __m128 a = _mm_loadu_ps(in + 2 * i);
+    const __m128 b = _mm_loadu_ps(in + 2 * i + 4);
+    _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+  DeinterleaveStereoScalar(in + 2 * i, left + i, right + i, frames - i);
+}
+
+void StereoToMonoSse2(const float* in, float* out, size_t frames) {
+  const __m128 half = _mm_set1_ps(0.5f);
+  size_t i = 0;
+  for (; i + 4 <= frames; i += 4) {
+    const __m128 a = _mm_loadu_ps(in + 2 * i);
+    const __m128 b = _mm_loadu_ps(in + 2 * i + 4);
+    const __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    const __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_add_ps(left, right), half));
+  }
+  StereoToMonoScalar(in + 2 * i, out + i, frames - i);
+}
+
+void MonoToStereoSse2(const float* in, float* out, size_t frames) {
+  size_t i = 0;
+  for (; i + 4 <= frames; i += 4) {
+    const __m128 m = _mm_loadu_ps(in + i);
+    _mm_storeu_ps(out + 2 * i, _mm_unpacklo_ps(m, m));
+    _mm_storeu_ps(out + 2 * i + 4, _mm_unpackhi_ps(m, m));
+  }
+  MonoToStereoScalar(in + i, out + 2 * i, frames - i);
+}
+
+void ApplyGainSse2(float* samples, size_t count, float gain) {
+  const __m128 g = _mm_set1_ps(gain);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), g));
+  }
+  ApplyGainScalar(samples + i, count - i, gain);
+}
+
+constexpr SampleKernels kSse2Kernels = {
+    .isa = SampleKernelIsa::kSse2,
+    .name = "sse2",
+    .float_to_int16 = FloatToInt16Sse2,
+    .int16_to_float = Int16ToFloatSse2,
+    .interleave_stereo = InterleaveStereoSse2,
+    .deinterleave_stereo = DeinterleaveStereoSse2,
+    .stereo_to_mono = StereoToMonoSse2,
+    .mono_to_stereo = MonoToStereoSse2,
+    .apply_gain = ApplyGainSse2,
+};
+
+// Built for AVX2 whatever the compiler's target; used only once the CPU
+// has been found to support it.
+#define BRIDGE_AVX2 __attribute__((target("avx2")))
+
+// Shuffles of two registers work within 128-bit lanes and leave 64-bit
+// pieces in the order 0, 2, 1, 3; this puts them back.
+BRIDGE_AVX2 __m256 Avx2Reorder(__m256 v) {
+  return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(v), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+BRIDGE_AVX2 void FloatToInt16Avx2(const float* in, const float* noise, void* out, size_t count) {
+  const __m256 low = _mm256_set1_ps(-1.0f);
+  const __m256 high = _mm256_set1_ps(1.0f);
+  const __m256 scale = _mm256_set1_ps(kInt16Scale);
+  auto* dst = static_cast<uint8_t*>(out);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256 a = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(in + i), low), high), scale);
+    __m256 b = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(in + i + 8), low), high), scale);
+    if (noise != nullptr) {
+      a = _mm256_add_ps(a, _mm256_loadu_ps(noise + i));
+      b = _mm256_add_ps(b, _mm256_loadu_ps(noise + i + 8));
+    }
+    // packs works within 128-bit lanes too, leaving a's and b's halves
+    // interleaved.
+    const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b)),
+                                                    _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * sizeof(int16_t)), packed);
+  }
+  FloatToInt16Sse2(in + i, noise != nullptr ? noise + i : nullptr, dst + i * sizeof(int16_t), count - i);
+}
+
+BRIDGE_AVX2 void Int16ToFloatAvx2(const void* in, float* out, size_t count) {
+  const __m256 scale = _mm256_set1_ps(kInt16Inverse);
+  const auto* src = static_cast<const uint8_t*>(in);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * sizeof(int16_t)));
+    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i + 8) * sizeof(int16_t)));
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(a)), scale));
+    _mm256_storeu_ps(out + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(b)), scale));
+  }
+  Int16ToFloatSse2(src + i * sizeof(int16_t), out + i, count - i);
+}
+
+BRIDGE_AVX2 void InterleaveStereoAvx2(const float* left, const float* right, float* out, size_t frames) {
+  size_t i = 0;
+  for (; i + 8 <= frames; i += 8) {
+    const __m256 l = _mm256_loadu_ps(left + i);
+    const __m256 r = _mm256_loadu_ps(right + i);
+    const __m256 low = _mm256_unpacklo_ps(l, r);
+    const __m256 high = _mm256_unpackhi_ps(l, r);
+    _mm256_storeu_ps(out + 2 * i, _mm256_permute2f128_ps(low, high, 0x20));
+    _mm256_storeu_ps(out + 2 * i + 8, _mm256_permute2f128_ps(low, high, 0x31));
+  }
+  InterleaveStereoSse2(left + i, right + i, out + 2 * i, frames - i);
+}
+
+BRIDGE_AVX2 void DeinterleaveStereoAvx2(const float* in, float* left, float* right, size_t frames) {
+  size_t i = 0;
+  for (; i + 8 <= frames; i += 8) {
+    const __m256 a = _mm256_loadu_ps(in + 2 * i);
+    const __m256 b = _mm256_loadu_ps(in + 2 * i + 8);
+    const __m256 l = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    const __m256 r = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    _mm256_storeu_ps(left + i, Avx2Reorder(l));
+    _mm256_storeu_ps(right + i, Avx2Reorder(r));
+  }
+  DeinterleaveStereoSse2(in + 2 * i, left + i, right + i, frames - i);
+}
+
+BRIDGE_AVX2 void StereoToMonoAvx2(const float* in, float* out, size_t frames) {
+  const __m256 half = _mm256_set1_ps(0.5f);
+  size_t i = 0;
+  for (; i + 8 <= frames; i += 8) {
+    const __m256 a = _mm256_loadu_ps(in + 2 * i);
+    const __m256 b = _mm256_loadu_ps(in + 2 * i + 8);
+    const __m256 left = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    const __m256 right = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    _mm256_storeu_ps(out + i, Avx2Reorder(_mm256_mul_ps(_mm256_add_ps(left, right), half)));
+  }
+  StereoToMonoSse2(in + 2 * i, out + i, frames - i);
+}
+
+BRIDGE_AVX2 void MonoToStereoAvx2(const float* in, float* out, size_t frames) {
+  size_t i = 0;
+  for (; i + 8 <= frames; i += 8) {
+    const __m256 m = _mm256_loadu_ps(in + i);
+    const __m256 low = _mm256_unpacklo_ps(m, m);
+    const __m256 high = _mm256_unpackhi_ps(m, m);
+    _mm256_storeu_ps(out + 2 * i, _mm256_permute2f128_ps(low, high, 0x20));
+    _mm256_storeu_ps(out + 2 * i + 8, _mm256_permute2f128_ps(low, high, 0x31));
+  }
+  MonoToStereoSse2(in + i, out + 2 * i, frames - i);
+}
+
+BRIDGE_AVX2 void ApplyGainAvx2(float* samples, size_t count, float gain) {
+  const __m256 g = _mm256_set1_ps(gain);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    _mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), g));
+  }
+  ApplyGainSse2(samples + i, count - i, gain);
+}
+
+#undef BRIDGE_AVX2
+
+constexpr SampleKernels kAvx2Kernels = {
+    .isa = SampleKernelIsa::kAvx2,
+    .name = "avx2",
+    .float_to_int16 = FloatToInt16Avx2,
+    .int16_to_float = Int16ToFloatAvx2,
+    .interleave_stereo = InterleaveStereoAvx2,
+    .deinterleave_stereo = DeinterleaveStereoAvx2,
+    .stereo_to_mono = StereoToMonoAvx2,
+    .mono_to_stereo = MonoToStereoAvx2,
+    .apply_gain = ApplyGainAvx2,
+};
+
+bool CpuHasAvx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+#elif BRIDGE_SAMPLE_KERNELS_NEON
+
+void FloatToInt16Neon(const float* in, const float* noise, void* out, size_t count) {
+  const float32x4_t low = vdupq_n_f32(-1.0f);
+  const float32x4_t high = vdupq_n_f32(1.0f);
+  auto* dst = static_cast<uint8_t*>(out);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    float32x4_t a = vld1q_f32(in + i);
+    float32x4_t b = vld1q_f32(in + i + 4);
+    // vmaxq_f32 would keep a NaN; selecting on a comparison maps it to -1
+    // as the other versions do.
+    a = vminq_f32(vbslq_f32(vcgtq_f32(a, low), a, low), high);
+    b = vminq_f32(vbslq_f32(vcgtq_f32(b, low), b, low), high);
+    a = vmulq_n_f32(a, kInt16Scale);
+    b = vmulq_n_f32(b, kInt16Scale);
+    if (noise != nullptr) {
+      a = vaddq_f32(a, vld1q_f32(noise + i));
+      b = vaddq_f32(b, vld1q_f32(noise + i + 4));
+    }
+    const int16x8_t packed = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)), vqmovn_s32(vcvtnq_s32_f32(b)));
+    vst1q_u8(dst + i * sizeof(int16_t), vreinterpretq_u8_s16(packed));
+  }
+  FloatToInt16Scalar(in + i, noise != nullptr ? noise + i : nullptr, dst + i * sizeof(int16_t), count - i);
+}
+
+void Int16ToFloatNeon(const void* in, float* out, size_t count) {
+  const auto* src = static_cast<const uint8_t*>(in);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const int16x8_t samples = vreinterpretq_s16_u8(vld1q_u8(src + i * sizeof(int16_t)));
+    vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples))), kInt16Inverse));
+    vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples))), kInt16Inverse));
+  }
+  Int16ToFloatScalar(src + i * sizeof(int16_t), out + i, count - i);
+}
+
+void InterleaveStereoNeon(const float* left, const float* right, float* out, size_t frames) {
+  size_t i = 0;
+  for (; i + 4 <= frames; i += 4) {
+    vst2q_f32(out + 2 * i, (float32x4x2_t{{vld1q_f32(left + i), vld1q_f32(right + i)}}));
+  }
+  InterleaveStereoScalar(left + i, right + i, out + 2 * i, frames - i);
+}
+
+void DeinterleaveStereoNeon(const float* in, float* left, float* right, size_t frames) {
+  size_t i = 0;
+  for (; i + 4 <= frames; i += 4) {
+    const float32x4x2_t lr = vld2q_f32(in + 2 * i);
+    vst1q_f32(left + i, lr.val[0]);
+    vst1q_f32(right + i, lr.val[1]);
+  }
+  DeinterleaveStereoScalar(in + 2 * i, left + i, right + i, frames - i);
+}
+
+void StereoToMonoNeon(const float* in, float* out, size_t frames) {
+  size_t i = 0;
+  for (; i + 4 <= frames; i += 4) {
+    const float32x4x2_t lr = vld2q_f32(in + 2 * i);
+    vst1q_f32(out + i, vmulq_n_f32(vaddq_f32(lr.val[0], lr.val[1]), 0.5f));
+  }
+  StereoToMonoScalar(in + 2 * i, out + i, frames - i);
+}
+
+void MonoToStereoNeon(const float* in, float* out, size_t frames) {
+  size_t i = 0;
+  for (; i + 4 <= frames; i += 4) {
+    const float32x4_t m = vld1q_f32(in + i);
+    vst2q_f32(out + 2 * i, (float32x4x2_t{{m, m}}));
+  }
+  MonoToStereoScalar(in + i, out + 2 * i, frames - i);
+}
+
+void ApplyGainNeon(float* samples, size_t count, float gain) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    vst1q_f32(samples + i, vmulq_n_f32(vld1q_f32(samples + i), gain));
+  }
+  ApplyGainScalar(samples + i, count - i, gain);
+}
+
+constexpr SampleKernels kNeonKernels = {
+    .isa = SampleKernelIsa::kNeon,
+    .name = "neon",
+    .float_to_int16 = FloatToInt16Neon,
+    .int16_to_float = Int16ToFloatNeon,
+    .interleave_stereo = InterleaveStereoNeon,
+    .deinterleave_stereo = DeinterleaveStereoNeon,
+    .stereo_to_mono = StereoToMonoNeon,
+    .mono_to_stereo = MonoToStereoNeon,
+    .apply_gain = ApplyGainNeon,
+};
+
+#endif
+
+const SampleKernels& PickSampleKernels() {
+  for (const SampleKernelIsa isa : {SampleKernelIsa::kAvx2, SampleKernelIsa::kNeon, SampleKernelIsa::kSse2}) {
+    if (const SampleKernels* kernels = SampleKernelsFor(isa)) {
+      return *kernels;
+    }
+  }
+  return kScalarKernels;
+}
+
+}  // namespace
+
+const SampleKernels& ActiveSampleKernels() {
+  static const SampleKernels& kernels = PickSampleKernels();
+  return kernels;
+}
+
+const SampleKernels* SampleKernelsFor(SampleKernelIsa isa) {
+  switch (isa) {
+    case SampleKernelIsa::kScalar:
+      return &kScalarKernels;
+#if BRIDGE_SAMPLE_KERNELS_X86
+    case SampleKernelIsa::kSse2:
+      return &kSse2Kernels;
+    case SampleKernelIsa::kAvx2: {
+      static const bool supported = CpuHasAvx2();
+      return supported ? &kAvx2Kernels : nullptr;
+    }
+#elif BRIDGE_SAMPLE_KERNELS_NEON
+    case SampleKernelIsa::kNeon:
+      return &kNeonKernels;
+#endif
+    default:
+      return nullptr;
+  }
+}
+
+void TpdfDither::Fill(float* noise, size_t count) {
+  constexpr float kUnit = 1.0f / 16777216.0f;
+  uint32_t x = state_;
+  for (size_t i = 0; i < count; ++i) {
+    // Two xorshift32 draws; their difference has a triangular distribution.
+    float pair[2];
+    for (float& value : pair) {
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      value = static_cast<float>(x >> 8) * kUnit;
+    }
+    noise[i] = pair[0] - pair[1];
+  }
+  state_ = x;
+}
+
+void FloatToInt16(const float* in, void* out, size_t count, TpdfDither* dither) {
+  const SampleKernels& kernels = ActiveSampleKernels();
+  if (dither == nullptr) {
+    kernels.float_to_int16(in, nullptr, out, count);
+    return;
+  }
+  float noise[kDitherChunk];
+  auto* dst = static_cast<uint8_t*>(out);
+  for (size_t done = 0; done < count;) {
+    const size_t n = std::min(count - done, kDitherChunk);
+    dither->Fill(noise, n);
+    kernels.float_to_int16(in + done, noise, dst + done * sizeof(int16_t), n);
+    done += n;
+  }
+}
+
+void Int16ToFloat(const void* in, float* out, size_t count) {
+  ActiveSampleKernels().int16_to_float(in, out, count);
+}
+
+void Interleave(const float* const* planes, uint32_t channels, size_t frames, float* out) {
+  if (channels == 2) {
+    ActiveSampleKernels().interleave_stereo(planes[0], planes[1], out, frames);
+    return;
+  }
+  for (size_t i = 0; i < frames; ++i) {
+    for (uint32_t ch = 0; ch < channels; ++ch) {
+      out[i * channels + ch] = planes[ch][i];
+    }
+  }
+}
+
+void Deinterleave(const float* in, uint32_t channels, size_t frames, float* const* planes) {
+  if (channels == 2) {
+    ActiveSampleKernels().deinterleave_stereo(in, planes[0], planes[1], frames);
+    return;
+  }
+  for (size_t i = 0; i < frames; ++i) {
+    for (uint32_t ch = 0; ch < channels; ++ch) {
+      planes[ch][i] = in[i * channels + ch];
+    }
+  }
+}
+
+void DownmixToMono(const float* in, uint32_t channels, size_t frames, float* out) {
+  if (channels == 2) {
+    ActiveSampleKernels().stereo_to_mono(in, out, frames);
+    return;
+  }
+  if (channels <= 1) {
+    std::memmove(out, in, frames * sizeof(float));
+    return;
+  }
+  const float scale = 1.0f / static_cast<float>(channels);
+  for (size_t i = 0; i < frames; ++i) {
+    float sum = 0.0f;
+    for (uint32_t ch = 0; ch < channels; ++ch) {
+      sum += in[i * channels + ch];
+    }
+    out[i] = sum * scale;
+  }
+}
+
+void UpmixFromMono(const float* in, uint32_t channels, size_t frames, float* out) {
+  if (channels == 2) {
+    ActiveSampleKernels().mono_to_stereo(in, out, frames);
+    return;
+  }
+  if (channels <= 1) {
+    std::memmove(out, in, frames * sizeof(float));
+    return;
+  }
+  for (size_t i = 0; i < frames; ++i) {
+    std::fill_n(out + i * channels, channels, in[i]);
+  }
+}
+
+void ApplyGain(float* samples, size_t count, float gain) {
+  ActiveSampleKernels().apply_gain(samples, count, gain);
+}
+
+}  // namespace bridge
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace bridge {
+
+// Sample format and channel layout conversions for the audio paths, each
+// with a scalar version and SSE2 and AVX2 (x86-64) or NEON (arm64) versions.
+// The first call picks the best set the CPU supports; every set gives the
+// same results bit for bit.
+//
+// Float samples are full scale at +-1.0. 16-bit samples are host-endian and
+// need not be aligned: int16 -> float divides by 32768, float -> int16
+// clamps to +-1.0, scales by 32767 and rounds to nearest, saturating. NaN
+// becomes -32767.
+enum class SampleKernelIsa : uint8_t {
+  kScalar,
+  kSse2,
+  kAvx2,
+  kNeon,
+};
+
+struct SampleKernels {
+  SampleKernelIsa isa;
+  const char* name;
+  // `noise`, when not null, holds one value per sample added after scaling,
+  // in LSBs.
+  void (*float_to_int16)(const float* in, const float* noise, void* out, size_t count);
+  void (*int16_to_float)(const void* in, float* out, size_t count);
+  void (*interleave_stereo)(const float* left, const float* right, float* out, size_t frames);
+  void (*deinterleave_stereo)(const float* in, float* left, float* right, size_t frames);
+  void (*stereo_to_mono)(const float* in, float* out, size_t frames);
+  void (*mono_to_stereo)(const float* in, float* out, size_t frames);
+  void (*apply_gain)(float* samples, size_t count, float gain);
+};
+
+// The set in use.
+const SampleKernels& ActiveSampleKernels();
+// A particular set, or null if it was not built or the CPU lacks it.
+const SampleKernels* SampleKernelsFor(SampleKernelIsa isa);
+
+// Triangular (TPDF) dither one LSB either side, for one stream at a time.
+class TpdfDither {
+ public:
+  explicit TpdfDither(uint32_t seed = 0x9e3779b9u) : state_(seed != 0 ? seed : 1) {}
+
+  void Fill(float* noise, size_t count);
+
+ private:
+  uint32_t state_;
+};
+
+// Entry points over the active set. The channel-count versions take the
+// SIMD path for stereo and a scalar loop otherwise; mono in and out is a
+// copy.
+void FloatToInt16(const float* in, void* out, size_t count, TpdfDither* dither = nullptr);
+void Int16ToFloat(const void* in, float* out, size_t count);
+void Interleave(const float* const* planes, uint32_t channels, size_t frames, float* out);
+void Deinterleave(const float* in, uint32_t channels, size_t frames, float* const* planes);
+// Averages the channels of each frame.
+void DownmixToMono(const float* in, uint32_t channels, size_t frames, float* out);
+// Copies each mono sample to every channel.
+void UpmixFromMono(const float* in, uint32_t channels, size_t frames, float* out);
+void ApplyGain(float* samples, size_t count, float gain);
+
+}  // namespace bridge
@@ -141,13 +141,13 @@ size_t SharedMemoryAudioRing::Write(const float* interleaved_frames, size_t fram
     return 0;
   }
 
+  // At most two copies: up to the end of the buffer, then from its start.
   float* data = DataStart();
-  for (uint32_t frame = 0; frame < to_write; ++frame) {
-    const uint32_t dst_frame = (write + frame) % capacity;
-    const size_t src_idx = static_cast<size_t>(frame) * channels;
-    const size_t dst_idx = static_cast<size_t>(dst_frame) * channels;
-    std::memcpy(&data[dst_idx], &interleaved_frames[src_idx], sizeof(float) * channels);
-  }
+  const uint32_t offset = write % capacity;
+  const uint32_t first = MinU32(to_write, capacity - offset);
+  const size_t frame_bytes = sizeof(float) * channels;
+  std::memcpy(&data[static_cast<size_t>(offset) * channels], interleaved_frames, frame_bytes * first);
+  std::memcpy(data, &interleaved_frames[static_cast<size_t>(first) * channels], frame_bytes * (to_write - first));
 
   header_->write_index.store(write + to_write, std::memory_order_release);
   return to_write;
@@ -168,18 +168,65 @@ size_t SharedMemoryAudioRing::Read(float* interleaved_frames, size_t frame_count
     return 0;
   }
 
-  float* data = DataStart();
+  const float* data = DataStart();
+  const uint32_t offset = read % capacity;
+  const uint32_t first = MinU32(to_read, capacity - offset);
+  const size_t frame_bytes = sizeof(float) * channels;
+  std::memcpy(interleaved_frames, &data[static_cast<size_t>(offset) * channels], frame_bytes * first);
+  std::memcpy(&interleaved_frames[static_cast<size_t>(first) * channels], data, frame_bytes * (to_read - first));
+
+  header_->read_index.store(read + to_read, std::memory_order_release);
+  return to_read;
+}
+
+size_t SharedMemoryAudioRing::Peek(uint32_t* cursor, float* interleaved_frames, size_t frame_count) const {
+  if (header_ == nullptr || cursor == nullptr || interleaved_frames == nullptr || frame_count == 0) {
+    return 0;
+  }
+
+  const uint32_t channels = header_->channels;
+  const uint32_t capacity = header_->capacity_frames;
+  const uint32_t window = capacity - capacity / 4;
+  const uint32_t write = header_->write_index.load(std::memory_order_acquire);
+  if (write - *cursor > window) {
+    *cursor = write - window;
+  }
+  const uint32_t start = *cursor;
+  const uint32_t to_read = static_cast<uint32_t>(MinSizeT(frame_count, write - start));
+  if (to_read == 0) {
+    return 0;
+  }
+
+  const float* data = DataStart();
   for (uint32_t frame = 0; frame < to_read; ++frame) {
-    const uint32_t src_frame = (read + frame) % capacity;
+    const uint32_t src_frame = (start + frame) % capacity;
     const size_t src_idx = static_cast<size_t>(src_frame) * channels;
     const size_t dst_idx = static_cast<size_t>(frame) * channels;
     std::memcpy(&interleaved_frames[dst_idx], &data[src_idx], sizeof(float) * channels);
   }
 
-  header_->read_index.store(read + to_read, std::memory_order_release);
+  const uint32_t write_after = header_->write_index.load(std::memory_order_acquire);
+  if (write_after - start > window) {
+    *cursor = write_after - window;
+    return 0;
+  }
+  *cursor = start + to_read;
   return to_read;
 }
 
+uint32_t SharedMemoryAudioRing::write_index() const {
+  return header_ == nullptr ? 0 : header_->write_index.load(std::memory_order_acquire);
+}
+
+uint32_t SharedMemoryAudioRing::available_frames() const {
+  if (header_ == nullptr) {
+    return 0;
+  }
+  const uint32_t write = header_->write_index.load(std::memory_order_acquire);
+  const uint32_t read = header_->read_index.load(std::memory_order_acquire);
+  return MinU32(write - read, header_->capacity_frames);
+}
+
 uint32_t SharedMemoryAudioRing::channels() const {
   return header_ == nullptr ? 0 : header_->channels;
 }
@@ -21,6 +21,16 @@ class SharedMemoryAudioRing {
   size_t Write(const float* interleaved_frames, size_t frame_count);
   size_t Read(float* interleaved_frames, size_t frame_count);
 
+  // Copies frames from *cursor onwards without consuming them, for a reader
+  // that shadows the ring's own consumer. The producer refills slots once
+  // the consumer has passed them, so a cursor more than three quarters of
+  // the ring behind the writer jumps forward and frames that may have been
+  // overwritten during the copy are discarded.
+  size_t Peek(uint32_t* cursor, float* interleaved_frames, size_t frame_count) const;
+  uint32_t write_index() const;
+  // Frames written and not yet consumed.
+  uint32_t available_frames() const;
+
   uint32_t channels() const;
   uint32_t capacity_frames() const;
   bool is_open() const;
@@ -11,8 +11,25 @@ let package = Package(
         .executable(name: "bridge_companion", targets: ["BridgeCompanion"]),
     ],
     targets: [
+        .target(
+            name: "HelperAtomics",
+            path: "Sources/HelperAtomics"
+        ),
+        .target(
+            name: "HelperBase64",
+            path: "Sources/HelperBase64"
+        ),
+        .target(
+            name: "HelperResampler",
+            path: "Sources/HelperResampler"
+        ),
+        .target(
+            name: "HelperSampleKernels",
+            path: "Sources/HelperSampleKernels"
+        ),
         .executableTarget(
             name: "EngineHelper",
+            dependencies: ["HelperAtomics", "HelperBase64", "HelperResampler", "HelperSampleKernels"],
             path: "Sources/EngineHelper",
             swiftSettings: [
                 .unsafeFlags(["-Xfrontend", "-strict-concurrency=minimal"]),
@@ -25,5 +42,6 @@ let package = Package(
                 .unsafeFlags(["-Xfrontend", "-strict-concurrency=minimal"]),
             ]
         ),
-    ]
+    ],
+    cxxLanguageStandard: .cxx20
 )
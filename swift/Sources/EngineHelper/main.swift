@@ -3,24 +3,371 @@ import Foundation
 import Speech
 
 import Darwin
+import HelperAtomics
+import HelperBase64
+import HelperResampler
+import HelperSampleKernels
 
 private let kMagic: UInt32 = 0x53415242
 private let kVersion: UInt32 = 1
 
-private final class LineEmitter {
+// Messages to and from the bridge are framed (see src/app/HelperFrame.h):
+// a 12-byte little-endian header of kind, reserved bytes, payload length and
+// attachment length, then the JSON payload and the attachment. With
+// --ipc=shared_memory the messages go through two SharedMemoryMessageRings
+// instead and the pipes carry only doorbell frames. Without an --ipc
+// argument the helper speaks one JSON object per line so it can be driven by
+// hand. With --control-fd=N, control commands (tts_cancel, stop_stt, disable
+// and shutdown) arrive as frames on descriptor N, ahead of the queue.
+// Synthesized speech goes to the bridge as tts_audio events with the PCM as
+// their attachment; the bridge paces it into the audio rings.
+// stderr is the helper's log: one line per entry, prefixed "debug:",
+// "info:", "warn:" or "error:".
+private enum IpcMode {
+    case framed
+    case jsonLines
+    case sharedMemory(commands: SharedMemoryMessageRing, events: SharedMemoryMessageRing)
+
+    static func fromArguments(_ arguments: [String]) -> IpcMode {
+        func value(_ prefix: String) -> String? {
+            arguments.first { $0.hasPrefix(prefix) }.map { String($0.dropFirst(prefix.count)) }
+        }
+
+        switch value("--ipc=") {
+        case "framed":
+            return .framed
+        case "shared_memory":
+            let commands = SharedMemoryMessageRing()
+            let events = SharedMemoryMessageRing()
+            guard let commandName = value("--command-ring="), let eventName = value("--event-ring="),
+                  commands.open(name: commandName), events.open(name: eventName)
+            else {
+                FileHandle.standardError.write(Data("error: cannot open the message rings\n".utf8))
+                exit(1)
+            }
+            return .sharedMemory(commands: commands, events: events)
+        default:
+            return .jsonLines
+        }
+    }
+}
+
+private func controlFdFromArguments(_ arguments: [String]) -> Int32? {
+    let prefix = "--control-fd="
+    return arguments.first { $0.hasPrefix(prefix) }.flatMap { Int32($0.dropFirst(prefix.count)) }
+}
+
+private let kFrameHeaderBytes = 12
+private let kFrameKindJSON: UInt8 = 1
+private let kFrameKindDoorbell: UInt8 = 2
+private let kMaxFrameBytes = 64 * 1024 * 1024
+
+private func frameHeader(kind: UInt8, payloadBytes: Int, attachmentBytes: Int = 0) -> [UInt8] {
+    var header = [UInt8](repeating: 0, count: kFrameHeaderBytes)
+    header[0] = kind
+    for i in 0 ..< 4 {
+        header[4 + i] = UInt8(truncatingIfNeeded: payloadBytes >> (8 * i))
+        header[8 + i] = UInt8(truncatingIfNeeded: attachmentBytes >> (8 * i))
+    }
+    return header
+}
+
+private final class MessageEmitter {
+    // How long emit() waits for the bridge to make room in a full event ring
+    // before the event is dropped.
+    private static let ringFullTimeoutMicroseconds = 1_000_000
+
+    private let mode: IpcMode
     private let lock = NSLock()
 
-    func emit(_ object: [String: Any]) {
+    init(mode: IpcMode) {
+        self.mode = mode
+    }
+
+    /// Sends one event. `attachment` carries raw bytes such as PCM: as the
+    /// frame's attachment, after a NUL in a ring message, or as base64 in an
+    /// "attachment" field in json_lines mode.
+    func emit(_ object: [String: Any], attachment: Data = Data()) {
+        var object = object
+        if case .jsonLines = mode, !attachment.isEmpty {
+            object["attachment"] = attachment.base64AudioString()
+        }
         guard JSONSerialization.isValidJSONObject(object),
-              let data = try? JSONSerialization.data(withJSONObject: object, options: [])
+              var payload = try? JSONSerialization.data(withJSONObject: object, options: [])
         else {
             return
         }
 
+        var message = Data(capacity: kFrameHeaderBytes + payload.count + attachment.count + 1)
+        switch mode {
+        case .framed:
+            message.append(contentsOf: frameHeader(
+                kind: kFrameKindJSON, payloadBytes: payload.count, attachmentBytes: attachment.count))
+            message.append(payload)
+            message.append(attachment)
+        case .jsonLines:
+            message.append(payload)
+            message.append(0x0A)
+        case .sharedMemory(_, let events):
+            if !attachment.isEmpty {
+                payload.append(0)
+                payload.append(attachment)
+            }
+            lock.lock()
+            defer { lock.unlock() }
+            var waited = 0
+            while !events.write(payload) {
+                if payload.count > events.maxMessageBytes || waited >= Self.ringFullTimeoutMicroseconds {
+                    FileHandle.standardError.write(Data("warn: event ring is full; dropping an event\n".utf8))
+                    return
+                }
+                usleep(100)
+                waited += 100
+            }
+            if events.takeWakeup() {
+                FileHandle.standardOutput.write(Data(frameHeader(kind: kFrameKindDoorbell, payloadBytes: 0)))
+            }
+            return
+        }
+
+        // One write per message keeps frames from interleaving.
         lock.lock()
         defer { lock.unlock() }
-        FileHandle.standardOutput.write(data)
-        FileHandle.standardOutput.write(Data([0x0A]))
+        FileHandle.standardOutput.write(message)
+    }
+}
+
+// Reads frames from stdin, or another descriptor, straight into one buffer
+// and returns each payload as a slice of it; only an unfinished frame is
+// moved to the front before the next read.
+private final class FrameReader {
+    private static let readBytes = 64 * 1024
+
+    private let fd: Int32
+    private var buffer = Data()
+    private var begin = 0
+
+    init(fd: Int32 = STDIN_FILENO) {
+        self.fd = fd
+    }
+
+    /// The next frame's kind and payload, or nil at end of input or on a
+    /// malformed frame. The helper takes no attachments yet; they are
+    /// skipped with their frame.
+    func next() -> (kind: UInt8, payload: Data)? {
+        while true {
+            let available = buffer.count - begin
+            if available >= kFrameHeaderBytes {
+                let base = buffer.startIndex + begin
+                let payloadBytes = readU32(at: base + 4)
+                let attachmentBytes = readU32(at: base + 8)
+                guard payloadBytes + attachmentBytes <= kMaxFrameBytes else {
+                    return nil
+                }
+                let frameBytes = kFrameHeaderBytes + payloadBytes + attachmentBytes
+                if available >= frameBytes {
+                    begin += frameBytes
+                    let start = base + kFrameHeaderBytes
+                    return (buffer[base], buffer[start ..< start + payloadBytes])
+                }
+            }
+            if !fill() {
+                return nil
+            }
+        }
+    }
+
+    private func fill() -> Bool {
+        if begin > 0 {
+            buffer.removeSubrange(buffer.startIndex ..< buffer.startIndex + begin)
+            begin = 0
+        }
+        let used = buffer.count
+        buffer.count = used + FrameReader.readBytes
+        while true {
+            let n = buffer.withUnsafeMutableBytes { raw in
+                Darwin.read(fd, raw.baseAddress! + used, FrameReader.readBytes)
+            }
+            if n < 0 && errno == EINTR {
+                continue
+            }
+            buffer.count = used + max(n, 0)
+            return n > 0
+        }
+    }
+
+    private func readU32(at index: Data.Index) -> Int {
+        var value = 0
+        for i in 0 ..< 4 {
+            value |= Int(buffer[index + i]) << (8 * i)
+        }
+        return value
+    }
+}
+
+// The helper's side of src/app/SharedMemoryMessageRing: a single-producer,
+// single-consumer ring of u32-length-prefixed messages, padded to four
+// bytes, that never wrap. The bridge creates the backing file; the header
+// layout and memory orderings must match the C++ class.
+private final class SharedMemoryMessageRing {
+    private static let headerBytes = 192
+    private static let magic: UInt32 = 0x424D_5253
+    private static let version: UInt32 = 1
+    private static let capacityOffset = 8
+    private static let writeIndexOffset = 64
+    private static let readIndexOffset = 128
+    private static let consumerWaitingOffset = 132
+    private static let wrapMarker: UInt32 = 0xFFFF_FFFF
+
+    private var mapping: UnsafeMutableRawPointer?
+    private var mappingSize = 0
+    private var capacity: UInt32 = 0
+    private var peekedBytes: UInt32 = 0
+
+    deinit {
+        if let mapping {
+            munmap(mapping, mappingSize)
+        }
+    }
+
+    var maxMessageBytes: Int {
+        capacity == 0 ? 0 : Int(capacity / 2) - 4
+    }
+
+    func open(name: String) -> Bool {
+        var pathName = name
+        if pathName.hasPrefix("/") {
+            pathName.removeFirst()
+        }
+        pathName = pathName.replacingOccurrences(of: "/", with: "_")
+        let fd = Darwin.open("/tmp/\(pathName).ring", O_RDWR)
+        guard fd >= 0 else {
+            return false
+        }
+        defer { Darwin.close(fd) }
+
+        var info = stat()
+        guard fstat(fd, &info) == 0, Int(info.st_size) > Self.headerBytes else {
+            return false
+        }
+        let size = Int(info.st_size)
+        let mapped = mmap(nil, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+        guard let mapped, mapped != MAP_FAILED else {
+            return false
+        }
+
+        let magic = mapped.load(as: UInt32.self)
+        let version = mapped.load(fromByteOffset: 4, as: UInt32.self)
+        let capacity = mapped.load(fromByteOffset: Self.capacityOffset, as: UInt32.self)
+        guard magic == Self.magic, version == Self.version, capacity >= 4096,
+              capacity & (capacity - 1) == 0, Self.headerBytes + Int(capacity) == size
+        else {
+            munmap(mapped, size)
+            return false
+        }
+
+        mapping = mapped
+        mappingSize = size
+        self.capacity = capacity
+        return true
+    }
+
+    /// Producer. False if the message does not fit right now.
+    func write(_ message: Data) -> Bool {
+        guard let mapping, message.count <= maxMessageBytes else {
+            return false
+        }
+        let length = UInt32(message.count)
+        let record = 4 + Self.padded(length)
+        var write = helper_atomic_load_relaxed(mapping + Self.writeIndexOffset)
+        let read = helper_atomic_load_acquire(mapping + Self.readIndexOffset)
+        var offset = write & (capacity - 1)
+        let skip = capacity - offset < record ? capacity - offset : 0
+        guard capacity &- (write &- read) >= skip + record else {
+            return false
+        }
+
+        let data = mapping + Self.headerBytes
+        if skip > 0 {
+            data.storeBytes(of: Self.wrapMarker, toByteOffset: Int(offset), as: UInt32.self)
+            write = write &+ skip
+            offset = 0
+        }
+        data.storeBytes(of: length, toByteOffset: Int(offset), as: UInt32.self)
+        message.withUnsafeBytes { bytes in
+            if let base = bytes.baseAddress {
+                (data + Int(offset) + 4).copyMemory(from: base, byteCount: message.count)
+            }
+        }
+        helper_atomic_store_release(mapping + Self.writeIndexOffset, write &+ record)
+        return true
+    }
+
+    /// Producer. True, once, if the consumer announced it was going to sleep.
+    func takeWakeup() -> Bool {
+        guard let mapping else { return false }
+        helper_atomic_fence_seq_cst()
+        let waiting = mapping + Self.consumerWaitingOffset
+        return helper_atomic_load_relaxed(waiting) != 0 && helper_atomic_exchange_relaxed(waiting, 0) != 0
+    }
+
+    /// Consumer. The payload refers to the ring and is valid until consume().
+    func peek() -> Data? {
+        guard let mapping else { return nil }
+        let write = helper_atomic_load_acquire(mapping + Self.writeIndexOffset)
+        var read = helper_atomic_load_relaxed(mapping + Self.readIndexOffset)
+        guard read != write else {
+            return nil
+        }
+
+        let data = mapping + Self.headerBytes
+        var offset = read & (capacity - 1)
+        var length = data.load(fromByteOffset: Int(offset), as: UInt32.self)
+        if length == Self.wrapMarker {
+            read = read &+ (capacity - offset)
+            helper_atomic_store_release(mapping + Self.readIndexOffset, read)
+            guard read != write else {
+                return nil
+            }
+            offset = 0
+            length = data.load(as: UInt32.self)
+        }
+        guard Int(length) <= maxMessageBytes, 4 + Self.padded(length) <= write &- read else {
+            return nil
+        }
+
+        peekedBytes = 4 + Self.padded(length)
+        return Data(bytesNoCopy: data + Int(offset) + 4, count: Int(length), deallocator: .none)
+    }
+
+    func consume() {
+        guard let mapping, peekedBytes > 0 else { return }
+        let read = helper_atomic_load_relaxed(mapping + Self.readIndexOffset)
+        helper_atomic_store_release(mapping + Self.readIndexOffset, read &+ peekedBytes)
+        peekedBytes = 0
+    }
+
+    /// Consumer. Announces that it is about to sleep; false, and it should
+    /// not, if messages arrived in the meantime.
+    func prepareToWait() -> Bool {
+        guard let mapping else { return true }
+        helper_atomic_store_seq_cst(mapping + Self.consumerWaitingOffset, 1)
+        if helper_atomic_load_seq_cst(mapping + Self.writeIndexOffset) !=
+            helper_atomic_load_relaxed(mapping + Self.readIndexOffset)
+        {
+            helper_atomic_store_relaxed(mapping + Self.consumerWaitingOffset, 0)
+            return false
+        }
+        return true
+    }
+
+    func finishWait() {
+        guard let mapping else { return }
+        helper_atomic_store_relaxed(mapping + Self.consumerWaitingOffset, 0)
+    }
+
+    private static func padded(_ bytes: UInt32) -> UInt32 {
+        (bytes + 3) & ~3
     }
 }
 
@@ -38,7 +385,9 @@ private final class SharedMemoryAudioRing {
         close()
     }
 
-    func open(name: String, create: Bool, channels: UInt32, capacityFrames: UInt32) -> Bool {
+    /// Creates the backing file if needed. `reset` empties the ring; without
+    /// it a ring with a matching header is joined as it is.
+    func open(name: String, reset: Bool, channels: UInt32, capacityFrames: UInt32) -> Bool {
         close()
 
         guard !name.isEmpty, channels > 0, capacityFrames > 0 else {
@@ -52,8 +401,7 @@ private final class SharedMemoryAudioRing {
         pathName = pathName.replacingOccurrences(of: "/", with: "_")
         let backingFile = "/tmp/\(pathName).ring"
 
-        let flags = create ? (O_CREAT | O_RDWR) : O_RDWR
-        let opened = Darwin.open(backingFile, flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH)
+        let opened = Darwin.open(backingFile, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH)
         guard opened >= 0 else {
             return false
         }
@@ -79,7 +427,7 @@ private final class SharedMemoryAudioRing {
         self.channels = channels
         self.capacityFrames = capacityFrames
 
-        if create || headerValue(at: 0) != kMagic || headerValue(at: 1) != kVersion ||
+        if reset || headerValue(at: 0) != kMagic || headerValue(at: 1) != kVersion ||
             headerValue(at: 2) != channels || headerValue(at: 3) != capacityFrames
         {
             memset(mapped, 0, mapSize)
@@ -111,39 +459,6 @@ private final class SharedMemoryAudioRing {
         capacityFrames = 0
     }
 
-    func write(interleavedFrames: [Float], sampleOffset: Int = 0, frameCount: Int) -> Int {
-        lock.lock()
-        defer { lock.unlock() }
-
-        guard let mapping, frameCount > 0, channels > 0, capacityFrames > 0 else {
-            return 0
-        }
-
-        let writeIndex = headerValue(at: 4)
-        let readIndex = headerValue(at: 5)
-        let used = writeIndex &- readIndex
-        let freeFrames = capacityFrames &- min(used, capacityFrames)
-        let writable = min(UInt32(frameCount), freeFrames)
-        if writable == 0 {
-            return 0
-        }
-
-        let totalChannels = Int(channels)
-        let dataPtr = mapping.advanced(by: Self.headerBytes).bindMemory(to: Float.self, capacity: Int(channels * capacityFrames))
-
-        for frame in 0 ..< Int(writable) {
-            let dstFrame = Int((writeIndex &+ UInt32(frame)) % capacityFrames)
-            let srcOffset = sampleOffset + frame * totalChannels
-            let dstOffset = dstFrame * totalChannels
-            for ch in 0 ..< totalChannels {
-                dataPtr[dstOffset + ch] = interleavedFrames[srcOffset + ch]
-            }
-        }
-
-        setHeaderValue(at: 4, value: writeIndex &+ writable)
-        return Int(writable)
-    }
-
     func read(frameCount: Int) -> [Float] {
         lock.lock()
         defer { lock.unlock() }
@@ -190,6 +505,65 @@ private final class SharedMemoryAudioRing {
     }
 }
 
+// Converts one channel between two sample rates with the bridge's polyphase
+// resampler (src/common/Resampler.h). Its filter state carries over from one
+// block to the next, so each stream keeps its own.
+private final class StreamResampler {
+    private let handle: OpaquePointer
+
+    init(inputRate: Int, outputRate: Int) {
+        handle = helper_resampler_create(UInt32(max(inputRate, 1)), UInt32(max(outputRate, 1)))
+    }
+
+    deinit {
+        helper_resampler_destroy(handle)
+    }
+
+    func process(_ input: [Float]) -> [Float] {
+        var output = [Float](repeating: 0, count: helper_resampler_output_capacity(handle, input.count))
+        let written = input.withUnsafeBufferPointer { source in
+            output.withUnsafeMutableBufferPointer { destination in
+                helper_resampler_process(handle, source.baseAddress, source.count, destination.baseAddress,
+                                         destination.count)
+            }
+        }
+        output.removeLast(output.count - written)
+        return output
+    }
+}
+
+// Base64 for audio inside JSON, through the bridge's codec
+// (src/common/Base64.h), which decodes straight into the buffer it returns.
+private extension Data {
+    func base64AudioString() -> String {
+        withUnsafeBytes { bytes in
+            String(unsafeUninitializedCapacity: (bytes.count + 2) / 3 * 4) { chars in
+                helper_base64_encode(bytes.baseAddress, bytes.count, chars.baseAddress)
+            }
+        }
+    }
+
+    init?(base64Audio text: String) {
+        var text = text
+        let decoded: Data? = text.withUTF8 { chars in
+            var data = Data(count: chars.count / 4 * 3 + chars.count % 4 * 3 / 4)
+            var written = 0
+            let ok = data.withUnsafeMutableBytes { bytes in
+                helper_base64_decode(chars.baseAddress, chars.count, bytes.baseAddress, bytes.count, &written)
+            }
+            guard ok else {
+                return nil
+            }
+            data.count = written
+            return data
+        }
+        guard let decoded else {
+            return nil
+        }
+        self = decoded
+    }
+}
+
 private struct EngineConfig {
     var sampleRateHz: Int = 48_000
     var channels: Int = 2
@@ -207,11 +581,26 @@ private struct EngineConfig {
 
     var micFeedRingName: String = "/virtual_audio_bridge_mic_feed"
     var speakerTapRingName: String = "/virtual_audio_bridge_speaker_tap"
+    // Cleared when other helpers may already be using the rings.
+    var resetRings: Bool = true
 }
 
 private final class EngineCoordinator {
-    private let emitter = LineEmitter()
+    private let ipcMode: IpcMode
+    private let controlFd: Int32?
+    private let emitter: MessageEmitter
     private let stateQueue = DispatchQueue(label: "engine_helper.state")
+    // Commands from both the data path and the control descriptor run here,
+    // one at a time.
+    private let commandQueue = DispatchQueue(label: "engine_helper.commands")
+
+    // Control commands that overtook data commands, with their "after" (see
+    // src/app/HelperFrame.h): data commands numbered below it that the
+    // control command undoes are dropped. Touched only on commandQueue.
+    private var dataCommandsSeen: UInt64 = 0
+    private var cancelledUtterances: [String: UInt64] = [:]
+    private var stoppedStreams: [String: UInt64] = [:]
+    private var disabledBefore: UInt64 = 0
 
     private var config = EngineConfig()
     private var sessionMode = "apple"
@@ -248,31 +637,47 @@ private final class EngineCoordinator {
         var flushed: Bool
     }
     private var pendingUtterances: [PendingUtterance] = []
+    private var appleUtteranceID: String?
     private var activeSynthesizer: AVSpeechSynthesizer?
     private var warmSynthesizer: AVSpeechSynthesizer?
     private var ttsConverter: AVAudioConverter?
     private var ttsConverterSourceFormat: AVAudioFormat?
 
-    private var ttsPendingSamples: [Float] = []
-    private var ttsPendingOffset: Int = 0
-    private let ttsPendingLock = NSLock()
-    private var ttsDrainTimer: DispatchSourceTimer?
+    // Synthesized audio goes to the bridge in blocks of at most this many
+    // frames, which keeps each well inside a ring message.
+    private static let ttsAudioBlockFrames = 8192
 
+    private var isStandby = false
     private var shouldExit = false
 
+    init(ipcMode: IpcMode, controlFd: Int32?) {
+        self.ipcMode = ipcMode
+        self.controlFd = controlFd
+        emitter = MessageEmitter(mode: ipcMode)
+    }
+
     func run() {
+        if let controlFd {
+            DispatchQueue.global(qos: .userInteractive).async { [self] in
+                runControl(fd: controlFd)
+            }
+        }
+
         // Read stdin on a background thread so the main RunLoop stays free
         // for AVSpeechSynthesizer and other framework callbacks.
         DispatchQueue.global(qos: .userInitiated).async { [self] in
-            while let line = readLine() {
-                guard let object = parseJSON(line) else {
-                    emitError(code: "invalid_json", message: "Failed to parse helper command")
-                    continue
-                }
-                handle(command: object)
-                if shouldExit {
-                    break
+            switch ipcMode {
+            case .framed:
+                let reader = FrameReader()
+                while let frame = reader.next() {
+                    if frame.kind == kFrameKindJSON, !dispatch(parseJSON(frame.payload)) {
+                        break
+                    }
                 }
+            case .jsonLines:
+                while let line = readLine(), dispatch(parseJSON(line)) {}
+            case .sharedMemory(let commands, _):
+                runSharedMemory(commands: commands)
             }
 
             shutdown()
@@ -283,9 +688,112 @@ private final class EngineCoordinator {
         RunLoop.main.run()
     }
 
+    /// Takes commands from the ring until the bridge asks the helper to exit
+    /// or closes stdin. Between bursts it sleeps on stdin, where the bridge
+    /// writes a doorbell frame if it queues a command meanwhile.
+    private func runSharedMemory(commands: SharedMemoryMessageRing) {
+        let doorbells = FrameReader()
+        while true {
+            while let command = commands.peek() {
+                let parsed = parseJSON(command)
+                commands.consume()
+                if !dispatch(parsed) {
+                    return
+                }
+            }
+            guard commands.prepareToWait() else {
+                continue
+            }
+            let doorbell = doorbells.next()
+            commands.finishWait()
+            if doorbell == nil {
+                return
+            }
+        }
+    }
+
+    /// Applies control commands as they arrive, without waiting for the data
+    /// commands queued ahead of them.
+    private func runControl(fd: Int32) {
+        let reader = FrameReader(fd: fd)
+        while let frame = reader.next() {
+            guard frame.kind == kFrameKindJSON, let command = parseJSON(frame.payload) else {
+                continue
+            }
+            commandQueue.sync { handle(command: command) }
+        }
+    }
+
+    /// Handles one command from the bridge's data path; returns false once
+    /// the helper has been asked to exit.
+    private func dispatch(_ command: [String: Any]?) -> Bool {
+        commandQueue.sync { () -> Bool in
+            let index = dataCommandsSeen
+            dataCommandsSeen += 1
+            guard let command = command else {
+                emitError(code: "invalid_json", message: "Failed to parse helper command")
+                return true
+            }
+            if !isSuperseded(command, index: index) {
+                handle(command: command)
+            }
+            return !shouldExit
+        }
+    }
+
+    /// Whether data command `index` was overtaken by a control command that
+    /// undoes it, like a tts_chunk sent before its utterance's tts_cancel.
+    private func isSuperseded(_ command: [String: Any], index: UInt64) -> Bool {
+        if !cancelledUtterances.isEmpty {
+            cancelledUtterances = cancelledUtterances.filter { $0.value > index }
+        }
+        if !stoppedStreams.isEmpty {
+            stoppedStreams = stoppedStreams.filter { $0.value > index }
+        }
+
+        switch (command["type"] as? String) ?? "" {
+        case "enable":
+            return index < disabledBefore
+        case "tts_start", "tts_chunk", "tts_flush":
+            let utteranceID = (command["utterance_id"] as? String) ?? ""
+            return index < disabledBefore || cancelledUtterances[utteranceID] != nil
+        case "start_stt":
+            let streamID = (command["stream_id"] as? String) ?? "stt-default"
+            return index < disabledBefore || stoppedStreams[streamID] != nil || stoppedStreams[""] != nil
+        default:
+            return false
+        }
+    }
+
+    /// Remembers what a control command undoes among the data commands it
+    /// overtook, if it overtook any.
+    private func noteOvertaken(type: String, command: [String: Any]) {
+        guard let after = (command["after"] as? NSNumber)?.uint64Value, after > dataCommandsSeen else {
+            return
+        }
+        switch type {
+        case "tts_cancel":
+            if let utteranceID = command["utterance_id"] as? String {
+                cancelledUtterances[utteranceID] = after
+            }
+        case "stop_stt":
+            stoppedStreams[(command["stream_id"] as? String) ?? ""] = after
+        case "disable":
+            disabledBefore = after
+        default:
+            break
+        }
+    }
+
     private func parseJSON(_ text: String) -> [String: Any]? {
-        guard let data = text.data(using: .utf8),
-              let object = try? JSONSerialization.jsonObject(with: data, options: []),
+        guard let data = text.data(using: .utf8) else {
+            return nil
+        }
+        return parseJSON(data)
+    }
+
+    private func parseJSON(_ data: Data) -> [String: Any]? {
+        guard let object = try? JSONSerialization.jsonObject(with: data, options: []),
               let dict = object as? [String: Any]
         else {
             return nil
@@ -295,10 +803,13 @@ private final class EngineCoordinator {
 
     private func handle(command: [String: Any]) {
         let type = (command["type"] as? String) ?? ""
+        noteOvertaken(type: type, command: command)
 
         switch type {
         case "engine_config":
             applyEngineConfig(command)
+        case "activate":
+            handleActivate()
         case "session_config":
             applySessionConfig(command)
         case "enable":
@@ -356,21 +867,43 @@ private final class EngineCoordinator {
         if let rings = command["rings"] as? [String: Any] {
             next.micFeedRingName = rings["mic_feed"] as? String ?? next.micFeedRingName
             next.speakerTapRingName = rings["speaker_tap"] as? String ?? next.speakerTapRingName
+            next.resetRings = rings["reset"] as? Bool ?? next.resetRings
         }
 
         config = next
 
+        // A standby keeps its configuration and warms up, but leaves the
+        // audio rings to the active helper until the bridge promotes it.
+        if command["standby"] as? Bool ?? false {
+            isStandby = true
+            warmUpAppleFrameworks()
+            emitter.emit(["type": "engine_ready", "standby": true])
+            return
+        }
+        openAudioRings()
+    }
+
+    private func handleActivate() {
+        guard isStandby else {
+            emitError(code: "not_standby", message: "activate is only valid for a standby helper")
+            return
+        }
+        isStandby = false
+        openAudioRings()
+    }
+
+    private func openAudioRings() {
         let openedMic = micRing.open(
-            name: next.micFeedRingName,
-            create: true,
-            channels: UInt32(next.channels),
-            capacityFrames: UInt32(next.ringCapacityFrames)
+            name: config.micFeedRingName,
+            reset: config.resetRings,
+            channels: UInt32(config.channels),
+            capacityFrames: UInt32(config.ringCapacityFrames)
         )
         let openedSpeaker = speakerRing.open(
-            name: next.speakerTapRingName,
-            create: true,
-            channels: UInt32(next.channels),
-            capacityFrames: UInt32(next.ringCapacityFrames)
+            name: config.speakerTapRingName,
+            reset: config.resetRings,
+            channels: UInt32(config.channels),
+            capacityFrames: UInt32(config.ringCapacityFrames)
         )
 
         if !openedMic || !openedSpeaker {
@@ -427,11 +960,14 @@ private final class EngineCoordinator {
             activeUtteranceFlushed = false
             activeSocketReady = false
             pendingUtterances.removeAll()
+            appleUtteranceID = nil
             let s = elevenTtsSocket
             elevenTtsSocket = nil
             return s
         }
         socket?.cancel(with: .normalClosure, reason: nil)
+        activeSynthesizer?.stopSpeaking(at: .immediate)
+        activeSynthesizer = nil
 
         // Stop any active STT
         if sessionMode == "elevenlabs" {
@@ -593,9 +1129,18 @@ private final class EngineCoordinator {
                 drainPendingUtterances()
             }
         } else {
-            stateQueue.sync {
+            let speaking = stateQueue.sync { () -> Bool in
                 utteranceBuffers.removeValue(forKey: utteranceID)
                 utteranceLanguages.removeValue(forKey: utteranceID)
+                guard appleUtteranceID == utteranceID else {
+                    return false
+                }
+                appleUtteranceID = nil
+                return true
+            }
+            if speaking {
+                activeSynthesizer?.stopSpeaking(at: .immediate)
+                activeSynthesizer = nil
             }
         }
 
@@ -656,60 +1201,23 @@ private final class EngineCoordinator {
         ])
     }
 
-    private func writeTtsAudioToTarget(_ interleavedStereo: [Float]) {
-        guard !interleavedStereo.isEmpty else { return }
-
-        ttsPendingLock.lock()
-        ttsPendingSamples.append(contentsOf: interleavedStereo)
-        if ttsDrainTimer == nil {
-            let timer = DispatchSource.makeTimerSource(queue: DispatchQueue.global(qos: .userInteractive))
-            timer.schedule(deadline: .now(), repeating: .milliseconds(5))
-            timer.setEventHandler { [weak self] in
-                self?.drainPendingSamples()
-            }
-            ttsDrainTimer = timer
-            timer.resume()
-        }
-        ttsPendingLock.unlock()
-    }
-
-    private func drainPendingSamples() {
-        ttsPendingLock.lock()
-        defer { ttsPendingLock.unlock() }
-
-        let remaining = ttsPendingSamples.count - ttsPendingOffset
-        guard remaining > 0 else {
-            ttsPendingSamples.removeAll(keepingCapacity: true)
-            ttsPendingOffset = 0
-            ttsDrainTimer?.cancel()
-            ttsDrainTimer = nil
-            return
-        }
-
+    /// Hands synthesized audio to the bridge, whose pacer writes it into
+    /// the session's rings as they play.
+    private func sendTtsAudio(_ interleaved: [Float], utteranceID: String) {
         let channels = max(config.channels, 1)
-        let frameCount = remaining / channels
-        guard frameCount > 0 else { return }
-
-        let written: Int
-        switch sessionTtsTarget {
-        case "virtual_speaker":
-            written = speakerRing.write(interleavedFrames: ttsPendingSamples, sampleOffset: ttsPendingOffset, frameCount: frameCount)
-        case "both":
-            let w1 = micRing.write(interleavedFrames: ttsPendingSamples, sampleOffset: ttsPendingOffset, frameCount: frameCount)
-            let w2 = speakerRing.write(interleavedFrames: ttsPendingSamples, sampleOffset: ttsPendingOffset, frameCount: frameCount)
-            written = min(w1, w2)
-        default:
-            written = micRing.write(interleavedFrames: ttsPendingSamples, sampleOffset: ttsPendingOffset, frameCount: frameCount)
-        }
-
-        if written > 0 {
-            ttsPendingOffset += written * channels
-        }
-
-        // Compact when more than half consumed
-        if ttsPendingOffset > ttsPendingSamples.count / 2 && ttsPendingOffset > 0 {
-            ttsPendingSamples.removeFirst(ttsPendingOffset)
-            ttsPendingOffset = 0
+        let usable = interleaved.count - interleaved.count % channels
+        let blockSamples = Self.ttsAudioBlockFrames * channels
+        var start = 0
+        while start < usable {
+            let end = min(start + blockSamples, usable)
+            let samples = interleaved[start ..< end].withUnsafeBytes { Data($0) }
+            emitter.emit([
+                "type": "tts_audio",
+                "utterance_id": utteranceID,
+                "target": sessionTtsTarget,
+                "frames": (end - start) / channels,
+            ], attachment: samples)
+            start = end
         }
     }
 
@@ -728,6 +1236,7 @@ private final class EngineCoordinator {
             synthesizer = AVSpeechSynthesizer()
         }
         activeSynthesizer = synthesizer
+        stateQueue.sync { appleUtteranceID = utteranceID }
 
         let voiceLanguage = (language != nil && !language!.isEmpty) ? language! : config.appleLocale
         let utterance = AVSpeechUtterance(string: text)
@@ -737,6 +1246,15 @@ private final class EngineCoordinator {
             guard let self else { return }
 
             guard let pcm = buffer as? AVAudioPCMBuffer else { return }
+            // A cancelled utterance has already reported completion.
+            let current = self.stateQueue.sync { () -> Bool in
+                let isCurrent = self.appleUtteranceID == utteranceID
+                if isCurrent && pcm.frameLength == 0 {
+                    self.appleUtteranceID = nil
+                }
+                return isCurrent
+            }
+            guard current else { return }
             if pcm.frameLength == 0 {
                 self.activeSynthesizer = nil
                 // Pre-create synthesizer for the next call.
@@ -746,7 +1264,7 @@ private final class EngineCoordinator {
             }
 
             let converted = self.convertBufferToBridgeFormat(buffer: pcm)
-            self.writeTtsAudioToTarget(converted)
+            self.sendTtsAudio(converted, utteranceID: utteranceID)
         }
     }
 
@@ -805,6 +1323,7 @@ private final class EngineCoordinator {
         workItem = DispatchWorkItem { [weak self] in
             guard let self, let workItem else { return }
             let monoFormat = AVAudioFormat(commonFormat: .pcmFormatFloat32, sampleRate: 16_000, channels: 1, interleaved: false)!
+            let resampler = StreamResampler(inputRate: self.config.sampleRateHz, outputRate: 16_000)
 
             while !workItem.isCancelled {
                 let ringFrames = self.sourceRingForSTT().read(frameCount: 480)
@@ -813,7 +1332,7 @@ private final class EngineCoordinator {
                     continue
                 }
 
-                let mono16k = Self.downmixAndResampleTo16k(interleavedStereo48k: ringFrames)
+                let mono16k = resampler.process(Self.downmixToMono(ringFrames, channels: self.config.channels))
                 if mono16k.isEmpty {
                     usleep(10_000)
                     continue
@@ -925,7 +1444,9 @@ private final class EngineCoordinator {
         }
 
         // Start async receive loop
-        elevenLabsTTSReceiveLoop(socket: socket, cfg: cfg)
+        let resampler = StreamResampler(inputRate: Self.sampleRateFromFormat(cfg.elevenTtsOutputFormat),
+                                        outputRate: cfg.sampleRateHz)
+        elevenLabsTTSReceiveLoop(socket: socket, cfg: cfg, resampler: resampler)
     }
 
     private func drainPendingUtterances() {
@@ -941,7 +1462,8 @@ private final class EngineCoordinator {
         openElevenLabsTTSSocket(text: next.text, flush: true)
     }
 
-    private func elevenLabsTTSReceiveLoop(socket: URLSessionWebSocketTask, cfg: EngineConfig) {
+    private func elevenLabsTTSReceiveLoop(socket: URLSessionWebSocketTask, cfg: EngineConfig,
+                                          resampler: StreamResampler) {
         socket.receive { [weak self] result in
             guard let self else { return }
             switch result {
@@ -954,19 +1476,20 @@ private final class EngineCoordinator {
                 }
 
                 guard let obj = self.parseJSON(textPayload) else {
-                    self.elevenLabsTTSReceiveLoop(socket: socket, cfg: cfg)
+                    self.elevenLabsTTSReceiveLoop(socket: socket, cfg: cfg, resampler: resampler)
                     return
                 }
 
-                let utteranceID = self.stateQueue.sync { self.activeUtteranceID } ?? "unknown"
+                let activeID = self.stateQueue.sync { self.activeUtteranceID }
+                let utteranceID = activeID ?? "unknown"
 
-                if let audioBase64 = obj["audio"] as? String,
-                   let audioData = Data(base64Encoded: audioBase64)
+                // Audio that arrives after a cancel has no utterance to play for.
+                if let activeID,
+                   let audioBase64 = obj["audio"] as? String,
+                   let audioData = Data(base64Audio: audioBase64)
                 {
-                    let interleaved = Self.pcm16MonoToStereoFloat(audioData,
-                        sourceSampleRate: Self.sampleRateFromFormat(cfg.elevenTtsOutputFormat),
-                        targetSampleRate: Double(cfg.sampleRateHz))
-                    self.writeTtsAudioToTarget(interleaved)
+                    let interleaved = Self.pcm16MonoToStereoFloat(audioData, resampler: resampler)
+                    self.sendTtsAudio(interleaved, utteranceID: activeID)
                 }
 
                 if let alignment = obj["alignment"] as? [String: Any] {
@@ -1002,7 +1525,7 @@ private final class EngineCoordinator {
                     return
                 }
 
-                self.elevenLabsTTSReceiveLoop(socket: socket, cfg: cfg)
+                self.elevenLabsTTSReceiveLoop(socket: socket, cfg: cfg, resampler: resampler)
 
             case .failure(let error):
                 // Socket was cancelled (e.g. disable or tts_cancel) — not an error
@@ -1080,6 +1603,7 @@ private final class EngineCoordinator {
         var sendWorkItem: DispatchWorkItem?
         sendWorkItem = DispatchWorkItem { [weak self] in
             guard let self else { return }
+            let resampler = StreamResampler(inputRate: self.config.sampleRateHz, outputRate: 16_000)
             do {
                 while !(sendWorkItem?.isCancelled ?? true) {
                     let source = self.sourceRingForSTT().read(frameCount: 480)
@@ -1088,7 +1612,7 @@ private final class EngineCoordinator {
                         continue
                     }
 
-                    let mono16k = Self.downmixAndResampleTo16k(interleavedStereo48k: source)
+                    let mono16k = resampler.process(Self.downmixToMono(source, channels: self.config.channels))
                     if mono16k.isEmpty {
                         continue
                     }
@@ -1096,7 +1620,7 @@ private final class EngineCoordinator {
                     let pcmData = Self.floatMonoToPCM16(mono16k)
                     let payload = Self.serialize([
                         "message_type": "input_audio_chunk",
-                        "audio_base_64": pcmData.base64EncodedString(),
+                        "audio_base_64": pcmData.base64AudioString(),
                         "sample_rate": 16000,
                     ])
                     try self.wsSendSync(socket, text: payload)
@@ -1147,12 +1671,6 @@ private final class EngineCoordinator {
     }
 
     private func shutdown() {
-        ttsPendingLock.lock()
-        ttsDrainTimer?.cancel()
-        ttsDrainTimer = nil
-        ttsPendingSamples.removeAll()
-        ttsPendingOffset = 0
-        ttsPendingLock.unlock()
         ttsConverter = nil
         ttsConverterSourceFormat = nil
 
@@ -1359,108 +1877,62 @@ private final class EngineCoordinator {
         return Array(UnsafeBufferPointer(start: ptr, count: samples))
     }
 
-    private static func downmixAndResampleTo16k(interleavedStereo48k: [Float]) -> [Float] {
-        if interleavedStereo48k.isEmpty {
-            return []
-        }
-
-        let frameCount = interleavedStereo48k.count / 2
-        if frameCount == 0 {
-            return []
-        }
-
+    private static func downmixToMono(_ interleaved: [Float], channels: Int) -> [Float] {
+        let channels = max(channels, 1)
+        let frameCount = interleaved.count / channels
         var mono = [Float](repeating: 0, count: frameCount)
-        for frame in 0 ..< frameCount {
-            let l = interleavedStereo48k[frame * 2]
-            let r = interleavedStereo48k[frame * 2 + 1]
-            mono[frame] = 0.5 * (l + r)
-        }
-
-        let sourceRate = 48_000.0
-        let targetRate = 16_000.0
-        let ratio = sourceRate / targetRate
-
-        var out: [Float] = []
-        out.reserveCapacity(max(1, Int(Double(mono.count) / ratio)))
-
-        var position = 0.0
-        while Int(position) < mono.count {
-            let i = Int(position)
-            let j = min(i + 1, mono.count - 1)
-            let frac = Float(position - Double(i))
-            out.append(mono[i] * (1.0 - frac) + mono[j] * frac)
-            position += ratio
+        interleaved.withUnsafeBufferPointer { input in
+            mono.withUnsafeMutableBufferPointer { output in
+                helper_downmix_to_mono(input.baseAddress, UInt32(channels), frameCount, output.baseAddress)
+            }
         }
-
-        return out
+        return mono
     }
 
     private static func floatMonoToPCM16(_ mono: [Float]) -> Data {
-        var data = Data(capacity: mono.count * 2)
-        for sample in mono {
-            let clipped = max(-1.0, min(1.0, sample))
-            var s = Int16(clipped * Float(Int16.max))
-            withUnsafeBytes(of: &s) { bytes in
-                data.append(contentsOf: bytes)
+        var data = Data(count: mono.count * 2)
+        mono.withUnsafeBufferPointer { input in
+            data.withUnsafeMutableBytes { output in
+                helper_float_to_int16(input.baseAddress, output.baseAddress, mono.count)
             }
         }
         return data
     }
 
-    private static func sampleRateFromFormat(_ format: String) -> Double {
+    private static func sampleRateFromFormat(_ format: String) -> Int {
         // Formats like "pcm_24000", "pcm_44100", "pcm_16000"
         if let underscore = format.lastIndex(of: "_"),
-           let rate = Double(format[format.index(after: underscore)...]) {
+           let rate = Int(format[format.index(after: underscore)...]) {
             return rate
         }
         return 24_000
     }
 
-    private static func pcm16MonoToStereoFloat(_ data: Data, sourceSampleRate: Double = 0, targetSampleRate: Double = 0) -> [Float] {
+    private static func pcm16MonoToStereoFloat(_ data: Data, resampler: StreamResampler) -> [Float] {
         let sampleCount = data.count / 2
         if sampleCount == 0 {
             return []
         }
 
-        // Decode PCM16 mono to Float mono
         var mono = [Float](repeating: 0, count: sampleCount)
-        data.withUnsafeBytes { rawBuffer in
-            let ptr = rawBuffer.bindMemory(to: Int16.self)
-            for i in 0 ..< sampleCount {
-                mono[i] = Float(ptr[i]) / Float(Int16.max)
-            }
-        }
-
-        // Resample if needed
-        let needsResample = sourceSampleRate > 0 && targetSampleRate > 0
-            && abs(sourceSampleRate - targetSampleRate) > 1.0
-        let resampled: [Float]
-        if needsResample {
-            let ratio = sourceSampleRate / targetSampleRate
-            let outCount = Int(Double(mono.count) / ratio)
-            var buf = [Float](repeating: 0, count: outCount)
-            var position = 0.0
-            for i in 0 ..< outCount {
-                let idx = Int(position)
-                let next = min(idx + 1, mono.count - 1)
-                let frac = Float(position - Double(idx))
-                buf[i] = mono[idx] * (1.0 - frac) + mono[next] * frac
-                position += ratio
-            }
-            resampled = buf
-        } else {
-            resampled = mono
+        data.withUnsafeBytes { input in
+            mono.withUnsafeMutableBufferPointer { output in
+                helper_int16_to_float(input.baseAddress, output.baseAddress, sampleCount)
+            }
         }
 
-        // Expand mono to interleaved stereo
+        let resampled = resampler.process(mono)
+
         var out = [Float](repeating: 0, count: resampled.count * 2)
-        for i in 0 ..< resampled.count {
-            out[i * 2] = resampled[i]
-            out[i * 2 + 1] = resampled[i]
+        resampled.withUnsafeBufferPointer { input in
+            out.withUnsafeMutableBufferPointer { output in
+                helper_upmix_from_mono(input.baseAddress, 2, resampled.count, output.baseAddress)
+            }
         }
         return out
     }
 }
 
-private let coordinator = EngineCoordinator()
+private let coordinator = EngineCoordinator(ipcMode: IpcMode.fromArguments(CommandLine.arguments),
+                                            controlFd: controlFdFromArguments(CommandLine.arguments))
 coordinator.run()
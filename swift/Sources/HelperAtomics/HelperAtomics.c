@@ -0,0 +1,3 @@
+// SwiftPM needs a source file in every C target; the functions are inline
+// in the header.
+#include "HelperAtomics.h"
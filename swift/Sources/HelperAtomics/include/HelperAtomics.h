@@ -0,0 +1,43 @@
+#ifndef HELPER_ATOMICS_H
+#define HELPER_ATOMICS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+// C11 atomics on 32-bit words in memory shared with the bridge, which Swift
+// cannot express without a package dependency. The bridge side uses
+// std::atomic<uint32_t> with the same orderings.
+
+static inline uint32_t helper_atomic_load_acquire(const void *address) {
+    return atomic_load_explicit((const _Atomic uint32_t *)address, memory_order_acquire);
+}
+
+static inline uint32_t helper_atomic_load_relaxed(const void *address) {
+    return atomic_load_explicit((const _Atomic uint32_t *)address, memory_order_relaxed);
+}
+
+static inline uint32_t helper_atomic_load_seq_cst(const void *address) {
+    return atomic_load_explicit((const _Atomic uint32_t *)address, memory_order_seq_cst);
+}
+
+static inline void helper_atomic_store_release(void *address, uint32_t value) {
+    atomic_store_explicit((_Atomic uint32_t *)address, value, memory_order_release);
+}
+
+static inline void helper_atomic_store_relaxed(void *address, uint32_t value) {
+    atomic_store_explicit((_Atomic uint32_t *)address, value, memory_order_relaxed);
+}
+
+static inline void helper_atomic_store_seq_cst(void *address, uint32_t value) {
+    atomic_store_explicit((_Atomic uint32_t *)address, value, memory_order_seq_cst);
+}
+
+static inline uint32_t helper_atomic_exchange_relaxed(void *address, uint32_t value) {
+    return atomic_exchange_explicit((_Atomic uint32_t *)address, value, memory_order_relaxed);
+}
+
+static inline void helper_atomic_fence_seq_cst(void) {
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+#endif
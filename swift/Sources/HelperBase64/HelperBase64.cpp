@@ -0,0 +1,13 @@
+// SwiftPM only builds sources inside the package, so the bridge's codec is
+// compiled into this target from its place in the tree.
+#include "../../../src/common/Base64.cpp"
+
+#include "HelperBase64.h"
+
+size_t helper_base64_encode(const void *data, size_t size, void *out) {
+  return bridge::Base64Encode(data, size, static_cast<char *>(out));
+}
+
+bool helper_base64_decode(const void *text, size_t size, void *out, size_t capacity, size_t *written) {
+  return bridge::Base64Decode(std::string_view(static_cast<const char *>(text), size), out, capacity, written);
+}
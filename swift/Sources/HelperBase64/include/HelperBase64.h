@@ -0,0 +1,24 @@
+#ifndef HELPER_BASE64_H
+#define HELPER_BASE64_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A C face on the bridge's base64 codec (src/common/Base64.h) for the engine
+// helper.
+
+// `out` holds (size + 2) / 3 * 4 characters; returns how many were written.
+size_t helper_base64_encode(const void *data, size_t size, void *out);
+
+// Returns false if `text` is not base64 or `capacity` bytes are too few.
+bool helper_base64_decode(const void *text, size_t size, void *out, size_t capacity, size_t *written);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,30 @@
+// SwiftPM only builds sources inside the package, so the bridge's resampler
+// is compiled into this target from its place in the tree.
+#include "../../../src/common/Resampler.cpp"
+
+#include "HelperResampler.h"
+
+struct HelperResampler {
+  bridge::Resampler resampler;
+};
+
+HelperResampler *helper_resampler_create(uint32_t input_rate, uint32_t output_rate) {
+  return new HelperResampler{bridge::Resampler(input_rate, output_rate)};
+}
+
+void helper_resampler_destroy(HelperResampler *resampler) {
+  delete resampler;
+}
+
+void helper_resampler_reset(HelperResampler *resampler) {
+  resampler->resampler.Reset();
+}
+
+size_t helper_resampler_output_capacity(const HelperResampler *resampler, size_t count) {
+  return resampler->resampler.OutputCapacity(count);
+}
+
+size_t helper_resampler_process(HelperResampler *resampler, const float *input, size_t count, float *output,
+                                size_t capacity) {
+  return resampler->resampler.Process(input, count, output, capacity);
+}
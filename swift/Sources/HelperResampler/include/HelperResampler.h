@@ -0,0 +1,31 @@
+#ifndef HELPER_RESAMPLER_H
+#define HELPER_RESAMPLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A C face on bridge::Resampler (src/common/Resampler.h) for the engine
+// helper: one channel of float samples, with state kept across calls.
+
+typedef struct HelperResampler HelperResampler;
+
+HelperResampler *helper_resampler_create(uint32_t input_rate, uint32_t output_rate);
+void helper_resampler_destroy(HelperResampler *resampler);
+void helper_resampler_reset(HelperResampler *resampler);
+
+// Enough room for the output of `count` more input samples.
+size_t helper_resampler_output_capacity(const HelperResampler *resampler, size_t count);
+
+// Returns how many samples were written to `output`.
+size_t helper_resampler_process(HelperResampler *resampler, const float *input, size_t count, float *output,
+                                size_t capacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
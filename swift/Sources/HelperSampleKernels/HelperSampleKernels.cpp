@@ -0,0 +1,21 @@
+// SwiftPM only builds sources inside the package, so the bridge's kernels
+// are compiled into this target from their place in the tree.
+#include "../../../src/common/SampleKernels.cpp"
+
+#include "HelperSampleKernels.h"
+
+void helper_float_to_int16(const float *input, void *output, size_t count) {
+  bridge::FloatToInt16(input, output, count);
+}
+
+void helper_int16_to_float(const void *input, float *output, size_t count) {
+  bridge::Int16ToFloat(input, output, count);
+}
+
+void helper_downmix_to_mono(const float *input, uint32_t channels, size_t frames, float *output) {
+  bridge::DownmixToMono(input, channels, frames, output);
+}
+
+void helper_upmix_from_mono(const float *input, uint32_t channels, size_t frames, float *output) {
+  bridge::UpmixFromMono(input, channels, frames, output);
+}
@@ -0,0 +1,23 @@
+#ifndef HELPER_SAMPLE_KERNELS_H
+#define HELPER_SAMPLE_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A C face on the bridge's sample conversion kernels
+// (src/common/SampleKernels.h) for the engine helper.
+
+void helper_float_to_int16(const float *input, void *output, size_t count);
+void helper_int16_to_float(const void *input, float *output, size_t count);
+void helper_downmix_to_mono(const float *input, uint32_t channels, size_t frames, float *output);
+void helper_upmix_from_mono(const float *input, uint32_t channels, size_t frames, float *output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <iostream>
+
+// What the tests under tests/ share: CHECK() reports a failed condition with
+// its location and carries on, and main() returns TestResult(), which is
+// nonzero if any check failed.
+namespace bridge_test {
+
+inline int& FailureCount() {
+  static int failures = 0;
+  return failures;
+}
+
+inline void ReportFailure(const char* file, int line, const char* condition) {
+  std::cerr << file << ":" << line << ": check failed: " << condition << "\n";
+  ++FailureCount();
+}
+
+inline int TestResult() {
+  if (FailureCount() != 0) {
+    std::cerr << FailureCount() << " check(s) failed\n";
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace bridge_test
+
+#define CHECK(condition)                                                \
+  do {                                                                  \
+    if (!(condition)) {                                                 \
+      ::bridge_test::ReportFailure(__FILE__, __LINE__, #condition);     \
+    }                                                                   \
+  } while (false)
@@ -0,0 +1,178 @@
+// AlignmentBlock: tts_alignment events encoded and decoded back, including
+// empty character lists, ids at their length limits, non-ASCII and escaped
+// characters and times at the ends of their range, the header layout,
+// events the encoder refuses and blocks the decoder rejects.
+
+#include "AlignmentBlock.h"
+#include "Check.h"
+#include "Json.h"
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+using bridge::AlignmentBlock;
+using bridge::JsonReader;
+using bridge::JsonValue;
+
+std::string Event(std::string_view utterance_id, std::string_view chars, std::string_view starts,
+                  std::string_view ends) {
+  return "{\"type\":\"tts_alignment\",\"utterance_id\":\"" + std::string(utterance_id) + "\",\"chars\":[" +
+         std::string(chars) + "],\"char_start_ms\":[" + std::string(starts) + "],\"char_end_ms\":[" +
+         std::string(ends) + "]}";
+}
+
+bool Encode(const std::string& event_json, std::string_view session_id, std::string* out, std::string* error) {
+  JsonReader reader;
+  const JsonValue* event = reader.Parse(event_json, error);
+  CHECK(event != nullptr);
+  return event != nullptr && bridge::EncodeAlignmentBlock(*event, session_id, out, error);
+}
+
+void TestRoundTrip() {
+  // "é" twice, once escaped, a CJK character and one outside the BMP as a
+  // surrogate pair; starts that go backwards and times far apart.
+  const std::string event = Event("utt-1", "\"H\",\"\xC3\xA9\",\"\\u00e9\",\"\xE6\xBC\xA2\",\"\\ud83d\\ude00\",\" \"",
+                                  "0,120,80,-5,4611686018427387904,-9223372036854775808",
+                                  "100,200,90,0,-4611686018427387904,9223372036854775807");
+  std::string block = "prefix";
+  std::string error;
+  CHECK(Encode(event, "session-\xE2\x9C\x93", &block, &error));
+  CHECK(block.compare(0, 6, "prefix") == 0);
+
+  const std::string_view encoded = std::string_view(block).substr(6);
+  const std::string text = "H\xC3\xA9\xC3\xA9\xE6\xBC\xA2\xF0\x9F\x98\x80 ";
+  // Header: version, kind, id lengths, reserved, count, text bytes.
+  const std::string header("\x01\x03\x05\x00\x0B\x00\x00\x00\x06\x00\x00\x00\x0D\x00\x00\x00", 16);
+  CHECK(encoded.substr(0, 16) == header);
+  CHECK(encoded.substr(16, 5 + 11 + text.size()) == "utt-1session-\xE2\x9C\x93" + text);
+
+  AlignmentBlock decoded;
+  CHECK(bridge::DecodeAlignmentBlock(encoded, &decoded, &error));
+  CHECK(decoded.utterance_id == "utt-1");
+  CHECK(decoded.session_id == "session-\xE2\x9C\x93");
+  CHECK(decoded.text == text);
+  CHECK(decoded.char_bytes == (std::vector<uint32_t>{1, 2, 2, 3, 4, 1}));
+  CHECK(decoded.start_ms == (std::vector<int64_t>{0, 120, 80, -5, int64_t{1} << 62,
+                                                  std::numeric_limits<int64_t>::min()}));
+  CHECK(decoded.end_ms == (std::vector<int64_t>{100, 200, 90, 0, -(int64_t{1} << 62),
+                                                std::numeric_limits<int64_t>::max()}));
+
+  // Every cut of the block is refused.
+  for (size_t size = 0; size < encoded.size(); ++size) {
+    CHECK(!bridge::DecodeAlignmentBlock(encoded.substr(0, size), &decoded, &error));
+  }
+}
+
+void TestBoundaries() {
+  std::string error;
+
+  // No characters: the ids alone, and a default session.
+  std::string block;
+  CHECK(Encode(Event("u", "", "", ""), "", &block, &error));
+  CHECK(block.size() == bridge::kAlignmentBlockHeaderBytes + 1);
+  AlignmentBlock decoded;
+  decoded.char_bytes = {7};
+  CHECK(bridge::DecodeAlignmentBlock(block, &decoded, &error));
+  CHECK(decoded.utterance_id == "u" && decoded.session_id.empty() && decoded.text.empty());
+  CHECK(decoded.char_bytes.empty() && decoded.start_ms.empty() && decoded.end_ms.empty());
+
+  // Ids fill their 16-bit lengths, and one byte more does not fit.
+  const std::string longest(0xFFFF, 'i');
+  block.clear();
+  CHECK(Encode(Event(longest, "\"a\"", "1", "2"), longest, &block, &error));
+  CHECK(bridge::DecodeAlignmentBlock(block, &decoded, &error));
+  CHECK(decoded.utterance_id == longest && decoded.session_id == longest && decoded.text == "a");
+  block.clear();
+  CHECK(!Encode(Event(longest + "i", "\"a\"", "1", "2"), "", &block, &error));
+  CHECK(error == "tts_alignment id is too long" && block.empty());
+  CHECK(!Encode(Event("u", "\"a\"", "1", "2"), longest + "i", &block, &error));
+  CHECK(error == "tts_alignment id is too long" && block.empty());
+
+  // Many characters, so lengths and counts need more than one byte.
+  std::string chars;
+  std::string starts;
+  std::string ends;
+  for (int i = 0; i < 1000; ++i) {
+    const char* separator = i == 0 ? "" : ",";
+    chars.append(separator).append(i % 2 == 0 ? "\"\xD0\xB6\"" : "\"x\"");
+    starts.append(separator).append(std::to_string(i * 300));
+    ends.append(separator).append(std::to_string(i * 300 + 250));
+  }
+  block.clear();
+  CHECK(Encode(Event("u", chars, starts, ends), "s", &block, &error));
+  CHECK(bridge::DecodeAlignmentBlock(block, &decoded, &error));
+  CHECK(decoded.char_bytes.size() == 1000 && decoded.text.size() == 1500);
+  CHECK(decoded.start_ms[999] == 999 * 300 && decoded.end_ms[999] == 999 * 300 + 250);
+}
+
+void TestRefusedEvents() {
+  const struct {
+    std::string event;
+    const char* error;
+  } cases[] = {
+      {"{\"type\":\"tts_alignment\",\"chars\":[\"a\"],\"char_start_ms\":[1]}", "tts_alignment is missing its arrays"},
+      {"{\"chars\":[\"a\"],\"char_start_ms\":[1],\"char_end_ms\":[2],\"chars\":\"a\"}",
+       "tts_alignment is missing its arrays"},
+      {Event("u", "\"a\",\"b\"", "1", "2,3"), "tts_alignment arrays differ in length"},
+      {Event("u", "\"a\"", "1,2", "2"), "tts_alignment arrays differ in length"},
+      {Event("u", "\"a\",7", "1,2", "2,3"), "tts_alignment character is not a string"},
+      {Event("u", "\"a\",\"b\"", "1,1.5", "2,3"), "tts_alignment time is not an integer"},
+      {Event("u", "\"a\",\"b\"", "1,2", "2,1e3"), "tts_alignment time is not an integer"},
+      {Event("u", "\"a\",\"b\"", "1,\"2\"", "2,3"), "tts_alignment time is not an integer"},
+      {Event("u", "\"a\"", "9223372036854775808", "2"), "tts_alignment time is not an integer"},
+  };
+  for (const auto& c : cases) {
+    std::string block = "kept";
+    std::string error;
+    CHECK(!Encode(c.event, "", &block, &error));
+    CHECK(error == c.error);
+    // Nothing is left behind after what was there.
+    CHECK(block == "kept");
+  }
+}
+
+void TestRejectedBlocks() {
+  std::string block;
+  std::string error;
+  CHECK(Encode(Event("u", "\"a\",\"bc\"", "1,2", "3,4"), "s", &block, &error));
+  AlignmentBlock decoded;
+  CHECK(bridge::DecodeAlignmentBlock(block, &decoded, &error));
+
+  const auto rejects = [&](std::string bytes, const char* expected) {
+    std::string decode_error;
+    return !bridge::DecodeAlignmentBlock(bytes, &decoded, &decode_error) && decode_error == expected;
+  };
+  CHECK(rejects(block.substr(0, 15), "alignment block is shorter than its header"));
+  CHECK(rejects(std::string(block).replace(0, 1, "\x02"), "not an alignment block"));
+  CHECK(rejects(std::string(block).replace(1, 1, "\x01"), "not an alignment block"));
+  // Ids and text longer than what follows.
+  CHECK(rejects(std::string(block).replace(2, 1, "\x40"), "alignment block is truncated"));
+  CHECK(rejects(std::string(block).replace(12, 1, "\x7F"), "alignment block is truncated"));
+  // One character more than the timings.
+  CHECK(rejects(std::string(block).replace(8, 1, "\x03"), "alignment block is truncated"));
+  // Trailing bytes, or a count that leaves timings over.
+  CHECK(rejects(block + '\0', "alignment block lengths do not add up"));
+  CHECK(rejects(std::string(block).replace(8, 1, "\x01"), "alignment block lengths do not add up"));
+  // Character lengths that only add up by wrapping around.
+  std::string wrapped = block.substr(0, 16 + 1 + 1 + 3);
+  wrapped.append("\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\x01", 10).append("\x02\x02", 2);
+  wrapped.append("\x04\x02\x02", 3);
+  CHECK(rejects(wrapped, "alignment block lengths do not add up"));
+  // A varint that never ends.
+  CHECK(rejects(block.substr(0, 21) + std::string(12, '\x80'), "alignment block is truncated"));
+}
+
+}  // namespace
+
+int main() {
+  TestRoundTrip();
+  TestBoundaries();
+  TestRefusedEvents();
+  TestRejectedBlocks();
+  return bridge_test::TestResult();
+}
@@ -0,0 +1,241 @@
+// AudioPacer against a real pair of shared-memory rings, read the way the
+// audio engine reads them: each ring's blocks played in the order they were
+// submitted while the other ring's play alongside, rings kept at their
+// target fill, cancels and lost sources taking back queued and later audio,
+// the queue limit, and a ring that never opens expiring its audio.
+
+#include "AudioPacer.h"
+#include "Check.h"
+#include "SharedMemoryAudioRing.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using bridge::AudioPacer;
+using bridge::SharedMemoryAudioRing;
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t kCapacity = 480;
+constexpr uint32_t kTargetFill = 64;
+
+std::string RingName(std::string_view what) {
+  return "/bridge_pacer_test_" + std::to_string(getpid()) + "_" + std::string(what);
+}
+
+// The audio engine's side of a ring: created first, read as it plays.
+class Reader {
+ public:
+  explicit Reader(std::string name) : name_(std::move(name)) {
+    CHECK(ring_.Open(name_, true, 1, kCapacity));
+  }
+  ~Reader() {
+    ring_.Close();
+    unlink(("/tmp/" + name_.substr(1) + ".ring").c_str());
+  }
+
+  // Reads until `count` frames have arrived or `timeout` passes, checking
+  // that the pacer never fills the ring beyond its target.
+  std::vector<float> ReadFrames(size_t count, std::chrono::milliseconds timeout = std::chrono::seconds(10)) {
+    std::vector<float> frames;
+    float buffer[kCapacity];
+    const auto deadline = Clock::now() + timeout;
+    while (frames.size() < count && Clock::now() < deadline) {
+      overfilled_ |= ring_.available_frames() > kTargetFill;
+      const size_t got = ring_.Read(buffer, std::min<size_t>(16, count - frames.size()));
+      frames.insert(frames.end(), buffer, buffer + got);
+      std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+    return frames;
+  }
+
+  bool overfilled() const {
+    return overfilled_;
+  }
+
+ private:
+  std::string name_;
+  SharedMemoryAudioRing ring_;
+  bool overfilled_ = false;
+};
+
+AudioPacer::Options PacerOptions() {
+  AudioPacer::Options options;
+  options.mic_feed_name = RingName("mic");
+  options.speaker_tap_name = RingName("tap");
+  options.channels = 1;
+  options.ring_capacity_frames = kCapacity;
+  options.target_fill_frames = kTargetFill;
+  options.tick = std::chrono::microseconds(1000);
+  return options;
+}
+
+// Frames of block `id`, each telling which block and which frame it is.
+std::vector<float> Frames(uint32_t id, size_t count) {
+  std::vector<float> frames(count);
+  for (size_t i = 0; i < count; ++i) {
+    frames[i] = static_cast<float>(id * 10000 + i);
+  }
+  return frames;
+}
+
+std::vector<float> Concat(std::initializer_list<std::vector<float>> parts) {
+  std::vector<float> all;
+  for (const std::vector<float>& part : parts) {
+    all.insert(all.end(), part.begin(), part.end());
+  }
+  return all;
+}
+
+void Submit(AudioPacer* pacer, uint64_t source, std::string_view stream, uint8_t targets,
+            const std::vector<float>& frames) {
+  pacer->Submit(source, stream, targets, frames.data(), frames.size());
+}
+
+bool WaitFor(const std::function<bool()>& condition) {
+  const auto deadline = Clock::now() + std::chrono::seconds(10);
+  while (!condition()) {
+    if (Clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+void TestOrdering() {
+  Reader mic(RingName("mic"));
+  Reader tap(RingName("tap"));
+  AudioPacer pacer(PacerOptions());
+
+  // Queued before the thread starts, so the order is fixed: the block for
+  // both rings waits for the ones ahead of it on each.
+  Submit(&pacer, 1, "a", bridge::kPaceMicFeed, Frames(1, 200));
+  Submit(&pacer, 1, "b", bridge::kPaceSpeakerTap, Frames(2, 100));
+  Submit(&pacer, 2, "c", bridge::kPaceMicFeed, Frames(3, 150));
+  Submit(&pacer, 2, "d", bridge::kPaceMicFeed | bridge::kPaceSpeakerTap, Frames(4, 50));
+  CHECK(pacer.queued_frames() == 500);
+  pacer.Start();
+  // More for the speaker tap after the shared block, while it all plays.
+  Submit(&pacer, 1, "e", bridge::kPaceSpeakerTap, Frames(5, 70));
+
+  std::vector<float> tap_frames;
+  std::thread tap_thread([&]() { tap_frames = tap.ReadFrames(220); });
+  const std::vector<float> mic_frames = mic.ReadFrames(400);
+  tap_thread.join();
+  CHECK(mic_frames == Concat({Frames(1, 200), Frames(3, 150), Frames(4, 50)}));
+  CHECK(tap_frames == Concat({Frames(2, 100), Frames(4, 50), Frames(5, 70)}));
+  CHECK(!mic.overfilled() && !tap.overfilled());
+
+  CHECK(WaitFor([&]() { return pacer.queued_frames() == 0; }));
+  pacer.Stop();
+  CHECK(pacer.ring_stats(bridge::kPaceMicFeed).frames_written.value() == 400);
+  CHECK(pacer.ring_stats(bridge::kPaceSpeakerTap).frames_written.value() == 220);
+  CHECK(pacer.frames_discarded() == 0);
+}
+
+void TestCancel() {
+  Reader mic(RingName("mic"));
+  Reader tap(RingName("tap"));
+  AudioPacer pacer(PacerOptions());
+
+  // Queued audio of a cancelled stream goes, and so does what comes later,
+  // until it is released; other streams and an empty one are untouched.
+  Submit(&pacer, 1, "keep", bridge::kPaceMicFeed, Frames(1, 100));
+  Submit(&pacer, 1, "drop", bridge::kPaceMicFeed | bridge::kPaceSpeakerTap, Frames(2, 100));
+  Submit(&pacer, 1, "", bridge::kPaceMicFeed, Frames(3, 30));
+  pacer.Cancel("drop");
+  pacer.Cancel("");
+  CHECK(pacer.queued_frames() == 130);
+  CHECK(pacer.frames_discarded() == 100);
+  Submit(&pacer, 1, "drop", bridge::kPaceMicFeed, Frames(4, 40));
+  CHECK(pacer.queued_frames() == 130);
+  CHECK(pacer.frames_discarded() == 140);
+  pacer.Release("drop");
+  Submit(&pacer, 1, "drop", bridge::kPaceMicFeed, Frames(5, 20));
+  CHECK(pacer.queued_frames() == 150);
+
+  // A lost source takes its queued audio with it.
+  Submit(&pacer, 7, "other", bridge::kPaceMicFeed, Frames(6, 60));
+  pacer.DiscardSource(7);
+  CHECK(pacer.queued_frames() == 150);
+  CHECK(pacer.frames_discarded() == 200);
+
+  pacer.Start();
+  CHECK(mic.ReadFrames(150) == Concat({Frames(1, 100), Frames(3, 30), Frames(5, 20)}));
+  CHECK(tap.ReadFrames(1, std::chrono::milliseconds(50)).empty());
+
+  // Cancelling a block partway through drops what has not been written;
+  // what is already in the ring plays out, and nothing after it.
+  Submit(&pacer, 1, "long", bridge::kPaceMicFeed, Frames(8, 4000));
+  std::vector<float> heard = mic.ReadFrames(200);
+  CHECK(heard == Frames(8, 200));
+  pacer.Cancel("long");
+  CHECK(pacer.queued_frames() == 0);
+  const uint64_t written = pacer.ring_stats(bridge::kPaceMicFeed).frames_written.value() - 150;
+  CHECK(pacer.frames_discarded() == 200 + 4000 - written);
+  const std::vector<float> rest = mic.ReadFrames(4000, std::chrono::milliseconds(100));
+  CHECK(200 + rest.size() == written && written <= 200 + kTargetFill);
+  heard.insert(heard.end(), rest.begin(), rest.end());
+  CHECK(heard == Frames(8, written));
+  pacer.Stop();
+}
+
+void TestQueueLimit() {
+  Reader mic(RingName("mic"));
+  Reader tap(RingName("tap"));
+  AudioPacer::Options options = PacerOptions();
+  options.max_queued_frames = 100;
+  AudioPacer pacer(options);
+  Submit(&pacer, 1, "a", bridge::kPaceMicFeed, Frames(1, 80));
+  Submit(&pacer, 1, "b", bridge::kPaceMicFeed | bridge::kPaceSpeakerTap, Frames(2, 30));
+  Submit(&pacer, 1, "c", bridge::kPaceSpeakerTap, Frames(3, 20));
+  CHECK(pacer.queued_frames() == 100);
+  CHECK(pacer.ring_stats(bridge::kPaceMicFeed).frames_dropped.value() == 30);
+  CHECK(pacer.ring_stats(bridge::kPaceSpeakerTap).frames_dropped.value() == 30);
+  pacer.Start();
+  CHECK(mic.ReadFrames(80) == Frames(1, 80));
+  CHECK(tap.ReadFrames(20) == Frames(3, 20));
+  pacer.Stop();
+}
+
+void TestRingExpiry() {
+  // Only the mic_feed ring exists; the speaker_tap one never opens.
+  Reader mic(RingName("mic"));
+  AudioPacer pacer(PacerOptions());
+  Submit(&pacer, 1, "tap only", bridge::kPaceSpeakerTap, Frames(1, 300));
+  Submit(&pacer, 1, "both", bridge::kPaceMicFeed | bridge::kPaceSpeakerTap, Frames(2, 50));
+  Submit(&pacer, 1, "mic only", bridge::kPaceMicFeed, Frames(3, 40));
+  pacer.Start();
+
+  // The block for both rings waits behind the speaker-tap block until that
+  // expires, then plays on the mic_feed ring alone.
+  CHECK(mic.ReadFrames(90) == Concat({Frames(2, 50), Frames(3, 40)}));
+  CHECK(WaitFor([&]() { return pacer.queued_frames() == 0; }));
+  CHECK(pacer.ring_stats(bridge::kPaceSpeakerTap).frames_expired.value() == 350);
+  CHECK(pacer.ring_stats(bridge::kPaceSpeakerTap).frames_written.value() == 0);
+  CHECK(pacer.ring_stats(bridge::kPaceMicFeed).frames_expired.value() == 0);
+  CHECK(pacer.ring_stats(bridge::kPaceMicFeed).frames_written.value() == 90);
+  pacer.Stop();
+}
+
+}  // namespace
+
+int main() {
+  TestOrdering();
+  TestCancel();
+  TestQueueLimit();
+  TestRingExpiry();
+  return bridge_test::TestResult();
+}
@@ -0,0 +1,258 @@
+// Base64: the RFC 4648 test vectors, every codec built for this CPU (SSSE3
+// and AVX2, or NEON) against the scalar one over many lengths, offsets and
+// output capacities with a bad character at every position, the streaming
+// encoder and decoder split at every point, and malformed text.
+
+#include "Base64.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using bridge::Base64Codec;
+using bridge::Base64Isa;
+
+std::string Encode(std::string_view plain) {
+  std::string text(bridge::Base64EncodedSize(plain.size()), '\0');
+  text.resize(bridge::Base64Encode(plain.data(), plain.size(), text.data()));
+  return text;
+}
+
+bool Decode(std::string_view text, std::string* plain, size_t capacity) {
+  plain->assign(capacity, '\0');
+  size_t written = 0;
+  const bool ok = bridge::Base64Decode(text, plain->data(), capacity, &written);
+  plain->resize(written);
+  return ok;
+}
+
+bool Decode(std::string_view text, std::string* plain) {
+  return Decode(text, plain, bridge::Base64DecodedMaxSize(text.size()));
+}
+
+std::string RandomBytes(size_t size, uint32_t seed) {
+  std::mt19937 random(seed);
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::string bytes(size, '\0');
+  for (char& c : bytes) {
+    c = static_cast<char>(byte(random));
+  }
+  return bytes;
+}
+
+// RFC 4648 section 10, both ways and with the padding left off.
+void TestVectors() {
+  const std::pair<std::string_view, std::string_view> vectors[] = {
+      {"", ""},
+      {"f", "Zg=="},
+      {"fo", "Zm8="},
+      {"foo", "Zm9v"},
+      {"foob", "Zm9vYg=="},
+      {"fooba", "Zm9vYmE="},
+      {"foobar", "Zm9vYmFy"},
+  };
+  for (const auto& [plain, encoded] : vectors) {
+    CHECK(Encode(plain) == encoded);
+    const std::string unpadded(encoded.substr(0, encoded.find('=')));
+    for (const std::string_view input : {encoded, std::string_view(unpadded)}) {
+      std::string bytes;
+      CHECK(Decode(input, &bytes) && bytes == plain);
+    }
+  }
+
+  // Every byte value, and the whole alphabet.
+  std::string all(256, '\0');
+  for (int i = 0; i < 256; ++i) {
+    all[static_cast<size_t>(i)] = static_cast<char>(i);
+  }
+  std::string bytes;
+  CHECK(Decode(Encode(all), &bytes) && bytes == all);
+  CHECK(Decode("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/", &bytes) &&
+        Encode(bytes) == "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/");
+}
+
+void TestMalformed() {
+  std::string bytes;
+  const std::string_view malformed[] = {"Zm9v YmFy", "Zm9v\nYmFy", "Zm9vYmFy\n", " Zm9v", "Zm9-YmFy", "Zm9_",
+                                        "Zm9vYm\x80y", std::string_view("Zm9v\0mFy", 8), "=m9v", "Z=9v", "Zm=v",
+                                        "Zm9vY", "Z", "Zg==Zg==", "Zg==Zm9v", "Zg==\n", "Zm8=A", "Zg==="};
+  for (const std::string_view text : malformed) {
+    CHECK(!Decode(text, &bytes));
+  }
+  // Unpadded and padded last groups of the right length are fine.
+  CHECK(Decode("Zm9vYg", &bytes) && bytes == "foob");
+  CHECK(Decode("Zm9vYmE", &bytes) && bytes == "fooba");
+
+  // Output that does not fit fails rather than being cut short.
+  CHECK(!Decode("Zm9vYmFy", &bytes, 5));
+  CHECK(!Decode("Zm9vYmE=", &bytes, 4));
+  CHECK(!Decode("Zm9vYmE", &bytes, 4));
+  CHECK(Decode("Zm9vYmE", &bytes, 5) && bytes == "fooba");
+  const std::string long_text = Encode(RandomBytes(3000, 1));
+  CHECK(!Decode(long_text, &bytes, 2999));
+  CHECK(Decode(long_text, &bytes, 3000) && bytes == RandomBytes(3000, 1));
+}
+
+// Characters outside the alphabet, several either side of its ranges.
+constexpr char kBadCharacters[] = {'=', ' ', '\n', '\0', '-', '_', '@', '[', '`', '{', '*', ',', '.', ':', '\x80',
+                                   '\xFF'};
+
+void CompareWithScalar(const Base64Codec& codec) {
+  const Base64Codec& scalar = *bridge::Base64CodecFor(Base64Isa::kScalar);
+  std::vector<size_t> sizes;
+  for (size_t size = 0; size <= 200; ++size) {
+    sizes.push_back(size);
+  }
+  sizes.push_back(1000);
+  sizes.push_back(4099);
+
+  int mismatches = 0;
+  for (const size_t size : sizes) {
+    for (size_t offset = 0; offset < 4; ++offset) {
+      const std::string plain = RandomBytes(size + offset, static_cast<uint32_t>(size * 4 + offset));
+      const auto* in = reinterpret_cast<const uint8_t*>(plain.data()) + offset;
+
+      std::string expected(size / 3 * 4 + 1, '#');
+      std::string actual(size / 3 * 4 + 1, '#');
+      const size_t expected_chars = scalar.encode_groups(in, size, expected.data() + 1);
+      const size_t actual_chars = codec.encode_groups(in, size, actual.data() + 1);
+      mismatches += expected_chars == size / 3 * 4 && actual_chars == expected_chars && actual == expected ? 0 : 1;
+
+      // Decoding from one character in, into buffers one byte in, at full
+      // capacity and less. Only what each reports as consumed is compared;
+      // nothing past the capacity may be touched.
+      const std::string& text = expected;
+      const size_t chars = text.size() - 1;
+      const size_t full = chars / 4 * 3;
+      const size_t short_by_one = full - std::min<size_t>(full, 1);
+      const size_t short_by_group = full - std::min<size_t>(full, 3);
+      for (const size_t capacity : {full, short_by_one, short_by_group, full / 2}) {
+        std::vector<uint8_t> expected_out(capacity + 33, 0xA5);
+        std::vector<uint8_t> actual_out(capacity + 33, 0xA5);
+        const size_t expected_used = scalar.decode_groups(text.data() + 1, chars, expected_out.data() + 1, capacity);
+        const size_t actual_used = codec.decode_groups(text.data() + 1, chars, actual_out.data() + 1, capacity);
+        bool same = expected_used == actual_used && expected_used % 4 == 0 &&
+                    std::memcmp(expected_out.data() + 1, actual_out.data() + 1, expected_used / 4 * 3) == 0 &&
+                    actual_out[0] == 0xA5;
+        for (size_t i = capacity + 1; i < actual_out.size(); ++i) {
+          same = same && actual_out[i] == 0xA5;
+        }
+        if (capacity == full) {
+          same = same && expected_used == chars && std::memcmp(expected_out.data() + 1, in, full) == 0;
+        }
+        mismatches += same ? 0 : 1;
+      }
+
+      // A bad character anywhere stops decoding at the start of its group.
+      if (size > 200 && offset > 0) {
+        continue;
+      }
+      std::vector<uint8_t> expected_out(full + 1);
+      std::vector<uint8_t> actual_out(full + 1);
+      for (size_t position = 0; position < chars; ++position) {
+        std::string bad = text;
+        bad[position + 1] = kBadCharacters[(position + size) % sizeof(kBadCharacters)];
+        const size_t expected_used = scalar.decode_groups(bad.data() + 1, chars, expected_out.data(), full);
+        const size_t actual_used = codec.decode_groups(bad.data() + 1, chars, actual_out.data(), full);
+        const bool same = expected_used == position / 4 * 4 && actual_used == expected_used &&
+                          std::memcmp(expected_out.data(), actual_out.data(), expected_used / 4 * 3) == 0;
+        mismatches += same ? 0 : 1;
+      }
+    }
+  }
+  if (mismatches != 0) {
+    std::cerr << codec.name << ": " << mismatches << " result(s) differ from scalar\n";
+  }
+  CHECK(mismatches == 0);
+}
+
+void TestStreaming() {
+  for (const size_t size : {size_t{0}, size_t{1}, size_t{2}, size_t{3}, size_t{47}, size_t{100}}) {
+    const std::string plain = RandomBytes(size, static_cast<uint32_t>(size));
+    const std::string text = Encode(plain);
+
+    // The encoder split in two at every point.
+    for (size_t split = 0; split <= size; ++split) {
+      bridge::Base64Encoder encoder;
+      std::string out(bridge::Base64EncodedSize(size + 2) * 2 + 4, '\0');
+      size_t written = encoder.Update(plain.data(), split, out.data());
+      written += encoder.Update(plain.data() + split, size - split, out.data() + written);
+      written += encoder.Finish(out.data() + written);
+      out.resize(written);
+      CHECK(out == text);
+    }
+
+    // The decoder split in two at every point, padded and not, each call
+    // given room for exactly what its text completes.
+    const std::string unpadded = text.substr(0, text.find('='));
+    for (const std::string& input : {text, unpadded}) {
+      for (size_t split = 0; split <= input.size(); ++split) {
+        bridge::Base64Decoder decoder;
+        std::string out(size, '\0');
+        size_t first = 0;
+        size_t second = 0;
+        size_t last = 0;
+        const size_t room = std::min(size, split / 4 * 3);
+        CHECK(decoder.Update(std::string_view(input).substr(0, split), out.data(), room, &first));
+        CHECK(decoder.Update(std::string_view(input).substr(split), out.data() + first, size - first, &second));
+        CHECK(decoder.Finish(out.data() + first + second, size - first - second, &last));
+        CHECK(first + second + last == size && out == plain);
+      }
+    }
+
+    // A byte at a time.
+    bridge::Base64Decoder decoder;
+    std::string out;
+    for (const char c : text) {
+      char byte[3];
+      size_t written = 0;
+      CHECK(decoder.Update(std::string_view(&c, 1), byte, sizeof(byte), &written));
+      out.append(byte, written);
+    }
+    size_t written = 0;
+    CHECK(decoder.Finish(nullptr, 0, &written) && written == 0);
+    CHECK(out == plain);
+  }
+
+  // A failure sticks until Reset().
+  bridge::Base64Decoder decoder;
+  uint8_t out[16];
+  size_t written = 0;
+  CHECK(!decoder.Update("Zm9v!AAA", out, sizeof(out), &written));
+  CHECK(!decoder.Update("Zm9v", out, sizeof(out), &written));
+  decoder.Reset();
+  CHECK(decoder.Update("Zm9v", out, sizeof(out), &written) && written == 3);
+  // Text after the padding, in the next call.
+  CHECK(decoder.Update("Zg==", out, sizeof(out), &written) && written == 1);
+  CHECK(!decoder.Update("Zg", out, sizeof(out), &written));
+  decoder.Reset();
+  CHECK(decoder.Update("Z", out, sizeof(out), &written));
+  CHECK(!decoder.Finish(out, sizeof(out), &written));
+}
+
+}  // namespace
+
+int main() {
+  TestVectors();
+  TestMalformed();
+  int compared = 0;
+  for (const Base64Isa isa : {Base64Isa::kSsse3, Base64Isa::kAvx2, Base64Isa::kNeon}) {
+    if (const Base64Codec* codec = bridge::Base64CodecFor(isa)) {
+      std::cout << "checking " << codec->name << " against scalar\n";
+      CompareWithScalar(*codec);
+      ++compared;
+    }
+  }
+  std::cout << compared << " SIMD codec(s) checked; active: " << bridge::ActiveBase64Codec().name << "\n";
+  TestStreaming();
+  return bridge_test::TestResult();
+}
@@ -0,0 +1,201 @@
+// permessage-deflate: offer negotiation, messages compressed by the bridge
+// and by a client window of its own inflating back to the original with and
+// without context takeover, fed whole and in pieces, and corrupt input.
+
+#include "Check.h"
+#include "PerMessageDeflate.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+using bridge::DeflateOptions;
+using bridge::DeflateParams;
+using bridge::PerMessageDeflate;
+
+void TestNegotiation() {
+  struct Case {
+    const char* header;
+    bool accepted;
+    const char* response;
+  };
+  const Case cases[] = {
+      {"", false, ""},
+      {"permessage-deflate", true, "permessage-deflate"},
+      {"x-webkit-deflate-frame, permessage-deflate; client_max_window_bits", true, "permessage-deflate"},
+      {"permessage-deflate; server_max_window_bits=10; client_no_context_takeover", true,
+       "permessage-deflate; client_no_context_takeover; server_max_window_bits=10"},
+      {"permessage-deflate; server_max_window_bits=\"12\"", true, "permessage-deflate; server_max_window_bits=12"},
+      {"permessage-deflate; server_no_context_takeover", true, "permessage-deflate; server_no_context_takeover"},
+      {"permessage-deflate; unknown=1, permessage-deflate; client_max_window_bits=9", true,
+       "permessage-deflate; client_max_window_bits=9"},
+      {"permessage-deflate; server_max_window_bits=8", false, ""},
+      {"permessage-deflate; server_max_window_bits=16", false, ""},
+      {"permessage-deflate; server_max_window_bits", false, ""},
+      {"permessage-deflate; client_max_window_bits=x", false, ""},
+      {"deflate-frame", false, ""},
+  };
+  for (const Case& c : cases) {
+    DeflateParams params;
+    std::string response;
+    const bool accepted = bridge::NegotiatePerMessageDeflate(c.header, DeflateOptions{}, &params, &response);
+    CHECK(accepted == c.accepted);
+    CHECK(params.enabled == c.accepted);
+    if (accepted) {
+      CHECK(response == c.response);
+    }
+  }
+
+  DeflateParams params;
+  std::string response;
+  DeflateOptions disabled;
+  disabled.enabled = false;
+  CHECK(!bridge::NegotiatePerMessageDeflate("permessage-deflate", disabled, &params, &response));
+
+  DeflateOptions configured;
+  configured.context_takeover = false;
+  configured.server_max_window_bits = 8;
+  configured.client_max_window_bits = 10;
+  CHECK(bridge::NegotiatePerMessageDeflate("permessage-deflate; client_max_window_bits", configured, &params,
+                                           &response));
+  CHECK(response ==
+        "permessage-deflate; server_no_context_takeover; server_max_window_bits=9; client_max_window_bits=10");
+  CHECK(params.server_max_window_bits == 9);
+  CHECK(params.server_no_context_takeover);
+}
+
+// Inflates `compressed` in pieces of `piece` bytes (all of it when 0).
+bool Inflate(PerMessageDeflate* inflater, std::string_view compressed, size_t piece, std::string* out) {
+  out->clear();
+  const auto sink = [out](const uint8_t* data, size_t size) { out->append(reinterpret_cast<const char*>(data), size); };
+  if (piece == 0) {
+    piece = compressed.size();
+  }
+  const auto* bytes = reinterpret_cast<const uint8_t*>(compressed.data());
+  size_t offset = 0;
+  do {
+    const size_t size = std::min(piece, compressed.size() - offset);
+    offset += size;
+    if (!inflater->Decompress(bytes + offset - size, size, offset == compressed.size(), sink)) {
+      return false;
+    }
+  } while (offset < compressed.size());
+  return true;
+}
+
+std::vector<std::string> SampleMessages() {
+  std::vector<std::string> messages = {
+      "{\"type\":\"stt_partial\",\"session_id\":\"A\",\"stream_id\":\"s\",\"text\":\"hello\"}",
+      "{\"type\":\"stt_partial\",\"session_id\":\"A\",\"stream_id\":\"s\",\"text\":\"hello there\"}",
+      "",
+      std::string(100000, 'a'),
+  };
+  std::mt19937 random(29);
+  std::string noise(40000, '\0');
+  for (char& c : noise) {
+    c = static_cast<char>(random());
+  }
+  messages.push_back(noise);
+  return messages;
+}
+
+void TestRoundTrip() {
+  for (const bool no_takeover : {false, true}) {
+    DeflateParams params;
+    params.enabled = true;
+    params.server_no_context_takeover = no_takeover;
+    params.client_no_context_takeover = no_takeover;
+    for (const size_t piece : {size_t{0}, size_t{1}, size_t{1000}}) {
+      PerMessageDeflate deflater;
+      PerMessageDeflate inflater;
+      CHECK(deflater.Init(params));
+      CHECK(inflater.Init(params));
+      std::string compressed;
+      std::string inflated;
+      for (int pass = 0; pass < 2; ++pass) {
+        for (const std::string& message : SampleMessages()) {
+          CHECK(deflater.Compress(reinterpret_cast<const uint8_t*>(message.data()), message.size(), &compressed));
+          CHECK(Inflate(&inflater, compressed, piece, &inflated));
+          CHECK(inflated == message);
+        }
+      }
+    }
+  }
+}
+
+// What a client with a 9-bit window sends: raw deflate, sync-flushed, with
+// the 00 00 FF FF tail removed. An empty message that flushes nothing is
+// sent as a single empty stored-block header.
+std::string ClientCompress(z_stream* stream, std::string_view message) {
+  std::string out(deflateBound(stream, static_cast<uLong>(message.size())) + 16, '\0');
+  stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(message.data()));
+  stream->avail_in = static_cast<uInt>(message.size());
+  stream->next_out = reinterpret_cast<Bytef*>(out.data());
+  stream->avail_out = static_cast<uInt>(out.size());
+  const int rc = deflate(stream, Z_SYNC_FLUSH);
+  out.resize(out.size() - stream->avail_out);
+  if (rc == Z_BUF_ERROR && out.empty()) {
+    return std::string(1, '\0');
+  }
+  CHECK(rc == Z_OK);
+  CHECK(out.size() >= 4 && out.compare(out.size() - 4, 4, std::string("\0\0\xFF\xFF", 4)) == 0);
+  out.resize(out.size() - 4);
+  return out;
+}
+
+void TestClientWindow() {
+  z_stream client{};
+  CHECK(deflateInit2(&client, Z_BEST_COMPRESSION, Z_DEFLATED, -9, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+  DeflateParams params;
+  params.enabled = true;
+  PerMessageDeflate inflater;
+  CHECK(inflater.Init(params));
+  std::string inflated;
+  for (const std::string& message : SampleMessages()) {
+    CHECK(Inflate(&inflater, ClientCompress(&client, message), 7, &inflated));
+    CHECK(inflated == message);
+  }
+  deflateEnd(&client);
+}
+
+void TestMalformed() {
+  DeflateParams params;
+  params.enabled = true;
+  const auto ignore = [](const uint8_t*, size_t) {};
+
+  PerMessageDeflate closed;
+  const uint8_t byte = 0;
+  CHECK(!closed.Decompress(&byte, 1, true, ignore));
+  std::string out;
+  CHECK(!closed.Compress(&byte, 1, &out));
+
+  // A final block of the reserved type 3, and a stored block whose length
+  // and its complement disagree.
+  const std::vector<std::vector<uint8_t>> corrupt = {
+      {0x07, 0x00},
+      {0x01, 0x05, 0x00, 0x00, 0x00, 'h', 'e', 'l', 'l', 'o'},
+  };
+  for (const std::vector<uint8_t>& input : corrupt) {
+    PerMessageDeflate inflater;
+    CHECK(inflater.Init(params));
+    CHECK(!inflater.Decompress(input.data(), input.size(), true, ignore));
+  }
+}
+
+}  // namespace
+
+int main() {
+  TestNegotiation();
+  TestRoundTrip();
+  TestClientWindow();
+  TestMalformed();
+  return bridge_test::TestResult();
+}
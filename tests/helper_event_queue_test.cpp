@@ -0,0 +1,122 @@
+// HelperEventQueue: slots rounded up, a full queue turning events away until
+// the consumer pops, positions wrapping many times round the slots, events
+// larger than a slot's reserve, and several producer threads at once.
+
+#include "Check.h"
+#include "HelperEventQueue.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using bridge::HelperEventQueue;
+using Clock = std::chrono::steady_clock;
+
+std::string Payload(uint64_t helper_id, uint64_t index) {
+  return "{\"helper\":" + std::to_string(helper_id) + ",\"index\":" + std::to_string(index) + "}";
+}
+
+void TestFullAndWrap() {
+  HelperEventQueue queue(5, 64);
+  CHECK(queue.capacity() == 8);
+  HelperEventQueue::Event event;
+  CHECK(!queue.Peek(&event));
+  CHECK(queue.size() == 0);
+
+  const Clock::time_point now = Clock::now();
+  uint64_t pushed = 0;
+  while (queue.TryPush(7, now, Payload(7, pushed))) {
+    ++pushed;
+  }
+  CHECK(pushed == 8);
+  CHECK(queue.size() == 8);
+
+  // Each pop makes room for exactly one more; the read side wraps too.
+  uint64_t popped = 0;
+  for (int round = 0; round < 100; ++round) {
+    CHECK(queue.Peek(&event));
+    CHECK(event.helper_id == 7 && event.received_at == now && event.payload == Payload(7, popped));
+    queue.Pop();
+    ++popped;
+    CHECK(queue.TryPush(7, now, Payload(7, pushed)));
+    ++pushed;
+    CHECK(!queue.TryPush(7, now, "no room"));
+  }
+  while (queue.Peek(&event)) {
+    CHECK(event.payload == Payload(7, popped));
+    queue.Pop();
+    ++popped;
+  }
+  CHECK(popped == pushed);
+  CHECK(queue.size() == 0);
+}
+
+void TestLargeEvents() {
+  HelperEventQueue queue(2, 16);
+  const std::string large(200 * 1024, 'L');
+  const std::string small = "{}";
+  HelperEventQueue::Event event;
+  for (int round = 0; round < 4; ++round) {
+    CHECK(queue.TryPush(1, Clock::now(), large));
+    CHECK(queue.TryPush(2, Clock::now(), small));
+    CHECK(queue.Peek(&event) && event.helper_id == 1 && event.payload == large);
+    queue.Pop();
+    CHECK(queue.Peek(&event) && event.helper_id == 2 && event.payload == small);
+    queue.Pop();
+  }
+}
+
+void TestProducerThreads() {
+  constexpr uint64_t kProducers = 4;
+  constexpr uint64_t kEventsEach = 50000;
+  HelperEventQueue queue(64, 64);
+  std::vector<std::thread> producers;
+  for (uint64_t helper_id = 0; helper_id < kProducers; ++helper_id) {
+    producers.emplace_back([&queue, helper_id]() {
+      for (uint64_t i = 0; i < kEventsEach;) {
+        if (queue.TryPush(helper_id, Clock::now(), Payload(helper_id, i))) {
+          ++i;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  // Each producer's events arrive in the order it pushed them.
+  std::vector<uint64_t> next(kProducers, 0);
+  uint64_t received = 0;
+  uint64_t out_of_order = 0;
+  HelperEventQueue::Event event;
+  while (received < kProducers * kEventsEach) {
+    if (!queue.Peek(&event)) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (event.helper_id >= kProducers || event.payload != Payload(event.helper_id, next[event.helper_id])) {
+      ++out_of_order;
+    } else {
+      ++next[event.helper_id];
+    }
+    queue.Pop();
+    ++received;
+  }
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+  CHECK(out_of_order == 0);
+  CHECK(!queue.Peek(&event));
+}
+
+}  // namespace
+
+int main() {
+  TestFullAndWrap();
+  TestLargeEvents();
+  TestProducerThreads();
+  return bridge_test::TestResult();
+}
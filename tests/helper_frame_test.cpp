@@ -0,0 +1,183 @@
+// HelperFrameReader in framed and json_lines modes, fed whole, a byte at a
+// time and in other pieces, and the small parsers beside it in HelperFrame.h.
+
+#include "Check.h"
+#include "HelperFrame.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+using bridge::HelperFrameKind;
+using bridge::HelperFrameReader;
+using bridge::HelperIpcMode;
+
+std::string Frame(HelperFrameKind kind, std::string_view payload, std::string_view attachment = {}) {
+  std::string frame(bridge::kHelperFrameHeaderBytes, '\0');
+  bridge::EncodeHelperFrameHeader(kind, static_cast<uint32_t>(payload.size()),
+                                  static_cast<uint32_t>(attachment.size()), reinterpret_cast<uint8_t*>(frame.data()));
+  frame.append(payload).append(attachment);
+  return frame;
+}
+
+// Feeds `stream` in pieces of at most `piece` bytes (all it can take when
+// 0) and returns what it reported, one "kind|payload|attachment" each.
+bool Feed(HelperFrameReader* reader, std::string_view stream, size_t piece, std::vector<std::string>* messages,
+          std::string* error) {
+  const auto collect = [messages](const HelperFrameReader::Message& message) {
+    messages->push_back(std::to_string(static_cast<int>(message.kind)) + "|" + std::string(message.payload) + "|" +
+                        std::string(message.attachment));
+  };
+  while (!stream.empty()) {
+    size_t capacity = 0;
+    char* data = reader->WritableData(&capacity);
+    CHECK(capacity >= 1);
+    const size_t size = std::min({stream.size(), capacity, piece == 0 ? stream.size() : piece});
+    std::memcpy(data, stream.data(), size);
+    stream.remove_prefix(size);
+    if (!reader->Commit(size, collect, error)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void TestFrames() {
+  const std::string pcm(100000, '\x7F');
+  std::string stream;
+  stream += Frame(HelperFrameKind::kJson, "{\"type\":\"engine_ready\"}");
+  stream += Frame(HelperFrameKind::kDoorbell, "");
+  stream += Frame(HelperFrameKind::kJson, "{\"type\":\"tts_audio\",\"frames\":1}", pcm);
+  stream += Frame(HelperFrameKind::kJson, "", "attachment only");
+  stream += Frame(HelperFrameKind::kJson, "{\"type\":\"stt_final\"}");
+  // An unfinished frame is held back.
+  const std::string partial = Frame(HelperFrameKind::kJson, "{\"type\":\"never\"}");
+  stream += partial.substr(0, partial.size() - 1);
+
+  for (const size_t piece : {size_t{0}, size_t{1}, size_t{5}, size_t{4099}}) {
+    HelperFrameReader reader(HelperIpcMode::kFramed);
+    std::vector<std::string> messages;
+    std::string error;
+    CHECK(Feed(&reader, stream, piece, &messages, &error));
+    CHECK(messages.size() == 5);
+    if (messages.size() == 5) {
+      CHECK(messages[0] == "1|{\"type\":\"engine_ready\"}|");
+      CHECK(messages[1] == "2||");
+      CHECK(messages[2] == "1|{\"type\":\"tts_audio\",\"frames\":1}|" + pcm);
+      CHECK(messages[3] == "1||attachment only");
+      CHECK(messages[4] == "1|{\"type\":\"stt_final\"}|");
+    }
+    // The last byte completes it.
+    messages.clear();
+    CHECK(Feed(&reader, partial.substr(partial.size() - 1), piece, &messages, &error));
+    CHECK(messages.size() == 1 && messages[0] == "1|{\"type\":\"never\"}|");
+
+    // Reset() drops whatever was pending.
+    CHECK(Feed(&reader, partial.substr(0, 5), piece, &messages, &error));
+    reader.Reset();
+    messages.clear();
+    CHECK(Feed(&reader, Frame(HelperFrameKind::kJson, "{}"), piece, &messages, &error));
+    CHECK(messages.size() == 1 && messages[0] == "1|{}|");
+  }
+
+  // Header layout: little-endian lengths after the kind and reserved bytes.
+  const std::string header = Frame(HelperFrameKind::kDoorbell, std::string(0x0201, 'p'), std::string(3, 'a'));
+  CHECK(header.compare(0, 12, std::string("\x02\x00\x00\x00\x01\x02\x00\x00\x03\x00\x00\x00", 12)) == 0);
+}
+
+void TestTooLarge() {
+  for (const uint32_t attachment : {bridge::kMaxHelperFrameBytes, uint32_t{0xFFFFFFFF}}) {
+    std::string frame(bridge::kHelperFrameHeaderBytes, '\0');
+    bridge::EncodeHelperFrameHeader(HelperFrameKind::kJson, 2, attachment, reinterpret_cast<uint8_t*>(frame.data()));
+    for (const size_t piece : {size_t{0}, size_t{1}}) {
+      HelperFrameReader reader(HelperIpcMode::kFramed);
+      std::vector<std::string> messages;
+      std::string error;
+      CHECK(!Feed(&reader, frame, piece, &messages, &error));
+      CHECK(error == "helper frame is too large");
+      CHECK(messages.empty());
+    }
+  }
+  // The same bytes are harmless as a line.
+  HelperFrameReader lines(HelperIpcMode::kJsonLines);
+  std::vector<std::string> messages;
+  std::string error;
+  std::string frame(bridge::kHelperFrameHeaderBytes, '\xFF');
+  CHECK(Feed(&lines, frame, 0, &messages, &error));
+}
+
+void TestLines() {
+  const std::string long_line = "{\"text\":\"" + std::string(50000, 'x') + "\"}";
+  const std::string stream = "{\"type\":\"a\"}\n\n\r\n{\"type\":\"b\"}\r\n" + long_line + "\n{\"type\":\"unfinished\"}";
+  for (const size_t piece : {size_t{0}, size_t{1}, size_t{7}, size_t{16384}}) {
+    HelperFrameReader reader(HelperIpcMode::kJsonLines);
+    std::vector<std::string> messages;
+    std::string error;
+    CHECK(Feed(&reader, stream, piece, &messages, &error));
+    CHECK(messages.size() == 3);
+    if (messages.size() == 3) {
+      CHECK(messages[0] == "1|{\"type\":\"a\"}|");
+      CHECK(messages[1] == "1|{\"type\":\"b\"}|");
+      CHECK(messages[2] == "1|" + long_line + "|");
+    }
+    messages.clear();
+    CHECK(Feed(&reader, "\n", piece, &messages, &error));
+    CHECK(messages.size() == 1 && messages[0] == "1|{\"type\":\"unfinished\"}|");
+  }
+}
+
+void TestHelpers() {
+  HelperIpcMode mode = HelperIpcMode::kFramed;
+  for (const HelperIpcMode expected :
+       {HelperIpcMode::kFramed, HelperIpcMode::kJsonLines, HelperIpcMode::kSharedMemory}) {
+    CHECK(bridge::ParseHelperIpcMode(bridge::HelperIpcModeName(expected), &mode) && mode == expected);
+  }
+  CHECK(!bridge::ParseHelperIpcMode("pipes", &mode));
+
+  for (const std::string_view type : {"tts_cancel", "stop_stt", "disable", "shutdown"}) {
+    CHECK(bridge::IsHelperControlCommand(type));
+  }
+  CHECK(!bridge::IsHelperControlCommand("tts_chunk"));
+  CHECK(!bridge::IsHelperControlCommand(""));
+
+  std::string_view message;
+  CHECK(bridge::ParseHelperLogLine("warn: disk slow", &message) == bridge::HelperLogLevel::kWarn);
+  CHECK(message == "disk slow");
+  CHECK(bridge::ParseHelperLogLine("debug:tight", &message) == bridge::HelperLogLevel::kDebug);
+  CHECK(message == "tight");
+  CHECK(bridge::ParseHelperLogLine("error:", &message) == bridge::HelperLogLevel::kInfo);
+  CHECK(message == "error:");
+  CHECK(bridge::ParseHelperLogLine("warning: not a level", &message) == bridge::HelperLogLevel::kInfo);
+  CHECK(message == "warning: not a level");
+
+  std::string_view payload;
+  std::string_view attachment;
+  bridge::SplitHelperRingMessage(std::string_view("{\"a\":1}\0\x01\x00\x02", 11), &payload, &attachment);
+  CHECK(payload == "{\"a\":1}");
+  CHECK(attachment == std::string_view("\x01\x00\x02", 3));
+  bridge::SplitHelperRingMessage("{\"a\":1}", &payload, &attachment);
+  CHECK(payload == "{\"a\":1}" && attachment.empty());
+
+  std::string decoded;
+  CHECK(bridge::DecodeHelperAttachment("Zm9vYmFy", &decoded) && decoded == "foobar");
+  CHECK(bridge::DecodeHelperAttachment("Pz8\\/Pw==", &decoded) && decoded == "??\?\?");
+  CHECK(bridge::DecodeHelperAttachment("", &decoded) && decoded.empty());
+  CHECK(!bridge::DecodeHelperAttachment("Zm9v!mFy", &decoded));
+  CHECK(!bridge::DecodeHelperAttachment("Zm9\\v", &decoded));
+  CHECK(!bridge::DecodeHelperAttachment("Z", &decoded));
+}
+
+}  // namespace
+
+int main() {
+  TestFrames();
+  TestTooLarge();
+  TestLines();
+  TestHelpers();
+  return bridge_test::TestResult();
+}
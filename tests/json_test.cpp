@@ -0,0 +1,206 @@
+// JsonReader and JsonWriter: documents that must survive a parse and
+// re-serialization unchanged, the RFC 8259 violations the reader must
+// reject, and the helpers built on them.
+
+#include "Check.h"
+#include "Json.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace {
+
+using bridge::JsonReader;
+using bridge::JsonType;
+using bridge::JsonValue;
+using bridge::JsonWriter;
+
+std::string Reserialize(const JsonValue& value) {
+  std::string out;
+  JsonWriter(&out).Value(value);
+  return out;
+}
+
+void TestRoundTrip() {
+  // Compact documents come back byte for byte.
+  const std::string_view compact[] = {
+      "{}",
+      "[]",
+      "null",
+      "\"\"",
+      "{\"type\":\"tts_chunk\",\"utterance_id\":\"u1\",\"text\":\"hi\"}",
+      "{\"a\":[1,-2,3.5,-0.25e-3,1E+9,0],\"b\":{\"c\":[true,false,null,{}]},\"d\":\"\"}",
+      "[\"tab\\tquote\\\"back\\\\\",\"caf\xC3\xA9\",\"\xF0\x9F\x98\x80\"]",
+      "{\"n\":12345678901234567890123}",
+  };
+  JsonReader reader;
+  for (const std::string_view text : compact) {
+    std::string error;
+    const JsonValue* value = reader.Parse(text, &error);
+    CHECK(value != nullptr);
+    if (value != nullptr) {
+      CHECK(Reserialize(*value) == text);
+    }
+  }
+
+  // Whitespace and escapes the writer has no need for are normalized, and
+  // the result parses to the same thing again.
+  const std::pair<std::string_view, std::string_view> normalized[] = {
+      {" { \"a\" : [ 1 , 2 ] ,\n\t\"b\" : \"x\" } ", "{\"a\":[1,2],\"b\":\"x\"}"},
+      {"\"\\u0041\\/\\u00e9\\ud83d\\ude00\"", "\"A/\xC3\xA9\xF0\x9F\x98\x80\""},
+      {"\"\\u0001\\u001f\"", "\"\\u0001\\u001f\""},
+  };
+  for (const auto& [text, expected] : normalized) {
+    std::string error;
+    const JsonValue* value = reader.Parse(text, &error);
+    CHECK(value != nullptr);
+    if (value == nullptr) {
+      continue;
+    }
+    const std::string once = Reserialize(*value);
+    CHECK(once == expected);
+    const JsonValue* again = reader.Parse(once, &error);
+    CHECK(again != nullptr && Reserialize(*again) == once);
+  }
+}
+
+void TestAccessors() {
+  JsonReader reader;
+  std::string error;
+  const JsonValue* value =
+      reader.Parse("{\"type\":\"start_stt\",\"n\":-42,\"big\":1e3,\"s\":\"a\\nb\",\"o\":{\"k\":1}}", &error);
+  CHECK(value != nullptr && value->is_object());
+  if (value == nullptr) {
+    return;
+  }
+  CHECK(value->StringField("type") == "start_stt");
+  CHECK(value->StringField("s") == "a\nb");
+  CHECK(!value->StringField("n").has_value());
+  CHECK(!value->StringField("missing").has_value());
+  CHECK(value->IntField("n") == -42);
+  CHECK(!value->IntField("big").has_value());
+  CHECK(!value->IntField("type").has_value());
+  const JsonValue* object = value->Find("o");
+  CHECK(object != nullptr && object->type == JsonType::kObject && object->IntField("k") == 1);
+}
+
+void TestWriter() {
+  std::string out;
+  JsonWriter(&out)
+      .BeginObject()
+      .Field("type", "error")
+      .Field("message", "bad \"quote\"\n\x01")
+      .Key("items")
+      .BeginArray()
+      .Int(-7)
+      .Bool(true)
+      .Null()
+      .BeginObject()
+      .EndObject()
+      .EndArray()
+      .EndObject();
+  CHECK(out ==
+        "{\"type\":\"error\",\"message\":\"bad \\\"quote\\\"\\n\\u0001\",\"items\":[-7,true,null,{}]}");
+  JsonReader reader;
+  std::string error;
+  const JsonValue* value = reader.Parse(out, &error);
+  CHECK(value != nullptr && value->StringField("message") == "bad \"quote\"\n\x01");
+}
+
+void TestMalformed() {
+  const std::string_view malformed[] = {
+      "",
+      " ",
+      "{",
+      "}",
+      "[1,]",
+      "[1 2]",
+      "{\"a\":1,}",
+      "{\"a\" 1}",
+      "{a:1}",
+      "{\"a\":}",
+      "{1:2}",
+      "[01]",
+      "[1.]",
+      "[.5]",
+      "[1e]",
+      "[-]",
+      "[+1]",
+      "[tru]",
+      "[nul]",
+      "[True]",
+      "\"unterminated",
+      "\"bad escape \\x\"",
+      "\"short \\u12\"",
+      "\"lone high \\ud800\"",
+      "\"high then text \\ud800x\"",
+      "\"high then high \\ud800\\ud800\"",
+      "\"lone low \\udc00\"",
+      "\"raw \x01 control\"",
+      "\"raw\nnewline\"",
+      "\"bad utf-8 \xC3\"",
+      "\"overlong \xC0\xAF\"",
+      "\"surrogate \xED\xA0\x80\"",
+      "{} {}",
+      "[1] x",
+  };
+  JsonReader reader;
+  for (const std::string_view text : malformed) {
+    std::string error;
+    CHECK(reader.Parse(text, &error) == nullptr);
+    CHECK(error.rfind("invalid JSON: ", 0) == 0);
+  }
+
+  // Nesting is capped so that hostile input cannot exhaust the stack.
+  std::string shallow(64, '[');
+  shallow.append(64, ']');
+  std::string deep(65, '[');
+  deep.append(65, ']');
+  std::string error;
+  CHECK(reader.Parse(shallow, &error) != nullptr);
+  CHECK(reader.Parse(deep, &error) == nullptr);
+}
+
+void TestHelpers() {
+  CHECK(bridge::IsValidUtf8("plain caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80"));
+  CHECK(!bridge::IsValidUtf8("\xC3"));
+  CHECK(!bridge::IsValidUtf8("\xC0\xAF"));
+  CHECK(!bridge::IsValidUtf8("\xED\xA0\x80"));
+  CHECK(!bridge::IsValidUtf8("\xF4\x90\x80\x80"));
+  CHECK(!bridge::IsValidUtf8("\xFF"));
+
+  const std::string_view event = "{\"type\":\"tts_status\",\"message\":\"say \\\"hi\\\"\",\"utterance_id\":\"u\"}";
+  CHECK(bridge::ExtractJsonStringField(event, "type") == "tts_status");
+  CHECK(bridge::ExtractJsonStringField(event, "message") == "say \\\"hi\\\"");
+  CHECK(bridge::ExtractJsonStringField(event, "utterance_id") == "u");
+  CHECK(bridge::ExtractJsonStringField(event, "missing").empty());
+  CHECK(bridge::ExtractJsonStringField("{\"type\":\"a\\", "type").empty());
+
+  for (const std::string_view value : {std::string_view("plain"), std::string_view("\"\\\n\r\t\x1F/\xC3\xA9")}) {
+    std::string quoted;
+    bridge::AppendJsonString(value, &quoted);
+    JsonReader reader;
+    std::string error;
+    const JsonValue* parsed = reader.Parse(quoted, &error);
+    CHECK(parsed != nullptr && parsed->type == JsonType::kString && parsed->text == value);
+  }
+
+  std::string encoded;
+  for (const uint32_t code_point : {0x41u, 0xE9u, 0x20ACu, 0x1F600u}) {
+    bridge::AppendUtf8(code_point, &encoded);
+  }
+  CHECK(encoded == "A\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80");
+}
+
+}  // namespace
+
+int main() {
+  TestRoundTrip();
+  TestAccessors();
+  TestWriter();
+  TestMalformed();
+  TestHelpers();
+  return bridge_test::TestResult();
+}
@@ -0,0 +1,244 @@
+// PcmBlock: headers written and read back, each malformed header field
+// rejected, and blocks fed to PcmBlockReader whole, a byte at a time and in
+// pieces that split frames and leave samples misaligned, including blocks
+// cut short, blocks longer than their frame count and channel mismatches.
+
+#include "Check.h"
+#include "PcmBlock.h"
+#include "SampleKernels.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+using bridge::PcmBlockHeader;
+using bridge::PcmBlockReader;
+using bridge::PcmSampleFormat;
+using bridge::PcmStreamId;
+
+std::vector<float> Ramp(size_t count) {
+  std::vector<float> samples(count);
+  for (size_t i = 0; i < count; ++i) {
+    samples[i] = static_cast<float>(static_cast<int>(i % 401) - 200) / 256.0f;
+  }
+  return samples;
+}
+
+std::string Block(const PcmBlockHeader& header, const std::vector<float>& samples) {
+  std::string block(bridge::kPcmBlockHeaderBytes, '\0');
+  bridge::EncodePcmBlockHeader(header, reinterpret_cast<uint8_t*>(block.data()));
+  bridge::AppendPcmSamples(samples.data(), samples.size(), header.format, &block);
+  return block;
+}
+
+PcmBlockHeader Header(PcmSampleFormat format, uint8_t channels, uint32_t frame_count) {
+  PcmBlockHeader header;
+  header.format = format;
+  header.channels = channels;
+  header.frame_count = frame_count;
+  header.timestamp_us = 0x0102030405060708ULL;
+  return header;
+}
+
+// Feeds `block` in pieces of at most `piece` bytes (all of it when 0), each
+// copied one byte past an aligned address when `misalign` is set, and
+// collects the frames the reader emits.
+bool Feed(PcmBlockReader* reader, const std::string& block, size_t piece, bool misalign, std::string* error) {
+  std::vector<uint8_t> buffer(block.size() + 8);
+  size_t offset = 0;
+  do {
+    const size_t size = std::min(block.size() - offset, piece == 0 ? block.size() : piece);
+    uint8_t* data = buffer.data() + (misalign ? 1 : 0);
+    std::memcpy(data, block.data() + offset, size);
+    offset += size;
+    if (!reader->Feed(data, size, offset == block.size(), error)) {
+      return false;
+    }
+  } while (offset < block.size());
+  return true;
+}
+
+struct Collected {
+  std::vector<float> samples;
+  std::vector<PcmBlockHeader> headers;
+};
+
+PcmBlockReader::Callbacks Collect(Collected* collected, uint32_t channels) {
+  PcmBlockReader::Callbacks callbacks;
+  callbacks.on_header = [collected](const PcmBlockHeader& header, std::string*) {
+    collected->headers.push_back(header);
+    return true;
+  };
+  callbacks.on_frames = [collected, channels](const float* frames, size_t frame_count) {
+    collected->samples.insert(collected->samples.end(), frames, frames + frame_count * channels);
+  };
+  return callbacks;
+}
+
+void TestHeader() {
+  PcmBlockHeader header = Header(PcmSampleFormat::kInt16, 8, 0xDEADBEEF);
+  header.stream = PcmStreamId::kSpeakerTap;
+  uint8_t bytes[bridge::kPcmBlockHeaderBytes] = {};
+  bridge::EncodePcmBlockHeader(header, bytes);
+  const uint8_t expected[] = {1, 2, 2, 8, 0xEF, 0xBE, 0xAD, 0xDE, 8, 7, 6, 5, 4, 3, 2, 1};
+  CHECK(std::memcmp(bytes, expected, sizeof(expected)) == 0);
+  PcmBlockHeader decoded;
+  std::string error;
+  CHECK(bridge::DecodePcmBlockHeader(bytes, &decoded, &error));
+  CHECK(decoded.version == 1 && decoded.stream == PcmStreamId::kSpeakerTap &&
+        decoded.format == PcmSampleFormat::kInt16 && decoded.channels == 8 && decoded.frame_count == 0xDEADBEEF &&
+        decoded.timestamp_us == 0x0102030405060708ULL);
+
+  const struct {
+    size_t offset;
+    uint8_t value;
+    const char* error;
+  } bad[] = {
+      {0, 0, "unsupported PCM block version"}, {0, 2, "unsupported PCM block version"},
+      {1, 0, "unknown PCM stream id"},         {1, 3, "unknown PCM stream id"},
+      {2, 0, "unknown PCM sample format"},     {2, 3, "unknown PCM sample format"},
+      {3, 0, "invalid PCM channel count"},     {3, 9, "invalid PCM channel count"},
+  };
+  for (const auto& field : bad) {
+    uint8_t copy[bridge::kPcmBlockHeaderBytes];
+    std::memcpy(copy, bytes, sizeof(copy));
+    copy[field.offset] = field.value;
+    PcmBlockHeader untouched;
+    CHECK(!bridge::DecodePcmBlockHeader(copy, &untouched, &error) && error == field.error);
+    CHECK(untouched.channels == 0);
+  }
+
+  PcmSampleFormat format = PcmSampleFormat::kFloat32;
+  CHECK(bridge::ParsePcmSampleFormat("s16", &format) && format == PcmSampleFormat::kInt16);
+  CHECK(bridge::ParsePcmSampleFormat(bridge::PcmSampleFormatName(PcmSampleFormat::kFloat32), &format) &&
+        format == PcmSampleFormat::kFloat32);
+  CHECK(!bridge::ParsePcmSampleFormat("f64", &format));
+  CHECK(bridge::PcmBytesPerSample(PcmSampleFormat::kInt16) == 2 &&
+        bridge::PcmBytesPerSample(PcmSampleFormat::kFloat32) == 4);
+}
+
+void TestRoundTrip() {
+  // More frames than the reader's scratch buffer, in both formats, with
+  // matching channels and mono spread over two.
+  constexpr uint32_t kFrames = 1500;
+  for (const PcmSampleFormat format : {PcmSampleFormat::kFloat32, PcmSampleFormat::kInt16}) {
+    for (const uint8_t channels : {uint8_t{2}, uint8_t{1}}) {
+      const std::vector<float> samples = Ramp(kFrames * channels);
+      const std::string block = Block(Header(format, channels, kFrames), samples);
+      CHECK(block.size() == bridge::kPcmBlockHeaderBytes + samples.size() * bridge::PcmBytesPerSample(format));
+
+      // What the reader should emit: the samples through the format, then
+      // spread over two channels.
+      std::vector<float> expected = samples;
+      if (format == PcmSampleFormat::kInt16) {
+        bridge::Int16ToFloat(block.data() + bridge::kPcmBlockHeaderBytes, expected.data(), expected.size());
+      }
+      if (channels == 1) {
+        std::vector<float> stereo(expected.size() * 2);
+        bridge::UpmixFromMono(expected.data(), 2, expected.size(), stereo.data());
+        expected = std::move(stereo);
+      }
+
+      for (const size_t piece : {size_t{0}, size_t{1}, size_t{3}, size_t{17}, size_t{4096}}) {
+        for (const bool misalign : {false, true}) {
+          Collected collected;
+          PcmBlockReader reader(2, Collect(&collected, 2));
+          std::string error;
+          CHECK(Feed(&reader, block, piece, misalign, &error));
+          CHECK(collected.headers.size() == 1 && collected.headers[0].frame_count == kFrames);
+          CHECK(collected.samples == expected);
+
+          // Reset() readies it for the next block.
+          reader.Reset();
+          collected.samples.clear();
+          CHECK(Feed(&reader, block, piece, misalign, &error));
+          CHECK(collected.samples == expected);
+        }
+      }
+    }
+  }
+
+  // A block of no frames is just a header.
+  Collected collected;
+  PcmBlockReader reader(2, Collect(&collected, 2));
+  std::string error;
+  CHECK(Feed(&reader, Block(Header(PcmSampleFormat::kFloat32, 2, 0), {}), 0, false, &error));
+  CHECK(collected.headers.size() == 1 && collected.samples.empty());
+}
+
+void TestMalformed() {
+  const std::string block = Block(Header(PcmSampleFormat::kInt16, 2, 10), Ramp(20));
+  const auto fails = [](const std::string& bytes, size_t piece, const std::string& expected) {
+    Collected collected;
+    PcmBlockReader reader(2, Collect(&collected, 2));
+    std::string error;
+    return !Feed(&reader, bytes, piece, false, &error) && error == expected;
+  };
+
+  for (const size_t piece : {size_t{0}, size_t{1}, size_t{5}}) {
+    // Truncated headers, including an empty message.
+    CHECK(fails(block.substr(0, bridge::kPcmBlockHeaderBytes - 1), piece, "PCM block is shorter than its header"));
+    CHECK(fails(block.substr(0, 1), piece, "PCM block is shorter than its header"));
+    // Missing frames, whole or in part.
+    CHECK(fails(block.substr(0, block.size() - 4), piece, "PCM block is shorter than its frame count"));
+    CHECK(fails(block.substr(0, block.size() - 1), piece, "PCM block is shorter than its frame count"));
+    CHECK(fails(block.substr(0, bridge::kPcmBlockHeaderBytes), piece, "PCM block is shorter than its frame count"));
+    // More than the frame count: a whole frame, or bytes that do not make
+    // one.
+    CHECK(fails(block + std::string(4, '\0'), piece, "PCM block is longer than its frame count"));
+    CHECK(fails(block + std::string(1, '\0'), piece, "PCM block is longer than its frame count"));
+  }
+  CHECK(fails("", 0, "PCM block is shorter than its header"));
+
+  // A frame count far beyond what arrives.
+  CHECK(fails(Block(Header(PcmSampleFormat::kFloat32, 2, 0xFFFFFFFF), Ramp(8)), 0,
+              "PCM block is shorter than its frame count"));
+
+  // Channels other than mono or the device's.
+  CHECK(fails(Block(Header(PcmSampleFormat::kFloat32, 3, 2), Ramp(6)), 0,
+              "PCM channel count does not match the device"));
+  std::string bad_header = block;
+  bad_header[3] = 0;
+  CHECK(fails(bad_header, 0, "invalid PCM channel count"));
+
+  // on_header can turn a block away before any frames are emitted.
+  PcmBlockReader::Callbacks callbacks;
+  size_t frames = 0;
+  callbacks.on_header = [](const PcmBlockHeader& header, std::string* error) {
+    *error = "wrong stream";
+    return header.stream == PcmStreamId::kSpeakerTap;
+  };
+  callbacks.on_frames = [&frames](const float*, size_t count) { frames += count; };
+  PcmBlockReader reader(2, callbacks);
+  std::string error;
+  CHECK(!Feed(&reader, block, 0, false, &error) && error == "wrong stream");
+  CHECK(frames == 0);
+}
+
+void TestAppendSamples() {
+  const std::vector<float> samples = {0.0f, 1.0f, -1.0f, 0.5f, 2.0f};
+  std::string out = "x";
+  bridge::AppendPcmSamples(samples.data(), samples.size(), PcmSampleFormat::kFloat32, &out);
+  CHECK(out.size() == 1 + samples.size() * sizeof(float));
+  CHECK(std::memcmp(out.data() + 1, samples.data(), samples.size() * sizeof(float)) == 0);
+
+  out = "x";
+  bridge::AppendPcmSamples(samples.data(), samples.size(), PcmSampleFormat::kInt16, &out);
+  const int16_t expected[] = {0, 32767, -32767, 16384, 32767};
+  CHECK(out.size() == 1 + sizeof(expected));
+  CHECK(std::memcmp(out.data() + 1, expected, sizeof(expected)) == 0);
+}
+
+}  // namespace
+
+int main() {
+  TestHeader();
+  TestRoundTrip();
+  TestMalformed();
+  TestAppendSamples();
+  return bridge_test::TestResult();
+}
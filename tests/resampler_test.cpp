@@ -0,0 +1,151 @@
+// Resampler: the rate ratios and filter lengths it documents, a stream cut
+// into blocks of any size and output capacities of any size coming out
+// exactly as when converted in one piece, and tones in the passband kept
+// while tones in the stopband are removed.
+
+#include "Check.h"
+#include "Resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using bridge::Resampler;
+
+constexpr double kPi = 3.14159265358979323846;
+
+std::vector<float> Tone(double frequency, uint32_t rate, size_t count, double amplitude) {
+  std::vector<float> samples(count);
+  for (size_t i = 0; i < count; ++i) {
+    samples[i] = static_cast<float>(amplitude * std::sin(2.0 * kPi * frequency * static_cast<double>(i) / rate));
+  }
+  return samples;
+}
+
+std::vector<float> Whole(Resampler* resampler, const std::vector<float>& input) {
+  std::vector<float> output(resampler->OutputCapacity(input.size()));
+  output.resize(resampler->Process(input.data(), input.size(), output.data(), output.size()));
+  return output;
+}
+
+double Rms(const std::vector<float>& samples, size_t begin) {
+  double sum = 0.0;
+  for (size_t i = begin; i < samples.size(); ++i) {
+    sum += static_cast<double>(samples[i]) * samples[i];
+  }
+  return std::sqrt(sum / static_cast<double>(samples.size() - begin));
+}
+
+void TestRatios() {
+  struct Case {
+    uint32_t input_rate;
+    uint32_t output_rate;
+    uint32_t interpolation;
+    uint32_t decimation;
+    size_t taps;
+  };
+  const Case cases[] = {
+      {48000, 16000, 1, 3, 216},
+      {16000, 48000, 3, 1, 72},
+      {24000, 48000, 2, 1, 72},
+      {44100, 16000, 160, 441, 0},
+      {48000, 48000, 1, 1, 1},
+  };
+  for (const Case& c : cases) {
+    Resampler resampler(c.input_rate, c.output_rate);
+    CHECK(resampler.interpolation() == c.interpolation);
+    CHECK(resampler.decimation() == c.decimation);
+    if (c.taps != 0) {
+      CHECK(resampler.taps_per_phase() == c.taps);
+    }
+    CHECK(resampler.taps_per_phase() % 4 == 0 || resampler.taps_per_phase() == 1);
+  }
+
+  // Same rates pass samples straight through.
+  Resampler same(16000, 16000);
+  const std::vector<float> input = Tone(440.0, 16000, 1000, 0.5);
+  CHECK(Whole(&same, input) == input);
+}
+
+void TestBlocks() {
+  std::mt19937 random(48);
+  std::uniform_real_distribution<float> sample(-1.0f, 1.0f);
+  std::vector<float> input(20000);
+  for (float& value : input) {
+    value = sample(random);
+  }
+
+  const uint32_t rates[][2] = {{48000, 16000}, {16000, 48000}, {44100, 16000}, {24000, 16000}};
+  for (const auto& rate : rates) {
+    Resampler reference(rate[0], rate[1]);
+    const std::vector<float> whole = Whole(&reference, input);
+    CHECK(!whole.empty());
+
+    // Blocks of random sizes, including empty ones, into outputs of random
+    // capacity; what does not fit waits for the next call.
+    Resampler resampler(rate[0], rate[1]);
+    std::uniform_int_distribution<size_t> block_size(0, 700);
+    std::uniform_int_distribution<size_t> capacity(0, 300);
+    std::vector<float> blocked;
+    std::vector<float> output(1000);
+    for (size_t offset = 0; offset < input.size();) {
+      const size_t count = std::min(block_size(random), input.size() - offset);
+      const size_t written = resampler.Process(input.data() + offset, count, output.data(), capacity(random));
+      blocked.insert(blocked.end(), output.begin(), output.begin() + static_cast<std::ptrdiff_t>(written));
+      offset += count;
+    }
+    while (true) {
+      const size_t written = resampler.Process(nullptr, 0, output.data(), output.size());
+      if (written == 0) {
+        break;
+      }
+      blocked.insert(blocked.end(), output.begin(), output.begin() + static_cast<std::ptrdiff_t>(written));
+    }
+    CHECK(blocked == whole);
+
+    // Reset() starts over as if new.
+    reference.Reset();
+    CHECK(Whole(&reference, input) == whole);
+
+    // The filter starts out primed with silence, so every input sample
+    // yields interpolation / decimation outputs from the first.
+    const double expected =
+        static_cast<double>(input.size()) * reference.interpolation() / reference.decimation();
+    CHECK(std::fabs(static_cast<double>(whole.size()) - expected) <= 1.0);
+  }
+}
+
+void TestFrequencyResponse() {
+  // A 1 kHz tone keeps its level (RMS of a 0.5 sine is 0.354); one above the
+  // output's Nyquist frequency is gone by 80 dB or more.
+  const double amplitude = 0.5;
+  const double tone_rms = amplitude / std::sqrt(2.0);
+  const uint32_t rates[][2] = {{48000, 16000}, {16000, 48000}, {44100, 16000}, {24000, 48000}};
+  for (const auto& rate : rates) {
+    Resampler pass(rate[0], rate[1]);
+    const std::vector<float> kept = Whole(&pass, Tone(1000.0, rate[0], rate[0] / 2, amplitude));
+    const size_t settled = pass.taps_per_phase() * pass.interpolation() / pass.decimation() + 1;
+    CHECK(std::fabs(Rms(kept, settled) - tone_rms) < 0.01 * tone_rms);
+  }
+  for (const auto& [input_rate, stop_frequency] : {std::pair<uint32_t, double>{48000, 10000.0}, {44100, 12000.0}}) {
+    Resampler stop(input_rate, 16000);
+    const std::vector<float> removed = Whole(&stop, Tone(stop_frequency, input_rate, input_rate / 2, amplitude));
+    const size_t settled = stop.taps_per_phase() * stop.interpolation() / stop.decimation() + 1;
+    CHECK(Rms(removed, settled) < tone_rms * 1e-4);
+  }
+}
+
+}  // namespace
+
+int main() {
+  TestRatios();
+  TestBlocks();
+  TestFrequencyResponse();
+  return bridge_test::TestResult();
+}
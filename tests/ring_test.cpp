@@ -0,0 +1,246 @@
+// The shared-memory rings, each side through a mapping of its own as the
+// bridge and the helper have: messages and frames that wrap past the end,
+// rings that fill up and drain, the wakeup handshake, and one producer and
+// one consumer thread running flat out.
+
+#include "Check.h"
+#include "SharedMemoryAudioRing.h"
+#include "SharedMemoryMessageRing.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using bridge::SharedMemoryAudioRing;
+using bridge::SharedMemoryMessageRing;
+
+constexpr uint32_t kMessageRingBytes = 4096;
+
+std::string RingName(std::string_view what) {
+  return "/bridge_ring_test_" + std::to_string(getpid()) + "_" + std::string(what);
+}
+
+// Message `index`, `size` bytes long, recognizable from its first bytes.
+std::string Message(uint32_t index, size_t size) {
+  std::string message(size, static_cast<char>('a' + index % 26));
+  const std::string tag = std::to_string(index) + ":";
+  message.replace(0, std::min(tag.size(), size), tag, 0, std::min(tag.size(), size));
+  return message;
+}
+
+void TestMessageRingOpen() {
+  SharedMemoryMessageRing ring;
+  CHECK(!ring.Open(RingName("bad"), true, 2048));
+  CHECK(!ring.Open(RingName("bad"), true, 6000));
+  CHECK(!ring.Open("", true, kMessageRingBytes));
+  CHECK(!ring.is_open());
+  CHECK(!ring.Write("closed"));
+
+  CHECK(ring.Open(RingName("open"), true, kMessageRingBytes));
+  CHECK(ring.max_message_bytes() == kMessageRingBytes / 2 - 4);
+  SharedMemoryMessageRing other;
+  CHECK(!other.Open(RingName("open"), false, 2 * kMessageRingBytes));
+  CHECK(other.Open(RingName("open"), false, kMessageRingBytes));
+  ring.Close();
+  // The creator removes the backing file.
+  CHECK(access(("/tmp/" + RingName("open").substr(1) + ".ring").c_str(), F_OK) != 0);
+}
+
+void TestMessageRingFullAndWrap() {
+  SharedMemoryMessageRing producer;
+  SharedMemoryMessageRing consumer;
+  CHECK(producer.Open(RingName("messages"), true, kMessageRingBytes));
+  CHECK(consumer.Open(RingName("messages"), false, kMessageRingBytes));
+
+  std::string_view message;
+  CHECK(!consumer.Peek(&message));
+  CHECK(!producer.Write(std::string(producer.max_message_bytes() + 1, 'x')));
+
+  // Fill it: 100-byte messages take 104 bytes each.
+  uint32_t written = 0;
+  while (producer.Write(Message(written, 100))) {
+    ++written;
+  }
+  CHECK(written == kMessageRingBytes / 104);
+  // Room for one more only once the consumer has moved on.
+  CHECK(consumer.Peek(&message) && message == Message(0, 100));
+  CHECK(!producer.Write(Message(written, 100)));
+  consumer.Consume();
+  CHECK(producer.Write(Message(written, 100)));
+  ++written;
+
+  uint32_t read = 1;
+  while (consumer.Peek(&message)) {
+    CHECK(message == Message(read, 100));
+    consumer.Consume();
+    ++read;
+  }
+  CHECK(read == written);
+
+  // Sizes that never divide the ring evenly, so records keep landing near
+  // its end and skipping to the front. Full-size messages fit only when the
+  // ring is empty or the tail is short.
+  const size_t sizes[] = {0, 1, 3, 4, 5, 333, 1021, 2043, 2044, 17};
+  uint32_t next_write = 0;
+  uint32_t next_read = 0;
+  for (int round = 0; round < 2000; ++round) {
+    const size_t size = sizes[next_write % (sizeof(sizes) / sizeof(sizes[0]))];
+    if (producer.Write(Message(next_write, size))) {
+      ++next_write;
+    } else {
+      CHECK(next_write != next_read);
+    }
+    // Read every other turn, so the ring spends time full.
+    for (int reads = 0; reads < (round % 2) * 2 && consumer.Peek(&message); ++reads) {
+      CHECK(message == Message(next_read, sizes[next_read % (sizeof(sizes) / sizeof(sizes[0]))]));
+      consumer.Consume();
+      ++next_read;
+    }
+  }
+  while (consumer.Peek(&message)) {
+    CHECK(message == Message(next_read, sizes[next_read % (sizeof(sizes) / sizeof(sizes[0]))]));
+    consumer.Consume();
+    ++next_read;
+  }
+  CHECK(next_read == next_write);
+  CHECK(next_write > 1000);
+}
+
+void TestMessageRingWakeup() {
+  SharedMemoryMessageRing producer;
+  SharedMemoryMessageRing consumer;
+  CHECK(producer.Open(RingName("wakeup"), true, kMessageRingBytes));
+  CHECK(consumer.Open(RingName("wakeup"), false, kMessageRingBytes));
+
+  // While the consumer keeps up, nothing is signalled.
+  CHECK(producer.Write("busy"));
+  CHECK(!producer.TakeWakeup());
+  CHECK(!consumer.PrepareToWait());
+  std::string_view message;
+  CHECK(consumer.Peek(&message));
+  consumer.Consume();
+
+  // Once it announces that it sleeps, the next write must wake it, once.
+  CHECK(consumer.PrepareToWait());
+  CHECK(producer.Write("wake up"));
+  CHECK(producer.TakeWakeup());
+  CHECK(!producer.TakeWakeup());
+  consumer.FinishWait();
+  CHECK(consumer.Peek(&message) && message == "wake up");
+  consumer.Consume();
+
+  CHECK(consumer.PrepareToWait());
+  consumer.FinishWait();
+  CHECK(producer.Write("late"));
+  CHECK(!producer.TakeWakeup());
+}
+
+void TestMessageRingThreads() {
+  SharedMemoryMessageRing producer;
+  SharedMemoryMessageRing consumer;
+  CHECK(producer.Open(RingName("threads"), true, kMessageRingBytes));
+  CHECK(consumer.Open(RingName("threads"), false, kMessageRingBytes));
+
+  constexpr uint32_t kMessages = 200000;
+  std::thread writer([&producer]() {
+    for (uint32_t i = 0; i < kMessages;) {
+      if (producer.Write(Message(i, i % 97))) {
+        ++i;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+  uint32_t mismatches = 0;
+  for (uint32_t i = 0; i < kMessages;) {
+    std::string_view message;
+    if (!consumer.Peek(&message)) {
+      std::this_thread::yield();
+      continue;
+    }
+    mismatches += message == Message(i, i % 97) ? 0 : 1;
+    consumer.Consume();
+    ++i;
+  }
+  writer.join();
+  CHECK(mismatches == 0);
+}
+
+std::vector<float> Frames(uint32_t first, size_t count, uint32_t channels) {
+  std::vector<float> samples(count * channels);
+  for (size_t i = 0; i < samples.size(); ++i) {
+    samples[i] = static_cast<float>(first * channels + i);
+  }
+  return samples;
+}
+
+void TestAudioRing() {
+  constexpr uint32_t kChannels = 2;
+  constexpr uint32_t kCapacity = 480;
+  const std::string name = RingName("audio");
+  SharedMemoryAudioRing writer;
+  SharedMemoryAudioRing reader;
+  CHECK(!writer.Open(name, true, 0, kCapacity));
+  CHECK(writer.Open(name, true, kChannels, kCapacity));
+  CHECK(reader.Open(name, false, kChannels, kCapacity));
+  CHECK(reader.channels() == kChannels && reader.capacity_frames() == kCapacity);
+
+  // Filling: a write longer than the free space stops at it.
+  const std::vector<float> first = Frames(0, 600, kChannels);
+  CHECK(writer.Write(first.data(), 600) == kCapacity);
+  CHECK(writer.Write(first.data(), 1) == 0);
+  CHECK(reader.available_frames() == kCapacity);
+
+  std::vector<float> out(kCapacity * kChannels);
+  CHECK(reader.Read(out.data(), 400) == 400);
+  CHECK(std::vector<float>(out.begin(), out.begin() + 400 * kChannels) == Frames(0, 400, kChannels));
+
+  // This write wraps: 80 frames up to the end, then 300 from the start.
+  const std::vector<float> second = Frames(kCapacity, 380, kChannels);
+  CHECK(writer.Write(second.data(), 380) == 380);
+  CHECK(reader.available_frames() == 460);
+  CHECK(reader.Read(out.data(), kCapacity) == 460);
+  CHECK(std::vector<float>(out.begin(), out.begin() + 460 * kChannels) == Frames(400, 460, kChannels));
+  CHECK(reader.Read(out.data(), 1) == 0);
+
+  // A shadowing reader sees the same frames without consuming them...
+  uint32_t cursor = writer.write_index();
+  CHECK(writer.Write(first.data(), 100) == 100);
+  CHECK(reader.Peek(&cursor, out.data(), kCapacity) == 100);
+  CHECK(std::vector<float>(out.begin(), out.begin() + 100 * kChannels) == Frames(0, 100, kChannels));
+  CHECK(reader.available_frames() == 100);
+  CHECK(reader.Peek(&cursor, out.data(), kCapacity) == 0);
+
+  // ...and skips ahead when it falls more than three quarters behind.
+  const uint32_t behind = cursor;
+  CHECK(reader.Read(out.data(), kCapacity) == 100);
+  for (int i = 0; i < 4; ++i) {
+    CHECK(writer.Write(first.data(), 100) == 100);
+    CHECK(reader.Read(out.data(), 100) == 100);
+  }
+  CHECK(reader.Peek(&cursor, out.data(), kCapacity) == kCapacity - kCapacity / 4);
+  CHECK(cursor == behind + 400);
+  CHECK(std::vector<float>(out.begin(), out.begin() + 60 * kChannels) == Frames(40, 60, kChannels));
+
+  writer.Close();
+  reader.Close();
+  unlink(("/tmp/" + name.substr(1) + ".ring").c_str());
+}
+
+}  // namespace
+
+int main() {
+  TestMessageRingOpen();
+  TestMessageRingFullAndWrap();
+  TestMessageRingWakeup();
+  TestMessageRingThreads();
+  TestAudioRing();
+  return bridge_test::TestResult();
+}
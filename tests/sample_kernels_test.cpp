@@ -0,0 +1,253 @@
+// SampleKernels: the scalar set against the conversions SampleKernels.h
+// documents, and every other set built for this CPU (SSE2 and AVX2, or
+// NEON) against the scalar set bit for bit, over every length up to a few
+// vectors, unaligned buffers, and the edge values: out of range, infinite,
+// NaN, denormal and negative zero.
+
+#include "Check.h"
+#include "SampleKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+using bridge::SampleKernelIsa;
+using bridge::SampleKernels;
+
+std::vector<float> TestSamples(size_t count, uint32_t seed) {
+  const float edges[] = {0.0f,
+                         -0.0f,
+                         1.0f,
+                         -1.0f,
+                         1.5f,
+                         -7.0f,
+                         0.5f / 32767.0f,
+                         1.5f / 32767.0f,
+                         -2.5f / 32767.0f,
+                         std::numeric_limits<float>::infinity(),
+                         -std::numeric_limits<float>::infinity(),
+                         std::numeric_limits<float>::quiet_NaN(),
+                         std::numeric_limits<float>::denorm_min(),
+                         std::nextafter(1.0f, 0.0f),
+                         std::nextafter(-1.0f, 0.0f)};
+  std::mt19937 random(seed);
+  std::uniform_real_distribution<float> sample(-1.2f, 1.2f);
+  std::vector<float> samples(count);
+  for (size_t i = 0; i < count; ++i) {
+    samples[i] = i % 5 == 0 ? edges[(i / 5 + seed) % (sizeof(edges) / sizeof(edges[0]))] : sample(random);
+  }
+  return samples;
+}
+
+bool SameBits(const void* a, const void* b, size_t bytes) {
+  return std::memcmp(a, b, bytes) == 0;
+}
+
+void TestScalarReference() {
+  const SampleKernels* scalar = bridge::SampleKernelsFor(SampleKernelIsa::kScalar);
+  CHECK(scalar != nullptr && scalar->isa == SampleKernelIsa::kScalar);
+  if (scalar == nullptr) {
+    return;
+  }
+
+  const float in[] = {0.0f,
+                      1.0f,
+                      -1.0f,
+                      2.0f,
+                      -2.0f,
+                      0.5f,
+                      1.5f / 32767.0f,
+                      2.5f / 32767.0f,
+                      std::numeric_limits<float>::quiet_NaN(),
+                      std::numeric_limits<float>::infinity(),
+                      -std::numeric_limits<float>::infinity()};
+  const int16_t expected[] = {0, 32767, -32767, 32767, -32767, 16384, 2, 2, -32767, 32767, -32767};
+  int16_t out[sizeof(in) / sizeof(in[0])] = {};
+  scalar->float_to_int16(in, nullptr, out, sizeof(in) / sizeof(in[0]));
+  CHECK(SameBits(out, expected, sizeof(out)));
+
+  // Noise is added after scaling, in LSBs, and the sum still saturates.
+  const float noisy_in[] = {0.0f, 0.0f, 1.0f, -1.0f};
+  const float noise[] = {0.75f, -1.0f, 1.0f, -1.0f};
+  const int16_t noisy_expected[] = {1, -1, 32767, -32768};
+  int16_t noisy_out[4] = {};
+  scalar->float_to_int16(noisy_in, noise, noisy_out, 4);
+  CHECK(SameBits(noisy_out, noisy_expected, sizeof(noisy_out)));
+
+  const int16_t pcm[] = {0, 32767, -32768, 16384, -1};
+  float floats[5] = {};
+  scalar->int16_to_float(pcm, floats, 5);
+  CHECK(floats[0] == 0.0f && floats[1] == 32767.0f / 32768.0f && floats[2] == -1.0f && floats[3] == 0.5f &&
+        floats[4] == -1.0f / 32768.0f);
+
+  const float left[] = {1.0f, 2.0f, 3.0f};
+  const float right[] = {-1.0f, -2.0f, -3.0f};
+  float stereo[6] = {};
+  scalar->interleave_stereo(left, right, stereo, 3);
+  const float stereo_expected[] = {1.0f, -1.0f, 2.0f, -2.0f, 3.0f, -3.0f};
+  CHECK(SameBits(stereo, stereo_expected, sizeof(stereo)));
+  float mono[3] = {};
+  scalar->stereo_to_mono(stereo, mono, 3);
+  CHECK(mono[0] == 0.0f && mono[1] == 0.0f && mono[2] == 0.0f);
+  scalar->mono_to_stereo(left, stereo, 3);
+  CHECK(stereo[0] == 1.0f && stereo[1] == 1.0f && stereo[4] == 3.0f && stereo[5] == 3.0f);
+}
+
+// Lengths 0 to 70 cover every tail after one or two vectors of any width.
+void CompareWithScalar(const SampleKernels& kernels) {
+  const SampleKernels& scalar = *bridge::SampleKernelsFor(SampleKernelIsa::kScalar);
+  std::vector<size_t> lengths;
+  for (size_t n = 0; n <= 70; ++n) {
+    lengths.push_back(n);
+  }
+  lengths.push_back(1021);
+
+  int mismatches = 0;
+  for (const size_t n : lengths) {
+    for (size_t offset = 0; offset < 4; ++offset) {
+      const std::vector<float> a = TestSamples(2 * n + offset, static_cast<uint32_t>(n * 4 + offset));
+      const std::vector<float> b = TestSamples(n + offset, static_cast<uint32_t>(n * 4 + offset + 1000));
+      std::vector<float> noise = TestSamples(n + offset, static_cast<uint32_t>(n + 7));
+      for (float& value : noise) {
+        value = std::isfinite(value) ? std::fmod(value, 1.0f) : 0.25f;
+      }
+      const float* in = a.data() + offset;
+      const float* plane = b.data() + offset;
+
+      // 16-bit buffers start one byte in, as they may inside a WebSocket
+      // frame.
+      std::vector<uint8_t> expected_pcm(2 * n + 1, 0);
+      std::vector<uint8_t> actual_pcm(2 * n + 1, 0);
+      const float* dither = noise.data() + offset;
+      for (const float* noise_in : {static_cast<const float*>(nullptr), dither}) {
+        scalar.float_to_int16(in, noise_in, expected_pcm.data() + 1, n);
+        kernels.float_to_int16(in, noise_in, actual_pcm.data() + 1, n);
+        mismatches += SameBits(expected_pcm.data(), actual_pcm.data(), expected_pcm.size()) ? 0 : 1;
+      }
+
+      std::vector<float> expected(2 * n + 1, 0.0f);
+      std::vector<float> actual(2 * n + 1, 0.0f);
+      std::vector<float> expected_right(n + 1, 0.0f);
+      std::vector<float> actual_right(n + 1, 0.0f);
+      const auto same = [&]() {
+        return SameBits(expected.data(), actual.data(), expected.size() * sizeof(float)) &&
+               SameBits(expected_right.data(), actual_right.data(), expected_right.size() * sizeof(float));
+      };
+
+      scalar.int16_to_float(expected_pcm.data() + 1, expected.data() + 1, n);
+      kernels.int16_to_float(expected_pcm.data() + 1, actual.data() + 1, n);
+      mismatches += same() ? 0 : 1;
+
+      scalar.interleave_stereo(in, plane, expected.data() + 1, n);
+      kernels.interleave_stereo(in, plane, actual.data() + 1, n);
+      mismatches += same() ? 0 : 1;
+
+      scalar.deinterleave_stereo(in, expected.data() + 1, expected_right.data() + 1, n);
+      kernels.deinterleave_stereo(in, actual.data() + 1, actual_right.data() + 1, n);
+      mismatches += same() ? 0 : 1;
+
+      scalar.stereo_to_mono(in, expected.data() + 1, n);
+      kernels.stereo_to_mono(in, actual.data() + 1, n);
+      mismatches += same() ? 0 : 1;
+
+      scalar.mono_to_stereo(plane, expected.data() + 1, n);
+      kernels.mono_to_stereo(plane, actual.data() + 1, n);
+      mismatches += same() ? 0 : 1;
+
+      for (const float gain : {0.5f, -1.25f, 0.0f, 1e-30f}) {
+        std::copy(in, in + n, expected.begin() + 1);
+        std::copy(in, in + n, actual.begin() + 1);
+        scalar.apply_gain(expected.data() + 1, n, gain);
+        kernels.apply_gain(actual.data() + 1, n, gain);
+        mismatches += same() ? 0 : 1;
+      }
+    }
+  }
+  if (mismatches != 0) {
+    std::cerr << kernels.name << ": " << mismatches << " result(s) differ from scalar\n";
+  }
+  CHECK(mismatches == 0);
+}
+
+void TestEntryPoints() {
+  // Channel counts other than two take the scalar loops.
+  const float planes_data[3][4] = {{1, 2, 3, 4}, {10, 20, 30, 40}, {100, 200, 300, 400}};
+  const float* planes[3] = {planes_data[0], planes_data[1], planes_data[2]};
+  float interleaved[12] = {};
+  bridge::Interleave(planes, 3, 4, interleaved);
+  CHECK(interleaved[0] == 1 && interleaved[1] == 10 && interleaved[2] == 100 && interleaved[11] == 400);
+  float back_data[3][4] = {};
+  float* back[3] = {back_data[0], back_data[1], back_data[2]};
+  bridge::Deinterleave(interleaved, 3, 4, back);
+  CHECK(SameBits(back_data, planes_data, sizeof(back_data)));
+  float mono[4] = {};
+  bridge::DownmixToMono(interleaved, 3, 4, mono);
+  CHECK(mono[0] == 37 && mono[3] == 148);
+  float upmixed[12] = {};
+  bridge::UpmixFromMono(mono, 3, 4, upmixed);
+  CHECK(upmixed[0] == 37 && upmixed[2] == 37 && upmixed[11] == 148);
+
+  // Two channels go through the active set, one is a copy.
+  bridge::Interleave(planes, 2, 4, interleaved);
+  CHECK(interleaved[0] == 1 && interleaved[1] == 10 && interleaved[6] == 4 && interleaved[7] == 40);
+  bridge::Deinterleave(interleaved, 2, 4, back);
+  CHECK(SameBits(back_data, planes_data, 2 * sizeof(back_data[0])));
+  bridge::DownmixToMono(interleaved, 2, 4, mono);
+  CHECK(mono[0] == 5.5f && mono[3] == 22.0f);
+  bridge::UpmixFromMono(mono, 2, 4, upmixed);
+  CHECK(upmixed[0] == 5.5f && upmixed[1] == 5.5f && upmixed[7] == 22.0f);
+  bridge::Interleave(planes, 1, 4, interleaved);
+  CHECK(SameBits(interleaved, planes_data[0], sizeof(planes_data[0])));
+  bridge::DownmixToMono(interleaved, 1, 4, mono);
+  CHECK(SameBits(mono, planes_data[0], sizeof(mono)));
+  bridge::UpmixFromMono(mono, 1, 4, upmixed);
+  CHECK(SameBits(upmixed, planes_data[0], sizeof(mono)));
+
+  // Dither stays within one LSB either side, and FloatToInt16 draws it in
+  // chunks without changing the sequence across a chunk boundary.
+  bridge::TpdfDither dither(7);
+  std::vector<float> noise(10000);
+  dither.Fill(noise.data(), noise.size());
+  double mean = 0.0;
+  for (const float value : noise) {
+    CHECK(value > -1.0f && value < 1.0f);
+    mean += value;
+  }
+  CHECK(std::fabs(mean / static_cast<double>(noise.size())) < 0.05);
+
+  const std::vector<float> in = TestSamples(1000, 3);
+  std::vector<int16_t> dithered(1000);
+  std::vector<int16_t> reference(1000);
+  bridge::TpdfDither first(11);
+  bridge::FloatToInt16(in.data(), dithered.data(), in.size(), &first);
+  bridge::TpdfDither second(11);
+  std::vector<float> reference_noise(in.size());
+  second.Fill(reference_noise.data(), reference_noise.size());
+  bridge::SampleKernelsFor(SampleKernelIsa::kScalar)
+      ->float_to_int16(in.data(), reference_noise.data(), reference.data(), in.size());
+  CHECK(dithered == reference);
+}
+
+}  // namespace
+
+int main() {
+  TestScalarReference();
+  int compared = 0;
+  for (const SampleKernelIsa isa : {SampleKernelIsa::kSse2, SampleKernelIsa::kAvx2, SampleKernelIsa::kNeon}) {
+    if (const SampleKernels* kernels = bridge::SampleKernelsFor(isa)) {
+      std::cout << "checking " << kernels->name << " against scalar\n";
+      CompareWithScalar(*kernels);
+      ++compared;
+    }
+  }
+  std::cout << compared << " SIMD set(s) checked; active: " << bridge::ActiveSampleKernels().name << "\n";
+  TestEntryPoints();
+  return bridge_test::TestResult();
+}
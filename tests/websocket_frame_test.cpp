@@ -0,0 +1,144 @@
+// FrameTemplate: rendered frames byte for byte against a header from
+// EncodeWebSocketHeader() and a payload built with JsonWriter, on either
+// side of the 7-bit, 16-bit and 64-bit length boundaries, with values that
+// need escaping, and slots left without a value.
+
+#include "Check.h"
+#include "Json.h"
+#include "WebSocketFrame.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace {
+
+using bridge::FrameTemplate;
+using bridge::JsonReader;
+using bridge::JsonValue;
+using bridge::JsonWriter;
+using bridge::WsOpcode;
+
+// What the pong template below should render, built the slow way.
+std::string ReferenceFrame(std::string_view id, std::string_view text) {
+  std::string payload;
+  JsonWriter(&payload).BeginObject().Field("type", "pong").Field("id", id).Field("text", text).EndObject();
+  uint8_t header[bridge::kMaxWsHeaderBytes];
+  const size_t header_len = bridge::EncodeWebSocketHeader(header, WsOpcode::kText, payload.size());
+  return std::string(reinterpret_cast<const char*>(header), header_len) + payload;
+}
+
+FrameTemplate PongTemplate() {
+  FrameTemplate frame;
+  frame.Literal("{\"type\":\"pong\",\"id\":").Slot().Literal(",\"text\":").Slot().Literal("}");
+  return frame;
+}
+
+void TestLengthBoundaries() {
+  const FrameTemplate pong = PongTemplate();
+  CHECK(pong.slot_count() == 2);
+  std::string empty;
+  pong.Render({"", ""}, &empty);
+  // The payload's fixed part, with the six characters of the id below.
+  const size_t overhead = empty.size() - 2 + 6;
+
+  // Payload sizes either side of each length encoding, reached with plain
+  // text and with text whose escapes make it longer than it looks.
+  const size_t sizes[] = {124, 125, 126, 127, 0xFFFE, 0xFFFF, 0x10000, 0x10001, 200000};
+  for (const size_t size : sizes) {
+    for (const bool escaped : {false, true}) {
+      std::string text(size - overhead, 'a');
+      if (escaped && text.size() >= 8) {
+        // "\n" takes two bytes and "\x01" six, so the value shrinks to keep
+        // the payload size the same.
+        text.resize(text.size() - 6);
+        text.replace(0, 2, "\n\x01");
+      }
+      std::string frame = "before";
+      pong.Render({"ping-7", text}, &frame);
+      const std::string reference = ReferenceFrame("ping-7", text);
+      CHECK(frame == "before" + reference);
+      const std::string_view rendered = std::string_view(frame).substr(6);
+      CHECK(bridge::WebSocketFramePayload(rendered).size() == size);
+
+      // The header bytes themselves.
+      CHECK(static_cast<uint8_t>(rendered[0]) == 0x81);
+      const uint8_t length = static_cast<uint8_t>(rendered[1]);
+      if (size < 126) {
+        CHECK(length == size && rendered.size() == 2 + size);
+      } else if (size <= 0xFFFF) {
+        CHECK(length == 126 && rendered.size() == 4 + size);
+        CHECK((static_cast<size_t>(static_cast<uint8_t>(rendered[2])) << 8 | static_cast<uint8_t>(rendered[3])) ==
+              size);
+      } else {
+        CHECK(length == 127 && rendered.size() == 10 + size);
+        uint64_t decoded = 0;
+        for (size_t i = 0; i < 8; ++i) {
+          decoded = decoded << 8 | static_cast<uint8_t>(rendered[2 + i]);
+        }
+        CHECK(decoded == size);
+      }
+    }
+  }
+}
+
+void TestEscaping() {
+  const FrameTemplate pong = PongTemplate();
+  const std::string_view values[] = {
+      "plain",
+      "quote \" backslash \\ slash /",
+      std::string_view("nul \0 bell \a tab \t", 18),
+      "\x1F\x7F",
+      "caf\xC3\xA9 \xE6\xBC\xA2 \xF0\x9F\x98\x80",
+      "line\xE2\x80\xA8separator",
+      "</script>",
+  };
+  for (const std::string_view value : values) {
+    std::string frame;
+    pong.Render({value, value}, &frame);
+    CHECK(frame == ReferenceFrame(value, value));
+
+    // The payload parses back to the values given.
+    JsonReader reader;
+    std::string error;
+    const std::string payload(bridge::WebSocketFramePayload(frame));
+    const JsonValue* pong_json = reader.Parse(payload, &error);
+    CHECK(pong_json != nullptr && pong_json->StringField("id") == value && pong_json->StringField("text") == value);
+  }
+}
+
+void TestSlots() {
+  // Slots without a value render as empty strings; extra values are unused.
+  const FrameTemplate pong = PongTemplate();
+  std::string frame;
+  pong.Render({"only-id"}, &frame);
+  CHECK(frame == ReferenceFrame("only-id", ""));
+  frame.clear();
+  pong.Render({}, &frame);
+  CHECK(frame == ReferenceFrame("", ""));
+  frame.clear();
+  pong.Render({"a", "b", "c"}, &frame);
+  CHECK(frame == ReferenceFrame("a", "b"));
+
+  // A template of literals alone, and one that begins and ends with a slot.
+  FrameTemplate fixed;
+  fixed.Literal("{\"type\":\"ready\"}");
+  CHECK(fixed.slot_count() == 0);
+  frame.clear();
+  fixed.Render({}, &frame);
+  CHECK(frame == std::string("\x81\x10{\"type\":\"ready\"}"));
+  FrameTemplate bare;
+  bare.Slot();
+  frame.clear();
+  bare.Render({"x\"y"}, &frame);
+  CHECK(frame == std::string("\x81\x06\"x\\\"y\""));
+}
+
+}  // namespace
+
+int main() {
+  TestLengthBoundaries();
+  TestEscaping();
+  TestSlots();
+  return bridge_test::TestResult();
+}
@@ -0,0 +1,248 @@
+// WebSocketReader against client frames fed whole, a byte at a time and at
+// every split point, and against each protocol violation it must reject;
+// JsonStringStreamDecoder the same way for tts_chunk text.
+
+#include "Check.h"
+#include "Json.h"
+#include "WebSocketFrame.h"
+#include "WebSocketReader.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using bridge::WsOpcode;
+
+// A masked client frame. `first_byte` carries FIN, RSV and the opcode.
+std::vector<uint8_t> ClientFrame(uint8_t first_byte, std::string_view payload) {
+  const uint8_t mask[4] = {0x37, 0xFA, 0x21, 0x3D};
+  std::vector<uint8_t> frame = {first_byte};
+  if (payload.size() < 126) {
+    frame.push_back(static_cast<uint8_t>(0x80 | payload.size()));
+  } else if (payload.size() <= 0xFFFF) {
+    frame.push_back(0x80 | 126);
+    frame.push_back(static_cast<uint8_t>(payload.size() >> 8));
+    frame.push_back(static_cast<uint8_t>(payload.size()));
+  } else {
+    frame.push_back(0x80 | 127);
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      frame.push_back(static_cast<uint8_t>(static_cast<uint64_t>(payload.size()) >> shift));
+    }
+  }
+  frame.insert(frame.end(), mask, mask + 4);
+  for (size_t i = 0; i < payload.size(); ++i) {
+    frame.push_back(static_cast<uint8_t>(payload[i]) ^ mask[i & 3]);
+  }
+  return frame;
+}
+
+void Append(std::vector<uint8_t>* out, const std::vector<uint8_t>& bytes) {
+  out->insert(out->end(), bytes.begin(), bytes.end());
+}
+
+// What the callbacks saw, flattened to text.
+struct Transcript {
+  std::vector<std::string> messages;
+  std::vector<std::string> controls;
+  std::string current;
+  bool last_compressed = false;
+
+  bridge::WebSocketReader::Callbacks Callbacks() {
+    bridge::WebSocketReader::Callbacks callbacks;
+    callbacks.on_message_begin = [this](WsOpcode opcode, bool compressed) {
+      current = opcode == WsOpcode::kText ? "text:" : "binary:";
+      last_compressed = compressed;
+    };
+    callbacks.on_message_data = [this](const uint8_t* data, size_t size, bool final) {
+      current.append(reinterpret_cast<const char*>(data), size);
+      if (final) {
+        messages.push_back(current);
+      }
+    };
+    callbacks.on_control = [this](WsOpcode opcode, const uint8_t* data, size_t size) {
+      controls.push_back(std::to_string(static_cast<int>(opcode)) + ":" +
+                         std::string(reinterpret_cast<const char*>(data), size));
+    };
+    return callbacks;
+  }
+};
+
+// Feeds `stream` in pieces of `piece` bytes (all of it when 0).
+bool FeedInPieces(std::vector<uint8_t> stream, size_t piece, Transcript* transcript, std::string* error) {
+  bridge::WebSocketReader reader(transcript->Callbacks());
+  if (piece == 0) {
+    piece = stream.size();
+  }
+  for (size_t offset = 0; offset < stream.size(); offset += piece) {
+    const size_t size = std::min(piece, stream.size() - offset);
+    if (!reader.Feed(stream.data() + offset, size, error)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void TestRoundTrip() {
+  const std::string medium(300, 'm');
+  const std::string large(70000, 'L');
+  std::vector<uint8_t> stream;
+  Append(&stream, ClientFrame(0x81, "hello"));
+  // A text message in three fragments with a ping between them.
+  Append(&stream, ClientFrame(0x01, "frag"));
+  Append(&stream, ClientFrame(0x89, "are you there"));
+  Append(&stream, ClientFrame(0x00, "men"));
+  Append(&stream, ClientFrame(0x80, "ted"));
+  Append(&stream, ClientFrame(0x82, medium));
+  Append(&stream, ClientFrame(0x82, large));
+  Append(&stream, ClientFrame(0x81, ""));
+  Append(&stream, ClientFrame(0x88, "\x03\xE8"));
+
+  for (const size_t piece : {size_t{0}, size_t{1}, size_t{7}, size_t{4096}}) {
+    Transcript transcript;
+    std::string error;
+    CHECK(FeedInPieces(stream, piece, &transcript, &error));
+    CHECK(transcript.messages.size() == 5);
+    if (transcript.messages.size() == 5) {
+      CHECK(transcript.messages[0] == "text:hello");
+      CHECK(transcript.messages[1] == "text:fragmented");
+      CHECK(transcript.messages[2] == "binary:" + medium);
+      CHECK(transcript.messages[3] == "binary:" + large);
+      CHECK(transcript.messages[4] == "text:");
+    }
+    CHECK(transcript.controls.size() == 2);
+    if (transcript.controls.size() == 2) {
+      CHECK(transcript.controls[0] == "9:are you there");
+      CHECK(transcript.controls[1] == "8:\x03\xE8");
+    }
+  }
+}
+
+// The bridge's own (unmasked) server frames read back the same.
+void TestServerHeaderRoundTrip() {
+  for (const size_t size : {size_t{0}, size_t{125}, size_t{126}, size_t{65535}, size_t{65536}}) {
+    std::vector<uint8_t> frame(bridge::kMaxWsHeaderBytes + size, 'x');
+    const size_t header = bridge::EncodeWebSocketHeader(frame.data(), WsOpcode::kBinary, size);
+    frame.erase(frame.begin() + static_cast<std::ptrdiff_t>(header),
+                frame.begin() + static_cast<std::ptrdiff_t>(bridge::kMaxWsHeaderBytes));
+    Transcript transcript;
+    std::string error;
+    CHECK(FeedInPieces(frame, 3, &transcript, &error));
+    CHECK(transcript.messages.size() == 1 && transcript.messages[0] == "binary:" + std::string(size, 'x'));
+  }
+}
+
+void TestCompressedBit() {
+  Transcript transcript;
+  bridge::WebSocketReader reader(transcript.Callbacks());
+  std::string error;
+  std::vector<uint8_t> frame = ClientFrame(0xC1, "zz");
+  CHECK(!reader.Feed(frame.data(), frame.size(), &error));
+
+  reader.Reset();
+  reader.set_allow_compressed(true);
+  frame = ClientFrame(0xC1, "zz");
+  CHECK(reader.Feed(frame.data(), frame.size(), &error));
+  CHECK(transcript.last_compressed);
+  // RSV1 is never allowed on a control frame.
+  frame = ClientFrame(0xC9, "");
+  CHECK(!reader.Feed(frame.data(), frame.size(), &error));
+}
+
+void TestMalformed() {
+  std::vector<uint8_t> oversized_length = {0x82, 0x80 | 127, 0x80, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0};
+  const std::vector<std::vector<uint8_t>> streams = {
+      ClientFrame(0xA1, "rsv2"),
+      ClientFrame(0x91, "rsv3"),
+      ClientFrame(0x83, "opcode 3"),
+      ClientFrame(0x8B, "opcode 11"),
+      ClientFrame(0x09, "unfinished ping"),
+      ClientFrame(0x89, std::string(126, 'p')),
+      ClientFrame(0x80, "continuation first"),
+      [] {
+        std::vector<uint8_t> stream = ClientFrame(0x01, "first half");
+        Append(&stream, ClientFrame(0x81, "new message"));
+        return stream;
+      }(),
+      oversized_length,
+  };
+  for (const std::vector<uint8_t>& stream : streams) {
+    for (const size_t piece : {size_t{0}, size_t{1}}) {
+      Transcript transcript;
+      std::string error;
+      CHECK(!FeedInPieces(stream, piece, &transcript, &error));
+      CHECK(!error.empty());
+    }
+  }
+}
+
+// Decodes the body of a JSON string (after the opening quote), split once at
+// `split`. Returns false if the decoder rejected it or never saw the quote.
+bool DecodeSplit(std::string_view body, size_t split, std::string* out) {
+  bridge::JsonStringStreamDecoder decoder;
+  out->clear();
+  size_t total = 0;
+  for (const std::string_view piece : {body.substr(0, split), body.substr(split)}) {
+    size_t consumed = 0;
+    if (!decoder.Decode(piece.data(), piece.size(), &consumed, out)) {
+      return false;
+    }
+    total += consumed;
+    if (decoder.done()) {
+      break;
+    }
+  }
+  return decoder.done() && total == body.size();
+}
+
+void TestJsonStringStream() {
+  const std::pair<std::string_view, std::string_view> good[] = {
+      {"plain\"", "plain"},
+      {"\"", ""},
+      {"tab\\tquote\\\"slash\\/back\\\\\"", "tab\tquote\"slash/back\\"},
+      {"\\u00e9\\u20AC\"", "\xC3\xA9\xE2\x82\xAC"},
+      {"\\ud83d\\ude00!\"", "\xF0\x9F\x98\x80!"},
+      {"caf\xC3\xA9\"", "caf\xC3\xA9"},
+  };
+  for (const auto& [body, expected] : good) {
+    for (size_t split = 0; split <= body.size(); ++split) {
+      std::string out;
+      CHECK(DecodeSplit(body, split, &out));
+      CHECK(out == expected);
+    }
+  }
+
+  const std::string_view bad[] = {
+      "\\x\"",
+      "\\u12G4\"",
+      "\\ud800\"",
+      "\\ud800x\"",
+      "\\ud800\\n\"",
+      "\\ud800\\u0041\"",
+      "\\udc00\"",
+      "raw\x01\"",
+      "new\nline\"",
+  };
+  for (const std::string_view body : bad) {
+    for (size_t split = 0; split <= body.size(); ++split) {
+      std::string out;
+      CHECK(!DecodeSplit(body, split, &out));
+    }
+  }
+}
+
+}  // namespace
+
+int main() {
+  TestRoundTrip();
+  TestServerHeaderRoundTrip();
+  TestCompressedBit();
+  TestMalformed();
+  TestJsonStringStream();
+  return bridge_test::TestResult();
+}